@@ -0,0 +1,145 @@
+// Throughput of NcaWriter on the host for the three shapes of content an install sees: a plain NCA
+// that's passed through, a solid NCZ and a block NCZ with several sections. Each is fed at a few
+// chunk sizes, the size of the pieces a source hands over, since that decides how often the
+// writer has to stop and flush. Placeholder writes are counted but not kept so only the writer is
+// measured. Allocations are those made through operator new, slabs from memalign aren't counted.
+// Run with --quick for a smoke test on small inputs.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "host/content_store.hpp"
+#include "host/synthetic.hpp"
+#include "nx/nca_writer.h"
+
+namespace
+{
+    std::atomic<u64> g_allocCount = 0;
+    std::atomic<u64> g_allocBytes = 0;
+}
+
+void* operator new(size_t size)
+{
+    g_allocCount.fetch_add(1, std::memory_order_relaxed);
+    g_allocBytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace
+{
+    struct Input
+    {
+        std::string name;
+        NcmContentId contentId;
+        u64 ncaSize;
+        std::vector<u8> data;
+    };
+
+    void RunCase(const Input& input, size_t chunkSize, int iterations)
+    {
+        auto storage = std::make_shared<nx::ncm::ContentStorage>(NcmStorageId_SdCard);
+        double bestSeconds = 0;
+        u64 allocCount = 0;
+        u64 allocBytes = 0;
+
+        for (int i = 0; i < iterations; i++)
+        {
+            host::ContentStore::Get(NcmStorageId_SdCard).Reset();
+            host::ContentStore::Get(NcmStorageId_SdCard).SetKeepData(false);
+
+            u64 startCount = g_allocCount.load();
+            u64 startBytes = g_allocBytes.load();
+            auto start = std::chrono::steady_clock::now();
+
+            {
+                NcaWriter writer(input.contentId, storage, true);
+
+                for (size_t offset = 0; offset < input.data.size(); offset += chunkSize)
+                    writer.write(input.data.data() + offset, std::min(chunkSize, input.data.size() - offset));
+
+                if (!writer.close())
+                {
+                    std::fprintf(stderr, "%s: the written NCA didn't match its content id\n", input.name.c_str());
+                    std::exit(1);
+                }
+            }
+
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (i == 0 || seconds < bestSeconds)
+            {
+                bestSeconds = seconds;
+                allocCount = g_allocCount.load() - startCount;
+                allocBytes = g_allocBytes.load() - startBytes;
+            }
+        }
+
+        // Throughput is of the NCA installed, not of the (smaller) compressed input
+        std::printf("%-14s %9zu KB %10.1f MB/s %17lu %18.1f MB\n", input.name.c_str(), chunkSize / 1024,
+            input.ncaSize / bestSeconds / 1e6, (unsigned long)allocCount, allocBytes / 1e6);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+    u64 bodySize = quick ? 0x400000 : 0x10000000;
+    int iterations = quick ? 1 : 3;
+
+    host::SyntheticNca nca = host::MakeNca(bodySize, 4, 0x5eed);
+    host::NczOptions blockOptions;
+    blockOptions.blocks = true;
+    blockOptions.blockSizeExponent = 17;
+
+    std::vector<Input> inputs;
+    inputs.push_back({"raw NCA", nca.contentId, nca.nca.size(), nca.nca});
+    inputs.push_back({"solid NCZ", nca.contentId, nca.nca.size(), host::MakeNcz(nca, {})});
+    inputs.push_back({"block NCZ", nca.contentId, nca.nca.size(), host::MakeNcz(nca, blockOptions)});
+
+    std::printf("%.1f MB NCA with %zu sections, best of %d\n\n", nca.nca.size() / 1e6, nca.sections.size(), iterations);
+    std::printf("%-14s %12s %15s %17s %21s\n", "input", "chunk", "throughput", "allocations", "allocated");
+
+    for (const Input& input : inputs)
+    {
+        for (size_t chunkSize : {(size_t)0x4000, (size_t)0x40000, (size_t)0x400000})
+            RunCase(input, chunkSize, iterations);
+    }
+
+    return 0;
+}
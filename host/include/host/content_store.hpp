@@ -0,0 +1,61 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <switch.h>
+
+namespace host
+{
+    // In-memory stand-in for NCM content storage, used by the host build of nx::ncm::ContentStorage.
+    // There is one per storage id, shared by every ContentStorage opened on it as with the real
+    // service. Placeholders are registered by moving their data over to the content id.
+    class ContentStore
+    {
+        public:
+            static ContentStore& Get(NcmStorageId storageId);
+            // Clears every store and puts its settings back to the defaults
+            static void ResetAll();
+
+            void Reset();
+            // Without data kept, writes are only bounds checked and counted. For benchmarks.
+            void SetKeepData(bool keepData);
+            // Writes sleep so they don't go faster than this, 0 for no limit
+            void SetWriteBandwidth(u64 bytesPerSecond);
+            // The write that would take the total past this many bytes throws, 0 for never
+            void SetFailAfter(u64 bytes);
+
+            void CreatePlaceholder(const NcmPlaceHolderId& placeholderId, size_t size);
+            void DeletePlaceholder(const NcmPlaceHolderId& placeholderId);
+            bool HasPlaceholder(const NcmPlaceHolderId& placeholderId);
+            void WritePlaceholder(const NcmPlaceHolderId& placeholderId, u64 offset, const void* buffer, size_t size);
+            void Register(const NcmPlaceHolderId& placeholderId, const NcmContentId& contentId);
+            void Delete(const NcmContentId& contentId);
+            bool Has(const NcmContentId& contentId);
+
+            bool GetPlaceholder(const NcmPlaceHolderId& placeholderId, std::vector<u8>& out);
+            bool GetContent(const NcmContentId& contentId, std::vector<u8>& out);
+            std::vector<NcmContentId> ListContent();
+            u64 GetBytesWritten();
+            // What the kept placeholders and content take up in memory
+            u64 GetBytesStored();
+            u64 GetWriteCount();
+
+        private:
+            struct Entry
+            {
+                std::vector<u8> data;
+                u64 size = 0;
+            };
+
+            std::mutex m_mutex;
+            std::map<std::string, Entry> m_placeholders;
+            std::map<std::string, Entry> m_content;
+            bool m_keepData = true;
+            u64 m_writeBandwidth = 0;
+            u64 m_failAfter = 0;
+            u64 m_bytesWritten = 0;
+            u64 m_writeCount = 0;
+    };
+}
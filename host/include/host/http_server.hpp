@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <switch.h>
+
+namespace host
+{
+    struct HttpRequest
+    {
+        std::string method;
+        std::string path;
+        // Lower case names
+        std::map<std::string, std::string> headers;
+        bool hasRange = false;
+        u64 rangeStart = 0;
+        // Inclusive, or ~0 for an open ended range
+        u64 rangeEnd = 0;
+    };
+
+    // Makes requests misbehave. A fault applies to the next GETs of its path (any path if empty)
+    // whose range starts at rangeStart (any if ~0), as many times as given.
+    struct HttpFault
+    {
+        std::string path;
+        u64 rangeStart = ~0ULL;
+        u32 times = 1;
+        // Answer with this status and errorBody instead, 0 to answer normally
+        u32 status = 0;
+        std::string errorBody = "error";
+        // Send the whole file with a 200, as a server without range support would
+        bool ignoreRange = false;
+        // Close the connection after this much of the body, ~0 to send all of it
+        u64 dropAfter = ~0ULL;
+        // Rather than closing after dropAfter, keep the connection open and silent until the client gives up
+        bool stall = false;
+    };
+
+    // A local HTTP/1.1 server for range requests, on 127.0.0.1 at a free port. Files get an ETag and
+    // Last-Modified, and conditional requests that still match them get a 304. Each response waits
+    // out the latency before its headers. Bandwidth is limited for the whole link and per connection,
+    // which is what makes a single connection slow against a real server.
+    class HttpServer
+    {
+        public:
+            HttpServer();
+            ~HttpServer();
+
+            HttpServer(const HttpServer&) = delete;
+            HttpServer& operator=(const HttpServer&) = delete;
+
+            void AddFile(const std::string& path, std::shared_ptr<const std::vector<u8>> data);
+            // Changes the file's content and with it the validators
+            void UpdateFile(const std::string& path, std::shared_ptr<const std::vector<u8>> data);
+            std::string GetUrl(const std::string& path);
+
+            void SetLatency(u64 milliseconds);
+            // 0 for no limit
+            void SetBandwidth(u64 bytesPerSecond);
+            void SetConnectionBandwidth(u64 bytesPerSecond);
+            void AddFault(const HttpFault& fault);
+
+            std::vector<HttpRequest> GetRequests();
+            void ClearRequests();
+            u64 GetBytesSent();
+            u32 GetPeakConnections();
+
+        private:
+            struct File
+            {
+                std::shared_ptr<const std::vector<u8>> data;
+                std::string etag;
+                std::string lastModified;
+            };
+
+            void AcceptFunc();
+            void ConnectionFunc(int socket);
+            bool HandleRequest(int socket, const HttpRequest& request, u64& connectionFreeTick);
+            bool Send(int socket, const void* data, size_t size, u64& connectionFreeTick, bool throttle);
+            bool TakeFault(const HttpRequest& request, HttpFault& fault);
+
+            int m_listenSocket = -1;
+            u16 m_port = 0;
+            std::atomic_bool m_stop = false;
+            std::thread m_acceptThread;
+
+            std::mutex m_mutex;
+            std::vector<std::thread> m_connectionThreads;
+            std::vector<int> m_sockets;
+            std::map<std::string, File> m_files;
+            std::vector<HttpFault> m_faults;
+            std::vector<HttpRequest> m_requests;
+            u64 m_latency = 0;
+            u64 m_bandwidth = 0;
+            u64 m_connectionBandwidth = 0;
+            u64 m_linkFreeTick = 0;
+            u64 m_bytesSent = 0;
+            u32 m_connections = 0;
+            u32 m_peakConnections = 0;
+            u32 m_version = 0;
+    };
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <switch.h>
+
+#include "nx/content_meta.hpp"
+
+namespace host
+{
+    struct SyntheticSection
+    {
+        u64 offset = 0;
+        u64 size = 0;
+        // 3 is AES-CTR, anything else is stored as is
+        u8 cryptoType = 3;
+        u8 key[0x10] = {};
+        u8 counter[0x10] = {};
+    };
+
+    // An NCA as it ends up on the console, plus what's needed to compress it into an NCZ
+    struct SyntheticNca
+    {
+        NcmContentId contentId = {};
+        std::vector<u8> nca;
+        // The NCA with every section decrypted, what an NCZ compresses
+        std::vector<u8> plain;
+        std::vector<SyntheticSection> sections;
+    };
+
+    struct NczOptions
+    {
+        // Block compressed NCZs have a block header and independent frames, solid ones a single stream
+        bool blocks = false;
+        u8 blockSizeExponent = 20;
+        int level = 3;
+    };
+
+    // bodySize bytes after the 0x4000 byte header area, split evenly into numSections sections.
+    // The data compresses about as well as game content: zero pages, repeated text and noise.
+    SyntheticNca MakeNca(u64 bodySize, u32 numSections, u32 seed, u8 contentType = NcmContentType_Program, u64 titleId = 0x0100000000010000);
+    std::vector<u8> MakeNcz(const SyntheticNca& nca, const NczOptions& options);
+
+    // A packaged content meta (the .cnmt inside a meta NCA) listing the given NCAs
+    std::vector<u8> MakeCnmt(u64 titleId, u32 version, NcmContentMetaType type, const std::vector<std::pair<NcmContentId, u64>>& contents, const std::vector<u8>& contentTypes);
+
+    using SyntheticFile = std::pair<std::string, std::vector<u8>>;
+
+    std::vector<u8> MakePfs0(const std::vector<SyntheticFile>& files);
+    std::vector<u8> MakeHfs0(const std::vector<SyntheticFile>& files);
+    // A gamecard image whose secure partition holds the files
+    std::vector<u8> MakeXci(const std::vector<SyntheticFile>& files);
+
+    // A meta NCA holding the packaged content meta as "<type>_<title id>.cnmt". Its only section is
+    // stored unencrypted so the host content filesystem can read the cnmt back out of it.
+    SyntheticNca MakeMetaNca(u64 titleId, NcmContentMetaType type, const std::vector<u8>& cnmt);
+
+    // An installable title: its NCAs with the meta NCA last, and a ticket with its certificate
+    struct SyntheticTitle
+    {
+        u64 titleId = 0;
+        std::vector<SyntheticNca> ncas;
+        std::vector<u8> ticket;
+        std::vector<u8> cert;
+    };
+
+    // A base application with a program NCA of about programSize bytes and a small control NCA
+    SyntheticTitle MakeTitle(u64 titleId, u64 programSize, u32 seed);
+    // The files of an NSP or XCI for the title. Compressed packages have the content NCAs as NCZs
+    // (NSZ and XCZ), the meta NCA always stays as it is.
+    std::vector<SyntheticFile> MakePackageFiles(const SyntheticTitle& title, bool compressed, const NczOptions& options = {});
+
+    // The content id the installer expects for an NCA, the first half of its SHA-256
+    NcmContentId GetContentId(const std::vector<u8>& nca);
+}
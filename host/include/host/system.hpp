@@ -0,0 +1,44 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <switch.h>
+
+namespace host
+{
+    struct ApplicationRecord
+    {
+        u64 applicationId = 0;
+        NcmContentMetaKey key = {};
+        u64 storageId = 0;
+    };
+
+    // What an install leaves behind on the console besides content: content meta records, the
+    // application records pushed to ns and the imported tickets. Backs the host ncm, ns and es calls.
+    class System
+    {
+        public:
+            static System& Get();
+
+            // Clears the records, along with every ContentStore
+            void Reset();
+
+            void SetMeta(NcmStorageId storageId, const NcmContentMetaKey& key, const void* data, size_t size);
+            bool GetMeta(NcmStorageId storageId, const NcmContentMetaKey& key, std::vector<u8>& out);
+            std::vector<NcmContentMetaKey> ListMeta(NcmStorageId storageId);
+
+            void PushApplicationRecord(const ApplicationRecord& record);
+            std::vector<ApplicationRecord> GetApplicationRecords();
+
+            void ImportTicket(const void* ticket, size_t ticketSize);
+            std::vector<std::vector<u8>> GetTickets();
+
+        private:
+            std::mutex m_mutex;
+            std::map<NcmStorageId, std::map<std::string, std::pair<NcmContentMetaKey, std::vector<u8>>>> m_meta;
+            std::vector<ApplicationRecord> m_applicationRecords;
+            std::vector<std::vector<u8>> m_tickets;
+    };
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <switch.h>
+
+namespace host
+{
+    // The PC end of a USB install, behind the host awoo_usbComms* calls. It speaks the TUC0 command
+    // protocol and answers file range requests (command 1) from the files it was given. Every
+    // request costs a round trip of latency, data then arrives no faster than the bandwidth and at
+    // most one transfer's worth per read, as over the real endpoint.
+    class UsbHost
+    {
+        public:
+            static UsbHost& Get();
+
+            // Drops the files and puts the settings back to the defaults
+            void Reset();
+
+            void AddFile(const std::string& name, std::shared_ptr<const std::vector<u8>> data);
+            void SetLatency(u64 nanoseconds);
+            // 0 for no limit
+            void SetBandwidth(u64 bytesPerSecond);
+            void SetMaxTransferSize(size_t size);
+
+            u64 GetRequestCount();
+            u64 GetBytesSent();
+
+            // What the console writes to and reads from the endpoint
+            size_t Write(const void* buffer, size_t size);
+            size_t Read(void* buffer, size_t size, u64 timeout);
+
+        private:
+            struct Response
+            {
+                std::vector<u8> header;
+                std::shared_ptr<const std::vector<u8>> data;
+                u64 offset = 0;
+                u64 size = 0;
+                // Nothing of it can be read before this tick
+                u64 readyTick = 0;
+            };
+
+            void HandleCommand();
+
+            std::mutex m_mutex;
+            std::condition_variable m_responseReady;
+            std::map<std::string, std::shared_ptr<const std::vector<u8>>> m_files;
+            std::vector<u8> m_command;
+            std::deque<Response> m_responses;
+            u64 m_latency = 0;
+            u64 m_bandwidth = 0;
+            size_t m_maxTransferSize = 0x800000;
+            u64 m_linkFreeTick = 0;
+            u64 m_requestCount = 0;
+            u64 m_bytesSent = 0;
+    };
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <endian.h>
+#include <byteswap.h>
+
+// newlib's names for the byte swaps
+#define __bswap16(x) bswap_16(x)
+#define __bswap32(x) bswap_32(x)
+#define __bswap64(x) bswap_64(x)
@@ -0,0 +1,383 @@
+// Host stand-in for libnx. Only what the installer uses is declared: the ncm/ns/fs types are laid
+// out as in libnx, crypto is backed by OpenSSL and ticks by the host's monotonic clock. Content
+// storage, the content meta database, ns, es and content filesystems are backed by host::ContentStore
+// and host::System, other services report failure.
+#pragma once
+
+#include <switch/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// arm/counter.h
+
+#define HOST_SYSTEM_TICK_FREQ 19200000
+
+u64 armGetSystemTick(void);
+
+static inline u64 armGetSystemTickFreq(void)
+{
+    return HOST_SYSTEM_TICK_FREQ;
+}
+
+static inline u64 armNsToTicks(u64 ns)
+{
+    return (ns * 12) / 625;
+}
+
+static inline u64 armTicksToNs(u64 tick)
+{
+    return (tick * 625) / 12;
+}
+
+// kernel/svc.h
+
+#define CUR_THREAD_HANDLE 0xFFFF8000
+
+void svcSleepThread(s64 nano);
+Result svcSetThreadCoreMask(Handle handle, s32 core_id, u32 affinity_mask);
+
+// sf/service.h
+
+typedef struct Service
+{
+    Handle session;
+    u32 own_handle;
+    u32 object_id;
+    u16 pointer_buffer_size;
+} Service;
+
+void serviceClose(Service* s);
+
+typedef struct Uuid
+{
+    u8 uuid[0x10];
+} Uuid;
+
+// services/applet.h, hid.h
+
+Result appletSetMediaPlaybackState(bool state);
+
+#define HidNpadButton_B BIT(1)
+
+// services/fs.h. Content filesystems are read from the host ContentStore, see host/source/fs.cpp.
+
+#define FS_MAX_PATH 0x301
+
+typedef struct FsRightsId
+{
+    u8 c[0x10];
+} FsRightsId;
+
+typedef enum
+{
+    FsOpenMode_Read = BIT(0),
+    FsOpenMode_Write = BIT(1),
+    FsOpenMode_Append = BIT(2),
+} FsOpenMode;
+
+typedef enum
+{
+    FsDirEntryType_Dir = 0,
+    FsDirEntryType_File = 1,
+} FsDirEntryType;
+
+typedef enum
+{
+    FsFileSystemType_Logo = 2,
+    FsFileSystemType_ContentControl = 3,
+    FsFileSystemType_ContentManual = 4,
+    FsFileSystemType_ContentMeta = 5,
+    FsFileSystemType_ContentData = 6,
+    FsFileSystemType_ApplicationPackage = 7,
+} FsFileSystemType;
+
+typedef struct FsFileSystem
+{
+    Service s;
+} FsFileSystem;
+
+typedef struct FsFile
+{
+    Service s;
+} FsFile;
+
+typedef struct FsDir
+{
+    Service s;
+} FsDir;
+
+typedef struct FsDirectoryEntry
+{
+    char name[FS_MAX_PATH];
+    u8 pad[3];
+    s8 type;
+    u8 pad2[3];
+    s64 file_size;
+} FsDirectoryEntry;
+
+typedef enum
+{
+    FsContentAttributes_None = 0x0,
+    FsContentAttributes_All = 0xF,
+} FsContentAttributes;
+
+typedef enum
+{
+    FsReadOption_None = 0,
+} FsReadOption;
+
+typedef enum
+{
+    FsDirOpenMode_ReadDirs = BIT(0),
+    FsDirOpenMode_ReadFiles = BIT(1),
+} FsDirOpenMode;
+
+Result fsOpenSdCardFileSystem(FsFileSystem* out);
+Result fsOpenFileSystemWithId(FsFileSystem* out, u64 id, FsFileSystemType fsType, const char* contentPath, FsContentAttributes attr);
+void fsFsClose(FsFileSystem* fs);
+Result fsFsOpenFile(FsFileSystem* fs, const char* path, u32 mode, FsFile* out);
+Result fsFsOpenDirectory(FsFileSystem* fs, const char* path, u32 mode, FsDir* out);
+Result fsFileRead(FsFile* f, s64 off, void* buf, u64 read_size, u32 option, u64* bytes_read);
+Result fsFileGetSize(FsFile* f, s64* out);
+void fsFileClose(FsFile* f);
+Result fsDirRead(FsDir* d, s64* total_entries, size_t max_entries, FsDirectoryEntry* buf);
+Result fsDirGetEntryCount(FsDir* d, s64* count);
+void fsDirClose(FsDir* d);
+
+// services/ncm_types.h
+
+typedef enum
+{
+    NcmStorageId_None = 0,
+    NcmStorageId_Host = 1,
+    NcmStorageId_GameCard = 2,
+    NcmStorageId_BuiltInSystem = 3,
+    NcmStorageId_BuiltInUser = 4,
+    NcmStorageId_SdCard = 5,
+    NcmStorageId_Any = 6,
+} NcmStorageId;
+
+typedef enum
+{
+    NcmContentType_Meta = 0,
+    NcmContentType_Program = 1,
+    NcmContentType_Data = 2,
+    NcmContentType_Control = 3,
+    NcmContentType_HtmlDocument = 4,
+    NcmContentType_LegalInformation = 5,
+    NcmContentType_DeltaFragment = 6,
+} NcmContentType;
+
+typedef enum
+{
+    NcmContentMetaType_Unknown = 0x0,
+    NcmContentMetaType_SystemProgram = 0x1,
+    NcmContentMetaType_SystemData = 0x2,
+    NcmContentMetaType_SystemUpdate = 0x3,
+    NcmContentMetaType_BootImagePackage = 0x4,
+    NcmContentMetaType_BootImagePackageSafe = 0x5,
+    NcmContentMetaType_Application = 0x80,
+    NcmContentMetaType_Patch = 0x81,
+    NcmContentMetaType_AddOnContent = 0x82,
+    NcmContentMetaType_Delta = 0x83,
+    NcmContentMetaType_DataPatch = 0x84,
+} NcmContentMetaType;
+
+typedef enum
+{
+    NcmContentInstallType_Full = 0x0,
+    NcmContentInstallType_FragmentOnly = 0x1,
+    NcmContentInstallType_Unknown = 0x7,
+} NcmContentInstallType;
+
+typedef struct NcmContentId
+{
+    u8 c[0x10];
+} NcmContentId;
+
+typedef struct NcmPlaceHolderId
+{
+    Uuid uuid;
+} NcmPlaceHolderId;
+
+typedef struct NcmContentInfo
+{
+    NcmContentId content_id;
+    u32 size_low;
+    u8 size_high;
+    u8 attr;
+    u8 content_type;
+    u8 id_offset;
+} NcmContentInfo;
+
+typedef struct NcmContentMetaKey
+{
+    u64 id;
+    u32 version;
+    u8 type;
+    u8 install_type;
+    u8 padding[2];
+} NcmContentMetaKey;
+
+typedef struct NcmContentMetaHeader
+{
+    u16 extended_header_size;
+    u16 content_count;
+    u16 content_meta_count;
+    u8 attributes;
+    u8 storage_id;
+} NcmContentMetaHeader;
+
+typedef struct NcmApplicationMetaExtendedHeader
+{
+    u64 patch_id;
+    u32 required_system_version;
+    u32 required_application_version;
+} NcmApplicationMetaExtendedHeader;
+
+typedef struct NcmPatchMetaExtendedHeader
+{
+    u64 application_id;
+    u32 required_system_version;
+    u32 extended_data_size;
+    u64 reserved;
+} NcmPatchMetaExtendedHeader;
+
+typedef struct NcmAddOnContentMetaExtendedHeader
+{
+    u64 application_id;
+    u32 required_application_version;
+    u32 padding;
+} NcmAddOnContentMetaExtendedHeader;
+
+static inline void ncmContentInfoSizeToU64(const NcmContentInfo* info, u64* out)
+{
+    *out = ((u64)info->size_high << 32) | info->size_low;
+}
+
+static inline void ncmU64ToContentInfoSize(const u64 size, NcmContentInfo* info)
+{
+    info->size_low = size & 0xFFFFFFFF;
+    info->size_high = (u8)(size >> 32);
+}
+
+// services/ncm.h. The host ContentStorage doesn't go through these, the meta databases are kept by
+// host::System.
+
+typedef struct NcmContentStorage
+{
+    Service s;
+} NcmContentStorage;
+
+typedef struct NcmContentMetaDatabase
+{
+    Service s;
+} NcmContentMetaDatabase;
+
+Result ncmInitialize(void);
+void ncmExit(void);
+Result ncmOpenContentMetaDatabase(NcmContentMetaDatabase* out_db, NcmStorageId storage_id);
+void ncmContentMetaDatabaseClose(NcmContentMetaDatabase* db);
+Result ncmContentMetaDatabaseSet(NcmContentMetaDatabase* db, const NcmContentMetaKey* key, const void* data, u64 data_size);
+Result ncmContentMetaDatabaseCommit(NcmContentMetaDatabase* db);
+Result ncmContentMetaDatabaseList(NcmContentMetaDatabase* db, s32* out_entries_total, s32* out_entries_written, NcmContentMetaKey* out_keys, s32 count, NcmContentMetaType meta_type, u64 id, u64 id_min, u64 id_max, NcmContentInstallType install_type);
+
+// services/ns.h, nacp.h
+
+typedef struct NacpLanguageEntry
+{
+    char name[0x200];
+    char author[0x100];
+} NacpLanguageEntry;
+
+typedef struct NacpStruct
+{
+    NacpLanguageEntry lang[16];
+    u8 rest[0x1000];
+} NacpStruct;
+
+typedef struct NsApplicationControlData
+{
+    NacpStruct nacp;
+    u8 icon[0x20000];
+} NsApplicationControlData;
+
+typedef enum
+{
+    NsApplicationControlSource_CacheOnly = 0,
+    NsApplicationControlSource_Storage = 1,
+    NsApplicationControlSource_StorageOnly = 2,
+} NsApplicationControlSource;
+
+typedef struct NsApplicationContentMetaStatus
+{
+    u8 meta_type;
+    u8 storageID;
+    u8 unk_x02;
+    u8 padding;
+    u32 version;
+    u64 application_id;
+} NsApplicationContentMetaStatus;
+
+Result nsInitialize(void);
+void nsExit(void);
+Result nsGetApplicationControlData(NsApplicationControlSource source, u64 application_id, NsApplicationControlData* buffer, size_t size, u64* actual_size);
+Result nsCountApplicationContentMeta(u64 application_id, s32* out);
+Result nsListApplicationContentMetaStatus(u64 application_id, s32 index, NsApplicationContentMetaStatus* list, s32 count, s32* out_entrycount);
+Result nacpGetLanguageEntry(NacpStruct* nacp, NacpLanguageEntry** langentry);
+
+// services/spl.h. The host has no console keys, these derive fixed stand-ins from their inputs.
+
+Result splCryptoGenerateAesKek(const void* wrapped_kek, u32 key_generation, u32 option, void* out_sealed_kek);
+Result splCryptoGenerateAesKey(const void* sealed_kek, const void* source, void* out_sealed_key);
+
+// crypto/sha256.h
+
+#define SHA256_HASH_SIZE 0x20
+
+// Holds OpenSSL's SHA256_CTX
+typedef struct Sha256Context
+{
+    u64 state[16];
+} Sha256Context;
+
+void sha256ContextCreate(Sha256Context* out);
+void sha256ContextUpdate(Sha256Context* ctx, const void* src, size_t size);
+void sha256ContextGetHash(Sha256Context* ctx, void* dst);
+void sha256CalculateHash(void* dst, const void* src, size_t size);
+
+// crypto/aes_ctr.h, aes_xts.h
+
+#define AES_BLOCK_SIZE 0x10
+#define AES_128_KEY_SIZE 0x10
+
+typedef struct Aes128CtrContext
+{
+    u8 key[AES_128_KEY_SIZE];
+    u8 ctr[AES_BLOCK_SIZE];
+    u8 enc_ctr_buffer[AES_BLOCK_SIZE];
+    size_t buffer_offset;
+} Aes128CtrContext;
+
+void aes128CtrContextCreate(Aes128CtrContext* out, const void* key, const void* ctr);
+void aes128CtrContextResetCtr(Aes128CtrContext* ctx, const void* ctr);
+void aes128CtrCrypt(Aes128CtrContext* ctx, void* dst, const void* src, size_t size);
+
+typedef struct Aes128XtsContext
+{
+    u8 key[AES_128_KEY_SIZE];
+    u8 tweak_key[AES_128_KEY_SIZE];
+    u8 tweak[AES_BLOCK_SIZE];
+    bool is_encryptor;
+} Aes128XtsContext;
+
+void aes128XtsContextCreate(Aes128XtsContext* out, const void* key0, const void* key1, bool is_encryptor);
+void aes128XtsContextResetSector(Aes128XtsContext* ctx, u64 sector, bool is_nintendo);
+size_t aes128XtsEncrypt(Aes128XtsContext* ctx, void* dst, const void* src, size_t size);
+size_t aes128XtsDecrypt(Aes128XtsContext* ctx, void* dst, const void* src, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
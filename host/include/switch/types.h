@@ -0,0 +1,31 @@
+// Host stand-in for the parts of libnx's switch/types.h the installer uses
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef volatile u8 vu8;
+typedef volatile u32 vu32;
+typedef volatile u64 vu64;
+
+typedef u32 Result;
+typedef u32 Handle;
+
+#define BIT(n) (1U<<(n))
+#define NX_PACKED __attribute__((packed))
+#define NX_INLINE __attribute__((always_inline)) static inline
+#define NX_CONSTEXPR static constexpr
+
+#define R_SUCCEEDED(res) ((res) == 0)
+#define R_FAILED(res) ((res) != 0)
+#define R_VALUE(res) (res)
+#define MAKERESULT(module, description) ((((module) & 0x1FF)) | ((description) & 0x1FFF) << 9)
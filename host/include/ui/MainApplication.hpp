@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <switch/types.h>
+
+// Host stand-in for the application, with what the installer core asks of it: dialogs, answered
+// with a preset option, and buttons, of which none are ever pressed.
+namespace inst::ui {
+    class MainApplication
+    {
+        public:
+            // The option every dialog returns, 1 accepts the NCA signature prompt
+            int dialogAnswer = 1;
+
+            int CreateShowDialog(const std::string& title, const std::string& content, const std::vector<std::string>& options, bool useLastOptionAsCancel, const std::string& icon = "");
+            void UpdateButtons();
+            u64 GetButtonsDown();
+    };
+
+    extern MainApplication* mainApp;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+// Host stand-in for the install screen, progress updates go nowhere
+namespace inst::ui {
+    class instPage
+    {
+        public:
+            static void setTopInstInfoText(std::string ourText);
+            static void setInstInfoText(std::string ourText);
+            static void setInstBarPerc(double ourPercent);
+            static void setInstallIcon(const std::string& imagePath);
+            static void clearInstallIcon();
+            static void loadMainMenu();
+            static void loadInstallScreen();
+    };
+}
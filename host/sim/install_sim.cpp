@@ -0,0 +1,290 @@
+// End to end installs on the host: NSPInstall and XCIInstallTask run against synthetic NSP, NSZ,
+// XCI and XCZ packages served over HTTP by a local range server and over USB by the fake TUC0
+// host. The links are slowed down to something like the real ones so the sources' pipelining
+// shows. Every install is checked against the NCAs it should have produced, then reported with
+// its wall time, peak memory and the throughput of each stage. Peak memory is the most the heap
+// held over what it did before the first install, less the content storage, which the console
+// keeps on the SD card. Buffers kept between installs are counted for every install after.
+// Run with --quick for a smoke test on a small title without link limits.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <malloc.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <curl/curl.h>
+
+#include "host/content_store.hpp"
+#include "host/http_server.hpp"
+#include "host/synthetic.hpp"
+#include "host/system.hpp"
+#include "host/usb_host.hpp"
+#include "install/http_nsp.hpp"
+#include "install/http_xci.hpp"
+#include "install/install_nsp.hpp"
+#include "install/install_telemetry.hpp"
+#include "install/install_xci.hpp"
+#include "install/usb_nsp.hpp"
+#include "install/usb_xci.hpp"
+#include "util/config.hpp"
+
+namespace
+{
+    static const u64 TITLE_ID = 0x0100000000010000;
+
+    struct Package
+    {
+        std::string name;
+        bool xci = false;
+        std::shared_ptr<const std::vector<u8>> data;
+    };
+
+    struct Settings
+    {
+        u64 programSize = 0x10000000;
+        u64 httpLatency = 20;
+        u64 httpBandwidth = 60000000;
+        u64 httpConnectionBandwidth = 15000000;
+        u64 usbLatency = 1;
+        u64 usbBandwidth = 35000000;
+    };
+
+    std::string FormatLatency(u64 milliseconds)
+    {
+        return milliseconds ? std::to_string(milliseconds) + " ms" : "no";
+    }
+
+    std::string FormatBandwidth(u64 bytesPerSecond)
+    {
+        return bytesPerSecond ? std::to_string(bytesPerSecond / 1000000) + " MB/s" : "unlimited";
+    }
+
+    // Samples the heap while an install runs
+    class MemorySampler
+    {
+        public:
+            explicit MemorySampler(u64 baseline) :
+                m_baseline(baseline), m_thread([this]() { SampleFunc(); })
+            {
+            }
+
+            ~MemorySampler()
+            {
+                Stop();
+            }
+
+            u64 Stop()
+            {
+                if (m_thread.joinable())
+                {
+                    m_stop = true;
+                    m_thread.join();
+                }
+
+                return m_peak > m_baseline ? m_peak - m_baseline : 0;
+            }
+
+            static u64 GetHeapSize()
+            {
+                struct mallinfo2 info = mallinfo2();
+                u64 stored = host::ContentStore::Get(NcmStorageId_SdCard).GetBytesStored();
+                u64 heap = info.uordblks + info.hblkhd;
+                return heap > stored ? heap - stored : 0;
+            }
+
+        private:
+            void SampleFunc()
+            {
+                while (!m_stop)
+                {
+                    m_peak = std::max(m_peak.load(), GetHeapSize());
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                }
+            }
+
+            u64 m_baseline;
+            std::atomic<u64> m_peak = 0;
+            std::atomic_bool m_stop = false;
+            std::thread m_thread;
+    };
+
+    bool Verify(const host::SyntheticTitle& title)
+    {
+        for (auto& nca : title.ncas)
+        {
+            std::vector<u8> content;
+
+            if (!host::ContentStore::Get(NcmStorageId_SdCard).GetContent(nca.contentId, content) || content != nca.nca)
+                return false;
+        }
+
+        return host::System::Get().ListMeta(NcmStorageId_SdCard).size() == 1 && host::System::Get().GetApplicationRecords().size() == 1 && host::System::Get().GetTickets().size() == 1;
+    }
+
+    bool Run(const std::string& source, const Package& package, const host::SyntheticTitle& title, const std::string& url, u64 heapBaseline)
+    {
+        host::System::Get().Reset();
+
+        auto start = std::chrono::steady_clock::now();
+        MemorySampler sampler(heapBaseline);
+        std::string stages;
+        std::string error;
+
+        try
+        {
+            std::unique_ptr<tin::install::Install> installTask;
+
+            if (package.xci)
+            {
+                std::shared_ptr<tin::install::xci::XCI> xci;
+
+                if (source == "http")
+                    xci = std::make_shared<tin::install::xci::HTTPXCI>(url);
+                else
+                    xci = std::make_shared<tin::install::xci::USBXCI>(package.name);
+
+                installTask = std::make_unique<tin::install::xci::XCIInstallTask>(NcmStorageId_SdCard, false, xci);
+            }
+            else
+            {
+                std::shared_ptr<tin::install::nsp::NSP> nsp;
+
+                if (source == "http")
+                    nsp = std::make_shared<tin::install::nsp::HTTPNSP>(url);
+                else
+                    nsp = std::make_shared<tin::install::nsp::USBNSP>(package.name);
+
+                installTask = std::make_unique<tin::install::nsp::NSPInstall>(NcmStorageId_SdCard, false, nsp);
+            }
+
+            installTask->Prepare();
+            installTask->Begin();
+            // The telemetry is reset by the next install
+            stages = tin::install::InstallTelemetry::Get().GetOverlayText();
+        }
+        catch (std::exception& e)
+        {
+            error = e.what();
+        }
+
+        u64 peakMemory = sampler.Stop();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (!error.empty())
+        {
+            std::fprintf(stderr, "%s %s: %s\n", source.c_str(), package.name.c_str(), error.c_str());
+            return false;
+        }
+
+        if (!Verify(title))
+        {
+            std::fprintf(stderr, "%s %s: the installed content didn't match the package\n", source.c_str(), package.name.c_str());
+            return false;
+        }
+
+        std::printf("%-6s %-10s %8.2f s %10.1f MB/s %10.1f MB   %s\n", source.c_str(), package.name.c_str(), seconds,
+            package.data->size() / seconds / 1e6, peakMemory / 1e6, stages.c_str());
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Settings settings;
+    bool quick = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--quick")
+        {
+            quick = true;
+            settings = { 0x400000, 0, 0, 0, 0, 0 };
+        }
+        else if (i + 1 < argc && arg == "--size-mb")
+            settings.programSize = std::strtoull(argv[++i], NULL, 10) * 0x100000;
+        else if (i + 1 < argc && arg == "--http-latency-ms")
+            settings.httpLatency = std::strtoull(argv[++i], NULL, 10);
+        else if (i + 1 < argc && arg == "--http-mbps")
+            settings.httpBandwidth = std::strtoull(argv[++i], NULL, 10) * 1000000;
+        else if (i + 1 < argc && arg == "--http-connection-mbps")
+            settings.httpConnectionBandwidth = std::strtoull(argv[++i], NULL, 10) * 1000000;
+        else if (i + 1 < argc && arg == "--usb-latency-ms")
+            settings.usbLatency = std::strtoull(argv[++i], NULL, 10);
+        else if (i + 1 < argc && arg == "--usb-mbps")
+            settings.usbBandwidth = std::strtoull(argv[++i], NULL, 10) * 1000000;
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--quick] [--size-mb N] [--http-latency-ms N] [--http-mbps N] [--http-connection-mbps N] [--usb-latency-ms N] [--usb-mbps N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // The installer keeps its journal and stats under the app directory, relative to here
+    std::filesystem::path workDir = std::filesystem::temp_directory_path() / ("install_sim_" + std::to_string(getpid()));
+    std::filesystem::create_directories(workDir / "sdmc:/switch/CyberFoil");
+    std::filesystem::current_path(workDir);
+
+    // The synthetic NCAs aren't signed, their content is compared after each install instead
+    inst::config::validateNCAs = false;
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    host::SyntheticTitle title = host::MakeTitle(TITLE_ID, settings.programSize, 1);
+    host::NczOptions blocks;
+    blocks.blocks = true;
+
+    std::vector<Package> packages;
+    packages.push_back({ "game.nsp", false, std::make_shared<std::vector<u8>>(host::MakePfs0(host::MakePackageFiles(title, false))) });
+    packages.push_back({ "game.nsz", false, std::make_shared<std::vector<u8>>(host::MakePfs0(host::MakePackageFiles(title, true))) });
+    packages.push_back({ "game.xci", true, std::make_shared<std::vector<u8>>(host::MakeXci(host::MakePackageFiles(title, false))) });
+    packages.push_back({ "game.xcz", true, std::make_shared<std::vector<u8>>(host::MakeXci(host::MakePackageFiles(title, true, blocks))) });
+
+    bool ok = true;
+    u64 heapBaseline = MemorySampler::GetHeapSize();
+
+    {
+        host::HttpServer server;
+        server.SetLatency(settings.httpLatency);
+        server.SetBandwidth(settings.httpBandwidth);
+        server.SetConnectionBandwidth(settings.httpConnectionBandwidth);
+
+        host::UsbHost::Get().Reset();
+        host::UsbHost::Get().SetLatency(settings.usbLatency * 1000000);
+        host::UsbHost::Get().SetBandwidth(settings.usbBandwidth);
+
+        for (auto& package : packages)
+        {
+            server.AddFile("/" + package.name, package.data);
+            host::UsbHost::Get().AddFile(package.name, package.data);
+        }
+
+        std::printf("%.1f MB title, HTTP %s latency %s (%s per connection), USB %s latency %s\n\n",
+            (title.ncas[0].nca.size() + title.ncas[1].nca.size()) / 1e6, FormatLatency(settings.httpLatency).c_str(),
+            FormatBandwidth(settings.httpBandwidth).c_str(), FormatBandwidth(settings.httpConnectionBandwidth).c_str(),
+            FormatLatency(settings.usbLatency).c_str(), FormatBandwidth(settings.usbBandwidth).c_str());
+        std::printf("%-6s %-10s %10s %15s %13s   %s\n", "source", "package", "wall", "throughput", "peak memory", "stages");
+
+        for (auto& source : { "http", "usb" })
+        {
+            for (auto& package : packages)
+                ok &= Run(source, package, title, server.GetUrl("/" + package.name), heapBaseline);
+        }
+    }
+
+    curl_global_cleanup();
+    std::filesystem::current_path(workDir.parent_path());
+    std::filesystem::remove_all(workDir);
+
+    if (quick)
+        std::printf("\n--quick: small title, links not limited\n");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#include "ui/MainApplication.hpp"
+#include "ui/instPage.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <curl/curl.h>
+#include "util/lang.hpp"
+#include "util/util.hpp"
+
+// The parts of the application the installer core calls into, in place of source/ui, lang.cpp and util.cpp
+
+namespace inst::ui {
+    static MainApplication g_mainApp;
+    MainApplication* mainApp = &g_mainApp;
+
+    int MainApplication::CreateShowDialog(const std::string& title, const std::string& content, const std::vector<std::string>& options, bool useLastOptionAsCancel, const std::string& icon)
+    {
+        return dialogAnswer;
+    }
+
+    void MainApplication::UpdateButtons()
+    {
+    }
+
+    u64 MainApplication::GetButtonsDown()
+    {
+        return 0;
+    }
+
+    void instPage::setTopInstInfoText(std::string ourText) {}
+    void instPage::setInstInfoText(std::string ourText) {}
+    void instPage::setInstBarPerc(double ourPercent) {}
+    void instPage::setInstallIcon(const std::string& imagePath) {}
+    void instPage::clearInstallIcon() {}
+    void instPage::loadMainMenu() {}
+    void instPage::loadInstallScreen() {}
+}
+
+namespace Language {
+    void Load() {}
+
+    // Messages are shown by their key
+    std::string LanguageEntry(std::string key)
+    {
+        return key;
+    }
+
+    std::string GetRandomMsg()
+    {
+        return "";
+    }
+}
+
+namespace inst::util {
+    // There are no services to bring up and the clocks stay as they are
+    void initInstallServices() {}
+    void deinitInstallServices() {}
+
+    std::vector<uint32_t> setClockSpeed(int deviceToClock, uint32_t clockSpeed)
+    {
+        return { 0, 0 };
+    }
+
+    bool ignoreCaseCompare(const std::string &a, const std::string &b)
+    {
+        const auto case_insensitive_less = [](char x, char y) {
+            return toupper(static_cast<unsigned char>(x)) < toupper(static_cast<unsigned char>(y));
+        };
+
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), case_insensitive_less);
+    }
+
+    std::string shortenString(std::string ourString, int ourLength, bool isFile)
+    {
+        std::string ourExtension = std::filesystem::path(ourString).extension().string();
+        if (ourString.size() - ourExtension.size() > (unsigned long)ourLength) {
+            if (isFile) return ourString.substr(0, ourLength) + "(...)" + ourExtension;
+            else return ourString.substr(0, ourLength) + "...";
+        }
+        return ourString;
+    }
+
+    std::string formatUrlString(std::string ourString)
+    {
+        std::string name = ourString.substr(ourString.find_last_of('/') + 1);
+        int length = 0;
+        char* unescaped = curl_easy_unescape(NULL, name.c_str(), name.size(), &length);
+        std::string result(unescaped, length);
+        curl_free(unescaped);
+        return result;
+    }
+
+    void playAudio(std::string audioPath) {}
+}
@@ -0,0 +1,271 @@
+#include "host/content_store.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include "nx/ncm.hpp"
+#include "util/error.hpp"
+#include "util/title_util.hpp"
+
+namespace host
+{
+    static const NcmStorageId STORAGE_IDS[] = { NcmStorageId_BuiltInUser, NcmStorageId_SdCard };
+
+    static std::string Key(const void* id)
+    {
+        return std::string((const char*)id, 0x10);
+    }
+
+    ContentStore& ContentStore::Get(NcmStorageId storageId)
+    {
+        static ContentStore builtInUser;
+        static ContentStore sdCard;
+
+        if (storageId == NcmStorageId_BuiltInUser)
+            return builtInUser;
+
+        if (storageId == NcmStorageId_SdCard)
+            return sdCard;
+
+        THROW_FORMAT("Storage %u isn't available on the host\n", storageId);
+    }
+
+    void ContentStore::ResetAll()
+    {
+        for (auto storageId : STORAGE_IDS)
+            Get(storageId).Reset();
+    }
+
+    void ContentStore::Reset()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_placeholders.clear();
+        m_content.clear();
+        m_keepData = true;
+        m_writeBandwidth = 0;
+        m_failAfter = 0;
+        m_bytesWritten = 0;
+        m_writeCount = 0;
+    }
+
+    void ContentStore::SetKeepData(bool keepData)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_keepData = keepData;
+    }
+
+    void ContentStore::SetWriteBandwidth(u64 bytesPerSecond)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_writeBandwidth = bytesPerSecond;
+    }
+
+    void ContentStore::SetFailAfter(u64 bytes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_failAfter = bytes;
+    }
+
+    void ContentStore::CreatePlaceholder(const NcmPlaceHolderId& placeholderId, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& entry = m_placeholders[Key(&placeholderId)];
+        entry.size = size;
+        entry.data.clear();
+
+        if (m_keepData)
+            entry.data.resize(size);
+    }
+
+    void ContentStore::DeletePlaceholder(const NcmPlaceHolderId& placeholderId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_placeholders.erase(Key(&placeholderId)))
+            THROW_FORMAT("Failed to delete placeholder. Error code: 0x%08x\n", MAKERESULT(5, 2));
+    }
+
+    bool ContentStore::HasPlaceholder(const NcmPlaceHolderId& placeholderId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_placeholders.count(Key(&placeholderId));
+    }
+
+    void ContentStore::WritePlaceholder(const NcmPlaceHolderId& placeholderId, u64 offset, const void* buffer, size_t size)
+    {
+        u64 bandwidth = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_placeholders.find(Key(&placeholderId));
+
+            if (it == m_placeholders.end())
+                THROW_FORMAT("Failed to write to placeholder. Error code: 0x%08x\n", MAKERESULT(5, 2));
+
+            if (offset + size > it->second.size)
+                THROW_FORMAT("Failed to write to placeholder. Error code: 0x%08x\n", MAKERESULT(5, 3));
+
+            if (m_failAfter && m_bytesWritten + size > m_failAfter)
+                THROW_FORMAT("Failed to write to placeholder. Error code: 0x%08x\n", MAKERESULT(5, 4));
+
+            if (m_keepData)
+                memcpy(it->second.data.data() + offset, buffer, size);
+
+            m_bytesWritten += size;
+            m_writeCount++;
+            bandwidth = m_writeBandwidth;
+        }
+
+        if (bandwidth)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(size * 1000000000 / bandwidth));
+    }
+
+    void ContentStore::Register(const NcmPlaceHolderId& placeholderId, const NcmContentId& contentId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_placeholders.find(Key(&placeholderId));
+
+        if (it == m_placeholders.end() || m_content.count(Key(&contentId)))
+            THROW_FORMAT("Failed to register placeholder NCA. Error code: 0x%08x\n", MAKERESULT(5, 5));
+
+        m_content[Key(&contentId)] = std::move(it->second);
+        m_placeholders.erase(it);
+    }
+
+    void ContentStore::Delete(const NcmContentId& contentId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_content.erase(Key(&contentId)))
+            THROW_FORMAT("Failed to delete registered NCA. Error code: 0x%08x\n", MAKERESULT(5, 6));
+    }
+
+    bool ContentStore::Has(const NcmContentId& contentId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_content.count(Key(&contentId));
+    }
+
+    bool ContentStore::GetPlaceholder(const NcmPlaceHolderId& placeholderId, std::vector<u8>& out)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_placeholders.find(Key(&placeholderId));
+
+        if (it == m_placeholders.end())
+            return false;
+
+        out = it->second.data;
+        return true;
+    }
+
+    bool ContentStore::GetContent(const NcmContentId& contentId, std::vector<u8>& out)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_content.find(Key(&contentId));
+
+        if (it == m_content.end())
+            return false;
+
+        out = it->second.data;
+        return true;
+    }
+
+    std::vector<NcmContentId> ContentStore::ListContent()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<NcmContentId> ids;
+
+        for (auto& content : m_content)
+        {
+            NcmContentId id;
+            memcpy(id.c, content.first.data(), sizeof(id.c));
+            ids.push_back(id);
+        }
+
+        return ids;
+    }
+
+    u64 ContentStore::GetBytesWritten()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bytesWritten;
+    }
+
+    u64 ContentStore::GetBytesStored()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        u64 total = 0;
+
+        for (auto& entry : m_placeholders)
+            total += entry.second.data.capacity();
+
+        for (auto& entry : m_content)
+            total += entry.second.data.capacity();
+
+        return total;
+    }
+
+    u64 ContentStore::GetWriteCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_writeCount;
+    }
+}
+
+// The host build of nx::ncm::ContentStorage, in place of source/nx/ncm.cpp
+namespace nx::ncm
+{
+    ContentStorage::ContentStorage(NcmStorageId storageId) : m_storageId(storageId)
+    {
+        memset(&m_contentStorage, 0, sizeof(m_contentStorage));
+        host::ContentStore::Get(storageId);
+    }
+
+    ContentStorage::~ContentStorage()
+    {
+    }
+
+    void ContentStorage::CreatePlaceholder(const NcmContentId &placeholderId, const NcmPlaceHolderId &registeredId, size_t size)
+    {
+        host::ContentStore::Get(m_storageId).CreatePlaceholder(*(const NcmPlaceHolderId*)&placeholderId, size);
+    }
+
+    void ContentStorage::DeletePlaceholder(const NcmPlaceHolderId &placeholderId)
+    {
+        host::ContentStore::Get(m_storageId).DeletePlaceholder(placeholderId);
+    }
+
+    bool ContentStorage::HasPlaceholder(const NcmPlaceHolderId &placeholderId)
+    {
+        return host::ContentStore::Get(m_storageId).HasPlaceholder(placeholderId);
+    }
+
+    void ContentStorage::WritePlaceholder(const NcmPlaceHolderId &placeholderId, u64 offset, void *buffer, size_t bufSize)
+    {
+        host::ContentStore::Get(m_storageId).WritePlaceholder(placeholderId, offset, buffer, bufSize);
+    }
+
+    void ContentStorage::Register(const NcmPlaceHolderId &placeholderId, const NcmContentId &registeredId)
+    {
+        host::ContentStore::Get(m_storageId).Register(placeholderId, registeredId);
+    }
+
+    void ContentStorage::Delete(const NcmContentId &registeredId)
+    {
+        host::ContentStore::Get(m_storageId).Delete(registeredId);
+    }
+
+    bool ContentStorage::Has(const NcmContentId &registeredId)
+    {
+        return host::ContentStore::Get(m_storageId).Has(registeredId);
+    }
+
+    std::string ContentStorage::GetPath(const NcmContentId &registeredId)
+    {
+        return "@Host:/Contents/" + tin::util::GetNcaIdString(registeredId) + ".nca";
+    }
+
+    NcmStorageId ContentStorage::GetStorageId() const
+    {
+        return m_storageId;
+    }
+}
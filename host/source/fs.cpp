@@ -0,0 +1,268 @@
+#include <switch.h>
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "host/content_store.hpp"
+#include "install/nca.hpp"
+#include "install/pfs0.hpp"
+#include "util/crypto.hpp"
+#include "util/title_util.hpp"
+
+// Content filesystems for the host. Only what the installer opens is supported: the PFS0 in the
+// first section of a registered NCA, which is how it reads the cnmt out of a meta NCA. The section
+// has to be stored unencrypted as the host has no key area keys, host::MakeMetaNca builds them so.
+
+namespace
+{
+    static const u32 MAGIC_PFS0 = 0x30534650;
+    static const char CONTENT_PATH_PREFIX[] = "@Host:/Contents/";
+
+    // libnx's result for content that can't be decrypted, the installer has its own message for it
+    static const Result RESULT_UNREADABLE = 0x236e02;
+    static const Result RESULT_NOT_FOUND = MAKERESULT(2, 1);
+
+    struct HostFile
+    {
+        std::string name;
+        std::vector<u8> data;
+    };
+
+    struct HostFileSystem
+    {
+        std::vector<HostFile> files;
+    };
+
+    struct OpenFile
+    {
+        std::shared_ptr<HostFileSystem> fileSystem;
+        size_t index = 0;
+    };
+
+    std::mutex g_mutex;
+    u32 g_nextHandle = 1;
+    std::map<u32, std::shared_ptr<HostFileSystem>> g_fileSystems;
+    std::map<u32, OpenFile> g_files;
+    std::map<u32, std::shared_ptr<HostFileSystem>> g_dirs;
+
+    bool FindContent(const std::string& path, std::vector<u8>& out)
+    {
+        const size_t prefixSize = sizeof(CONTENT_PATH_PREFIX) - 1;
+
+        if (path.compare(0, prefixSize, CONTENT_PATH_PREFIX) != 0 || path.size() < prefixSize + 32)
+            return false;
+
+        NcmContentId contentId = tin::util::GetNcaIdFromString(path.substr(prefixSize, 32));
+
+        for (auto storageId : { NcmStorageId_SdCard, NcmStorageId_BuiltInUser })
+        {
+            if (host::ContentStore::Get(storageId).GetContent(contentId, out))
+                return true;
+        }
+
+        return false;
+    }
+
+    Result ReadPfs0Section(const std::vector<u8>& nca, HostFileSystem& fileSystem)
+    {
+        if (nca.size() < sizeof(tin::install::NcaHeader))
+            return RESULT_UNREADABLE;
+
+        tin::install::NcaHeader header;
+        Crypto::AesXtr decryptor(Crypto::Keys().headerKey, false);
+        decryptor.decrypt(&header, nca.data(), sizeof(header), 0, 0x200);
+
+        // Anything but a plain section would need the key area decrypted
+        if (header.magic != MAGIC_NCA3 || header.fs_headers[0].crypt_type != 1)
+            return RESULT_UNREADABLE;
+
+        u64 pfs0Offset;
+        memcpy(&pfs0Offset, header.fs_headers[0].superblock_data + 0x38, sizeof(pfs0Offset));
+        u64 offset = (u64)header.section_entries[0].media_start_offset * 0x200 + pfs0Offset;
+
+        if (offset + sizeof(tin::install::PFS0BaseHeader) > nca.size())
+            return RESULT_UNREADABLE;
+
+        auto base = (const tin::install::PFS0BaseHeader*)(nca.data() + offset);
+        u64 entriesOffset = offset + sizeof(tin::install::PFS0BaseHeader);
+        u64 stringTableOffset = entriesOffset + base->numFiles * sizeof(tin::install::PFS0FileEntry);
+        u64 dataOffset = stringTableOffset + base->stringTableSize;
+
+        if (base->magic != MAGIC_PFS0 || dataOffset > nca.size())
+            return RESULT_UNREADABLE;
+
+        for (u32 i = 0; i < base->numFiles; i++)
+        {
+            auto entry = (const tin::install::PFS0FileEntry*)(nca.data() + entriesOffset + i * sizeof(tin::install::PFS0FileEntry));
+
+            if (entry->stringTableOffset >= base->stringTableSize || dataOffset + entry->dataOffset + entry->fileSize > nca.size())
+                return RESULT_UNREADABLE;
+
+            HostFile file;
+            file.name = std::string((const char*)nca.data() + stringTableOffset + entry->stringTableOffset);
+            file.data.assign(nca.begin() + dataOffset + entry->dataOffset, nca.begin() + dataOffset + entry->dataOffset + entry->fileSize);
+            fileSystem.files.push_back(std::move(file));
+        }
+
+        return 0;
+    }
+
+    std::shared_ptr<HostFileSystem> GetFileSystem(FsFileSystem* fs)
+    {
+        auto found = g_fileSystems.find(fs->s.session);
+        return found == g_fileSystems.end() ? nullptr : found->second;
+    }
+}
+
+extern "C"
+{
+    Result fsOpenSdCardFileSystem(FsFileSystem* out)
+    {
+        return RESULT_NOT_FOUND;
+    }
+
+    Result fsOpenFileSystemWithId(FsFileSystem* out, u64 id, FsFileSystemType fsType, const char* contentPath, FsContentAttributes attr)
+    {
+        memset(out, 0, sizeof(*out));
+
+        if (fsType != FsFileSystemType_ContentMeta)
+            return RESULT_NOT_FOUND;
+
+        std::vector<u8> nca;
+
+        if (!FindContent(contentPath, nca))
+            return RESULT_NOT_FOUND;
+
+        auto fileSystem = std::make_shared<HostFileSystem>();
+        Result rc = ReadPfs0Section(nca, *fileSystem);
+
+        if (R_FAILED(rc))
+            return rc;
+
+        std::lock_guard<std::mutex> lock(g_mutex);
+        out->s.session = g_nextHandle++;
+        g_fileSystems[out->s.session] = fileSystem;
+        return 0;
+    }
+
+    void fsFsClose(FsFileSystem* fs)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_fileSystems.erase(fs->s.session);
+        fs->s.session = 0;
+    }
+
+    // The PFS0 is flat, so paths are the root or a file directly in it
+    Result fsFsOpenFile(FsFileSystem* fs, const char* path, u32 mode, FsFile* out)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        auto fileSystem = GetFileSystem(fs);
+
+        if (!fileSystem || path[0] != '/' || mode != FsOpenMode_Read)
+            return RESULT_NOT_FOUND;
+
+        for (size_t i = 0; i < fileSystem->files.size(); i++)
+        {
+            if (fileSystem->files[i].name == path + 1)
+            {
+                out->s.session = g_nextHandle++;
+                g_files[out->s.session] = { fileSystem, i };
+                return 0;
+            }
+        }
+
+        return RESULT_NOT_FOUND;
+    }
+
+    Result fsFsOpenDirectory(FsFileSystem* fs, const char* path, u32 mode, FsDir* out)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        auto fileSystem = GetFileSystem(fs);
+
+        if (!fileSystem || strcmp(path, "/") != 0)
+            return RESULT_NOT_FOUND;
+
+        out->s.session = g_nextHandle++;
+        g_dirs[out->s.session] = fileSystem;
+        return 0;
+    }
+
+    Result fsFileRead(FsFile* f, s64 off, void* buf, u64 read_size, u32 option, u64* bytes_read)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        auto found = g_files.find(f->s.session);
+
+        if (found == g_files.end())
+            return RESULT_NOT_FOUND;
+
+        const std::vector<u8>& data = found->second.fileSystem->files[found->second.index].data;
+        u64 size = off < (s64)data.size() ? std::min(read_size, data.size() - off) : 0;
+        memcpy(buf, data.data() + off, size);
+        *bytes_read = size;
+        return 0;
+    }
+
+    Result fsFileGetSize(FsFile* f, s64* out)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        auto found = g_files.find(f->s.session);
+
+        if (found == g_files.end())
+            return RESULT_NOT_FOUND;
+
+        *out = found->second.fileSystem->files[found->second.index].data.size();
+        return 0;
+    }
+
+    void fsFileClose(FsFile* f)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_files.erase(f->s.session);
+        f->s.session = 0;
+    }
+
+    Result fsDirRead(FsDir* d, s64* total_entries, size_t max_entries, FsDirectoryEntry* buf)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        auto found = g_dirs.find(d->s.session);
+
+        if (found == g_dirs.end())
+            return RESULT_NOT_FOUND;
+
+        auto& files = found->second->files;
+        size_t count = std::min(max_entries, files.size());
+
+        for (size_t i = 0; i < count; i++)
+        {
+            memset(&buf[i], 0, sizeof(buf[i]));
+            strncpy(buf[i].name, files[i].name.c_str(), sizeof(buf[i].name) - 1);
+            buf[i].type = FsDirEntryType_File;
+            buf[i].file_size = files[i].data.size();
+        }
+
+        *total_entries = count;
+        return 0;
+    }
+
+    Result fsDirGetEntryCount(FsDir* d, s64* count)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        auto found = g_dirs.find(d->s.session);
+
+        if (found == g_dirs.end())
+            return RESULT_NOT_FOUND;
+
+        *count = found->second->files.size();
+        return 0;
+    }
+
+    void fsDirClose(FsDir* d)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_dirs.erase(d->s.session);
+        d->s.session = 0;
+    }
+}
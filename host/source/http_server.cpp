@@ -0,0 +1,456 @@
+#include "host/http_server.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "util/error.hpp"
+
+namespace host
+{
+    static const size_t SEND_CHUNK_SIZE = 0x4000;
+
+    static const char* GetStatusText(u32 status)
+    {
+        switch (status)
+        {
+            case 200: return "OK";
+            case 206: return "Partial Content";
+            case 304: return "Not Modified";
+            case 404: return "Not Found";
+            case 408: return "Request Timeout";
+            case 416: return "Range Not Satisfiable";
+            case 429: return "Too Many Requests";
+            case 500: return "Internal Server Error";
+            case 503: return "Service Unavailable";
+            default: return "Status";
+        }
+    }
+
+    static std::string ToLower(std::string value)
+    {
+        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::tolower(c); });
+        return value;
+    }
+
+    static bool ParseRequest(const std::string& head, HttpRequest& request)
+    {
+        size_t lineEnd = head.find("\r\n");
+        std::string requestLine = head.substr(0, lineEnd);
+        size_t methodEnd = requestLine.find(' ');
+        size_t pathEnd = requestLine.find(' ', methodEnd + 1);
+
+        if (methodEnd == std::string::npos || pathEnd == std::string::npos)
+            return false;
+
+        request.method = requestLine.substr(0, methodEnd);
+        request.path = requestLine.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+
+        while (lineEnd != std::string::npos && lineEnd + 2 < head.size())
+        {
+            size_t start = lineEnd + 2;
+            lineEnd = head.find("\r\n", start);
+            std::string line = head.substr(start, lineEnd == std::string::npos ? std::string::npos : lineEnd - start);
+            size_t colon = line.find(':');
+
+            if (colon == std::string::npos)
+                continue;
+
+            size_t valueStart = line.find_first_not_of(' ', colon + 1);
+            request.headers[ToLower(line.substr(0, colon))] = valueStart == std::string::npos ? "" : line.substr(valueStart);
+        }
+
+        auto range = request.headers.find("range");
+
+        if (range != request.headers.end() && range->second.compare(0, 6, "bytes=") == 0)
+        {
+            std::string spec = range->second.substr(6);
+            size_t dash = spec.find('-');
+
+            if (dash != std::string::npos && dash > 0)
+            {
+                request.hasRange = true;
+                request.rangeStart = std::stoull(spec.substr(0, dash));
+                request.rangeEnd = dash + 1 < spec.size() ? std::stoull(spec.substr(dash + 1)) : ~0ULL;
+            }
+        }
+
+        return true;
+    }
+
+    HttpServer::HttpServer()
+    {
+        m_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+
+        if (m_listenSocket < 0)
+            THROW_FORMAT("Failed to create the server socket\n");
+
+        int reuse = 1;
+        setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+
+        socklen_t addressSize = sizeof(address);
+
+        if (bind(m_listenSocket, (sockaddr*)&address, sizeof(address)) != 0 || listen(m_listenSocket, 16) != 0 || getsockname(m_listenSocket, (sockaddr*)&address, &addressSize) != 0)
+        {
+            close(m_listenSocket);
+            THROW_FORMAT("Failed to listen on the loopback interface\n");
+        }
+
+        m_port = ntohs(address.sin_port);
+        m_acceptThread = std::thread([this]() { AcceptFunc(); });
+    }
+
+    HttpServer::~HttpServer()
+    {
+        m_stop = true;
+        shutdown(m_listenSocket, SHUT_RDWR);
+        close(m_listenSocket);
+        m_acceptThread.join();
+
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            for (int socket : m_sockets)
+                shutdown(socket, SHUT_RDWR);
+
+            threads.swap(m_connectionThreads);
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    void HttpServer::AddFile(const std::string& path, std::shared_ptr<const std::vector<u8>> data)
+    {
+        UpdateFile(path, data);
+    }
+
+    void HttpServer::UpdateFile(const std::string& path, std::shared_ptr<const std::vector<u8>> data)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        u32 version = ++m_version;
+
+        // Every version of every file gets its own validators
+        time_t modified = 1767225600 + version;
+        char date[64];
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", gmtime(&modified));
+
+        File& file = m_files[path];
+        file.data = data;
+        file.etag = "\"" + std::to_string(version) + "-" + std::to_string(data->size()) + "\"";
+        file.lastModified = date;
+    }
+
+    std::string HttpServer::GetUrl(const std::string& path)
+    {
+        return "http://127.0.0.1:" + std::to_string(m_port) + path;
+    }
+
+    void HttpServer::SetLatency(u64 milliseconds)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_latency = milliseconds;
+    }
+
+    void HttpServer::SetBandwidth(u64 bytesPerSecond)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bandwidth = bytesPerSecond;
+    }
+
+    void HttpServer::SetConnectionBandwidth(u64 bytesPerSecond)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connectionBandwidth = bytesPerSecond;
+    }
+
+    void HttpServer::AddFault(const HttpFault& fault)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_faults.push_back(fault);
+    }
+
+    std::vector<HttpRequest> HttpServer::GetRequests()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_requests;
+    }
+
+    void HttpServer::ClearRequests()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requests.clear();
+    }
+
+    u64 HttpServer::GetBytesSent()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bytesSent;
+    }
+
+    u32 HttpServer::GetPeakConnections()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_peakConnections;
+    }
+
+    void HttpServer::AcceptFunc()
+    {
+        while (!m_stop)
+        {
+            int socket = accept(m_listenSocket, NULL, NULL);
+
+            if (socket < 0)
+                continue;
+
+            int noDelay = 1;
+            setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (m_stop)
+            {
+                close(socket);
+                break;
+            }
+
+            m_sockets.push_back(socket);
+            m_connectionThreads.emplace_back([this, socket]() { ConnectionFunc(socket); });
+        }
+    }
+
+    void HttpServer::ConnectionFunc(int socket)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_peakConnections = std::max(m_peakConnections, ++m_connections);
+        }
+
+        std::string buffer;
+        u64 connectionFreeTick = 0;
+        char data[0x1000];
+
+        while (!m_stop)
+        {
+            size_t headEnd = buffer.find("\r\n\r\n");
+
+            if (headEnd == std::string::npos)
+            {
+                ssize_t received = recv(socket, data, sizeof(data), 0);
+
+                if (received <= 0)
+                    break;
+
+                buffer.append(data, received);
+                continue;
+            }
+
+            HttpRequest request;
+            bool parsed = ParseRequest(buffer.substr(0, headEnd), request);
+            buffer.erase(0, headEnd + 4);
+
+            if (!parsed || !HandleRequest(socket, request, connectionFreeTick))
+                break;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connections--;
+        m_sockets.erase(std::find(m_sockets.begin(), m_sockets.end(), socket));
+        close(socket);
+    }
+
+    bool HttpServer::TakeFault(const HttpRequest& request, HttpFault& fault)
+    {
+        for (auto it = m_faults.begin(); it != m_faults.end(); ++it)
+        {
+            if ((!it->path.empty() && it->path != request.path) || (it->rangeStart != ~0ULL && (!request.hasRange || it->rangeStart != request.rangeStart)))
+                continue;
+
+            fault = *it;
+
+            if (--it->times == 0)
+                m_faults.erase(it);
+
+            return true;
+        }
+
+        return false;
+    }
+
+    // Returns false once the connection is to be closed
+    bool HttpServer::HandleRequest(int socket, const HttpRequest& request, u64& connectionFreeTick)
+    {
+        File file;
+        HttpFault fault;
+        bool found = false;
+        bool faulted = false;
+        u64 latency = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_requests.push_back(request);
+            latency = m_latency;
+
+            auto it = m_files.find(request.path);
+
+            if (it != m_files.end())
+            {
+                file = it->second;
+                found = true;
+            }
+
+            if (request.method == "GET")
+                faulted = TakeFault(request, fault);
+        }
+
+        if (latency)
+            svcSleepThread(latency * 1000000);
+
+        std::string head;
+        u32 status = 200;
+        u64 bodyOffset = 0;
+        u64 bodySize = 0;
+        std::string errorBody;
+
+        if (faulted && fault.status)
+        {
+            status = fault.status;
+            errorBody = fault.errorBody;
+        }
+        else if (!found)
+        {
+            status = 404;
+            errorBody = "not found";
+        }
+        else
+        {
+            auto inm = request.headers.find("if-none-match");
+            auto ims = request.headers.find("if-modified-since");
+            u64 size = file.data->size();
+
+            if (inm != request.headers.end() ? inm->second == file.etag : (ims != request.headers.end() && ims->second == file.lastModified))
+            {
+                status = 304;
+            }
+            else if (request.hasRange && !(faulted && fault.ignoreRange))
+            {
+                if (request.rangeStart >= size)
+                {
+                    status = 416;
+                    head += "Content-Range: bytes */" + std::to_string(size) + "\r\n";
+                }
+                else
+                {
+                    status = 206;
+                    bodyOffset = request.rangeStart;
+                    bodySize = std::min(request.rangeEnd, size - 1) - request.rangeStart + 1;
+                    head += "Content-Range: bytes " + std::to_string(bodyOffset) + "-" + std::to_string(bodyOffset + bodySize - 1) + "/" + std::to_string(size) + "\r\n";
+                }
+            }
+            else
+            {
+                bodySize = size;
+            }
+
+            head += "ETag: " + file.etag + "\r\n";
+            head += "Last-Modified: " + file.lastModified + "\r\n";
+        }
+
+        if (!errorBody.empty())
+            bodySize = errorBody.size();
+
+        std::string response = "HTTP/1.1 " + std::to_string(status) + " " + GetStatusText(status) + "\r\n";
+        response += "Accept-Ranges: bytes\r\n";
+        response += head;
+
+        if (status != 304)
+            response += "Content-Length: " + std::to_string(bodySize) + "\r\n";
+
+        response += "\r\n";
+
+        if (!Send(socket, response.data(), response.size(), connectionFreeTick, false))
+            return false;
+
+        if (request.method == "HEAD" || status == 304)
+            return true;
+
+        if (!errorBody.empty())
+            return Send(socket, errorBody.data(), errorBody.size(), connectionFreeTick, false);
+
+        u64 sendSize = faulted ? std::min(bodySize, fault.dropAfter) : bodySize;
+
+        if (!Send(socket, file.data->data() + bodyOffset, sendSize, connectionFreeTick, true))
+            return false;
+
+        if (sendSize < bodySize && fault.stall)
+        {
+            // The client sends nothing more until it has the response, so this returns once it hangs up
+            char data[0x100];
+
+            while (recv(socket, data, sizeof(data), 0) > 0)
+            {
+            }
+        }
+
+        // The rest of the response never comes, the client sees the connection drop
+        return sendSize == bodySize;
+    }
+
+    bool HttpServer::Send(int socket, const void* data, size_t size, u64& connectionFreeTick, bool throttle)
+    {
+        const u8* ptr = (const u8*)data;
+
+        while (size)
+        {
+            size_t chunk = std::min(size, SEND_CHUNK_SIZE);
+
+            if (throttle)
+            {
+                u64 now = armGetSystemTick();
+                u64 doneTick = now;
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+
+                    if (m_bandwidth)
+                    {
+                        m_linkFreeTick = std::max(now, m_linkFreeTick) + armNsToTicks(chunk * 1000000000ULL / m_bandwidth);
+                        doneTick = m_linkFreeTick;
+                    }
+
+                    if (m_connectionBandwidth)
+                    {
+                        connectionFreeTick = std::max(now, connectionFreeTick) + armNsToTicks(chunk * 1000000000ULL / m_connectionBandwidth);
+                        doneTick = std::max(doneTick, connectionFreeTick);
+                    }
+                }
+
+                if (doneTick > now)
+                    svcSleepThread(armTicksToNs(doneTick - now));
+            }
+
+            ssize_t sent = send(socket, ptr, chunk, MSG_NOSIGNAL);
+
+            if (sent <= 0)
+                return false;
+
+            ptr += sent;
+            size -= sent;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bytesSent += sent;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,309 @@
+#define OPENSSL_SUPPRESS_DEPRECATED
+
+#include <switch.h>
+#include <mbedtls/bignum.h>
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+namespace
+{
+    static_assert(sizeof(SHA256_CTX) <= sizeof(Sha256Context), "Sha256Context can't hold SHA256_CTX");
+
+    void AesEcb(const u8* key, bool encrypt, void* dst, const void* src, size_t size)
+    {
+        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+        int outSize = 0;
+
+        EVP_CipherInit_ex(ctx, EVP_aes_128_ecb(), NULL, key, NULL, encrypt ? 1 : 0);
+        EVP_CIPHER_CTX_set_padding(ctx, 0);
+        EVP_CipherUpdate(ctx, (u8*)dst, &outSize, (const u8*)src, (int)size);
+        EVP_CIPHER_CTX_free(ctx);
+    }
+
+    // The counter is big endian, as in libnx
+    void AddToCounter(u8* ctr, u64 blocks)
+    {
+        for (int i = AES_BLOCK_SIZE - 1; i >= 0 && blocks; i--)
+        {
+            u64 sum = ctr[i] + (blocks & 0xFF);
+            ctr[i] = (u8)sum;
+            blocks = (blocks >> 8) + (sum >> 8);
+        }
+    }
+
+    // Multiplies the XTS tweak by x in GF(2^128)
+    void NextTweak(u8* tweak)
+    {
+        u8 carry = 0;
+
+        for (int i = 0; i < AES_BLOCK_SIZE; i++)
+        {
+            u8 next = tweak[i] >> 7;
+            tweak[i] = (u8)((tweak[i] << 1) | carry);
+            carry = next;
+        }
+
+        if (carry)
+            tweak[0] ^= 0x87;
+    }
+
+    size_t XtsCrypt(Aes128XtsContext* ctx, bool encrypt, void* dst, const void* src, size_t size)
+    {
+        u8* out = (u8*)dst;
+        const u8* in = (const u8*)src;
+        u8 tweak[AES_BLOCK_SIZE];
+        memcpy(tweak, ctx->tweak, sizeof(tweak));
+
+        for (size_t i = 0; i + AES_BLOCK_SIZE <= size; i += AES_BLOCK_SIZE)
+        {
+            u8 block[AES_BLOCK_SIZE];
+
+            for (int j = 0; j < AES_BLOCK_SIZE; j++)
+                block[j] = in[i + j] ^ tweak[j];
+
+            AesEcb(ctx->key, encrypt, block, block, AES_BLOCK_SIZE);
+
+            for (int j = 0; j < AES_BLOCK_SIZE; j++)
+                out[i + j] = block[j] ^ tweak[j];
+
+            NextTweak(tweak);
+        }
+
+        memcpy(ctx->tweak, tweak, sizeof(tweak));
+        return size;
+    }
+
+    BIGNUM* Bn(const mbedtls_mpi* X)
+    {
+        return (BIGNUM*)X->bn;
+    }
+}
+
+extern "C"
+{
+    // newlib's heap bounds, which the segment pool sizes itself from. Pretend to have the 3GB an
+    // application gets, the host allocator grows as needed.
+    static char s_heapBase[1];
+    char* fake_heap_start = s_heapBase;
+    char* fake_heap_end = s_heapBase + 0xC0000000ull;
+
+    u64 armGetSystemTick(void)
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        return armNsToTicks((u64)ns);
+    }
+
+    void svcSleepThread(s64 nano)
+    {
+        if (nano > 0)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(nano));
+        else
+            std::this_thread::yield();
+    }
+
+    // Threads stay wherever the host scheduler puts them
+    Result svcSetThreadCoreMask(Handle handle, s32 core_id, u32 affinity_mask)
+    {
+        return 0;
+    }
+
+    Result nsInitialize(void)
+    {
+        return 0;
+    }
+
+    void nsExit(void)
+    {
+    }
+
+    // No titles are installed on the host
+    Result nsGetApplicationControlData(NsApplicationControlSource source, u64 application_id, NsApplicationControlData* buffer, size_t size, u64* actual_size)
+    {
+        *actual_size = 0;
+        return MAKERESULT(16, 1);
+    }
+
+    Result nsCountApplicationContentMeta(u64 application_id, s32* out)
+    {
+        *out = 0;
+        return MAKERESULT(16, 1);
+    }
+
+    Result nsListApplicationContentMetaStatus(u64 application_id, s32 index, NsApplicationContentMetaStatus* list, s32 count, s32* out_entrycount)
+    {
+        *out_entrycount = 0;
+        return MAKERESULT(16, 1);
+    }
+
+    Result nacpGetLanguageEntry(NacpStruct* nacp, NacpLanguageEntry** langentry)
+    {
+        *langentry = &nacp->lang[0];
+        return 0;
+    }
+
+    Result splCryptoGenerateAesKek(const void* wrapped_kek, u32 key_generation, u32 option, void* out_sealed_kek)
+    {
+        u8* out = (u8*)out_sealed_kek;
+        memcpy(out, wrapped_kek, AES_128_KEY_SIZE);
+        out[0] ^= (u8)key_generation;
+        out[1] ^= (u8)option;
+        return 0;
+    }
+
+    Result splCryptoGenerateAesKey(const void* sealed_kek, const void* source, void* out_sealed_key)
+    {
+        AesEcb((const u8*)sealed_kek, true, out_sealed_key, source, AES_128_KEY_SIZE);
+        return 0;
+    }
+
+    void sha256ContextCreate(Sha256Context* out)
+    {
+        SHA256_Init((SHA256_CTX*)out);
+    }
+
+    void sha256ContextUpdate(Sha256Context* ctx, const void* src, size_t size)
+    {
+        SHA256_Update((SHA256_CTX*)ctx, src, size);
+    }
+
+    void sha256ContextGetHash(Sha256Context* ctx, void* dst)
+    {
+        SHA256_Final((u8*)dst, (SHA256_CTX*)ctx);
+    }
+
+    void sha256CalculateHash(void* dst, const void* src, size_t size)
+    {
+        SHA256((const u8*)src, size, (u8*)dst);
+    }
+
+    void aes128CtrContextCreate(Aes128CtrContext* out, const void* key, const void* ctr)
+    {
+        memcpy(out->key, key, AES_128_KEY_SIZE);
+        aes128CtrContextResetCtr(out, ctr);
+    }
+
+    void aes128CtrContextResetCtr(Aes128CtrContext* ctx, const void* ctr)
+    {
+        memcpy(ctx->ctr, ctr, AES_BLOCK_SIZE);
+        ctx->buffer_offset = 0;
+    }
+
+    void aes128CtrCrypt(Aes128CtrContext* ctx, void* dst, const void* src, size_t size)
+    {
+        u8* out = (u8*)dst;
+        const u8* in = (const u8*)src;
+
+        // Finish the block a previous call stopped in
+        while (size && ctx->buffer_offset)
+        {
+            *out++ = *in++ ^ ctx->enc_ctr_buffer[ctx->buffer_offset];
+            ctx->buffer_offset = (ctx->buffer_offset + 1) % AES_BLOCK_SIZE;
+            size--;
+        }
+
+        size_t blocks = size / AES_BLOCK_SIZE;
+
+        if (blocks)
+        {
+            EVP_CIPHER_CTX* evp = EVP_CIPHER_CTX_new();
+            int outSize = 0;
+
+            EVP_EncryptInit_ex(evp, EVP_aes_128_ctr(), NULL, ctx->key, ctx->ctr);
+            EVP_EncryptUpdate(evp, out, &outSize, in, (int)(blocks * AES_BLOCK_SIZE));
+            EVP_CIPHER_CTX_free(evp);
+
+            AddToCounter(ctx->ctr, blocks);
+            out += blocks * AES_BLOCK_SIZE;
+            in += blocks * AES_BLOCK_SIZE;
+            size -= blocks * AES_BLOCK_SIZE;
+        }
+
+        if (size)
+        {
+            AesEcb(ctx->key, true, ctx->enc_ctr_buffer, ctx->ctr, AES_BLOCK_SIZE);
+            AddToCounter(ctx->ctr, 1);
+
+            for (size_t i = 0; i < size; i++)
+                out[i] = in[i] ^ ctx->enc_ctr_buffer[i];
+
+            ctx->buffer_offset = size;
+        }
+    }
+
+    void aes128XtsContextCreate(Aes128XtsContext* out, const void* key0, const void* key1, bool is_encryptor)
+    {
+        memcpy(out->key, key0, AES_128_KEY_SIZE);
+        memcpy(out->tweak_key, key1, AES_128_KEY_SIZE);
+        memset(out->tweak, 0, sizeof(out->tweak));
+        out->is_encryptor = is_encryptor;
+    }
+
+    // Nintendo's variant stores the sector number big endian
+    void aes128XtsContextResetSector(Aes128XtsContext* ctx, u64 sector, bool is_nintendo)
+    {
+        u8 tweak[AES_BLOCK_SIZE] = {};
+
+        for (int i = 0; i < 8; i++)
+        {
+            u8 b = (u8)(sector >> (8 * i));
+
+            if (is_nintendo)
+                tweak[AES_BLOCK_SIZE - 1 - i] = b;
+            else
+                tweak[i] = b;
+        }
+
+        AesEcb(ctx->tweak_key, true, ctx->tweak, tweak, AES_BLOCK_SIZE);
+    }
+
+    size_t aes128XtsEncrypt(Aes128XtsContext* ctx, void* dst, const void* src, size_t size)
+    {
+        return XtsCrypt(ctx, true, dst, src, size);
+    }
+
+    size_t aes128XtsDecrypt(Aes128XtsContext* ctx, void* dst, const void* src, size_t size)
+    {
+        return XtsCrypt(ctx, false, dst, src, size);
+    }
+
+    void mbedtls_mpi_init(mbedtls_mpi* X)
+    {
+        X->bn = BN_new();
+    }
+
+    void mbedtls_mpi_free(mbedtls_mpi* X)
+    {
+        BN_free(Bn(X));
+        X->bn = NULL;
+    }
+
+    int mbedtls_mpi_lset(mbedtls_mpi* X, mbedtls_mpi_sint z)
+    {
+        BN_set_word(Bn(X), (BN_ULONG)(z < 0 ? -z : z));
+        BN_set_negative(Bn(X), z < 0);
+        return 0;
+    }
+
+    int mbedtls_mpi_read_binary(mbedtls_mpi* X, const unsigned char* buf, size_t buflen)
+    {
+        return BN_bin2bn(buf, (int)buflen, Bn(X)) ? 0 : -1;
+    }
+
+    int mbedtls_mpi_write_binary(const mbedtls_mpi* X, unsigned char* buf, size_t buflen)
+    {
+        return BN_bn2binpad(Bn(X), buf, (int)buflen) == (int)buflen ? 0 : -1;
+    }
+
+    int mbedtls_mpi_exp_mod(mbedtls_mpi* X, const mbedtls_mpi* A, const mbedtls_mpi* E, const mbedtls_mpi* N, mbedtls_mpi* prec_RR)
+    {
+        BN_CTX* ctx = BN_CTX_new();
+        int ret = BN_mod_exp(Bn(X), Bn(A), Bn(E), Bn(N), ctx) ? 0 : -1;
+        BN_CTX_free(ctx);
+        return ret;
+    }
+}
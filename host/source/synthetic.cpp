@@ -0,0 +1,415 @@
+#include "host/synthetic.hpp"
+
+#include <cstring>
+#include <random>
+#include <zstd.h>
+#include "install/hfs0.hpp"
+#include "install/nca.hpp"
+#include "install/pfs0.hpp"
+#include "util/crypto.hpp"
+#include "util/error.hpp"
+#include "util/title_util.hpp"
+
+namespace host
+{
+    static const u64 NCA_BODY_OFFSET = NCA_HEADER_SIZE;
+    static const u64 NCZ_SECTION_MAGIC = 0x4E544345535A434E;
+    static const u64 NCZ_BLOCK_MAGIC = 0x4B434F4C425A434E;
+    static const u32 MAGIC_PFS0 = 0x30534650;
+    static const u64 XCI_HFS0_OFFSET = 0xf000;
+
+    static const char FILLER_TEXT[] = "romfs:/Data/Level/Stage_01/Actor.bfres zstd lz4 bntx bfsha ";
+
+    static void FillBody(u8* data, u64 size, std::mt19937& rng)
+    {
+        const u64 pageSize = 0x1000;
+
+        for (u64 page = 0; page < size; page += pageSize)
+        {
+            u64 len = std::min(pageSize, size - page);
+            u32 kind = rng() % 10;
+
+            if (kind < 3)
+            {
+                memset(data + page, 0, len);
+            }
+            else if (kind < 6)
+            {
+                for (u64 i = 0; i < len; i++)
+                    data[page + i] = FILLER_TEXT[(page + i) % (sizeof(FILLER_TEXT) - 1)];
+            }
+            else
+            {
+                for (u64 i = 0; i < len; i++)
+                    data[page + i] = (u8)rng();
+            }
+        }
+    }
+
+    static void CryptSection(const SyntheticSection& section, u8* data, u64 offset, u64 size)
+    {
+        if (section.cryptoType != 3)
+            return;
+
+        // Set up the same way the NCZ writer does it
+        u64 counter;
+        memcpy(&counter, section.counter, sizeof(counter));
+        Crypto::Aes128Ctr crypto(section.key, Crypto::AesCtr(Crypto::swapEndian(counter)));
+        crypto.seek(offset);
+        crypto.encrypt(data, data, size);
+    }
+
+    NcmContentId GetContentId(const std::vector<u8>& nca)
+    {
+        u8 hash[SHA256_HASH_SIZE];
+        sha256CalculateHash(hash, nca.data(), nca.size());
+
+        NcmContentId contentId;
+        memcpy(contentId.c, hash, sizeof(contentId.c));
+        return contentId;
+    }
+
+    SyntheticNca MakeNca(u64 bodySize, u32 numSections, u32 seed, u8 contentType, u64 titleId)
+    {
+        if (!numSections || numSections > 4)
+            THROW_FORMAT("An NCA has 1 to 4 sections\n");
+
+        std::mt19937 rng(seed);
+        SyntheticNca result;
+        u64 totalSize = NCA_BODY_OFFSET + bodySize;
+
+        result.plain.resize(totalSize);
+        FillBody(result.plain.data() + NCA_BODY_OFFSET, bodySize, rng);
+
+        // Sections are media aligned, the last one takes what's left
+        u64 sectionSize = (bodySize / numSections) & ~0x1FFULL;
+        u64 offset = NCA_BODY_OFFSET;
+
+        for (u32 i = 0; i < numSections; i++)
+        {
+            SyntheticSection section;
+            section.offset = offset;
+            section.size = i + 1 == numSections ? totalSize - offset : sectionSize;
+            // Every other section is left unencrypted, like a plain romfs next to an encrypted exefs
+            section.cryptoType = i % 2 ? 1 : 3;
+
+            for (auto& b : section.key)
+                b = (u8)rng();
+
+            for (u32 j = 0; j < 8; j++)
+                section.counter[j] = (u8)rng();
+
+            result.sections.push_back(section);
+            offset += section.size;
+        }
+
+        tin::install::NcaHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = MAGIC_NCA3;
+        header.distribution = 0;
+        header.content_type = contentType;
+        header.nca_size = totalSize;
+        header.m_titleId = titleId;
+
+        for (u32 i = 0; i < numSections; i++)
+        {
+            header.section_entries[i].media_start_offset = result.sections[i].offset / 0x200;
+            header.section_entries[i].media_end_offset = (result.sections[i].offset + result.sections[i].size + 0x1FF) / 0x200;
+            header.fs_headers[i].crypt_type = result.sections[i].cryptoType;
+        }
+
+        Crypto::AesXtr encryptor(Crypto::Keys().headerKey, true);
+        encryptor.encrypt(result.plain.data(), &header, sizeof(header), 0, 0x200);
+
+        result.nca = result.plain;
+
+        for (auto& section : result.sections)
+            CryptSection(section, result.nca.data() + section.offset, section.offset, section.size);
+
+        result.contentId = GetContentId(result.nca);
+        return result;
+    }
+
+    template<class T>
+    static void Append(std::vector<u8>& buffer, const T& value)
+    {
+        const u8* p = (const u8*)&value;
+        buffer.insert(buffer.end(), p, p + sizeof(T));
+    }
+
+    std::vector<u8> MakeNcz(const SyntheticNca& nca, const NczOptions& options)
+    {
+        std::vector<u8> ncz(nca.nca.begin(), nca.nca.begin() + NCA_BODY_OFFSET);
+
+        Append<u64>(ncz, NCZ_SECTION_MAGIC);
+        Append<u64>(ncz, nca.sections.size());
+
+        for (auto& section : nca.sections)
+        {
+            u8 entry[0x40] = {};
+            memcpy(entry, &section.offset, 8);
+            memcpy(entry + 0x8, &section.size, 8);
+            entry[0x10] = section.cryptoType;
+            memcpy(entry + 0x20, section.key, 0x10);
+            memcpy(entry + 0x30, section.counter, 0x10);
+            ncz.insert(ncz.end(), entry, entry + sizeof(entry));
+        }
+
+        const u8* body = nca.plain.data() + NCA_BODY_OFFSET;
+        u64 bodySize = nca.plain.size() - NCA_BODY_OFFSET;
+
+        if (!options.blocks)
+        {
+            std::vector<u8> compressed(ZSTD_compressBound(bodySize));
+            size_t size = ZSTD_compress(compressed.data(), compressed.size(), body, bodySize, options.level);
+
+            if (ZSTD_isError(size))
+                THROW_FORMAT("%s\n", ZSTD_getErrorName(size));
+
+            ncz.insert(ncz.end(), compressed.begin(), compressed.begin() + size);
+            return ncz;
+        }
+
+        u64 blockSize = 1ULL << options.blockSizeExponent;
+        u32 numBlocks = (bodySize + blockSize - 1) / blockSize;
+
+        Append<u64>(ncz, NCZ_BLOCK_MAGIC);
+        Append<u8>(ncz, 2);
+        Append<u8>(ncz, 1);
+        Append<u8>(ncz, 0);
+        Append<u8>(ncz, options.blockSizeExponent);
+        Append<u32>(ncz, numBlocks);
+        Append<u64>(ncz, bodySize);
+
+        u64 sizeListOffset = ncz.size();
+        ncz.resize(ncz.size() + numBlocks * sizeof(u32));
+        std::vector<u8> compressed(ZSTD_compressBound(blockSize));
+
+        for (u32 i = 0; i < numBlocks; i++)
+        {
+            const u8* block = body + i * blockSize;
+            u64 size = std::min(blockSize, bodySize - i * blockSize);
+            size_t compressedSize = ZSTD_compress(compressed.data(), compressed.size(), block, size, options.level);
+
+            if (ZSTD_isError(compressedSize))
+                THROW_FORMAT("%s\n", ZSTD_getErrorName(compressedSize));
+
+            // Blocks that don't get smaller are stored as is
+            u32 storedSize = compressedSize < size ? compressedSize : size;
+
+            if (compressedSize < size)
+                ncz.insert(ncz.end(), compressed.begin(), compressed.begin() + compressedSize);
+            else
+                ncz.insert(ncz.end(), block, block + size);
+
+            memcpy(ncz.data() + sizeListOffset + i * sizeof(u32), &storedSize, sizeof(u32));
+        }
+
+        return ncz;
+    }
+
+    std::vector<u8> MakeCnmt(u64 titleId, u32 version, NcmContentMetaType type, const std::vector<std::pair<NcmContentId, u64>>& contents, const std::vector<u8>& contentTypes)
+    {
+        std::vector<u8> cnmt;
+        nx::ncm::PackagedContentMetaHeader header;
+        memset(&header, 0, sizeof(header));
+        header.title_id = titleId;
+        header.version = version;
+        header.type = type;
+        header.extended_header_size = type == NcmContentMetaType_Patch ? sizeof(NcmPatchMetaExtendedHeader) : sizeof(NcmApplicationMetaExtendedHeader);
+        header.content_count = contents.size();
+        Append(cnmt, header);
+
+        if (type == NcmContentMetaType_Patch)
+        {
+            NcmPatchMetaExtendedHeader extended = {};
+            extended.application_id = titleId ^ 0x800;
+            Append(cnmt, extended);
+        }
+        else
+        {
+            NcmApplicationMetaExtendedHeader extended = {};
+            extended.patch_id = titleId ^ 0x800;
+            Append(cnmt, extended);
+        }
+
+        for (size_t i = 0; i < contents.size(); i++)
+        {
+            nx::ncm::PackagedContentInfo info;
+            memset(&info, 0, sizeof(info));
+            info.content_info.content_id = contents[i].first;
+            info.content_info.size_low = (u32)contents[i].second;
+            info.content_info.size_high = (u8)(contents[i].second >> 32);
+            info.content_info.content_type = contentTypes[i];
+            Append(cnmt, info);
+        }
+
+        // Digest
+        cnmt.resize(cnmt.size() + 0x20);
+        return cnmt;
+    }
+
+    template<class Header, class Entry>
+    static std::vector<u8> MakePartition(u32 magic, const std::vector<SyntheticFile>& files, void (*fill)(Entry&, u64 dataOffset, u64 size, u32 nameOffset))
+    {
+        std::string stringTable;
+        std::vector<u32> nameOffsets;
+
+        for (auto& file : files)
+        {
+            nameOffsets.push_back(stringTable.size());
+            stringTable += file.first;
+            stringTable.push_back('\0');
+        }
+
+        // Padded so the data that follows is aligned
+        u64 headerSize = sizeof(Header) + files.size() * sizeof(Entry) + stringTable.size();
+        stringTable.resize(stringTable.size() + ((0x20 - headerSize % 0x20) % 0x20));
+
+        Header header = {};
+        header.magic = magic;
+        header.numFiles = files.size();
+        header.stringTableSize = stringTable.size();
+
+        std::vector<u8> out;
+        Append(out, header);
+        u64 dataOffset = 0;
+
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            Entry entry = {};
+            fill(entry, dataOffset, files[i].second.size(), nameOffsets[i]);
+            Append(out, entry);
+            dataOffset += files[i].second.size();
+        }
+
+        out.insert(out.end(), stringTable.begin(), stringTable.end());
+
+        for (auto& file : files)
+            out.insert(out.end(), file.second.begin(), file.second.end());
+
+        return out;
+    }
+
+    std::vector<u8> MakePfs0(const std::vector<SyntheticFile>& files)
+    {
+        return MakePartition<tin::install::PFS0BaseHeader, tin::install::PFS0FileEntry>(MAGIC_PFS0, files, [](tin::install::PFS0FileEntry& entry, u64 dataOffset, u64 size, u32 nameOffset)
+        {
+            entry.dataOffset = dataOffset;
+            entry.fileSize = size;
+            entry.stringTableOffset = nameOffset;
+        });
+    }
+
+    std::vector<u8> MakeHfs0(const std::vector<SyntheticFile>& files)
+    {
+        return MakePartition<tin::install::HFS0BaseHeader, tin::install::HFS0FileEntry>(MAGIC_HFS0, files, [](tin::install::HFS0FileEntry& entry, u64 dataOffset, u64 size, u32 nameOffset)
+        {
+            entry.dataOffset = dataOffset;
+            entry.fileSize = size;
+            entry.stringTableOffset = nameOffset;
+            entry.hashedSize = 0x200;
+        });
+    }
+
+    std::vector<u8> MakeXci(const std::vector<SyntheticFile>& files)
+    {
+        std::vector<u8> xci(XCI_HFS0_OFFSET);
+        memcpy(xci.data() + 0x100, "HEAD", 4);
+
+        std::vector<u8> root = MakeHfs0({{"update", MakeHfs0({})}, {"normal", MakeHfs0({})}, {"secure", MakeHfs0(files)}});
+        xci.insert(xci.end(), root.begin(), root.end());
+        return xci;
+    }
+
+    SyntheticNca MakeMetaNca(u64 titleId, NcmContentMetaType type, const std::vector<u8>& cnmt)
+    {
+        char name[0x40];
+        snprintf(name, sizeof(name), "%s_%016lx.cnmt", type == NcmContentMetaType_Patch ? "Patch" : "Application", titleId);
+
+        std::vector<u8> pfs0 = MakePfs0({{name, cnmt}});
+        u64 sectionSize = (pfs0.size() + 0x1FF) & ~0x1FFULL;
+
+        SyntheticNca result;
+        result.plain.resize(NCA_BODY_OFFSET + sectionSize);
+        memcpy(result.plain.data() + NCA_BODY_OFFSET, pfs0.data(), pfs0.size());
+
+        SyntheticSection section;
+        section.offset = NCA_BODY_OFFSET;
+        section.size = sectionSize;
+        section.cryptoType = 1;
+        result.sections.push_back(section);
+
+        tin::install::NcaHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = MAGIC_NCA3;
+        header.content_type = NcmContentType_Meta;
+        header.nca_size = result.plain.size();
+        header.m_titleId = titleId;
+        header.section_entries[0].media_start_offset = section.offset / 0x200;
+        header.section_entries[0].media_end_offset = (section.offset + section.size) / 0x200;
+        header.fs_headers[0].fs_type = 1;
+        header.fs_headers[0].crypt_type = 1;
+
+        // The PFS0 superblock: the partition's offset and size within the section
+        u64 pfs0Offset = 0;
+        u64 pfs0Size = pfs0.size();
+        memcpy(header.fs_headers[0].superblock_data + 0x38, &pfs0Offset, sizeof(pfs0Offset));
+        memcpy(header.fs_headers[0].superblock_data + 0x40, &pfs0Size, sizeof(pfs0Size));
+
+        Crypto::AesXtr encryptor(Crypto::Keys().headerKey, true);
+        encryptor.encrypt(result.plain.data(), &header, sizeof(header), 0, 0x200);
+
+        result.nca = result.plain;
+        result.contentId = GetContentId(result.nca);
+        return result;
+    }
+
+    SyntheticTitle MakeTitle(u64 titleId, u64 programSize, u32 seed)
+    {
+        SyntheticTitle title;
+        title.titleId = titleId;
+        title.ncas.push_back(MakeNca(programSize, 2, seed, NcmContentType_Program, titleId));
+        title.ncas.push_back(MakeNca(0x20000, 1, seed + 1, NcmContentType_Control, titleId));
+
+        std::vector<std::pair<NcmContentId, u64>> contents;
+        std::vector<u8> contentTypes;
+
+        for (auto& nca : title.ncas)
+            contents.push_back({ nca.contentId, nca.nca.size() });
+
+        contentTypes = { NcmContentType_Program, NcmContentType_Control };
+
+        title.ncas.push_back(MakeMetaNca(titleId, NcmContentMetaType_Application, MakeCnmt(titleId, 0, NcmContentMetaType_Application, contents, contentTypes)));
+
+        // Only imported, never parsed
+        title.ticket.assign(0x2C0, 0);
+        title.ticket[0] = 0x04;
+        title.cert.assign(0x700, 0);
+        return title;
+    }
+
+    std::vector<SyntheticFile> MakePackageFiles(const SyntheticTitle& title, bool compressed, const NczOptions& options)
+    {
+        std::vector<SyntheticFile> files;
+
+        for (size_t i = 0; i < title.ncas.size(); i++)
+        {
+            const SyntheticNca& nca = title.ncas[i];
+            std::string name = tin::util::GetNcaIdString(nca.contentId);
+
+            if (i + 1 == title.ncas.size())
+                files.push_back({ name + ".cnmt.nca", nca.nca });
+            else if (compressed)
+                files.push_back({ name + ".ncz", MakeNcz(nca, options) });
+            else
+                files.push_back({ name + ".nca", nca.nca });
+        }
+
+        char rightsId[0x21];
+        snprintf(rightsId, sizeof(rightsId), "%016lx%016x", title.titleId, 0);
+        files.push_back({ std::string(rightsId) + ".tik", title.ticket });
+        files.push_back({ std::string(rightsId) + ".cert", title.cert });
+        return files;
+    }
+}
@@ -0,0 +1,196 @@
+#include "host/system.hpp"
+
+#include <cstring>
+#include "host/content_store.hpp"
+#include "nx/ipc/tin_ipc.h"
+
+namespace host
+{
+    // Ids, versions and types, the padding doesn't tell records apart
+    static std::string MetaKey(const NcmContentMetaKey& key)
+    {
+        return std::string((const char*)&key, offsetof(NcmContentMetaKey, padding));
+    }
+
+    System& System::Get()
+    {
+        static System system;
+        return system;
+    }
+
+    void System::Reset()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_meta.clear();
+            m_applicationRecords.clear();
+            m_tickets.clear();
+        }
+
+        ContentStore::ResetAll();
+    }
+
+    void System::SetMeta(NcmStorageId storageId, const NcmContentMetaKey& key, const void* data, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_meta[storageId][MetaKey(key)] = { key, std::vector<u8>((const u8*)data, (const u8*)data + size) };
+    }
+
+    bool System::GetMeta(NcmStorageId storageId, const NcmContentMetaKey& key, std::vector<u8>& out)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& records = m_meta[storageId];
+        auto found = records.find(MetaKey(key));
+
+        if (found == records.end())
+            return false;
+
+        out = found->second.second;
+        return true;
+    }
+
+    std::vector<NcmContentMetaKey> System::ListMeta(NcmStorageId storageId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<NcmContentMetaKey> keys;
+
+        for (auto& record : m_meta[storageId])
+            keys.push_back(record.second.first);
+
+        return keys;
+    }
+
+    void System::PushApplicationRecord(const ApplicationRecord& record)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_applicationRecords.push_back(record);
+    }
+
+    std::vector<ApplicationRecord> System::GetApplicationRecords()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_applicationRecords;
+    }
+
+    void System::ImportTicket(const void* ticket, size_t ticketSize)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tickets.emplace_back((const u8*)ticket, (const u8*)ticket + ticketSize);
+    }
+
+    std::vector<std::vector<u8>> System::GetTickets()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_tickets;
+    }
+}
+
+extern "C"
+{
+    // The database handle is just the storage it was opened on
+
+    Result ncmInitialize(void)
+    {
+        return 0;
+    }
+
+    void ncmExit(void)
+    {
+    }
+
+    Result ncmOpenContentMetaDatabase(NcmContentMetaDatabase* out_db, NcmStorageId storage_id)
+    {
+        memset(out_db, 0, sizeof(*out_db));
+
+        if (storage_id != NcmStorageId_BuiltInUser && storage_id != NcmStorageId_SdCard)
+            return MAKERESULT(5, 1);
+
+        out_db->s.session = storage_id;
+        return 0;
+    }
+
+    void ncmContentMetaDatabaseClose(NcmContentMetaDatabase* db)
+    {
+        db->s.session = 0;
+    }
+
+    Result ncmContentMetaDatabaseSet(NcmContentMetaDatabase* db, const NcmContentMetaKey* key, const void* data, u64 data_size)
+    {
+        host::System::Get().SetMeta((NcmStorageId)db->s.session, *key, data, data_size);
+        return 0;
+    }
+
+    Result ncmContentMetaDatabaseCommit(NcmContentMetaDatabase* db)
+    {
+        return 0;
+    }
+
+    Result ncmContentMetaDatabaseList(NcmContentMetaDatabase* db, s32* out_entries_total, s32* out_entries_written, NcmContentMetaKey* out_keys, s32 count, NcmContentMetaType meta_type, u64 id, u64 id_min, u64 id_max, NcmContentInstallType install_type)
+    {
+        s32 total = 0;
+        s32 written = 0;
+
+        for (auto& key : host::System::Get().ListMeta((NcmStorageId)db->s.session))
+        {
+            if ((meta_type != NcmContentMetaType_Unknown && key.type != meta_type) || key.id < id_min || key.id > id_max || key.install_type != install_type)
+                continue;
+
+            if (written < count)
+                out_keys[written++] = key;
+
+            total++;
+        }
+
+        *out_entries_total = total;
+        *out_entries_written = written;
+        return 0;
+    }
+
+    Result nsextInitialize(void)
+    {
+        return 0;
+    }
+
+    void nsextExit(void)
+    {
+    }
+
+    Result nsPushApplicationRecord(u64 application_id, NsApplicationRecordType last_modified_event, ContentStorageRecord* content_records, u32 count)
+    {
+        for (u32 i = 0; i < count; i++)
+        {
+            host::ApplicationRecord record;
+            record.applicationId = application_id;
+            record.key = content_records[i].metaRecord;
+            record.storageId = content_records[i].storageId;
+            host::System::Get().PushApplicationRecord(record);
+        }
+
+        return 0;
+    }
+
+    Result esInitialize(void)
+    {
+        return 0;
+    }
+
+    void esExit(void)
+    {
+    }
+
+    Result esImportTicket(void const* tikBuf, size_t tikSize, void const* certBuf, size_t certSize)
+    {
+        host::System::Get().ImportTicket(tikBuf, tikSize);
+        return 0;
+    }
+
+    void serviceClose(Service* s)
+    {
+        s->session = 0;
+    }
+
+    Result appletSetMediaPlaybackState(bool state)
+    {
+        return 0;
+    }
+}
@@ -0,0 +1,211 @@
+#include "host/usb_host.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include "util/usb_comms_awoo.h"
+#include "util/usb_util.hpp"
+
+namespace host
+{
+    static const u32 TUC0_MAGIC = 0x30435554;
+
+    struct FileRangeCmdHeader
+    {
+        u64 size;
+        u64 offset;
+        u64 nspNameLen;
+        u64 padding;
+    };
+
+    UsbHost& UsbHost::Get()
+    {
+        static UsbHost usbHost;
+        return usbHost;
+    }
+
+    void UsbHost::Reset()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_files.clear();
+        m_command.clear();
+        m_responses.clear();
+        m_latency = 0;
+        m_bandwidth = 0;
+        m_maxTransferSize = 0x800000;
+        m_linkFreeTick = 0;
+        m_requestCount = 0;
+        m_bytesSent = 0;
+    }
+
+    void UsbHost::AddFile(const std::string& name, std::shared_ptr<const std::vector<u8>> data)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_files[name] = data;
+    }
+
+    void UsbHost::SetLatency(u64 nanoseconds)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_latency = nanoseconds;
+    }
+
+    void UsbHost::SetBandwidth(u64 bytesPerSecond)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bandwidth = bytesPerSecond;
+    }
+
+    void UsbHost::SetMaxTransferSize(size_t size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_maxTransferSize = std::max(size, (size_t)1);
+    }
+
+    u64 UsbHost::GetRequestCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_requestCount;
+    }
+
+    u64 UsbHost::GetBytesSent()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bytesSent;
+    }
+
+    size_t UsbHost::Write(const void* buffer, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_command.insert(m_command.end(), (const u8*)buffer, (const u8*)buffer + size);
+        HandleCommand();
+        return size;
+    }
+
+    // Runs once a whole command (header and data) has been written
+    void UsbHost::HandleCommand()
+    {
+        if (m_command.size() < sizeof(tin::util::USBCmdHeader))
+            return;
+
+        tin::util::USBCmdHeader header;
+        memcpy(&header, m_command.data(), sizeof(header));
+
+        if (m_command.size() < sizeof(header) + header.dataSize)
+            return;
+
+        std::vector<u8> data(m_command.begin() + sizeof(header), m_command.begin() + sizeof(header) + header.dataSize);
+        m_command.erase(m_command.begin(), m_command.begin() + sizeof(header) + header.dataSize);
+
+        if (header.magic != TUC0_MAGIC || header.type != tin::util::USBCmdType::REQUEST || header.cmdId != 1 || data.size() < sizeof(FileRangeCmdHeader))
+            return;
+
+        FileRangeCmdHeader range;
+        memcpy(&range, data.data(), sizeof(range));
+        std::string name((const char*)data.data() + sizeof(range), std::min((u64)data.size() - sizeof(range), range.nspNameLen));
+
+        Response response;
+        auto file = m_files.find(name);
+
+        if (file != m_files.end() && range.offset < file->second->size())
+        {
+            response.data = file->second;
+            response.offset = range.offset;
+            response.size = std::min(range.size, file->second->size() - range.offset);
+        }
+
+        tin::util::USBCmdHeader responseHeader;
+        responseHeader.magic = TUC0_MAGIC;
+        responseHeader.type = tin::util::USBCmdType::RESPONSE;
+        responseHeader.cmdId = 1;
+        responseHeader.dataSize = response.size;
+        response.header.assign((const u8*)&responseHeader, (const u8*)&responseHeader + sizeof(responseHeader));
+        response.readyTick = armGetSystemTick() + armNsToTicks(m_latency);
+
+        m_requestCount++;
+        m_responses.push_back(std::move(response));
+        m_responseReady.notify_all();
+    }
+
+    size_t UsbHost::Read(void* buffer, size_t size, u64 timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if (!m_responseReady.wait_for(lock, std::chrono::nanoseconds(timeout), [&]() { return !m_responses.empty(); }))
+            return 0;
+
+        Response& response = m_responses.front();
+        u64 now = armGetSystemTick();
+        size_t readSize = 0;
+
+        if (!response.header.empty())
+        {
+            readSize = std::min(size, response.header.size());
+            memcpy(buffer, response.header.data(), readSize);
+            response.header.erase(response.header.begin(), response.header.begin() + readSize);
+        }
+        else
+        {
+            readSize = std::min({ size, (size_t)response.size, m_maxTransferSize });
+            memcpy(buffer, response.data->data() + response.offset, readSize);
+            response.offset += readSize;
+            response.size -= readSize;
+            m_bytesSent += readSize;
+        }
+
+        // The transfer completes once the link has carried it, after the request's round trip
+        u64 start = std::max({ now, response.readyTick, m_linkFreeTick });
+        m_linkFreeTick = start + (m_bandwidth ? armNsToTicks(readSize * 1000000000ULL / m_bandwidth) : 0);
+        u64 doneTick = m_linkFreeTick;
+
+        if (response.header.empty() && !response.size)
+            m_responses.pop_front();
+
+        lock.unlock();
+
+        if (doneTick > now)
+            svcSleepThread(armTicksToNs(doneTick - now));
+
+        return readSize;
+    }
+}
+
+extern "C"
+{
+    Result awoo_usbCommsInitialize(void)
+    {
+        return 0;
+    }
+
+    Result awoo_usbCommsInitializeEx(u32 num_interfaces, const awoo_UsbCommsInterfaceInfo* infos)
+    {
+        return 0;
+    }
+
+    void awoo_usbCommsExit(void)
+    {
+    }
+
+    void awoo_usbCommsSetErrorHandling(bool flag)
+    {
+    }
+
+    size_t awoo_usbCommsRead(void* buffer, size_t size, u64 timeout)
+    {
+        return host::UsbHost::Get().Read(buffer, size, timeout);
+    }
+
+    size_t awoo_usbCommsWrite(const void* buffer, size_t size, u64 timeout)
+    {
+        return host::UsbHost::Get().Write(buffer, size);
+    }
+
+    size_t awoo_usbCommsReadEx(void* buffer, size_t size, u32 interface, u64 timeout)
+    {
+        return host::UsbHost::Get().Read(buffer, size, timeout);
+    }
+
+    size_t awoo_usbCommsWriteEx(const void* buffer, size_t size, u32 interface, u64 timeout)
+    {
+        return host::UsbHost::Get().Write(buffer, size);
+    }
+}
@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "data/buffered_placeholder_writer.hpp"
+#include "host/content_store.hpp"
+#include "host/synthetic.hpp"
+
+namespace
+{
+    class BufferedPlaceholderWriterTest : public ::testing::Test
+    {
+        protected:
+            void SetUp() override
+            {
+                host::ContentStore::ResetAll();
+                tin::data::BufferSegmentPool::Get().SetBudget(2 * tin::data::BUFFER_SEGMENT_DATA_SIZE);
+                m_storage = std::make_shared<nx::ncm::ContentStorage>(NcmStorageId_SdCard);
+            }
+
+            void TearDown() override
+            {
+                tin::data::BufferSegmentPool::Get().Trim();
+            }
+
+            std::shared_ptr<nx::ncm::ContentStorage> m_storage;
+    };
+
+    const size_t SEGMENT_SIZE = tin::data::BUFFER_SEGMENT_DATA_SIZE;
+
+    // Long enough for a thread that isn't blocked to have got somewhere
+    void WaitABit()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    TEST_F(BufferedPlaceholderWriterTest, StreamsAnNcaThroughTheRing)
+    {
+        // Several laps of a two segment ring
+        auto nca = host::MakeNca(0x2800000, 2, 11);
+        tin::data::BufferedPlaceholderWriter writer(m_storage, nca.contentId, true, nca.nca.size());
+        EXPECT_EQ(writer.GetNumSegments(), 2u);
+
+        std::thread consumer([&]()
+        {
+            while (!writer.IsPlaceholderComplete())
+            {
+                if (!writer.WriteSegmentToPlaceholder())
+                    break;
+            }
+        });
+
+        for (size_t offset = 0; offset < nca.nca.size(); offset += 0x12345)
+            ASSERT_TRUE(writer.AppendData(nca.nca.data() + offset, std::min<size_t>(0x12345, nca.nca.size() - offset)));
+
+        consumer.join();
+        EXPECT_TRUE(writer.IsBufferDataComplete());
+        EXPECT_TRUE(writer.IsPlaceholderComplete());
+
+        std::vector<u8> written;
+        ASSERT_TRUE(host::ContentStore::Get(NcmStorageId_SdCard).GetPlaceholder(*(const NcmPlaceHolderId*)&nca.contentId, written));
+        EXPECT_EQ(written, nca.nca);
+    }
+
+    TEST_F(BufferedPlaceholderWriterTest, SmallNcaUsesOneSegment)
+    {
+        auto nca = host::MakeNca(0x10000, 1, 12);
+        tin::data::BufferedPlaceholderWriter writer(m_storage, nca.contentId, true, nca.nca.size());
+
+        ASSERT_TRUE(writer.AppendData(nca.nca.data(), nca.nca.size()));
+        EXPECT_TRUE(writer.IsBufferDataComplete());
+        EXPECT_TRUE(writer.WriteSegmentToPlaceholder());
+        EXPECT_TRUE(writer.IsPlaceholderComplete());
+    }
+
+    TEST_F(BufferedPlaceholderWriterTest, ProducerBlocksWhileTheRingIsFull)
+    {
+        auto nca = host::MakeNca(0x2800000, 2, 13);
+        tin::data::BufferedPlaceholderWriter writer(m_storage, nca.contentId, true, nca.nca.size());
+        ASSERT_EQ(writer.GetNumSegments(), 2u);
+
+        // Both segments full and nothing consumed yet
+        ASSERT_TRUE(writer.AppendData(nca.nca.data(), 2 * SEGMENT_SIZE));
+
+        std::atomic_bool appended = false;
+        std::thread producer([&]()
+        {
+            EXPECT_TRUE(writer.AppendData(nca.nca.data() + 2 * SEGMENT_SIZE, 0x1000));
+            appended = true;
+        });
+
+        WaitABit();
+        EXPECT_FALSE(appended);
+        EXPECT_EQ(writer.GetSizeBuffered(), 2 * SEGMENT_SIZE);
+
+        // Freeing up the oldest segment lets the producer carry on into it
+        ASSERT_TRUE(writer.WriteSegmentToPlaceholder());
+        producer.join();
+        EXPECT_TRUE(appended);
+        EXPECT_EQ(writer.GetSizeBuffered(), 2 * SEGMENT_SIZE + 0x1000);
+        EXPECT_EQ(writer.GetSizeWrittenToPlaceholder(), SEGMENT_SIZE);
+        writer.Cancel();
+    }
+
+    TEST_F(BufferedPlaceholderWriterTest, ConsumerBlocksUntilASegmentIsFull)
+    {
+        auto nca = host::MakeNca(0x2800000, 2, 14);
+        tin::data::BufferedPlaceholderWriter writer(m_storage, nca.contentId, true, nca.nca.size());
+
+        std::atomic_bool written = false;
+        std::thread consumer([&]()
+        {
+            EXPECT_TRUE(writer.WriteSegmentToPlaceholder());
+            written = true;
+        });
+
+        // A partly filled segment isn't handed over
+        ASSERT_TRUE(writer.AppendData(nca.nca.data(), SEGMENT_SIZE - 0x1000));
+        WaitABit();
+        EXPECT_FALSE(written);
+        EXPECT_EQ(writer.GetSizeWrittenToPlaceholder(), 0u);
+
+        ASSERT_TRUE(writer.AppendData(nca.nca.data() + SEGMENT_SIZE - 0x1000, 0x1000));
+        consumer.join();
+        EXPECT_TRUE(written);
+        EXPECT_EQ(writer.GetSizeWrittenToPlaceholder(), SEGMENT_SIZE);
+        writer.Cancel();
+    }
+
+    TEST_F(BufferedPlaceholderWriterTest, CancelWakesABlockedProducer)
+    {
+        auto nca = host::MakeNca(0x2800000, 2, 15);
+        tin::data::BufferedPlaceholderWriter writer(m_storage, nca.contentId, true, nca.nca.size());
+        ASSERT_TRUE(writer.AppendData(nca.nca.data(), 2 * SEGMENT_SIZE));
+
+        std::atomic_bool returned = false;
+        std::thread producer([&]()
+        {
+            EXPECT_FALSE(writer.AppendData(nca.nca.data() + 2 * SEGMENT_SIZE, 0x1000));
+            returned = true;
+        });
+
+        WaitABit();
+        EXPECT_FALSE(returned);
+
+        writer.Cancel();
+        producer.join();
+        EXPECT_TRUE(writer.IsCancelled());
+        EXPECT_EQ(writer.GetSizeBuffered(), 2 * SEGMENT_SIZE);
+
+        // Nothing blocks once cancelled
+        size_t availableSize = 0;
+        EXPECT_EQ(writer.AcquireWrite(&availableSize), nullptr);
+        EXPECT_EQ(writer.AcquireRead(), nullptr);
+    }
+
+    TEST_F(BufferedPlaceholderWriterTest, CancelWakesABlockedConsumerAndWaiters)
+    {
+        auto nca = host::MakeNca(0x2800000, 2, 16);
+        tin::data::BufferedPlaceholderWriter writer(m_storage, nca.contentId, true, nca.nca.size());
+
+        std::atomic_bool returned = false;
+        std::thread consumer([&]()
+        {
+            EXPECT_FALSE(writer.WriteSegmentToPlaceholder());
+            returned = true;
+        });
+
+        std::atomic_bool waited = false;
+        std::thread waiter([&]()
+        {
+            // Would wait a minute if the cancel didn't wake it
+            EXPECT_FALSE(writer.WaitPlaceholderComplete(60000000000ULL));
+            waited = true;
+        });
+
+        WaitABit();
+        EXPECT_FALSE(returned);
+        EXPECT_FALSE(waited);
+
+        auto start = std::chrono::steady_clock::now();
+        writer.Cancel();
+        consumer.join();
+        waiter.join();
+        EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+        EXPECT_FALSE(writer.IsPlaceholderComplete());
+        EXPECT_EQ(writer.GetSizeWrittenToPlaceholder(), 0u);
+    }
+}
@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <unistd.h>
+#include "host/content_store.hpp"
+#include "host/http_server.hpp"
+#include "host/synthetic.hpp"
+#include "install/http_nsp.hpp"
+#include "install/nsp.hpp"
+#include "install/xci.hpp"
+#include "nx/nca_writer.h"
+#include "util/config.hpp"
+#include "util/title_util.hpp"
+
+namespace
+{
+    void ReadRange(const std::vector<u8>& data, void* buf, off_t offset, size_t size)
+    {
+        if ((size_t)offset + size > data.size())
+            throw std::runtime_error("Read past the end of the container");
+
+        memcpy(buf, data.data() + offset, size);
+    }
+
+    class MemoryNSP : public tin::install::nsp::NSP
+    {
+        public:
+            MemoryNSP(std::vector<u8> data) : m_data(std::move(data)) {}
+
+            void StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId, bool verifyHash, const tin::install::ProgressSink& progress) override
+            {
+                const tin::install::PFS0FileEntry* entry = this->GetFileEntryByNcaId(ncaId);
+                NcaWriter writer(ncaId, contentStorage, verifyHash);
+                writer.write(m_data.data() + this->GetDataOffset() + entry->dataOffset, entry->fileSize);
+                writer.close();
+            }
+
+            void BufferData(void* buf, off_t offset, size_t size) override
+            {
+                ReadRange(m_data, buf, offset, size);
+            }
+
+        private:
+            std::vector<u8> m_data;
+    };
+
+    class MemoryXCI : public tin::install::xci::XCI
+    {
+        public:
+            MemoryXCI(std::vector<u8> data) : m_data(std::move(data)) {}
+
+            void StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId, bool verifyHash, const tin::install::ProgressSink& progress) override
+            {
+                const tin::install::HFS0FileEntry* entry = this->GetFileEntryByNcaId(ncaId);
+                NcaWriter writer(ncaId, contentStorage, verifyHash);
+                writer.write(m_data.data() + this->GetDataOffset() + entry->dataOffset, entry->fileSize);
+                writer.close();
+            }
+
+            void BufferData(void* buf, off_t offset, size_t size) override
+            {
+                ReadRange(m_data, buf, offset, size);
+            }
+
+        private:
+            std::vector<u8> m_data;
+    };
+
+    class ContainerTest : public ::testing::Test
+    {
+        protected:
+            void SetUp() override
+            {
+                host::ContentStore::ResetAll();
+                m_storage = std::make_shared<nx::ncm::ContentStorage>(NcmStorageId_SdCard);
+                m_program = host::MakeNca(0x40000, 2, 21);
+                m_control = host::MakeNca(0x8000, 1, 22, NcmContentType_Control);
+                m_files = {
+                    {tin::util::GetNcaIdString(m_program.contentId) + ".ncz", host::MakeNcz(m_program, {})},
+                    {tin::util::GetNcaIdString(m_control.contentId) + ".nca", m_control.nca},
+                    {"0100000000010000.tik", std::vector<u8>(0x2C0, 1)},
+                };
+            }
+
+            bool IsInstalled(const host::SyntheticNca& nca)
+            {
+                std::vector<u8> data;
+                return host::ContentStore::Get(NcmStorageId_SdCard).GetPlaceholder(*(const NcmPlaceHolderId*)&nca.contentId, data) && data == nca.nca;
+            }
+
+            std::shared_ptr<nx::ncm::ContentStorage> m_storage;
+            host::SyntheticNca m_program;
+            host::SyntheticNca m_control;
+            std::vector<host::SyntheticFile> m_files;
+    };
+
+    TEST_F(ContainerTest, ParsesPfs0)
+    {
+        MemoryNSP nsp(host::MakePfs0(m_files));
+        nsp.RetrieveHeader();
+
+        EXPECT_EQ(nsp.GetBaseHeader()->numFiles, 3u);
+        EXPECT_EQ(nsp.GetFileEntriesByExtension("tik").size(), 1u);
+        EXPECT_EQ(nsp.GetFileEntryByName("missing.nca"), nullptr);
+        EXPECT_STREQ(nsp.GetFileEntryName(nsp.GetFileEntry(2)), "0100000000010000.tik");
+        EXPECT_THROW(nsp.GetFileEntry(3), std::runtime_error);
+
+        // NCZ entries are found by the NCA's id
+        ASSERT_NE(nsp.GetFileEntryByNcaId(m_program.contentId), nullptr);
+        nsp.StreamToPlaceholder(m_storage, m_program.contentId, true, tin::install::ProgressSink());
+        nsp.StreamToPlaceholder(m_storage, m_control.contentId, true, tin::install::ProgressSink());
+        EXPECT_TRUE(IsInstalled(m_program));
+        EXPECT_TRUE(IsInstalled(m_control));
+    }
+
+    TEST_F(ContainerTest, ParsesXciSecurePartition)
+    {
+        MemoryXCI xci(host::MakeXci(m_files));
+        xci.RetrieveHeader();
+
+        EXPECT_EQ(xci.GetSecureHeader()->numFiles, 3u);
+        EXPECT_EQ(xci.GetFileEntriesByExtension("nca").size(), 1u);
+        ASSERT_NE(xci.GetFileEntryByNcaId(m_control.contentId), nullptr);
+
+        xci.StreamToPlaceholder(m_storage, m_program.contentId, true, tin::install::ProgressSink());
+        xci.StreamToPlaceholder(m_storage, m_control.contentId, true, tin::install::ProgressSink());
+        EXPECT_TRUE(IsInstalled(m_program));
+        EXPECT_TRUE(IsInstalled(m_control));
+    }
+
+    TEST_F(ContainerTest, HttpNspReportsAHashMismatch)
+    {
+        // The journal lives under the app directory, which is relative on the host
+        auto lastDir = std::filesystem::current_path();
+        auto workDir = std::filesystem::temp_directory_path() / ("container_test_" + std::to_string(getpid()));
+        std::filesystem::create_directories(workDir / inst::config::appDir);
+        std::filesystem::current_path(workDir);
+
+        NcmContentId wrongId = m_program.contentId;
+        wrongId.c[0] ^= 0xFF;
+        std::vector<host::SyntheticFile> files = {{tin::util::GetNcaIdString(wrongId) + ".nca", m_program.nca}};
+
+        {
+            host::HttpServer server;
+            server.AddFile("/game.nsp", std::make_shared<std::vector<u8>>(host::MakePfs0(files)));
+            tin::install::nsp::HTTPNSP nsp(server.GetUrl("/game.nsp"));
+            nsp.RetrieveHeader();
+
+            // The writer's own error comes through, and no journal is left for the deleted placeholder
+            std::string error;
+
+            try
+            {
+                nsp.StreamToPlaceholder(m_storage, wrongId, true, tin::install::ProgressSink());
+            }
+            catch (std::runtime_error& e)
+            {
+                error = e.what();
+            }
+
+            EXPECT_NE(error.find("Hash mismatch"), std::string::npos) << error;
+            EXPECT_FALSE(host::ContentStore::Get(NcmStorageId_SdCard).HasPlaceholder(*(const NcmPlaceHolderId*)&wrongId));
+            EXPECT_FALSE(std::filesystem::exists(inst::config::appDir + "/journal/" + tin::util::GetNcaIdString(wrongId) + ".json"));
+        }
+
+        std::filesystem::current_path(lastDir);
+        std::filesystem::remove_all(workDir);
+    }
+
+    TEST_F(ContainerTest, RejectsXciWithoutHfs0)
+    {
+        MemoryXCI xci(std::vector<u8>(0x10000, 0));
+        EXPECT_THROW(xci.RetrieveHeader(), std::runtime_error);
+    }
+}
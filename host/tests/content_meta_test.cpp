@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include "host/synthetic.hpp"
+#include "nx/content_meta.hpp"
+
+namespace
+{
+    NcmContentId MakeId(u8 seed)
+    {
+        NcmContentId id;
+        memset(id.c, seed, sizeof(id.c));
+        return id;
+    }
+
+    TEST(ContentMetaTest, ReadsKeyAndContentInfos)
+    {
+        auto cnmt = host::MakeCnmt(0x0100000000010000, 0x10000, NcmContentMetaType_Application,
+            {{MakeId(1), 0x123456789}, {MakeId(2), 0x4000}, {MakeId(3), 0x8000}},
+            {NcmContentType_Program, NcmContentType_Control, NcmContentType_DeltaFragment});
+        nx::ncm::ContentMeta meta(cnmt.data(), cnmt.size());
+
+        auto key = meta.GetContentMetaKey();
+        EXPECT_EQ(key.id, 0x0100000000010000u);
+        EXPECT_EQ(key.version, 0x10000u);
+        EXPECT_EQ(key.type, NcmContentMetaType_Application);
+
+        // Delta fragments aren't installed
+        auto infos = meta.GetContentInfos();
+        ASSERT_EQ(infos.size(), 2u);
+        EXPECT_EQ(memcmp(infos[0].content_id.c, MakeId(1).c, 0x10), 0);
+        EXPECT_EQ(infos[0].size_low, 0x23456789u);
+        EXPECT_EQ(infos[0].size_high, 0x1);
+        EXPECT_EQ(infos[1].content_type, NcmContentType_Control);
+    }
+
+    TEST(ContentMetaTest, BuildsInstallContentMeta)
+    {
+        auto cnmt = host::MakeCnmt(0x0100000000010800, 0x20000, NcmContentMetaType_Patch,
+            {{MakeId(4), 0x10000}}, {NcmContentType_Program});
+        nx::ncm::ContentMeta meta(cnmt.data(), cnmt.size());
+
+        NcmContentInfo cnmtInfo = {};
+        cnmtInfo.content_id = MakeId(9);
+        cnmtInfo.content_type = NcmContentType_Meta;
+
+        tin::data::ByteBuffer buffer;
+        meta.GetInstallContentMeta(buffer, cnmtInfo, true);
+
+        auto header = buffer.Read<NcmContentMetaHeader>(0);
+        EXPECT_EQ(header.extended_header_size, sizeof(NcmPatchMetaExtendedHeader));
+        EXPECT_EQ(header.content_count, 2);
+
+        // The required system version is cleared, the cnmt record comes first
+        EXPECT_EQ(buffer.Read<u32>(sizeof(NcmContentMetaHeader) + 8), 0u);
+        auto first = buffer.Read<NcmContentInfo>(sizeof(NcmContentMetaHeader) + header.extended_header_size);
+        EXPECT_EQ(memcmp(first.content_id.c, MakeId(9).c, 0x10), 0);
+        EXPECT_EQ(buffer.GetSize(), sizeof(NcmContentMetaHeader) + header.extended_header_size + 2 * sizeof(NcmContentInfo));
+    }
+
+    TEST(ContentMetaTest, RejectsTruncatedData)
+    {
+        u8 data[0x10] = {};
+        EXPECT_THROW(nx::ncm::ContentMeta(data, sizeof(data)), std::runtime_error);
+    }
+}
@@ -0,0 +1,338 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <random>
+#include "host/http_server.hpp"
+#include "util/config.hpp"
+#include "util/network_util.hpp"
+
+namespace
+{
+    const size_t PIECE_SIZE = 0x400000;
+
+    class HttpDownloadTest : public ::testing::Test
+    {
+        protected:
+            void SetUp() override
+            {
+                m_retries = inst::config::httpRetries;
+                m_stallSeconds = inst::config::httpStallSeconds;
+                inst::config::httpRetries = 3;
+                inst::config::httpStallSeconds = 1;
+
+                std::mt19937 rng(7);
+                auto data = std::make_shared<std::vector<u8>>(0x1800000);
+
+                for (auto& b : *data)
+                    b = (u8)rng();
+
+                m_data = data;
+                m_server.AddFile("/file", m_data);
+            }
+
+            void TearDown() override
+            {
+                tin::network::ClearConnectionPool();
+                inst::config::httpRetries = m_retries;
+                inst::config::httpStallSeconds = m_stallSeconds;
+            }
+
+            std::vector<u8> Expected(size_t offset, size_t size)
+            {
+                return std::vector<u8>(m_data->begin() + offset, m_data->begin() + offset + size);
+            }
+
+            // The ranges the data was requested with, HEADs left out
+            std::vector<host::HttpRequest> GetRanges()
+            {
+                std::vector<host::HttpRequest> ranges;
+
+                for (auto& request : m_server.GetRequests())
+                {
+                    if (request.method == "GET")
+                        ranges.push_back(request);
+                }
+
+                return ranges;
+            }
+
+            host::HttpServer m_server;
+            std::shared_ptr<const std::vector<u8>> m_data;
+            int m_retries = 0;
+            int m_stallSeconds = 0;
+    };
+
+    // Collects what a download hands over
+    std::function<size_t (u8* bytes, size_t size)> Collect(std::vector<u8>& out)
+    {
+        return [&out](u8* bytes, size_t size) -> size_t
+        {
+            out.insert(out.end(), bytes, bytes + size);
+            return size;
+        };
+    }
+
+    TEST_F(HttpDownloadTest, SegmentedSplitsLargeRangesIntoPieces)
+    {
+        const size_t offset = 0x1234;
+        const size_t size = 0x1400000;
+
+        // Slow enough per connection for the pieces to overlap
+        m_server.SetConnectionBandwidth(100000000);
+
+        tin::network::HTTPDownload download(m_server.GetUrl("/file"));
+        m_server.ClearRequests();
+
+        std::vector<u8> out;
+        EXPECT_EQ(download.StreamDataRangeSegmented(offset, size, Collect(out)), 0);
+        EXPECT_EQ(out, Expected(offset, size));
+
+        // Every piece is asked for once, back to back, over more than one connection. The pieces
+        // run in parallel, so their requests can arrive in any order.
+        auto ranges = GetRanges();
+        ASSERT_EQ(ranges.size(), size / PIECE_SIZE);
+        std::sort(ranges.begin(), ranges.end(), [](const host::HttpRequest& a, const host::HttpRequest& b) { return a.rangeStart < b.rangeStart; });
+
+        for (size_t i = 0; i < ranges.size(); i++)
+        {
+            ASSERT_TRUE(ranges[i].hasRange);
+            EXPECT_EQ(ranges[i].rangeStart, offset + i * PIECE_SIZE);
+            EXPECT_EQ(ranges[i].rangeEnd, std::min(offset + (i + 1) * PIECE_SIZE, offset + size) - 1);
+        }
+
+        EXPECT_GE(m_server.GetPeakConnections(), 2u);
+    }
+
+    TEST_F(HttpDownloadTest, SegmentedLeavesSmallRangesWhole)
+    {
+        tin::network::HTTPDownload download(m_server.GetUrl("/file"));
+        m_server.ClearRequests();
+
+        std::vector<u8> out;
+        EXPECT_EQ(download.StreamDataRangeSegmented(0x100, 3 * PIECE_SIZE, Collect(out)), 0);
+        EXPECT_EQ(out, Expected(0x100, 3 * PIECE_SIZE));
+
+        auto ranges = GetRanges();
+        ASSERT_EQ(ranges.size(), 1u);
+        EXPECT_EQ(ranges[0].rangeStart, 0x100u);
+        EXPECT_EQ(ranges[0].rangeEnd, 0x100 + 3 * PIECE_SIZE - 1);
+    }
+
+    TEST_F(HttpDownloadTest, SegmentedRetryResumesWhereThePieceStopped)
+    {
+        const size_t size = 0x1400000;
+
+        // The third piece's connection drops part way through, the fourth gets a 503 first
+        host::HttpFault drop;
+        drop.path = "/file";
+        drop.rangeStart = 2 * PIECE_SIZE;
+        drop.dropAfter = 0x123456;
+        m_server.AddFault(drop);
+
+        host::HttpFault unavailable;
+        unavailable.path = "/file";
+        unavailable.rangeStart = 3 * PIECE_SIZE;
+        unavailable.status = 503;
+        m_server.AddFault(unavailable);
+
+        tin::network::HTTPDownload download(m_server.GetUrl("/file"));
+        m_server.ClearRequests();
+
+        std::vector<u8> out;
+        EXPECT_EQ(download.StreamDataRangeSegmented(0, size, Collect(out)), 0);
+        EXPECT_EQ(out, Expected(0, size));
+
+        std::vector<u64> starts;
+
+        for (auto& range : GetRanges())
+            starts.push_back(range.rangeStart);
+
+        // The dropped piece is asked for again from its first missing byte, the 503 one from its start
+        EXPECT_EQ(std::count(starts.begin(), starts.end(), 2 * PIECE_SIZE + 0x123456), 1);
+        EXPECT_EQ(std::count(starts.begin(), starts.end(), 3 * PIECE_SIZE), 2);
+        EXPECT_EQ(starts.size(), size / PIECE_SIZE + 2);
+    }
+
+    TEST_F(HttpDownloadTest, SegmentedStalledPieceIsRetried)
+    {
+        const size_t size = 0x1400000;
+
+        // The second piece's connection goes quiet part way through without closing
+        host::HttpFault stall;
+        stall.path = "/file";
+        stall.rangeStart = PIECE_SIZE;
+        stall.dropAfter = 0x54321;
+        stall.stall = true;
+        m_server.AddFault(stall);
+
+        tin::network::HTTPDownload download(m_server.GetUrl("/file"));
+        m_server.ClearRequests();
+
+        std::vector<u8> out;
+        EXPECT_EQ(download.StreamDataRangeSegmented(0, size, Collect(out)), 0);
+        EXPECT_EQ(out, Expected(0, size));
+
+        std::vector<u64> starts;
+
+        for (auto& range : GetRanges())
+            starts.push_back(range.rangeStart);
+
+        EXPECT_EQ(std::count(starts.begin(), starts.end(), PIECE_SIZE + 0x54321), 1);
+        EXPECT_EQ(starts.size(), size / PIECE_SIZE + 1);
+    }
+
+    TEST_F(HttpDownloadTest, SegmentedGivesUpOnAFinalError)
+    {
+        host::HttpFault missing;
+        missing.path = "/file";
+        missing.rangeStart = PIECE_SIZE;
+        missing.status = 404;
+        m_server.AddFault(missing);
+
+        tin::network::HTTPDownload download(m_server.GetUrl("/file"));
+        m_server.ClearRequests();
+
+        std::vector<u8> out;
+        EXPECT_NE(download.StreamDataRangeSegmented(0, 0x1400000, Collect(out)), 0);
+
+        // Nothing past the failed piece is handed over, and it isn't asked for again
+        EXPECT_LE(out.size(), PIECE_SIZE);
+        size_t attempts = 0;
+
+        for (auto& range : GetRanges())
+            attempts += range.rangeStart == PIECE_SIZE;
+
+        EXPECT_EQ(attempts, 1u);
+    }
+
+    TEST_F(HttpDownloadTest, RetryResumesFromTheLastDeliveredByte)
+    {
+        const size_t offset = 0x4321;
+        const size_t size = 0x200000;
+
+        host::HttpFault drop;
+        drop.path = "/file";
+        drop.rangeStart = offset;
+        drop.dropAfter = 0x12345;
+        m_server.AddFault(drop);
+
+        tin::network::HTTPDownload download(m_server.GetUrl("/file"));
+        m_server.ClearRequests();
+
+        std::vector<u8> out;
+        EXPECT_EQ(download.StreamDataRange(offset, size, Collect(out)), 0);
+        EXPECT_EQ(out, Expected(offset, size));
+
+        auto ranges = GetRanges();
+        ASSERT_EQ(ranges.size(), 2u);
+        EXPECT_EQ(ranges[0].rangeStart, offset);
+        EXPECT_EQ(ranges[1].rangeStart, offset + 0x12345);
+        EXPECT_EQ(ranges[1].rangeEnd, offset + size - 1);
+    }
+
+    TEST_F(HttpDownloadTest, StalledTransferResumesFromTheLastDeliveredByte)
+    {
+        const size_t offset = 0x4321;
+        const size_t size = 0x200000;
+
+        // The server stops sending but keeps the connection open, so only the stall timeout ends it
+        host::HttpFault stall;
+        stall.path = "/file";
+        stall.rangeStart = offset;
+        stall.dropAfter = 0x12345;
+        stall.stall = true;
+        m_server.AddFault(stall);
+
+        tin::network::HTTPDownload download(m_server.GetUrl("/file"));
+        m_server.ClearRequests();
+
+        std::vector<u8> out;
+        EXPECT_EQ(download.StreamDataRange(offset, size, Collect(out)), 0);
+        EXPECT_EQ(out, Expected(offset, size));
+
+        auto ranges = GetRanges();
+        ASSERT_EQ(ranges.size(), 2u);
+        EXPECT_EQ(ranges[1].rangeStart, offset + 0x12345);
+        EXPECT_EQ(ranges[1].rangeEnd, offset + size - 1);
+    }
+
+    TEST_F(HttpDownloadTest, ErrorBodiesAreNotPassedOn)
+    {
+        const size_t offset = 0x800;
+        const size_t size = 0x10000;
+
+        host::HttpFault unavailable;
+        unavailable.path = "/file";
+        unavailable.status = 503;
+        unavailable.errorBody = std::string(0x2000, 'x');
+        m_server.AddFault(unavailable);
+
+        tin::network::HTTPDownload download(m_server.GetUrl("/file"));
+        m_server.ClearRequests();
+
+        // The error page is read and dropped, and the retry still starts at the beginning
+        std::vector<u8> out;
+        EXPECT_EQ(download.StreamDataRange(offset, size, Collect(out)), 0);
+        EXPECT_EQ(out, Expected(offset, size));
+
+        auto ranges = GetRanges();
+        ASSERT_EQ(ranges.size(), 2u);
+        EXPECT_EQ(ranges[0].rangeStart, offset);
+        EXPECT_EQ(ranges[1].rangeStart, offset);
+    }
+
+    TEST_F(HttpDownloadTest, FinalErrorDeliversNothing)
+    {
+        host::HttpFault missing;
+        missing.path = "/file";
+        missing.status = 404;
+        missing.errorBody = "<html>not found</html>";
+        m_server.AddFault(missing);
+
+        tin::network::HTTPDownload download(m_server.GetUrl("/file"));
+        m_server.ClearRequests();
+
+        std::vector<u8> out;
+        EXPECT_NE(download.StreamDataRange(0, 0x10000, Collect(out)), 0);
+        EXPECT_TRUE(out.empty());
+        EXPECT_EQ(GetRanges().size(), 1u);
+    }
+
+    TEST_F(HttpDownloadTest, WholeFileResponseIsRefused)
+    {
+        // A 200 carries the file from its start, not the range that was asked for
+        host::HttpFault ignored;
+        ignored.path = "/file";
+        ignored.ignoreRange = true;
+        m_server.AddFault(ignored);
+
+        tin::network::HTTPDownload download(m_server.GetUrl("/file"));
+        m_server.ClearRequests();
+
+        std::vector<u8> out;
+        EXPECT_NE(download.StreamDataRange(0x1000, 0x10000, Collect(out)), 0);
+        EXPECT_TRUE(out.empty());
+        EXPECT_EQ(GetRanges().size(), 1u);
+    }
+
+    TEST_F(HttpDownloadTest, RetriesStopAtTheConfiguredLimit)
+    {
+        inst::config::httpRetries = 1;
+
+        host::HttpFault unavailable;
+        unavailable.path = "/file";
+        unavailable.status = 503;
+        unavailable.times = 3;
+        m_server.AddFault(unavailable);
+
+        tin::network::HTTPDownload download(m_server.GetUrl("/file"));
+        m_server.ClearRequests();
+
+        std::vector<u8> out;
+        EXPECT_NE(download.StreamDataRange(0, 0x10000, Collect(out)), 0);
+        EXPECT_TRUE(out.empty());
+        EXPECT_EQ(GetRanges().size(), 2u);
+    }
+}
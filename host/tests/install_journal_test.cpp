@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <unistd.h>
+#include "host/content_store.hpp"
+#include "install/install_journal.hpp"
+#include "util/config.hpp"
+#include "util/title_util.hpp"
+
+namespace
+{
+    const u64 NCA_SIZE = 0x100000;
+
+    class InstallJournalTest : public ::testing::Test
+    {
+        protected:
+            void SetUp() override
+            {
+                // Journals live under the app directory, which is relative on the host
+                m_lastDir = std::filesystem::current_path();
+                m_workDir = std::filesystem::temp_directory_path() / ("install_journal_test_" + std::to_string(getpid()));
+                std::filesystem::create_directories(m_workDir / inst::config::appDir);
+                std::filesystem::current_path(m_workDir);
+
+                host::ContentStore::ResetAll();
+                m_storage = std::make_shared<nx::ncm::ContentStorage>(NcmStorageId_SdCard);
+
+                memset(&m_ncaId, 0, sizeof(m_ncaId));
+                m_ncaId.c[0] = 0x12;
+                m_ncaId.c[15] = 0x34;
+            }
+
+            void TearDown() override
+            {
+                std::filesystem::current_path(m_lastDir);
+                std::filesystem::remove_all(m_workDir);
+            }
+
+            void SaveJournal(const NcaResumePoint& point)
+            {
+                m_storage->CreatePlaceholder(m_ncaId, *(NcmPlaceHolderId*)&m_ncaId, NCA_SIZE);
+
+                tin::install::InstallJournal journal(m_storage, m_ncaId, NCA_SIZE);
+                journal.Update(point);
+                journal.Flush();
+            }
+
+            NcaResumePoint MakePoint()
+            {
+                NcaResumePoint point;
+                point.inputOffset = 0x8000;
+                point.outputOffset = 0x8000;
+                point.prefixSize = NCA_HEADER_SIZE;
+                return point;
+            }
+
+            std::filesystem::path GetJournalPath()
+            {
+                return inst::config::appDir + "/journal/" + tin::util::GetNcaIdString(m_ncaId) + ".json";
+            }
+
+            bool HasPlaceholder()
+            {
+                return m_storage->HasPlaceholder(*(NcmPlaceHolderId*)&m_ncaId);
+            }
+
+            std::shared_ptr<nx::ncm::ContentStorage> m_storage;
+            NcmContentId m_ncaId;
+            std::filesystem::path m_lastDir;
+            std::filesystem::path m_workDir;
+    };
+
+    TEST_F(InstallJournalTest, HashStateIsKept)
+    {
+        NcaResumePoint point = MakePoint();
+        point.hashed = true;
+
+        for (size_t i = 0; i < sizeof(point.hashState); i++)
+            ((u8*)&point.hashState)[i] = (u8)(i * 7);
+
+        SaveJournal(point);
+
+        NcaResumePoint loaded;
+        tin::install::InstallJournal journal(m_storage, m_ncaId, NCA_SIZE);
+        ASSERT_TRUE(journal.Load(loaded));
+        EXPECT_TRUE(loaded.hashed);
+        EXPECT_EQ(0, memcmp(&loaded.hashState, &point.hashState, sizeof(point.hashState)));
+    }
+
+    TEST_F(InstallJournalTest, PointWithoutHashStateLoadsUnhashed)
+    {
+        SaveJournal(MakePoint());
+
+        NcaResumePoint loaded;
+        tin::install::InstallJournal journal(m_storage, m_ncaId, NCA_SIZE);
+        ASSERT_TRUE(journal.Load(loaded));
+        EXPECT_FALSE(loaded.hashed);
+    }
+
+    TEST_F(InstallJournalTest, PruneKeepsARecentJournal)
+    {
+        SaveJournal(MakePoint());
+
+        tin::install::InstallJournal::Prune();
+        EXPECT_TRUE(std::filesystem::exists(GetJournalPath()));
+        EXPECT_TRUE(HasPlaceholder());
+    }
+
+    TEST_F(InstallJournalTest, PruneDropsAJournalWithoutAPlaceholder)
+    {
+        SaveJournal(MakePoint());
+        m_storage->DeletePlaceholder(*(NcmPlaceHolderId*)&m_ncaId);
+
+        tin::install::InstallJournal::Prune();
+        EXPECT_FALSE(std::filesystem::exists(GetJournalPath()));
+    }
+
+    TEST_F(InstallJournalTest, PruneDropsAStaleJournalAndItsPlaceholder)
+    {
+        SaveJournal(MakePoint());
+
+        auto age = std::chrono::hours(24 * (tin::install::InstallJournal::JOURNAL_MAX_AGE_DAYS + 1));
+        std::filesystem::last_write_time(GetJournalPath(), std::filesystem::file_time_type::clock::now() - age);
+
+        tin::install::InstallJournal::Prune();
+        EXPECT_FALSE(std::filesystem::exists(GetJournalPath()));
+        EXPECT_FALSE(HasPlaceholder());
+    }
+}
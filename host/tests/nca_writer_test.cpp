@@ -0,0 +1,351 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <zstd.h>
+#include "host/content_store.hpp"
+#include "host/synthetic.hpp"
+#include "nx/nca_writer.h"
+
+namespace
+{
+    class NcaWriterTest : public ::testing::Test
+    {
+        protected:
+            void SetUp() override
+            {
+                host::ContentStore::ResetAll();
+                m_storage = std::make_shared<nx::ncm::ContentStorage>(NcmStorageId_SdCard);
+            }
+
+            // Feeds data to the writer in pieces of chunkSize, as a source would deliver it
+            void WriteAll(NcaWriter& writer, const std::vector<u8>& data, size_t chunkSize)
+            {
+                for (size_t offset = 0; offset < data.size(); offset += chunkSize)
+                    writer.write(data.data() + offset, std::min(chunkSize, data.size() - offset));
+            }
+
+            std::vector<u8> GetPlaceholder(const NcmContentId& contentId)
+            {
+                std::vector<u8> data;
+                EXPECT_TRUE(host::ContentStore::Get(NcmStorageId_SdCard).GetPlaceholder(*(const NcmPlaceHolderId*)&contentId, data));
+                return data;
+            }
+
+            std::shared_ptr<nx::ncm::ContentStorage> m_storage;
+    };
+
+    // Holds every block back until the one after it is done, so blocks finish last to first
+    class ReversingDecompressor : public NczBlockDecompressor
+    {
+        public:
+            ReversingDecompressor(u32 numBlocks, NcaWriterStageCounter& stats) :
+                NczBlockDecompressor(numBlocks, numBlocks, stats), m_done(numBlocks, false)
+            {
+            }
+
+            ~ReversingDecompressor()
+            {
+                stop();
+            }
+
+            std::vector<u32> GetFinishOrder()
+            {
+                std::lock_guard<std::mutex> lock(m_orderMutex);
+                return m_finishOrder;
+            }
+
+        protected:
+            void decompress(ZSTD_DCtx* dctx, Job& job) override
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_orderMutex);
+                    m_orderChanged.wait(lock, [&]() { return job.index + 1 == m_done.size() || m_done[job.index + 1]; });
+                }
+
+                NczBlockDecompressor::decompress(dctx, job);
+
+                {
+                    std::lock_guard<std::mutex> lock(m_orderMutex);
+                    m_done[job.index] = true;
+                    m_finishOrder.push_back(job.index);
+                }
+
+                m_orderChanged.notify_all();
+            }
+
+            std::mutex m_orderMutex;
+            std::condition_variable m_orderChanged;
+            std::vector<bool> m_done;
+            std::vector<u32> m_finishOrder;
+    };
+
+    TEST_F(NcaWriterTest, RawNcaIsWrittenAsIs)
+    {
+        auto nca = host::MakeNca(0x180000, 2, 1);
+        NcaWriter writer(nca.contentId, m_storage, true);
+        WriteAll(writer, nca.nca, 0x1234);
+        EXPECT_TRUE(writer.close());
+
+        EXPECT_EQ(GetPlaceholder(nca.contentId), nca.nca);
+    }
+
+    TEST_F(NcaWriterTest, SolidNczIsDecompressedAndEncrypted)
+    {
+        auto nca = host::MakeNca(0x600000, 1, 2);
+        auto ncz = host::MakeNcz(nca, {});
+        NcaWriter writer(nca.contentId, m_storage, true);
+        WriteAll(writer, ncz, 0x10000);
+        EXPECT_TRUE(writer.close());
+
+        EXPECT_EQ(GetPlaceholder(nca.contentId), nca.nca);
+    }
+
+    TEST_F(NcaWriterTest, CorruptSolidNczThrows)
+    {
+        auto nca = host::MakeNca(0x600000, 1, 8);
+        auto ncz = host::MakeNcz(nca, {});
+        // The random body is stored in raw zstd blocks, so break the frame magic rather than the data
+        const u8 magic[] = { 0x28, 0xB5, 0x2F, 0xFD };
+        auto frame = std::search(ncz.begin() + 0x4000, ncz.end(), magic, magic + sizeof(magic));
+        ASSERT_NE(frame, ncz.end());
+        *frame ^= 0xFF;
+
+        // Without hash verification it's the decompression error alone that has to stop the install
+        NcaWriter writer(nca.contentId, m_storage, false);
+        EXPECT_THROW({
+            WriteAll(writer, ncz, 0x10000);
+            writer.close();
+        }, std::runtime_error);
+    }
+
+    TEST_F(NcaWriterTest, BlockNczWithSeveralSections)
+    {
+        auto nca = host::MakeNca(0x900000, 4, 3);
+        host::NczOptions options;
+        options.blocks = true;
+        options.blockSizeExponent = 16;
+        auto ncz = host::MakeNcz(nca, options);
+        NcaWriter writer(nca.contentId, m_storage, true);
+        WriteAll(writer, ncz, 0x8000);
+        EXPECT_TRUE(writer.close());
+
+        EXPECT_EQ(GetPlaceholder(nca.contentId), nca.nca);
+    }
+
+    TEST(NczBlockDecompressorTest, BlocksComeBackInTheOrderTheyWereSubmitted)
+    {
+        const u32 numBlocks = 6;
+        const size_t blockSize = 0x10000;
+        auto nca = host::MakeNca(numBlocks * blockSize, 1, 9);
+
+        NcaWriterStageCounter stats;
+        ReversingDecompressor decompressor(numBlocks, stats);
+
+        for (u32 i = 0; i < numBlocks; i++)
+        {
+            const u8* block = nca.plain.data() + i * blockSize;
+            auto job = std::make_unique<NczBlockDecompressor::Job>();
+            job->index = i;
+            job->output.resize(blockSize);
+
+            // Every other block stored as is, as NCZs do with blocks that don't compress
+            if (i % 2)
+            {
+                job->input.assign(block, block + blockSize);
+            }
+            else
+            {
+                job->input.resize(ZSTD_compressBound(blockSize));
+                job->input.resize(ZSTD_compress(job->input.data(), job->input.size(), block, blockSize, 1));
+            }
+
+            decompressor.submit(std::move(job));
+        }
+
+        for (u32 i = 0; i < numBlocks; i++)
+        {
+            auto job = decompressor.popFront();
+            EXPECT_EQ(job->index, i);
+            EXPECT_FALSE(job->failed);
+            EXPECT_EQ(0, memcmp(job->output.data(), nca.plain.data() + i * blockSize, blockSize));
+        }
+
+        EXPECT_TRUE(decompressor.empty());
+        EXPECT_EQ(decompressor.GetFinishOrder(), std::vector<u32>({ 5, 4, 3, 2, 1, 0 }));
+        EXPECT_EQ(stats.snapshot().bytes, numBlocks * blockSize);
+    }
+
+    TEST(NczBlockDecompressorTest, DecompressorsShareTheInstallPool)
+    {
+        const u32 numBlocks = 4;
+        const size_t blockSize = 0x10000;
+        auto nca = host::MakeNca(numBlocks * blockSize, 1, 10);
+
+        auto pool = NczWorkerPool::shared();
+        EXPECT_EQ(NczWorkerPool::shared(), pool);
+
+        // Two NCAs' worth of blocks interleaved on the one pool, each comes back in its own order
+        NcaWriterStageCounter stats;
+        NczBlockDecompressor first(pool, numBlocks, stats);
+        NczBlockDecompressor second(pool, numBlocks, stats);
+
+        for (u32 i = 0; i < numBlocks; i++)
+        {
+            for (auto* decompressor : { &first, &second })
+            {
+                const u8* block = nca.plain.data() + i * blockSize;
+                auto job = std::make_unique<NczBlockDecompressor::Job>();
+                job->index = i;
+                job->output.resize(blockSize);
+                job->input.resize(ZSTD_compressBound(blockSize));
+                job->input.resize(ZSTD_compress(job->input.data(), job->input.size(), block, blockSize, 1));
+                decompressor->submit(std::move(job));
+            }
+        }
+
+        for (auto* decompressor : { &first, &second })
+        {
+            for (u32 i = 0; i < numBlocks; i++)
+            {
+                auto job = decompressor->popFront();
+                EXPECT_EQ(job->index, i);
+                EXPECT_FALSE(job->failed);
+                EXPECT_EQ(0, memcmp(job->output.data(), nca.plain.data() + i * blockSize, blockSize));
+            }
+        }
+
+        EXPECT_EQ(stats.snapshot().bytes, 2 * numBlocks * blockSize);
+    }
+
+    TEST_F(NcaWriterTest, DistributionTypeIsPatchedInTheHeader)
+    {
+        auto nca = host::MakeNca(0x10000, 1, 4);
+        NcaWriter writer(nca.contentId, m_storage, false);
+        WriteAll(writer, nca.nca, 0x4000);
+        writer.close();
+
+        auto written = GetPlaceholder(nca.contentId);
+        ASSERT_EQ(written.size(), nca.nca.size());
+        EXPECT_TRUE(std::equal(written.begin() + 0x4000, written.end(), nca.nca.begin() + 0x4000));
+    }
+
+    TEST_F(NcaWriterTest, HashMismatchDeletesThePlaceholder)
+    {
+        auto nca = host::MakeNca(0x20000, 1, 5);
+        NcmContentId wrongId = nca.contentId;
+        wrongId.c[0] ^= 0xFF;
+
+        NcaWriter writer(wrongId, m_storage, true);
+        WriteAll(writer, nca.nca, 0x10000);
+        EXPECT_THROW(writer.close(), std::runtime_error);
+
+        EXPECT_FALSE(host::ContentStore::Get(NcmStorageId_SdCard).HasPlaceholder(*(const NcmPlaceHolderId*)&wrongId));
+    }
+
+    TEST_F(NcaWriterTest, FailedPlaceholderWriteThrowsFromClose)
+    {
+        auto nca = host::MakeNca(0x800000, 1, 6);
+        auto ncz = host::MakeNcz(nca, {});
+        host::ContentStore::Get(NcmStorageId_SdCard).SetFailAfter(0x500000);
+
+        NcaWriter writer(nca.contentId, m_storage, false);
+        EXPECT_ANY_THROW({
+            WriteAll(writer, ncz, 0x10000);
+            writer.close();
+        });
+    }
+
+    TEST_F(NcaWriterTest, BlockNczResumesFromACheckpoint)
+    {
+        auto nca = host::MakeNca(0x1800000, 2, 7);
+        host::NczOptions options;
+        options.blocks = true;
+        options.blockSizeExponent = 17;
+        auto ncz = host::MakeNcz(nca, options);
+
+        // Write part of it, keeping the placeholder of the interrupted attempt
+        NcaResumePoint point;
+        {
+            NcaWriter writer(nca.contentId, m_storage, false);
+            writer.write(ncz.data(), ncz.size() / 2);
+
+            bool found = false;
+            for (int i = 0; i < 1000 && !(found = writer.checkpoint(point)); i++)
+                svcSleepThread(1000000);
+
+            ASSERT_TRUE(found);
+            writer.close();
+        }
+
+        NcaWriter writer(nca.contentId, m_storage, false);
+        writer.resume(point);
+        writer.write(ncz.data(), point.prefixSize);
+        writer.write(ncz.data() + point.inputOffset, ncz.size() - point.inputOffset);
+        writer.close();
+
+        EXPECT_EQ(GetPlaceholder(nca.contentId), nca.nca);
+    }
+
+    TEST_F(NcaWriterTest, BlockNczResumeIsVerified)
+    {
+        auto nca = host::MakeNca(0x1800000, 2, 8);
+        host::NczOptions options;
+        options.blocks = true;
+        options.blockSizeExponent = 17;
+        auto ncz = host::MakeNcz(nca, options);
+
+        // Closing part way keeps the placeholder, there's nothing to verify yet
+        NcaResumePoint point;
+        {
+            NcaWriter writer(nca.contentId, m_storage, true);
+            writer.write(ncz.data(), ncz.size() / 2);
+
+            bool found = false;
+            for (int i = 0; i < 1000 && !(found = writer.checkpoint(point)); i++)
+                svcSleepThread(1000000);
+
+            ASSERT_TRUE(found);
+            EXPECT_NO_THROW(writer.close());
+        }
+
+        EXPECT_TRUE(point.hashed);
+
+        NcaWriter writer(nca.contentId, m_storage, true);
+        writer.resume(point);
+        writer.write(ncz.data(), point.prefixSize);
+        writer.write(ncz.data() + point.inputOffset, ncz.size() - point.inputOffset);
+        EXPECT_NO_THROW(writer.close());
+
+        EXPECT_EQ(GetPlaceholder(nca.contentId), nca.nca);
+    }
+
+    TEST_F(NcaWriterTest, ResumedNcaIsStillHashed)
+    {
+        auto nca = host::MakeNca(0x100000, 1, 9);
+
+        NcaResumePoint point;
+        {
+            NcaWriter writer(nca.contentId, m_storage, true);
+            writer.write(nca.nca.data(), nca.nca.size() / 2);
+            ASSERT_TRUE(writer.checkpoint(point));
+            writer.close();
+        }
+
+        ASSERT_TRUE(point.hashed);
+
+        // What comes after the resume point is corrupted, which only the carried over hash can tell
+        std::vector<u8> corrupted = nca.nca;
+        corrupted[point.inputOffset + 0x100] ^= 0xFF;
+
+        NcaWriter writer(nca.contentId, m_storage, true);
+        writer.resume(point);
+        writer.write(corrupted.data(), point.prefixSize);
+        writer.write(corrupted.data() + point.inputOffset, corrupted.size() - point.inputOffset);
+        EXPECT_THROW(writer.close(), std::runtime_error);
+        EXPECT_TRUE(writer.verificationFailed());
+    }
+}
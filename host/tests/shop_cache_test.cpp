@@ -0,0 +1,224 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "host/http_server.hpp"
+#include "shopInstall.hpp"
+#include "util/config.hpp"
+#include "util/json.hpp"
+
+namespace
+{
+    const char SECTIONS_PATH[] = "/api/shop/sections";
+
+    std::shared_ptr<std::vector<u8>> MakeSections(const std::string& name)
+    {
+        nlohmann::json item = {
+            {"url", "/files/" + name + ".nsp"},
+            {"name", name + " [0100000000010000][v0].nsp"},
+            {"size", 0x100000},
+            {"title_id", "0100000000010000"},
+        };
+        nlohmann::json body = {
+            {"sections", {{{"id", "all"}, {"title", "All"}, {"items", {item}}}}},
+        };
+        std::string text = body.dump();
+        return std::make_shared<std::vector<u8>>(text.begin(), text.end());
+    }
+
+    class ShopCacheTest : public ::testing::Test
+    {
+        protected:
+            void SetUp() override
+            {
+                // The cache lives under the app directory, which is relative on the host
+                m_lastDir = std::filesystem::current_path();
+                m_workDir = std::filesystem::temp_directory_path() / ("shop_cache_test_" + std::to_string(getpid()));
+                std::filesystem::create_directories(m_workDir / inst::config::appDir);
+                std::filesystem::current_path(m_workDir);
+
+                m_backgroundRefresh = inst::config::shopBackgroundRefresh;
+                inst::config::shopBackgroundRefresh = false;
+
+                m_server.AddFile(SECTIONS_PATH, MakeSections("First"));
+                m_shopUrl = m_server.GetUrl("");
+            }
+
+            void TearDown() override
+            {
+                inst::config::shopBackgroundRefresh = m_backgroundRefresh;
+                std::filesystem::current_path(m_lastDir);
+                std::filesystem::remove_all(m_workDir);
+            }
+
+            std::vector<std::string> Fetch(bool allowCache)
+            {
+                shopInstStuff::ShopCatalog catalog;
+                std::string error;
+                auto sections = shopInstStuff::FetchShopSections(m_shopUrl, "", "", catalog, error, allowCache);
+                EXPECT_EQ(error, "");
+
+                std::vector<std::string> names;
+
+                for (auto& section : sections)
+                {
+                    for (auto index : section.items)
+                        names.push_back(std::string(catalog.GetName(index)));
+                }
+
+                return names;
+            }
+
+            std::vector<host::HttpRequest> GetSectionRequests()
+            {
+                std::vector<host::HttpRequest> requests;
+
+                for (auto& request : m_server.GetRequests())
+                {
+                    if (request.path == SECTIONS_PATH)
+                        requests.push_back(request);
+                }
+
+                return requests;
+            }
+
+            std::string GetHeader(const host::HttpRequest& request, const std::string& name)
+            {
+                auto found = request.headers.find(name);
+                return found == request.headers.end() ? "" : found->second;
+            }
+
+            std::filesystem::path GetMetaPath()
+            {
+                return inst::config::appDir + "/shop_cache_" + std::to_string(std::hash<std::string>{}(m_shopUrl)) + ".meta.json";
+            }
+
+            nlohmann::json ReadMeta()
+            {
+                std::ifstream in(GetMetaPath());
+                return nlohmann::json::parse(in);
+            }
+
+            host::HttpServer m_server;
+            std::string m_shopUrl;
+            std::filesystem::path m_lastDir;
+            std::filesystem::path m_workDir;
+            bool m_backgroundRefresh = false;
+    };
+
+    TEST_F(ShopCacheTest, FirstFetchKeepsTheValidators)
+    {
+        EXPECT_EQ(Fetch(true), std::vector<std::string>({ "First [0100000000010000][v0].nsp" }));
+
+        auto requests = GetSectionRequests();
+        ASSERT_EQ(requests.size(), 1u);
+        EXPECT_EQ(GetHeader(requests[0], "if-none-match"), "");
+        EXPECT_EQ(GetHeader(requests[0], "if-modified-since"), "");
+
+        auto meta = ReadMeta();
+        EXPECT_FALSE(meta.value("etag", "").empty());
+        EXPECT_FALSE(meta.value("last_modified", "").empty());
+    }
+
+    TEST_F(ShopCacheTest, FreshCacheIsUsedWithoutARequest)
+    {
+        auto first = Fetch(true);
+        m_server.ClearRequests();
+
+        EXPECT_EQ(Fetch(true), first);
+        EXPECT_TRUE(GetSectionRequests().empty());
+    }
+
+    TEST_F(ShopCacheTest, UnchangedShopAnswers304AndTheCacheIsKept)
+    {
+        auto first = Fetch(true);
+        auto meta = ReadMeta();
+        m_server.ClearRequests();
+
+        // A forced refresh still asks conditionally
+        EXPECT_EQ(Fetch(false), first);
+
+        auto requests = GetSectionRequests();
+        ASSERT_EQ(requests.size(), 1u);
+        EXPECT_EQ(GetHeader(requests[0], "if-none-match"), meta["etag"].get<std::string>());
+        EXPECT_EQ(GetHeader(requests[0], "if-modified-since"), meta["last_modified"].get<std::string>());
+        EXPECT_EQ(ReadMeta()["etag"], meta["etag"]);
+    }
+
+    TEST_F(ShopCacheTest, NotModifiedRenewsAStaleCache)
+    {
+        auto first = Fetch(true);
+
+        // Last checked long past the TTL
+        auto meta = ReadMeta();
+        meta["checked_at"] = 0;
+        std::ofstream(GetMetaPath(), std::ios::trunc) << meta.dump();
+        m_server.ClearRequests();
+
+        EXPECT_EQ(Fetch(true), first);
+        ASSERT_EQ(GetSectionRequests().size(), 1u);
+        EXPECT_EQ(GetHeader(GetSectionRequests()[0], "if-none-match"), meta["etag"].get<std::string>());
+        EXPECT_GT(ReadMeta()["checked_at"].get<std::int64_t>(), 0);
+
+        // Fresh again, so the next visit doesn't ask
+        m_server.ClearRequests();
+        EXPECT_EQ(Fetch(true), first);
+        EXPECT_TRUE(GetSectionRequests().empty());
+    }
+
+    TEST_F(ShopCacheTest, ChangedShopReplacesTheCache)
+    {
+        Fetch(true);
+        auto meta = ReadMeta();
+
+        m_server.UpdateFile(SECTIONS_PATH, MakeSections("Second"));
+        m_server.ClearRequests();
+
+        // The old validators no longer match, so the new listing comes back in full
+        EXPECT_EQ(Fetch(false), std::vector<std::string>({ "Second [0100000000010000][v0].nsp" }));
+        ASSERT_EQ(GetSectionRequests().size(), 1u);
+        EXPECT_EQ(GetHeader(GetSectionRequests()[0], "if-none-match"), meta["etag"].get<std::string>());
+        EXPECT_NE(ReadMeta()["etag"], meta["etag"]);
+
+        // And the new copy is what's served from the cache
+        m_server.ClearRequests();
+        EXPECT_EQ(Fetch(true), std::vector<std::string>({ "Second [0100000000010000][v0].nsp" }));
+        EXPECT_TRUE(GetSectionRequests().empty());
+    }
+
+    TEST_F(ShopCacheTest, StopAbortsAStalledRevalidation)
+    {
+        auto first = Fetch(true);
+        auto meta = ReadMeta();
+        meta["checked_at"] = 0;
+        std::ofstream(GetMetaPath(), std::ios::trunc) << meta.dump();
+
+        // The shop changed, so the revalidation gets a body, which then never arrives
+        m_server.UpdateFile(SECTIONS_PATH, MakeSections("Second"));
+        host::HttpFault stall;
+        stall.path = SECTIONS_PATH;
+        stall.dropAfter = 0x10;
+        stall.stall = true;
+        m_server.AddFault(stall);
+        m_server.ClearRequests();
+
+        // The stale copy is served and revalidated in the background
+        inst::config::shopBackgroundRefresh = true;
+        EXPECT_EQ(Fetch(true), first);
+
+        for (int i = 0; i < 500 && GetSectionRequests().empty(); i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ASSERT_EQ(GetSectionRequests().size(), 1u);
+
+        // Well inside the request's own 15 second timeout
+        auto start = std::chrono::steady_clock::now();
+        shopInstStuff::StopCacheRevalidation();
+        EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+        EXPECT_EQ(ReadMeta()["checked_at"], 0);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <switch/types.h>
+
+namespace tin::data
+{
+    static const size_t BUFFER_SEGMENT_DATA_SIZE = 0x800000; // Approximately 8MB
+
+    struct BufferSegment
+    {
+        // Kept first and page aligned so it can be used directly as a USB transfer buffer
+        alignas(0x1000) u8 data[BUFFER_SEGMENT_DATA_SIZE];
+        bool isFinalized = false;
+        u64 writeOffset = 0;
+    };
+
+    // Process-wide cache of buffer segments shared by every BufferedPlaceholderWriter.
+    // Segments are allocated lazily, never zeroed, and kept around for reuse by later NCAs
+    // and installs until Trim() is called. The total allocated never exceeds the budget.
+    class BufferSegmentPool
+    {
+        private:
+            std::mutex m_mutex;
+            std::vector<BufferSegment*> m_freeSegments;
+            size_t m_budget = 2 * BUFFER_SEGMENT_DATA_SIZE;
+            size_t m_numAllocated = 0;
+            u32 m_numStreams = 1;
+
+            BufferSegmentPool() {}
+
+        public:
+            BufferSegmentPool(const BufferSegmentPool&) = delete;
+            BufferSegmentPool& operator=(const BufferSegmentPool&) = delete;
+
+            static BufferSegmentPool& Get();
+
+            // The budget is in bytes and is rounded down to whole segments
+            void SetBudget(size_t budget);
+            u32 GetMaxSegments();
+
+            // The budget is split evenly between this many writers when sizing their windows
+            void SetStreamCount(u32 numStreams);
+
+            // Returns a cached segment, or allocates a new one if within budget.
+            // Returns NULL if the budget is exhausted or the heap is out of memory.
+            BufferSegment* Acquire();
+            void Release(BufferSegment* segment);
+
+            // Determine how many segments a writer for data of this size should use, taking into
+            // account both the budget and how much heap is actually left. Always at least 1.
+            u32 CalcWindowSize(size_t totalDataSize);
+
+            // Frees all cached segments that aren't currently in use
+            void Trim();
+    };
+}
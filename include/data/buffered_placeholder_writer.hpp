@@ -23,59 +23,96 @@ SOFTWARE.
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <switch/types.h>
 #include <memory>
+#include <vector>
 
+#include "data/buffer_segment_pool.hpp"
 #include "nx/ncm.hpp"
 #include "nx/nca_writer.h"
 
 namespace tin::data
 {
-    static const size_t BUFFER_SEGMENT_DATA_SIZE = 0x800000; // Approximately 8MB
-    extern int NUM_BUFFER_SEGMENTS;
-
-    struct BufferSegment
-    {
-        std::atomic_bool isFinalized = false;
-        u64 writeOffset = 0;
-        u8 data[BUFFER_SEGMENT_DATA_SIZE] = {0};
-    };
-
-    // Receives data in a circular buffer split into 8MB segments
+    // Receives data in a circular buffer split into 8MB segments.
+    // There must only be one producer thread (AcquireWrite/CommitWrite/AppendData) and one
+    // consumer thread (AcquireRead/Release/WriteSegmentToPlaceholder). Both sides block
+    // rather than spin while waiting on each other, and Cancel() wakes everyone up.
+    // Segments are borrowed from the BufferSegmentPool as the producer first reaches them, so
+    // small NCAs never touch more memory than they need. If the pool runs dry part way through
+    // the first lap, the ring simply shrinks to the segments it already has.
     class BufferedPlaceholderWriter
     {
         private:
             size_t m_totalDataSize = 0;
-            size_t m_sizeBuffered = 0;
-            size_t m_sizeWrittenToPlaceholder = 0;
+            std::atomic<size_t> m_sizeBuffered = 0;
+            std::atomic<size_t> m_sizeWrittenToPlaceholder = 0;
+            std::atomic_bool m_cancelled = false;
 
             // The current segment to which further data will be appended
             u64 m_currentFreeSegment = 0;
-            BufferSegment* m_currentFreeSegmentPtr = NULL;
             // The current segment that will be written to the placeholder
             u64 m_currentSegmentToWrite = 0;
-            BufferSegment* m_currentSegmentToWritePtr = NULL;
 
-            std::unique_ptr<BufferSegment[]> m_bufferSegments;
+            // Slots are NULL until the producer first needs them
+            std::vector<BufferSegment*> m_bufferSegments;
+            u32 m_numSegments = 0;
+
+            std::mutex m_mutex;
+            std::condition_variable m_canWrite;
+            std::condition_variable m_canRead;
+            std::condition_variable m_stateChanged;
+
+            // Telemetry, see InstallTelemetry
+            std::atomic<u64> m_firstWriteTick = 0;
+            std::atomic<u64> m_lastWriteTick = 0;
+            std::atomic<u64> m_backpressureTicks = 0;
+            std::atomic<u64> m_bufferWaitTicks = 0;
 
             std::shared_ptr<nx::ncm::ContentStorage> m_contentStorage;
             NcmContentId m_ncaId;
 			NcaWriter m_writer;
 
-        public:
-            BufferedPlaceholderWriter(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId, size_t totalDataSize);
-
-            void AppendData(void* source, size_t length);
-            bool CanAppendData(size_t length);
-
-            void WriteSegmentToPlaceholder();
-            bool CanWriteSegmentToPlaceholder();
+            void UpdateTelemetry();
 
-            // Determine the number of segments required to fit data of this size
-            u32 CalcNumSegmentsRequired(size_t size);
-
-            // Check if there are enough free segments to fit data of this size
-            bool IsSizeAvailable(size_t size);
+        public:
+            // verifyHash is passed on to NcaWriter
+            BufferedPlaceholderWriter(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId, bool verifyHash, size_t totalDataSize);
+            ~BufferedPlaceholderWriter();
+
+            // Producer side. AcquireWrite blocks until the current segment is free, then returns
+            // a pointer into it and the number of bytes that may be written there. Returns NULL
+            // if the writer has been cancelled. Sources that can fill memory themselves (e.g. USB)
+            // should read straight into this pointer and then CommitWrite what they received.
+            // The pointer is page aligned whenever everything committed so far has been.
+            u8* AcquireWrite(size_t* outSize);
+            void CommitWrite(size_t length);
+            // Copies the data in via AcquireWrite/CommitWrite. Returns false if cancelled.
+            bool AppendData(void* source, size_t length);
+
+            // Consumer side. AcquireRead blocks until the next segment has been finalized and
+            // returns it, or NULL if the writer has been cancelled.
+            BufferSegment* AcquireRead();
+            void Release();
+            // Writes the next finalized segment to the placeholder. Returns false if cancelled.
+            bool WriteSegmentToPlaceholder();
+
+            // Continue an interrupted NCA, see NcaWriter::resume. Must be called before any data is written.
+            void Resume(const NcaResumePoint& point);
+            // Consumer side. The latest point the NCA can be resumed from, false if there's none yet.
+            bool GetCheckpoint(NcaResumePoint& point);
+            // Consumer side. Whether the finished NCA failed its hash check, its placeholder is gone then.
+            bool VerificationFailed();
+
+            // Wakes up any blocked producer, consumer or waiter. Irreversible.
+            void Cancel();
+            bool IsCancelled();
+
+            // Block until the condition is met, the writer is cancelled or the timeout elapses.
+            // Returns whether the condition has been met.
+            bool WaitBufferDataComplete(u64 timeoutNs);
+            bool WaitPlaceholderComplete(u64 timeoutNs);
 
             bool IsBufferDataComplete();
             bool IsPlaceholderComplete();
@@ -83,6 +120,7 @@ namespace tin::data
             size_t GetTotalDataSize();
             size_t GetSizeBuffered();
             size_t GetSizeWrittenToPlaceholder();
+            u32 GetNumSegments();
 
             void DebugPrintBuffers();
     };
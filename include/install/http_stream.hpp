@@ -0,0 +1,19 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <switch/types.h>
+
+#include "install/progress_sink.hpp"
+#include "nx/ncm.hpp"
+#include "util/network_util.hpp"
+
+namespace tin::install
+{
+    // Streams an NCA at ncaOffset of a remote NSP or XCI to its placeholder, shared by HTTPNSP and
+    // HTTPXCI. The download and the placeholder writes run on threads of their own. An NCA with a
+    // journal left by an earlier attempt carries on from there, and an interrupted one records how
+    // far it got.
+    void StreamHttpNcaToPlaceholder(tin::network::HTTPDownload& download, std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId, bool verifyHash,
+        u64 ncaOffset, u64 ncaSize, const std::string& ncaFileName, const ProgressSink& progress);
+}
@@ -32,10 +32,13 @@ namespace tin::install::xci
     {
         public:
             tin::network::HTTPDownload m_download;
+            tin::network::HTTPRangeCache m_rangeCache;
 
             HTTPXCI(std::string url);
 
-            virtual void StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId placeholderId) override;
+            virtual void StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId placeholderId, bool verifyHash, const tin::install::ProgressSink& progress) override;
             virtual void BufferData(void* buf, off_t offset, size_t size) override;
+            virtual u32 GetMaxConcurrentStreams() override;
+            virtual bool CanResume() override;
     };
 }
\ No newline at end of file
@@ -31,6 +31,7 @@ extern "C"
 #include <tuple>
 #include <vector>
 
+#include "install/progress_sink.hpp"
 #include "install/simple_filesystem.hpp"
 #include "data/byte_buffer.hpp"
 
@@ -45,6 +46,8 @@ namespace tin::install
             const NcmStorageId m_destStorageId;
             bool m_ignoreReqFirmVersion = false;
             bool m_declinedValidation = false;
+            // Set once Begin has validated every NCA, so InstallNCA doesn't do it again
+            bool m_ncasValidated = false;
 
             std::vector<nx::ncm::ContentMeta> m_contentMeta;
 
@@ -55,7 +58,14 @@ namespace tin::install
             virtual void InstallContentMetaRecords(tin::data::ByteBuffer& installContentMetaBuf, int i);
             virtual void InstallApplicationRecord(int i);
             virtual void InstallTicketCert() = 0;
-            virtual void InstallNCA(const NcmContentId &ncaId) = 0;
+            // Checks the NCA header signature and asks the user whether to continue if it fails.
+            // It may show a dialog, so it must only run on the main thread.
+            virtual void ValidateNCA(const NcmContentId& ncaId);
+            // Progress goes to the given sink, only one of several concurrent streams shows it
+            virtual void InstallNCA(const NcmContentId &ncaId, const ProgressSink& progress) = 0;
+
+            // How many NCAs the source can stream at once, must be safe to call InstallNCA from this many threads
+            virtual u32 GetMaxConcurrentNCAs();
 
         public:
             virtual ~Install();
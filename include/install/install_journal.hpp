@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <switch/types.h>
+
+#include "nx/ncm.hpp"
+#include "nx/nca_writer.h"
+
+namespace tin::install
+{
+    // Records how far an NCA got into its placeholder, so a failed install can pick up from there
+    // instead of starting over. Stored per content id under the app directory. The journal only
+    // describes data that is known to be on the placeholder, and is rewritten every
+    // JOURNAL_UPDATE_INTERVAL bytes of progress.
+    class InstallJournal
+    {
+        private:
+            std::shared_ptr<nx::ncm::ContentStorage> m_contentStorage;
+            NcmContentId m_ncaId;
+            u64 m_ncaSize;
+            std::string m_path;
+
+            NcaResumePoint m_point;
+            u64 m_savedOffset = 0;
+            bool m_dirty = false;
+
+            void Save();
+
+        public:
+            static const u64 JOURNAL_UPDATE_INTERVAL = 0x4000000; // 64MB
+            static const int JOURNAL_MAX_AGE_DAYS = 7;
+
+            InstallJournal(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, const NcmContentId& ncaId, u64 ncaSize);
+
+            // Returns whether there's a journal matching this NCA and a placeholder it can be
+            // resumed into. A journal that doesn't match is removed.
+            bool Load(NcaResumePoint& point);
+            void Update(const NcaResumePoint& point);
+            // Write the latest point out even if the interval hasn't passed
+            void Flush();
+            void Remove();
+
+            static void Remove(const NcmContentId& ncaId);
+            // Drops journals whose placeholder is gone, and those (with their placeholders) that
+            // haven't been touched in JOURNAL_MAX_AGE_DAYS. Run before an install starts.
+            static void Prune();
+    };
+}
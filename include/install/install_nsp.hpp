@@ -36,8 +36,10 @@ namespace tin::install::nsp
 
         protected:
             std::vector<std::tuple<nx::ncm::ContentMeta, NcmContentInfo>> ReadCNMT() override;
-            void InstallNCA(const NcmContentId& ncaId) override;
+            void ValidateNCA(const NcmContentId& ncaId) override;
+            void InstallNCA(const NcmContentId& ncaId, const ProgressSink& progress) override;
             void InstallTicketCert() override;
+            u32 GetMaxConcurrentNCAs() override;
 
         public:
             NSPInstall(NcmStorageId destStorageId, bool ignoreReqFirmVersion, const std::shared_ptr<NSP>& remoteNSP);
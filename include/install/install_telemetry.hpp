@@ -0,0 +1,62 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <switch/types.h>
+
+#include "nx/nca_writer.h"
+
+namespace tin::install
+{
+    struct InstallStageStats
+    {
+        u64 ticks = 0;
+        u64 bytes = 0;
+    };
+
+    // Where the time for one NCA went. receive is time spent getting data from the source, not
+    // counting backpressure, the time the source waited for room in the buffer. bufferWait is the
+    // time the placeholder side waited for data instead.
+    struct NcaInstallStats
+    {
+        NcmContentId ncaId;
+        u64 size = 0;
+        u64 startTick = 0;
+        u64 endTick = 0;
+
+        InstallStageStats receive;
+        InstallStageStats bufferWait;
+        InstallStageStats backpressure;
+        InstallStageStats decompress;
+        InstallStageStats encrypt;
+        InstallStageStats write;
+        InstallStageStats registration;
+    };
+
+    // Collects per stage timings of the NCAs in the current install. Sources report as they go,
+    // so the totals can be shown while the install is running and written out once it's done.
+    class InstallTelemetry
+    {
+        private:
+            std::mutex m_mutex;
+            std::vector<NcaInstallStats> m_ncas;
+            u64 m_startTick = 0;
+
+            NcaInstallStats& GetNca(const NcmContentId& ncaId);
+
+        public:
+            static InstallTelemetry& Get();
+
+            void Reset();
+
+            void BeginNca(const NcmContentId& ncaId, u64 size);
+            void SetReceiveStats(const NcmContentId& ncaId, const InstallStageStats& receive, const InstallStageStats& bufferWait, const InstallStageStats& backpressure);
+            void SetWriterStats(const NcmContentId& ncaId, const NcaWriterStats& stats);
+            void EndNca(const NcmContentId& ncaId, u64 registerTicks);
+
+            // A single line of throughput per stage across every NCA so far
+            std::string GetOverlayText();
+            void Dump(const std::string& path);
+    };
+}
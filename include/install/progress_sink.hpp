@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include "ui/instPage.hpp"
+
+namespace tin::install
+{
+    // Where an NCA stream reports its progress. When several NCAs install at once only one of them
+    // drives the install page, the others are handed a muted sink.
+    class ProgressSink
+    {
+        public:
+            explicit ProgressSink(bool visible = true) :
+                m_visible(visible)
+            {
+            }
+
+            void SetText(const std::string& text) const
+            {
+                if (m_visible)
+                    inst::ui::instPage::setInstInfoText(text);
+            }
+
+            void SetPercent(double percent) const
+            {
+                if (m_visible)
+                    inst::ui::instPage::setInstBarPerc(percent);
+            }
+
+        private:
+            bool m_visible;
+    };
+}
@@ -22,6 +22,7 @@ SOFTWARE.
 
 #pragma once
 
+#include <mutex>
 #include "install/nsp.hpp"
 
 namespace tin::install::nsp
@@ -32,9 +33,11 @@ namespace tin::install::nsp
         SDMCNSP(std::string path);
         ~SDMCNSP();
 
-        virtual void StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId) override;
+        virtual void StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId, bool verifyHash, const tin::install::ProgressSink& progress) override;
         virtual void BufferData(void* buf, off_t offset, size_t size) override;
+        virtual u32 GetMaxConcurrentStreams() override;
     private:
         FILE* m_nspFile;
+        std::mutex m_fileMutex;
     };
 }
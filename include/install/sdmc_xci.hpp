@@ -22,6 +22,7 @@ SOFTWARE.
 
 #pragma once
 
+#include <mutex>
 #include "install/xci.hpp"
 
 namespace tin::install::xci
@@ -32,9 +33,11 @@ namespace tin::install::xci
         SDMCXCI(std::string path);
         ~SDMCXCI();
 
-        virtual void StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId) override;
+        virtual void StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId, bool verifyHash, const tin::install::ProgressSink& progress) override;
         virtual void BufferData(void* buf, off_t offset, size_t size) override;
+        virtual u32 GetMaxConcurrentStreams() override;
     private:
         FILE* m_xciFile;
+        std::mutex m_fileMutex;
     };
 }
\ No newline at end of file
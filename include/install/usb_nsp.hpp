@@ -35,7 +35,7 @@ namespace tin::install::nsp
         public:
             USBNSP(std::string nspName);
 
-            virtual void StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId placeholderId) override;
+            virtual void StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId placeholderId, bool verifyHash, const tin::install::ProgressSink& progress) override;
             virtual void BufferData(void* buf, off_t offset, size_t size) override;
     };
 }
\ No newline at end of file
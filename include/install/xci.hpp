@@ -27,6 +27,7 @@ SOFTWARE.
 
 #include <switch/types.h>
 #include "install/hfs0.hpp"
+#include "install/progress_sink.hpp"
 #include "nx/ncm.hpp"
 #include <memory>
 
@@ -41,8 +42,13 @@ namespace tin::install::xci
             XCI();
 
         public:
-            virtual void StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId placeholderId) = 0;
+            // With verifyHash set, the NCA is checked against its content id as it is written
+            virtual void StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId placeholderId, bool verifyHash, const tin::install::ProgressSink& progress) = 0;
             virtual void BufferData(void* buf, off_t offset, size_t size) = 0;
+            // Number of StreamToPlaceholder calls that may run at the same time
+            virtual u32 GetMaxConcurrentStreams();
+            // Whether StreamToPlaceholder can continue from a placeholder left by an earlier attempt
+            virtual bool CanResume();
 
             virtual void RetrieveHeader();
             virtual const HFS0BaseHeader* GetSecureHeader();
@@ -22,41 +22,226 @@ SOFTWARE.
 
 #pragma once
 #include <switch.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include "nx/ncm.hpp"
 #include <memory>
 #include "install/nca.hpp"
 
+// Time is in system ticks. Busy is time spent doing the stage's work, idle is time spent
+// blocked waiting on the neighbouring stages.
+struct NcaWriterStageStats
+{
+	u64 busyTicks = 0;
+	u64 idleTicks = 0;
+	u64 bytes = 0;
+};
+
+struct NcaWriterStats
+{
+	NcaWriterStageStats decompress;
+	NcaWriterStageStats encrypt;
+	NcaWriterStageStats write;
+};
+
+// Thread safe accumulator behind NcaWriterStageStats
+class NcaWriterStageCounter
+{
+public:
+	void addBusy(u64 startTick, u64 bytes = 0);
+	void addIdle(u64 startTick);
+	NcaWriterStageStats snapshot() const;
+
+protected:
+	std::atomic<u64> m_busyTicks = 0;
+	std::atomic<u64> m_idleTicks = 0;
+	std::atomic<u64> m_bytes = 0;
+};
+
+// A point an interrupted NCA write can be continued from. Offsets are absolute, input ones into the
+// NCA/NCZ as streamed and output ones into the placeholder. The first prefixSize bytes of the input
+// carry the headers and are replayed before continuing at inputOffset. block is the next NCZ block.
+// When the write is being verified, hashState is the SHA-256 state over the first outputOffset bytes.
+struct NcaResumePoint
+{
+	u64 inputOffset = 0;
+	u64 outputOffset = 0;
+	u64 prefixSize = 0;
+	u32 block = 0;
+	bool hashed = false;
+	Sha256Context hashState;
+};
+
+// SHA-256 over the NCA as it is streamed, computed on its own thread. update() only queues
+// the buffer, which must stay valid until wait() returns, so hashing can overlap the write.
+class NcaHasher
+{
+public:
+	NcaHasher();
+	~NcaHasher();
+
+	void update(const void* ptr, u64 sz);
+	void wait();
+	void getHash(u8* out);
+	u64 size() const;
+	// The state over everything hashed so far, and continuing from such a state
+	void saveState(Sha256Context& out);
+	void restoreState(const Sha256Context& state, u64 size);
+
+protected:
+	void run();
+
+	Sha256Context m_ctx;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	const u8* m_ptr = NULL;
+	u64 m_pendingSize = 0;
+	u64 m_size = 0;
+	bool m_pending = false;
+	bool m_exit = false;
+	std::thread m_thread;
+};
+
+typedef struct ZSTD_DCtx_s ZSTD_DCtx;
+
+// Worker threads for NCZ block decompression, each pinned to an application core. An install
+// holds one for as long as it runs, and the NCAs it streams at once all decompress on it.
+class NczWorkerPool
+{
+public:
+	explicit NczWorkerPool(u32 numWorkers);
+	~NczWorkerPool();
+
+	// The pool of the install in progress, created by whoever asks first and kept while it's held
+	static std::shared_ptr<NczWorkerPool> shared();
+	static u32 workerCount();
+
+	// Runs task on a worker. Tasks are started in the order they were queued.
+	void run(std::function<void (ZSTD_DCtx* dctx)> task);
+
+protected:
+	void workerFunc(u32 core);
+
+	std::mutex m_mutex;
+	std::condition_variable m_taskAvailable;
+	std::deque<std::function<void (ZSTD_DCtx* dctx)>> m_tasks;
+	std::vector<std::thread> m_workers;
+	bool m_stop = false;
+};
+
+// Decompresses the NCZ blocks of one NCA on a worker pool. Blocks are handed back in the order
+// they were submitted, regardless of the order they finish in.
+class NczBlockDecompressor
+{
+public:
+	struct Job
+	{
+		std::vector<u8> input;
+		std::vector<u8> output;
+		u32 index = 0;
+		u64 inputEnd = 0;
+		bool done = false;
+		bool failed = false;
+	};
+
+	NczBlockDecompressor(std::shared_ptr<NczWorkerPool> pool, u32 maxJobs, NcaWriterStageCounter& stats);
+	// With a pool of its own
+	NczBlockDecompressor(u32 numWorkers, u32 maxJobs, NcaWriterStageCounter& stats);
+	virtual ~NczBlockDecompressor();
+
+	bool full();
+	bool empty();
+	void submit(std::unique_ptr<Job> job);
+	// Waits for the oldest submitted job to finish and removes it from the queue
+	std::unique_ptr<Job> popFront();
+
+protected:
+	// Fills in job.output, or sets job.failed. Runs on the worker threads.
+	virtual void decompress(ZSTD_DCtx* dctx, Job& job);
+	// Waits for the jobs already on the pool, the rest are dropped. Subclasses overriding decompress
+	// call this from their destructor.
+	void stop();
+	void runJob(ZSTD_DCtx* dctx, Job& job);
+
+	std::shared_ptr<NczWorkerPool> m_pool;
+	std::mutex m_mutex;
+	std::condition_variable m_jobDone;
+	std::deque<std::unique_ptr<Job>> m_jobs;
+	u32 m_inFlight = 0;
+	NcaWriterStageCounter& m_stats;
+	u32 m_maxJobs;
+	bool m_stop = false;
+};
+
 class NcaBodyWriter
 {
 public:
-	NcaBodyWriter(const NcmContentId& ncaId, u64 offset, std::shared_ptr<nx::ncm::ContentStorage>& contentStorage);
+	NcaBodyWriter(const NcmContentId& ncaId, u64 offset, std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcaHasher* hasher = NULL);
 	virtual ~NcaBodyWriter();
 	virtual u64 write(const  u8* ptr, u64 sz);
+	// Throws if anything written couldn't make it to the placeholder
+	virtual bool close();
+	virtual void resume(const NcaResumePoint& point);
+	// Latest point whose data is fully on the placeholder, false if there's none
+	virtual bool checkpoint(NcaResumePoint& point);
 	
 	bool isOpen() const;
+	NcaWriterStats stats() const;
 
 protected:
 	std::shared_ptr<nx::ncm::ContentStorage> m_contentStorage;
 	NcmContentId m_ncaId;
 
+	u64 m_bodyOffset;
 	u64 m_offset;
+	NcaHasher* m_hasher;
+
+	NcaWriterStageCounter m_decompressStats;
+	NcaWriterStageCounter m_encryptStats;
+	NcaWriterStageCounter m_writeStats;
 };
 
 class NcaWriter
 {
 public:
-	NcaWriter(const NcmContentId& ncaId, std::shared_ptr<nx::ncm::ContentStorage>& contentStorage);
+	// With verifyHash set, close() checks the streamed data against the content id and
+	// deletes the placeholder and throws on a mismatch
+	NcaWriter(const NcmContentId& ncaId, std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, bool verifyHash = false);
 	virtual ~NcaWriter();
 
 	bool isOpen() const;
 	bool close();
+	// Whether close() found a hash mismatch and deleted the placeholder
+	bool verificationFailed() const;
 	u64 write(const  u8* ptr, u64 sz);
 	void flushHeader();
+	NcaWriterStats stats() const;
+
+	// Continue an interrupted write. The placeholder must still be there, and the caller then writes the
+	// first point.prefixSize bytes of the NCA again followed by everything from point.inputOffset on.
+	// The hash is only verified if the point carries the hash state.
+	void resume(const NcaResumePoint& point);
+	bool checkpoint(NcaResumePoint& point);
 
 protected:
+	u64 writeData(const  u8* ptr, u64 sz);
+	// The size the header gives for the whole NCA, 0 until the header is in
+	u64 headerNcaSize() const;
+
 	NcmContentId m_ncaId;
 	std::shared_ptr<nx::ncm::ContentStorage> m_contentStorage;
 	std::vector<u8> m_buffer;
 	std::shared_ptr<NcaBodyWriter> m_writer;
+	std::unique_ptr<NcaHasher> m_hasher;
+	NcaWriterStats m_stats;
+	NcaResumePoint m_resumePoint;
+	bool m_resuming = false;
+	bool m_resumed = false;
+	bool m_verificationFailed = false;
+	u64 m_inputOffset = 0;
 };
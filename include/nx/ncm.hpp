@@ -38,6 +38,7 @@ namespace nx::ncm
     {
         private:
             NcmContentStorage m_contentStorage;
+            NcmStorageId m_storageId;
 
         public:
             // Don't allow copying, or garbage may be closed by the destructor
@@ -49,10 +50,12 @@ namespace nx::ncm
 
             void CreatePlaceholder(const NcmContentId &placeholderId, const NcmPlaceHolderId &registeredId, size_t size);
             void DeletePlaceholder(const NcmPlaceHolderId &placeholderId);
+            bool HasPlaceholder(const NcmPlaceHolderId &placeholderId);
             void WritePlaceholder(const NcmPlaceHolderId &placeholderId, u64 offset, void *buffer, size_t bufSize);
             void Register(const NcmPlaceHolderId &placeholderId, const NcmContentId &registeredId);
             void Delete(const NcmContentId &registeredId);
             bool Has(const NcmContentId &registeredId);
             std::string GetPath(const NcmContentId &registeredId);
+            NcmStorageId GetStorageId() const;
     };
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace shopInstStuff {
+    struct ShopItem;
+    struct ShopSection;
+
+    // Every item of a shop, stored column by column. Text lives in a single arena and urls are
+    // split into an interned directory prefix plus the file name, so items that share a folder
+    // (which is nearly all of them) only store their own leaf. Sections, filters and selections
+    // refer to items by index, and an item listed in several sections is only stored once.
+    class ShopCatalog {
+        public:
+            using Index = std::uint32_t;
+
+            // Returns the index of the item, reusing the existing one if its url is already known
+            Index Add(const ShopItem& item);
+            void Clear();
+            std::size_t Size() const;
+
+            // Views are only valid until the next Add
+            std::string_view GetName(Index index) const;
+            // The name as shown, with " (Update)" or " (DLC)" appended once type labels are on
+            std::string GetDisplayName(Index index) const;
+            std::string GetUrl(Index index) const;
+            std::string GetIconUrl(Index index) const;
+            std::string_view GetAppId(Index index) const;
+            std::uint64_t GetSize(Index index) const;
+            std::uint64_t GetTitleId(Index index) const;
+            std::uint32_t GetAppVersion(Index index) const;
+            std::int32_t GetAppType(Index index) const;
+            bool HasUrl(Index index) const;
+            bool HasIconUrl(Index index) const;
+            bool HasAppId(Index index) const;
+            bool HasTitleId(Index index) const;
+            bool HasAppVersion(Index index) const;
+
+            // Copy of a single item, with its display name
+            ShopItem GetItem(Index index) const;
+            void SetTypeLabels(bool enabled);
+
+            // Binary snapshot of the catalog and the sections that index it. Loading appends to the
+            // catalog with one file read and no allocation per item, the sections are replaced.
+            bool Save(const std::string& path, const std::vector<ShopSection>& sections) const;
+            bool Load(const std::string& path, std::vector<ShopSection>& sections);
+
+        private:
+            struct StringRef {
+                std::uint32_t offset = 0;
+                std::uint32_t length = 0;
+            };
+
+            enum Flags : std::uint8_t {
+                kHasTitleId = 1 << 0,
+                kHasAppVersion = 1 << 1,
+                kHasIconUrl = 1 << 2,
+                kHasAppId = 1 << 3,
+            };
+
+            std::string m_arena;
+            std::vector<std::string> m_prefixes;
+            std::unordered_map<std::string, std::uint32_t> m_prefixLookup;
+            // Url hash to item, collisions are told apart by comparing the urls. Loaded items are only
+            // hashed once something is added after them.
+            std::unordered_multimap<std::size_t, Index> m_urlLookup;
+            Index m_urlLookupEnd = 0;
+            bool m_typeLabels = false;
+
+            std::vector<StringRef> m_names;
+            std::vector<std::uint32_t> m_urlPrefixes;
+            std::vector<StringRef> m_urlLeaves;
+            std::vector<std::uint32_t> m_iconPrefixes;
+            std::vector<StringRef> m_iconLeaves;
+            std::vector<StringRef> m_appIds;
+            std::vector<std::uint64_t> m_sizes;
+            std::vector<std::uint64_t> m_titleIds;
+            std::vector<std::uint32_t> m_appVersions;
+            std::vector<std::int32_t> m_appTypes;
+            std::vector<std::uint8_t> m_flags;
+
+            std::uint32_t InternPrefix(const std::string& prefix);
+            void IndexUrls();
+            StringRef Store(std::string_view text);
+            std::string_view Load(const StringRef& ref) const;
+            void StoreUrl(const std::string& url, std::uint32_t& prefix, StringRef& leaf);
+            std::string LoadUrl(std::uint32_t prefix, const StringRef& leaf) const;
+    };
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace shopInstStuff {
+    // Shop icons, fetched by a couple of background workers into shop_icons/ on the SD card. The
+    // folder is kept under inst::config::shopIconCacheMB by evicting the least recently used icons,
+    // tracked in shop_icons/index.json. Callers get the cached path or nothing, never a wait, unless
+    // they ask for one.
+    class ShopIconService {
+        public:
+            enum class Priority { Visible, Prefetch };
+
+            static ShopIconService& Get();
+            ~ShopIconService();
+
+            // File name an icon is cached under, by title id when there is one
+            static std::string GetCacheName(const std::string& iconUrl, bool hasTitleId, std::uint64_t titleId);
+
+            // Path of the cached icon, or empty if it isn't there yet, in which case it's queued.
+            // Visible requests jump the queue, the latest first. A full queue drops its oldest
+            // prefetches, never visible requests.
+            std::string Request(const std::string& iconUrl, const std::string& cacheName, Priority priority);
+            // Like Request, but waits up to timeoutMs for the download
+            std::string Wait(const std::string& iconUrl, const std::string& cacheName, int timeoutMs);
+            // Drops queued prefetches, for when the list they were for is gone
+            void CancelPrefetch();
+            // Forgets which icons failed to download, so a refreshed shop tries all of them again
+            void ClearFailures();
+            // Goes up whenever an icon lands, so a placeholder can be retried
+            std::uint64_t GetGeneration();
+            // Aborts the downloads in flight, joins the workers and saves the index. Called on the
+            // way out, before the app shuts its services down. Nothing is fetched after this.
+            void Stop();
+
+        private:
+            struct Job {
+                std::string url;
+                std::string cacheName;
+                Priority priority;
+            };
+
+            // A failed url is left alone for a while, longer with each failure in a row
+            struct Failure {
+                int count = 0;
+                std::chrono::steady_clock::time_point retryAt;
+            };
+
+            struct CacheEntry {
+                std::uint64_t size = 0;
+                std::uint64_t lastUsed = 0;
+            };
+
+            std::mutex m_mutex;
+            std::condition_variable m_jobCv;
+            std::condition_variable m_doneCv;
+            std::vector<std::thread> m_workers;
+            std::deque<Job> m_jobs;
+            std::unordered_set<std::string> m_inFlight;
+            std::unordered_map<std::string, Failure> m_failed;
+            std::atomic<bool> m_stop{false};
+            std::uint64_t m_generation = 0;
+
+            bool m_indexLoaded = false;
+            std::unordered_map<std::string, CacheEntry> m_entries;
+            std::uint64_t m_totalSize = 0;
+            std::uint64_t m_useCounter = 0;
+            int m_unsavedChanges = 0;
+
+            ShopIconService() = default;
+            std::string GetCacheDir() const;
+            void LoadIndex();
+            void SaveIndex();
+            void Touch(const std::string& cacheName);
+            void AddEntry(const std::string& cacheName, std::uint64_t size);
+            std::string Lookup(const std::string& cacheName);
+            bool IsFailed(const std::string& iconUrl);
+            void Enqueue(const Job& job);
+            void WorkerMain();
+            bool Download(void* curl, const Job& job);
+    };
+}
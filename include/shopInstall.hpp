@@ -3,6 +3,8 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include "shopCatalog.hpp"
+#include "util/config.hpp"
 
 namespace shopInstStuff {
     struct ShopItem {
@@ -23,11 +25,23 @@ namespace shopInstStuff {
     struct ShopSection {
         std::string id;
         std::string title;
-        std::vector<ShopItem> items;
+        // Indices into the ShopCatalog the section was fetched into
+        std::vector<ShopCatalog::Index> items;
     };
 
-    std::vector<ShopItem> FetchShop(const std::string& shopUrl, const std::string& user, const std::string& pass, std::string& error);
-    std::vector<ShopSection> FetchShopSections(const std::string& shopUrl, const std::string& user, const std::string& pass, std::string& error, bool allowCache = true);
+    std::vector<ShopCatalog::Index> FetchShop(const std::string& shopUrl, const std::string& user, const std::string& pass, ShopCatalog& catalog, std::string& error);
+    std::vector<ShopSection> FetchShopSections(const std::string& shopUrl, const std::string& user, const std::string& pass, ShopCatalog& catalog, std::string& error, bool allowCache = true);
+    // The configured shop first, then the extra profiles, without blank or repeated urls
+    std::vector<inst::config::ShopProfile> GetShopProfiles();
+    // Hands each shop's credentials to the network layer, which sends them only to that shop
+    void RegisterShopAuth(const std::vector<inst::config::ShopProfile>& shops);
+    // Fetches every shop at once and merges them into catalog. An item several shops offer, matched
+    // by title id and version, is kept from the one whose response started soonest, going by curl's
+    // start transfer time of its last fetch.
+    std::vector<ShopSection> FetchShopSections(const std::vector<inst::config::ShopProfile>& shops, ShopCatalog& catalog, std::string& error, bool allowCache = true);
+    // Aborts the background revalidation of stale shop caches. Called on the way out, before the
+    // app shuts its services down.
+    void StopCacheRevalidation();
     std::string FetchShopMotd(const std::string& shopUrl, const std::string& user, const std::string& pass);
     void installTitleShop(const std::vector<ShopItem>& items, int storage, const std::string& sourceLabel);
 }
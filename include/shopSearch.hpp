@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "shopCatalog.hpp"
+
+namespace shopInstStuff {
+    // Case-insensitive substring search over a list of catalog items. Names are folded once when
+    // the index is built and every three-byte run is indexed, so a query only has to check the
+    // items that share its rarest trigram. A query that extends the previous one only rechecks
+    // the previous matches.
+    class ShopSearchIndex {
+        public:
+            void Build(const ShopCatalog& catalog, const std::vector<ShopCatalog::Index>& items);
+            void Clear();
+            // Matching items, in the order the index was built with
+            const std::vector<ShopCatalog::Index>& Search(const std::string& query);
+
+        private:
+            std::vector<ShopCatalog::Index> m_items;
+            // Folded names back to back, entry i is [m_offsets[i], m_offsets[i + 1])
+            std::string m_folded;
+            std::vector<std::uint32_t> m_offsets;
+            // Sorted trigram keys, the entries of key i are m_postings[m_postingStarts[i]..m_postingStarts[i + 1])
+            std::vector<std::uint32_t> m_trigrams;
+            std::vector<std::uint32_t> m_postingStarts;
+            std::vector<std::uint32_t> m_postings;
+
+            bool m_hasLast = false;
+            std::string m_lastQuery;
+            std::vector<std::uint32_t> m_lastMatches;
+            std::vector<ShopCatalog::Index> m_results;
+    };
+}
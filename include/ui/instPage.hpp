@@ -18,9 +18,11 @@ namespace inst::ui {
             TextBlock::Ref appVersionText;
             TextBlock::Ref hintText;
             TextBlock::Ref progressText;
+            TextBlock::Ref statsText;
             static void setTopInstInfoText(std::string ourText);
             static void setInstInfoText(std::string ourText);
             static void setInstBarPerc(double ourPercent);
+            static void updateStatsText();
             static void setInstallIcon(const std::string& imagePath);
             static void clearInstallIcon();
             static void loadMainMenu();
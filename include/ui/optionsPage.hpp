@@ -22,5 +22,6 @@ namespace inst::ui {
             void setMenuText();
             std::string getMenuOptionIcon(bool ourBool);
             std::string getMenuLanguage(int ourLangCode);
+            void editShopProfiles();
     };
 }
\ No newline at end of file
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <unordered_map>
+#include <unordered_set>
 #include <pu/Plutonium>
 #include "shopInstall.hpp"
+#include "shopSearch.hpp"
 
 using namespace pu::ui::elm;
 namespace inst::ui {
@@ -17,16 +20,34 @@ namespace inst::ui {
             Image::Ref titleImage;
             TextBlock::Ref appVersionText;
         private:
+            shopInstStuff::ShopCatalog catalog;
             std::vector<shopInstStuff::ShopSection> shopSections;
-            std::vector<shopInstStuff::ShopItem> selectedItems;
-            std::vector<shopInstStuff::ShopItem> visibleItems;
-            std::vector<shopInstStuff::ShopItem> availableUpdates;
+            shopInstStuff::ShopSearchIndex searchIndex;
+            std::vector<shopInstStuff::ShopCatalog::Index> selectedItems;
+            std::unordered_set<shopInstStuff::ShopCatalog::Index> selectedLookup;
+            std::vector<shopInstStuff::ShopCatalog::Index> visibleItems;
+            std::vector<shopInstStuff::ShopCatalog::Index> availableUpdates;
             int selectedSectionIndex = 0;
             std::string searchQuery;
             std::string previewKey;
+            bool previewIconPending = false;
+            std::uint64_t previewIconGeneration = 0;
             bool debugVisible = false;
             int gridSelectedIndex = 0;
             int gridPage = -1;
+            // Which catalogue item each grid image currently holds the icon of
+            struct GridSlot {
+                shopInstStuff::ShopCatalog::Index item = 0;
+                std::uint64_t lastUsed = 0;
+                bool assigned = false;
+                bool iconResolved = false;
+                bool placeholderSet = false;
+            };
+            std::vector<GridSlot> gridSlots;
+            std::unordered_map<shopInstStuff::ShopCatalog::Index, int> gridSlotByItem;
+            std::uint64_t gridSlotCounter = 0;
+            bool gridIconsPending = false;
+            std::uint64_t gridIconGeneration = 0;
             TextBlock::Ref butText;
             Rectangle::Ref topRect;
             Rectangle::Ref infoRect;
@@ -39,7 +60,7 @@ namespace inst::ui {
             TextBlock::Ref gridTitleText;
             TextBlock::Ref debugText;
             void drawMenuItems(bool clearItems);
-            void selectTitle(int selectedIndex);
+            void selectTitle(int selectedIndex, bool redraw = true);
             void updateRememberedSelection();
             void updateSectionText();
             void updateButtonsText();
@@ -47,9 +68,10 @@ namespace inst::ui {
             void cacheAvailableUpdates();
             void filterOwnedSections();
             void updatePreview();
+            void resetGridSlots();
             void updateInstalledGrid();
             void updateDebug();
-            const std::vector<shopInstStuff::ShopItem>& getCurrentItems() const;
+            const std::vector<shopInstStuff::ShopCatalog::Index>& getCurrentItems() const;
             bool isAllSection() const;
             bool isInstalledSection() const;
             void showInstalledDetails();
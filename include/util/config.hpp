@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 namespace inst::config {
@@ -7,16 +8,29 @@ namespace inst::config {
     static const std::string configPath = appDir + "/config.json";
     static const std::string appVersion = std::string(APP_VERSION);
 
+    struct ShopProfile {
+        std::string url;
+        std::string user;
+        std::string pass;
+    };
+
     extern std::string gAuthKey;
     extern std::string sigPatchesUrl;
     extern std::string lastNetUrl;
     extern std::string shopUrl;
     extern std::string shopUser;
     extern std::string shopPass;
+    // Shops listed alongside the one above, their catalogues are merged into one
+    extern std::vector<ShopProfile> shopProfiles;
     extern std::vector<std::string> updateInfo;
     extern int languageSetting;
+    // Attempts in a row that an HTTP transfer may fail without progress before it's given up on
+    extern int httpRetries;
+    // Seconds an HTTP transfer may go without receiving anything before it's retried
+    extern int httpStallSeconds;
     extern bool ignoreReqVers;
     extern bool validateNCAs;
+    extern bool installStats;
     extern bool overClock;
     extern bool deletePrompt;
     extern bool autoUpdate;
@@ -26,6 +40,8 @@ namespace inst::config {
     extern bool usbAck;
     extern bool shopHideInstalled;
     extern bool shopHideInstalledSection;
+    extern bool shopBackgroundRefresh;
+    extern int shopIconCacheMB;
 
     void setConfig();
     void parseConfig();
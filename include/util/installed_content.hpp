@@ -0,0 +1,54 @@
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <switch.h>
+
+namespace tin::util
+{
+    struct InstalledAddOn
+    {
+        u64 titleId = 0;
+        u32 version = 0;
+    };
+
+    // What is installed for one application, across both storages
+    struct InstalledTitle
+    {
+        bool hasBase = false;
+        u32 baseVersion = 0;
+        bool hasPatch = false;
+        u32 patchVersion = 0;
+        std::vector<InstalledAddOn> addOns;
+    };
+
+    // Snapshot of both content meta databases keyed by base title id. It is listed in one pass the
+    // first time it's asked anything, and installs refresh just the titles they touched, so
+    // ownership checks don't need an ns or ncm round trip per title.
+    class InstalledContentIndex
+    {
+        private:
+            std::mutex m_mutex;
+            bool m_loaded = false;
+            std::unordered_map<u64, InstalledTitle> m_titles;
+
+            void Load();
+            void AddKey(const NcmContentMetaKey& key);
+
+        public:
+            static InstalledContentIndex& Get();
+
+            // Drops everything and lists both databases again
+            void Refresh();
+            // Lists only the base, update and DLC ids belonging to baseTitleId
+            void RefreshTitle(u64 baseTitleId);
+
+            bool IsBaseInstalled(u64 baseTitleId);
+            bool GetPatchVersion(u64 baseTitleId, u32& outVersion);
+            bool IsAddOnInstalled(u64 addOnTitleId);
+            bool GetTitle(u64 baseTitleId, InstalledTitle& out);
+            // Every application with its base installed
+            std::vector<u64> GetInstalledBases();
+    };
+}
@@ -28,10 +28,12 @@ SOFTWARE.
 #include <sys/errno.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <curl/curl.h>
 
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -76,9 +78,44 @@ namespace tin::network
     
             void BufferDataRange(void* buffer, size_t offset, size_t size, std::function<void (size_t sizeRead)> progressFunc);
             int StreamDataRange(size_t offset, size_t size, std::function<size_t (u8* bytes, size_t size)> streamFunc);
+            // Same as StreamDataRange, but large ranges are split into pieces fetched over several connections
+            // at once. The number of connections follows the measured throughput, data reaches streamFunc in order.
+            int StreamDataRangeSegmented(size_t offset, size_t size, std::function<size_t (u8* bytes, size_t size)> streamFunc);
     };
 
-    void SetBasicAuth(const std::string& user, const std::string& pass);
+    // HTTPHeader and HTTPDownload keep their curl handles and connections alive between requests.
+    // This closes the idle ones, call it once a batch of installs is done.
+    void ClearConnectionPool();
+    // A handle from that pool, for requests made outside of them. Give it back with ReleaseCurl.
+    CURL* AcquireCurl();
+    void ReleaseCurl(CURL* curl);
+
+    // Serves the small reads made while parsing a remote container (its header, NCA headers, tickets
+    // and certs) from cached ranges. The first miss reads ahead far enough to usually cover all of the
+    // headers, later misses fetch at least a small window and are merged with neighbouring ranges.
+    class HTTPRangeCache
+    {
+        private:
+            HTTPDownload& m_download;
+            std::mutex m_mutex;
+            std::map<size_t, std::vector<u8>> m_ranges;
+            size_t m_cachedSize = 0;
+            bool m_prefetched = false;
+
+            bool ReadCached(void* buffer, size_t offset, size_t size);
+            void Insert(size_t offset, std::vector<u8>& data);
+
+        public:
+            HTTPRangeCache(HTTPDownload& download);
+
+            void BufferDataRange(void* buffer, size_t offset, size_t size);
+    };
+
+    // Credentials apply to every request whose url has the same scheme, host and port as url. An
+    // empty user and pass removes them.
+    void SetBasicAuth(const std::string& url, const std::string& user, const std::string& pass);
+    // The "user:pass" to send with a request to url, false if it needs none
+    bool GetBasicAuth(const std::string& url, std::string& authValue);
     void ClearBasicAuth();
 
     void NSULDrop(std::string url);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <switch.h>
+
+namespace tin::util
+{
+    // Icons of installed titles, read from their control data on a background thread and kept in
+    // memory as jpeg bytes. Reading control data is an ns round trip plus a copy of the whole
+    // nacp, so each icon is only read once while it stays among the most recently used.
+    // Decoding is left to the page, since Plutonium's Image only takes encoded data, so each
+    // 256x256 jpeg is still decoded on the UI thread when its tile is filled. The shop grid logs
+    // how long that takes per page.
+    class TitleIconCache
+    {
+        public:
+            using Icon = std::shared_ptr<std::vector<u8>>;
+
+            static TitleIconCache& Get();
+            ~TitleIconCache();
+
+            // True once the icon of baseTitleId has been read, out is then null if it has none.
+            // False while it's still being read, it gets queued if it wasn't already.
+            bool Find(u64 baseTitleId, Icon& out);
+            // Queued behind everything asked for with Find
+            void Prefetch(const std::vector<u64>& baseTitleIds);
+            // Forgets the icon of baseTitleId, for when the title was installed or removed
+            void Invalidate(u64 baseTitleId);
+            // Goes up whenever an icon has been read or invalidated
+            u64 GetGeneration();
+
+        private:
+            struct Entry
+            {
+                Icon icon;
+                u64 lastUsed = 0;
+            };
+
+            std::mutex m_mutex;
+            std::condition_variable m_cv;
+            std::thread m_worker;
+            std::atomic<bool> m_stop{false};
+            std::deque<u64> m_queue;
+            std::unordered_map<u64, Entry> m_entries;
+            u64 m_totalSize = 0;
+            u64 m_useCounter = 0;
+            u64 m_generation = 0;
+            // Title the worker is reading, its result is dropped if invalidated meanwhile
+            u64 m_reading = 0;
+            bool m_readingInvalidated = false;
+
+            TitleIconCache() = default;
+            void Enqueue(u64 baseTitleId, bool front);
+            void WorkerMain();
+    };
+}
@@ -0,0 +1,130 @@
+#include "data/buffer_segment_pool.hpp"
+
+#include <malloc.h>
+#include <algorithm>
+#include <new>
+#include "util/debug.h"
+#include "util/error.hpp"
+
+extern "C" char* fake_heap_start;
+extern "C" char* fake_heap_end;
+
+namespace tin::data
+{
+    // Heap left untouched for curl, decompression contexts and the UI
+    static const size_t HEAP_RESERVE_SIZE = 0x2000000;
+
+    static size_t GetAvailableHeap()
+    {
+        // newlib's mallinfo already reports size_t fields, glibc deprecated it for mallinfo2
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+        struct mallinfo2 info = mallinfo2();
+#else
+        struct mallinfo info = mallinfo();
+#endif
+        size_t heapSize = fake_heap_end - fake_heap_start;
+        size_t unclaimed = heapSize > (size_t)info.arena ? heapSize - info.arena : 0;
+        return unclaimed + info.fordblks;
+    }
+
+    BufferSegmentPool& BufferSegmentPool::Get()
+    {
+        static BufferSegmentPool pool;
+        return pool;
+    }
+
+    void BufferSegmentPool::SetBudget(size_t budget)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_budget = budget;
+    }
+
+    u32 BufferSegmentPool::GetMaxSegments()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_budget / BUFFER_SEGMENT_DATA_SIZE;
+    }
+
+    void BufferSegmentPool::SetStreamCount(u32 numStreams)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_numStreams = std::max(numStreams, (u32)1);
+    }
+
+    BufferSegment* BufferSegmentPool::Acquire()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_freeSegments.empty())
+        {
+            BufferSegment* segment = m_freeSegments.back();
+            m_freeSegments.pop_back();
+            return segment;
+        }
+
+        if ((m_numAllocated + 1) * BUFFER_SEGMENT_DATA_SIZE > m_budget)
+            return NULL;
+
+        void* mem = memalign(alignof(BufferSegment), sizeof(BufferSegment));
+
+        if (mem == NULL)
+        {
+            LOG_DEBUG("Out of memory after allocating %lu buffer segments\n", m_numAllocated);
+            return NULL;
+        }
+
+        m_numAllocated++;
+        return new (mem) BufferSegment;
+    }
+
+    void BufferSegmentPool::Release(BufferSegment* segment)
+    {
+        if (segment == NULL)
+            return;
+
+        segment->isFinalized = false;
+        segment->writeOffset = 0;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // If the budget was lowered since this was handed out, give the memory back
+        if (m_numAllocated * BUFFER_SEGMENT_DATA_SIZE > m_budget)
+        {
+            segment->~BufferSegment();
+            free(segment);
+            m_numAllocated--;
+            return;
+        }
+
+        m_freeSegments.push_back(segment);
+    }
+
+    u32 BufferSegmentPool::CalcWindowSize(size_t totalDataSize)
+    {
+        size_t numSegmentsRequired = (totalDataSize + BUFFER_SEGMENT_DATA_SIZE - 1) / BUFFER_SEGMENT_DATA_SIZE;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t maxSegments = m_budget / BUFFER_SEGMENT_DATA_SIZE;
+
+        // Cached segments are free to use, anything beyond them has to come out of the heap
+        size_t availableHeap = GetAvailableHeap();
+        size_t heapSegments = availableHeap > HEAP_RESERVE_SIZE ? (availableHeap - HEAP_RESERVE_SIZE) / sizeof(BufferSegment) : 0;
+        maxSegments = std::min(maxSegments, m_freeSegments.size() + heapSegments) / m_numStreams;
+
+        return std::max((size_t)1, std::min(numSegmentsRequired, maxSegments));
+    }
+
+    void BufferSegmentPool::Trim()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (BufferSegment* segment : m_freeSegments)
+        {
+            segment->~BufferSegment();
+            free(segment);
+        }
+
+        m_numAllocated -= m_freeSegments.size();
+        m_freeSegments.clear();
+    }
+}
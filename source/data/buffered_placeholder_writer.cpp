@@ -22,150 +22,263 @@ SOFTWARE.
 
 #include "data/buffered_placeholder_writer.hpp"
 
-#include <climits>
-#include <math.h>
+#include <chrono>
 #include <algorithm>
 #include <exception>
+#include "install/install_telemetry.hpp"
 #include "util/error.hpp"
 #include "util/debug.h"
 
 namespace tin::data
 {
-    int NUM_BUFFER_SEGMENTS;
-
-    BufferedPlaceholderWriter::BufferedPlaceholderWriter(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId, size_t totalDataSize) :
-        m_totalDataSize(totalDataSize), m_contentStorage(contentStorage), m_ncaId(ncaId), m_writer(ncaId, contentStorage)
+    BufferedPlaceholderWriter::BufferedPlaceholderWriter(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId, bool verifyHash, size_t totalDataSize) :
+        m_totalDataSize(totalDataSize), m_contentStorage(contentStorage), m_ncaId(ncaId), m_writer(ncaId, contentStorage, verifyHash)
     {
-        // Though currently the number of segments is fixed, we want them allocated on the heap, not the stack
-        m_bufferSegments = std::make_unique<BufferSegment[]>(NUM_BUFFER_SEGMENTS);
-
-        if (m_bufferSegments == nullptr)
-            THROW_FORMAT("Failed to allocated buffer segments!\n");
+        m_numSegments = BufferSegmentPool::Get().CalcWindowSize(totalDataSize);
+        m_bufferSegments.resize(m_numSegments, NULL);
+        tin::install::InstallTelemetry::Get().BeginNca(ncaId, totalDataSize);
+    }
 
-        m_currentFreeSegmentPtr = &m_bufferSegments[m_currentFreeSegment];
-        m_currentSegmentToWritePtr = &m_bufferSegments[m_currentSegmentToWrite];
+    BufferedPlaceholderWriter::~BufferedPlaceholderWriter()
+    {
+        for (BufferSegment* segment : m_bufferSegments)
+            BufferSegmentPool::Get().Release(segment);
     }
 
-    void BufferedPlaceholderWriter::AppendData(void* source, size_t length)
+    u8* BufferedPlaceholderWriter::AcquireWrite(size_t* outSize)
     {
-        if (m_sizeBuffered + length > m_totalDataSize)
-            THROW_FORMAT("Cannot append data as it would exceed the expected total.\n");
+        if (m_sizeBuffered >= m_totalDataSize)
+            THROW_FORMAT("Cannot acquire a segment as all data has already been buffered.\n");
 
-        size_t dataSizeRemaining = length;
-        u64 sourceOffset = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
 
-        while (dataSizeRemaining > 0)
-        {
-            size_t bufferSegmentSizeRemaining = BUFFER_SEGMENT_DATA_SIZE - m_currentFreeSegmentPtr->writeOffset;
+        if (!m_firstWriteTick)
+            m_firstWriteTick = armGetSystemTick();
 
-            if (m_currentFreeSegmentPtr->isFinalized)
-                THROW_FORMAT("Current buffer segment is already finalized!\n");
+        if (m_bufferSegments[m_currentFreeSegment] == NULL)
+        {
+            BufferSegment* segment = BufferSegmentPool::Get().Acquire();
 
-            if (dataSizeRemaining < bufferSegmentSizeRemaining)
+            if (segment != NULL)
             {
-                memcpy(m_currentFreeSegmentPtr->data + m_currentFreeSegmentPtr->writeOffset, (u8*)source + sourceOffset, dataSizeRemaining);
-                sourceOffset += dataSizeRemaining;
-                m_currentFreeSegmentPtr->writeOffset += dataSizeRemaining;
-                dataSizeRemaining = 0;
+                m_bufferSegments[m_currentFreeSegment] = segment;
+            }
+            else if (m_currentFreeSegment != 0)
+            {
+                // Neither side has wrapped yet, so shrink the ring down to the segments we already have
+                LOG_DEBUG("Shrinking buffer from %u to %lu segments\n", m_numSegments, m_currentFreeSegment);
+                m_numSegments = m_currentFreeSegment;
+                m_currentFreeSegment = 0;
+
+                if (m_currentSegmentToWrite == m_numSegments)
+                    m_currentSegmentToWrite = 0;
             }
             else
             {
-                memcpy(m_currentFreeSegmentPtr->data + m_currentFreeSegmentPtr->writeOffset, (u8*)source + sourceOffset, bufferSegmentSizeRemaining);
-                dataSizeRemaining -= bufferSegmentSizeRemaining;
-                sourceOffset += bufferSegmentSizeRemaining;
-                m_currentFreeSegmentPtr->writeOffset += bufferSegmentSizeRemaining;
-                m_currentFreeSegmentPtr->isFinalized = true;
-
-                m_currentFreeSegment = (m_currentFreeSegment + 1) % NUM_BUFFER_SEGMENTS;
-                m_currentFreeSegmentPtr = &m_bufferSegments[m_currentFreeSegment];
+                THROW_FORMAT("Failed to allocate buffer segments!\n");
             }
         }
 
-        m_sizeBuffered += length;
+        BufferSegment* segment = m_bufferSegments[m_currentFreeSegment];
+        u64 waitStart = armGetSystemTick();
+        m_canWrite.wait(lock, [&]() { return m_cancelled || !segment->isFinalized; });
+        m_backpressureTicks += armGetSystemTick() - waitStart;
+
+        if (m_cancelled)
+            return NULL;
 
-        if (m_sizeBuffered == m_totalDataSize)
+        size_t bufferSegmentSizeRemaining = BUFFER_SEGMENT_DATA_SIZE - segment->writeOffset;
+        *outSize = std::min(bufferSegmentSizeRemaining, m_totalDataSize - m_sizeBuffered);
+        return segment->data + segment->writeOffset;
+    }
+
+    void BufferedPlaceholderWriter::CommitWrite(size_t length)
+    {
+        if (m_sizeBuffered + length > m_totalDataSize)
+            THROW_FORMAT("Cannot commit data as it would exceed the expected total.\n");
+
+        bool complete = false;
         {
-            m_currentFreeSegmentPtr->isFinalized = true;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            BufferSegment* segment = m_bufferSegments[m_currentFreeSegment];
+
+            if (segment == NULL || segment->isFinalized)
+                THROW_FORMAT("Current buffer segment hasn't been acquired!\n");
+
+            if (segment->writeOffset + length > BUFFER_SEGMENT_DATA_SIZE)
+                THROW_FORMAT("Cannot commit data as it would exceed the current buffer segment.\n");
+
+            segment->writeOffset += length;
+            m_sizeBuffered += length;
+            m_lastWriteTick = armGetSystemTick();
+            complete = m_sizeBuffered == m_totalDataSize;
+
+            if (!complete && segment->writeOffset < BUFFER_SEGMENT_DATA_SIZE)
+                return;
+
+            // The final segment is finalized early, its write offset tells the consumer how much of it is valid
+            segment->isFinalized = true;
+            m_currentFreeSegment = (m_currentFreeSegment + 1) % m_numSegments;
         }
+
+        m_canRead.notify_one();
+
+        if (complete)
+            m_stateChanged.notify_all();
     }
 
-    bool BufferedPlaceholderWriter::CanAppendData(size_t length)
+    bool BufferedPlaceholderWriter::AppendData(void* source, size_t length)
     {
         if (m_sizeBuffered + length > m_totalDataSize)
-            return false;
+            THROW_FORMAT("Cannot append data as it would exceed the expected total.\n");
 
-        if (!this->IsSizeAvailable(length))
-            return false;
+        u8* sourcePtr = (u8*)source;
+
+        while (length > 0)
+        {
+            size_t availableSize = 0;
+            u8* dest = this->AcquireWrite(&availableSize);
+
+            if (dest == NULL)
+                return false;
+
+            size_t chunkSize = std::min(length, availableSize);
+            memcpy(dest, sourcePtr, chunkSize);
+            this->CommitWrite(chunkSize);
+
+            sourcePtr += chunkSize;
+            length -= chunkSize;
+        }
 
         return true;
     }
 
-    void BufferedPlaceholderWriter::WriteSegmentToPlaceholder()
+    BufferSegment* BufferedPlaceholderWriter::AcquireRead()
     {
         if (m_sizeWrittenToPlaceholder >= m_totalDataSize)
             THROW_FORMAT("Cannot write segment as end of data has already been reached!\n");
 
-        if (!m_currentSegmentToWritePtr->isFinalized)
-            THROW_FORMAT("Cannot write segment as it hasn't been finalized!\n");
+        std::unique_lock<std::mutex> lock(m_mutex);
+        u64 waitStart = armGetSystemTick();
+        m_canRead.wait(lock, [&]()
+        {
+            BufferSegment* segment = m_bufferSegments[m_currentSegmentToWrite];
+            return m_cancelled || (segment != NULL && segment->isFinalized);
+        });
+        m_bufferWaitTicks += armGetSystemTick() - waitStart;
 
-        // NOTE: The final segment will have leftover data from previous writes, however
-        // this will be accounted for by this size
-        size_t sizeToWriteToPlaceholder = std::min(m_totalDataSize - m_sizeWrittenToPlaceholder, BUFFER_SEGMENT_DATA_SIZE);
-        m_writer.write(m_currentSegmentToWritePtr->data, sizeToWriteToPlaceholder);
+        if (m_cancelled)
+            return NULL;
 
-        m_currentSegmentToWritePtr->isFinalized = false;
-        m_currentSegmentToWritePtr->writeOffset = 0;
-        m_currentSegmentToWrite = (m_currentSegmentToWrite + 1) % NUM_BUFFER_SEGMENTS;
-        m_currentSegmentToWritePtr = &m_bufferSegments[m_currentSegmentToWrite];
-        m_sizeWrittenToPlaceholder += sizeToWriteToPlaceholder;
+        return m_bufferSegments[m_currentSegmentToWrite];
     }
 
-    bool BufferedPlaceholderWriter::CanWriteSegmentToPlaceholder()
+    void BufferedPlaceholderWriter::Release()
     {
-        if (m_sizeWrittenToPlaceholder >= m_totalDataSize)
-            return false;
+        bool complete = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            BufferSegment* segment = m_bufferSegments[m_currentSegmentToWrite];
 
-        if (!m_currentSegmentToWritePtr->isFinalized)
+            if (segment == NULL || !segment->isFinalized)
+                THROW_FORMAT("Cannot release segment as it hasn't been finalized!\n");
+
+            m_sizeWrittenToPlaceholder += segment->writeOffset;
+            complete = m_sizeWrittenToPlaceholder == m_totalDataSize;
+
+            segment->isFinalized = false;
+            segment->writeOffset = 0;
+            m_currentSegmentToWrite = (m_currentSegmentToWrite + 1) % m_numSegments;
+        }
+
+        m_canWrite.notify_one();
+
+        if (complete)
+            m_stateChanged.notify_all();
+    }
+
+    bool BufferedPlaceholderWriter::WriteSegmentToPlaceholder()
+    {
+        BufferSegment* segment = this->AcquireRead();
+
+        if (segment == NULL)
             return false;
 
+        m_writer.write(segment->data, segment->writeOffset);
+
+        // Finish the NCA before reporting it complete, so a hash mismatch surfaces on this thread
+        if (m_sizeWrittenToPlaceholder + segment->writeOffset == m_totalDataSize)
+            m_writer.close();
+
+        this->Release();
+        this->UpdateTelemetry();
         return true;
     }
 
-    u32 BufferedPlaceholderWriter::CalcNumSegmentsRequired(size_t size)
+    void BufferedPlaceholderWriter::UpdateTelemetry()
     {
-        if (m_currentFreeSegmentPtr->isFinalized)
-            return INT_MAX;
+        u64 firstWriteTick = m_firstWriteTick;
+        u64 lastWriteTick = m_lastWriteTick;
 
-        size_t bufferSegmentSizeRemaining = BUFFER_SEGMENT_DATA_SIZE - m_currentFreeSegmentPtr->writeOffset;
+        tin::install::InstallStageStats receive, bufferWait, backpressure;
+        backpressure.ticks = m_backpressureTicks;
+        bufferWait.ticks = m_bufferWaitTicks;
+        receive.bytes = m_sizeBuffered;
 
-        if (size <= bufferSegmentSizeRemaining) return 1;
-        else 
+        if (firstWriteTick && lastWriteTick > firstWriteTick)
         {
-            double numSegmentsReq = 1 + (double)(size - bufferSegmentSizeRemaining) / (double)BUFFER_SEGMENT_DATA_SIZE;
-            return ceil(numSegmentsReq);
+            u64 span = lastWriteTick - firstWriteTick;
+            receive.ticks = span > backpressure.ticks ? span - backpressure.ticks : 0;
         }
+
+        tin::install::InstallTelemetry::Get().SetReceiveStats(m_ncaId, receive, bufferWait, backpressure);
+        tin::install::InstallTelemetry::Get().SetWriterStats(m_ncaId, m_writer.stats());
     }
 
-    bool BufferedPlaceholderWriter::IsSizeAvailable(size_t size)
+    void BufferedPlaceholderWriter::Resume(const NcaResumePoint& point)
     {
-        u32 numSegmentsRequired = this->CalcNumSegmentsRequired(size);
+        m_writer.resume(point);
+    }
 
-        if ((int)numSegmentsRequired > NUM_BUFFER_SEGMENTS)
-            return false;
+    bool BufferedPlaceholderWriter::GetCheckpoint(NcaResumePoint& point)
+    {
+        return m_writer.checkpoint(point);
+    }
+
+    bool BufferedPlaceholderWriter::VerificationFailed()
+    {
+        return m_writer.verificationFailed();
+    }
 
-        for (unsigned int i = 0; i < numSegmentsRequired; i++)
+    void BufferedPlaceholderWriter::Cancel()
+    {
         {
-            unsigned int segmentIndex = m_currentFreeSegment + i;
-            BufferSegment* bufferSegment = &m_bufferSegments[segmentIndex % NUM_BUFFER_SEGMENTS];
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_cancelled = true;
+        }
 
-            if (bufferSegment->isFinalized)
-                return false;
+        m_canWrite.notify_all();
+        m_canRead.notify_all();
+        m_stateChanged.notify_all();
+    }
 
-            if (i != 0 && bufferSegment->writeOffset != 0)
-                THROW_FORMAT("Unexpected non-zero write offset at segment %u (%lu)\n", segmentIndex, bufferSegment->writeOffset);
-        }
+    bool BufferedPlaceholderWriter::IsCancelled()
+    {
+        return m_cancelled;
+    }
 
-        return true;
+    bool BufferedPlaceholderWriter::WaitBufferDataComplete(u64 timeoutNs)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stateChanged.wait_for(lock, std::chrono::nanoseconds(timeoutNs), [&]() { return m_cancelled || m_sizeBuffered == m_totalDataSize; });
+        return m_sizeBuffered == m_totalDataSize;
+    }
+
+    bool BufferedPlaceholderWriter::WaitPlaceholderComplete(u64 timeoutNs)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stateChanged.wait_for(lock, std::chrono::nanoseconds(timeoutNs), [&]() { return m_cancelled || m_sizeWrittenToPlaceholder == m_totalDataSize; });
+        return m_sizeWrittenToPlaceholder == m_totalDataSize;
     }
 
     bool BufferedPlaceholderWriter::IsBufferDataComplete()
@@ -199,14 +312,23 @@ namespace tin::data
         return m_sizeWrittenToPlaceholder;
     }
 
+    u32 BufferedPlaceholderWriter::GetNumSegments()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_numSegments;
+    }
+
     void BufferedPlaceholderWriter::DebugPrintBuffers()
     {
         LOG_DEBUG("BufferedPlaceholderWriter Buffers: \n");
 
-        for (int i = 0; i < NUM_BUFFER_SEGMENTS; i++)
+        for (u32 i = 0; i < m_numSegments; i++)
         {
+            if (m_bufferSegments[i] == NULL)
+                continue;
+
             LOG_DEBUG("Buffer %u:\n", i);
-            printBytes(m_bufferSegments[i].data, BUFFER_SEGMENT_DATA_SIZE, true);
+            printBytes(m_bufferSegments[i]->data, BUFFER_SEGMENT_DATA_SIZE, true);
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "install/http_stream.hpp"
+
+#include <threads.h>
+#include <atomic>
+#include "data/buffered_placeholder_writer.hpp"
+#include "install/install_journal.hpp"
+#include "util/debug.h"
+#include "util/error.hpp"
+#include "util/util.hpp"
+#include "util/lang.hpp"
+
+namespace tin::install
+{
+    struct StreamFuncArgs
+    {
+        tin::network::HTTPDownload* download;
+        tin::data::BufferedPlaceholderWriter* bufferedPlaceholderWriter;
+        tin::install::InstallJournal* journal;
+        u64 ncaOffset;
+        u64 ncaSize;
+        // Only set when continuing a placeholder left by an earlier attempt
+        bool resuming = false;
+        NcaResumePoint resumePoint;
+        // Per stream, as several NCAs may be downloading at once
+        std::atomic_bool stop = false;
+        // Why the placeholder writer stopped, thrown once both threads are joined
+        std::string errorMessage;
+    };
+
+    static int CurlStreamFunc(void* in)
+    {
+        StreamFuncArgs* args = reinterpret_cast<StreamFuncArgs*>(in);
+
+        auto streamFunc = [&](u8* streamBuf, size_t streamBufSize) -> size_t
+        {
+            // Returning less than we were given makes curl abort the transfer
+            if (!args->bufferedPlaceholderWriter->AppendData(streamBuf, streamBufSize))
+                return 0;
+
+            return streamBufSize;
+        };
+
+        int rc = 0;
+
+        // A resumed NCA needs its headers again before the body continues where it left off
+        if (args->resuming)
+        {
+            rc = args->download->StreamDataRange(args->ncaOffset, args->resumePoint.prefixSize, streamFunc);
+
+            if (rc != 1)
+                rc = args->download->StreamDataRangeSegmented(args->ncaOffset + args->resumePoint.inputOffset, args->ncaSize - args->resumePoint.inputOffset, streamFunc);
+        }
+        else
+        {
+            rc = args->download->StreamDataRangeSegmented(args->ncaOffset, args->ncaSize, streamFunc);
+        }
+
+        if (rc == 1)
+        {
+            args->stop = true;
+            args->bufferedPlaceholderWriter->Cancel();
+        }
+        return 0;
+    }
+
+    static int PlaceholderWriteFunc(void* in)
+    {
+        StreamFuncArgs* args = reinterpret_cast<StreamFuncArgs*>(in);
+
+        try
+        {
+            while (!args->bufferedPlaceholderWriter->IsPlaceholderComplete() && !args->stop)
+            {
+                if (!args->bufferedPlaceholderWriter->WriteSegmentToPlaceholder())
+                    break;
+
+                NcaResumePoint point;
+                if (args->bufferedPlaceholderWriter->GetCheckpoint(point))
+                    args->journal->Update(point);
+            }
+        }
+        catch (std::exception& e)
+        {
+            LOG_DEBUG("Failed to write placeholder: %s\n", e.what());
+            args->errorMessage = e.what();
+            args->stop = true;
+            args->bufferedPlaceholderWriter->Cancel();
+        }
+
+        // A failed hash check deleted the placeholder, so there's nothing left to carry on from
+        if (args->bufferedPlaceholderWriter->VerificationFailed())
+        {
+            args->journal->Remove();
+        }
+        // Record whatever made it to the placeholder, so a retry can carry on from there
+        else if (args->stop)
+        {
+            NcaResumePoint point;
+            if (args->bufferedPlaceholderWriter->GetCheckpoint(point))
+                args->journal->Update(point);
+
+            args->journal->Flush();
+        }
+
+        return 0;
+    }
+
+    void StreamHttpNcaToPlaceholder(tin::network::HTTPDownload& download, std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId, bool verifyHash,
+        u64 ncaOffset, u64 ncaSize, const std::string& ncaFileName, const ProgressSink& progress)
+    {
+        LOG_DEBUG("Retrieving %s\n", ncaFileName.c_str());
+
+        tin::install::InstallJournal journal(contentStorage, ncaId, ncaSize);
+        NcaResumePoint resumePoint;
+        bool resuming = journal.Load(resumePoint);
+
+        // A journal from before hash states were kept can't be verified, so such an NCA starts over
+        if (resuming && verifyHash && !resumePoint.hashed)
+        {
+            LOG_DEBUG("No hash state to resume %s with, starting over\n", ncaFileName.c_str());
+            journal.Remove();
+            resuming = false;
+        }
+
+        if (!resuming)
+        {
+            try {
+                contentStorage->DeletePlaceholder(*(NcmPlaceHolderId*)&ncaId);
+            }
+            catch (...) {}
+        }
+
+        size_t streamSize = resuming ? resumePoint.prefixSize + ncaSize - resumePoint.inputOffset : ncaSize;
+        tin::data::BufferedPlaceholderWriter bufferedPlaceholderWriter(contentStorage, ncaId, verifyHash, streamSize);
+        if (resuming) bufferedPlaceholderWriter.Resume(resumePoint);
+
+        StreamFuncArgs args;
+        args.download = &download;
+        args.bufferedPlaceholderWriter = &bufferedPlaceholderWriter;
+        args.journal = &journal;
+        args.resuming = resuming;
+        args.resumePoint = resumePoint;
+        args.ncaOffset = ncaOffset;
+        args.ncaSize = ncaSize;
+        thrd_t curlThread;
+        thrd_t writeThread;
+
+        thrd_create(&curlThread, CurlStreamFunc, &args);
+        thrd_create(&writeThread, PlaceholderWriteFunc, &args);
+
+        u64 freq = armGetSystemTickFreq();
+        u64 startTime = armGetSystemTick();
+        size_t startSizeBuffered = 0;
+        double speed = 0.0;
+
+        progress.SetPercent(0);
+        while (!bufferedPlaceholderWriter.WaitBufferDataComplete(100000000) && !args.stop)
+        {
+            u64 newTime = armGetSystemTick();
+
+            if (newTime - startTime >= freq * 0.5)
+            {
+                size_t newSizeBuffered = bufferedPlaceholderWriter.GetSizeBuffered();
+                double mbBuffered = (newSizeBuffered / 1000000.0) - (startSizeBuffered / 1000000.0);
+                double duration = ((double)(newTime - startTime) / (double)freq);
+                speed =  mbBuffered / duration;
+
+                startTime = newTime;
+                startSizeBuffered = newSizeBuffered;
+                int downloadProgress = (int)(((double)bufferedPlaceholderWriter.GetSizeBuffered() / (double)bufferedPlaceholderWriter.GetTotalDataSize()) * 100.0);
+                #ifdef NXLINK_DEBUG
+                    u64 totalSizeMB = bufferedPlaceholderWriter.GetTotalDataSize() / 1000000;
+                    u64 downloadSizeMB = bufferedPlaceholderWriter.GetSizeBuffered() / 1000000;
+                    LOG_DEBUG("> Download Progress: %lu/%lu MB (%i%s) (%.2f MB/s)\r", downloadSizeMB, totalSizeMB, downloadProgress, "%", speed);
+                #endif
+
+                progress.SetText("inst.info_page.downloading"_lang + inst::util::formatUrlString(ncaFileName) + "inst.info_page.at"_lang + std::to_string(speed).substr(0, std::to_string(speed).size()-4) + "MB/s");
+                progress.SetPercent((double)downloadProgress);
+            }
+        }
+        progress.SetPercent(100);
+        
+        #ifdef NXLINK_DEBUG
+            u64 totalSizeMB = bufferedPlaceholderWriter.GetTotalDataSize() / 1000000;
+        #endif
+
+        progress.SetText("inst.info_page.top_info0"_lang + ncaFileName + "...");
+        progress.SetPercent(0);
+        while (!bufferedPlaceholderWriter.WaitPlaceholderComplete(100000000) && !args.stop)
+        {
+            int installProgress = (int)(((double)bufferedPlaceholderWriter.GetSizeWrittenToPlaceholder() / (double)bufferedPlaceholderWriter.GetTotalDataSize()) * 100.0);
+            #ifdef NXLINK_DEBUG
+                u64 installSizeMB = bufferedPlaceholderWriter.GetSizeWrittenToPlaceholder() / 1000000;
+                LOG_DEBUG("> Install Progress: %lu/%lu MB (%i%s)\r", installSizeMB, totalSizeMB, installProgress, "%");
+            #endif
+            progress.SetPercent((double)installProgress);
+        }
+        progress.SetPercent(100);
+
+        // Make sure neither thread is left blocked on the other before joining
+        if (args.stop) bufferedPlaceholderWriter.Cancel();
+
+        thrd_join(curlThread, NULL);
+        thrd_join(writeThread, NULL);
+        if (!args.errorMessage.empty()) throw std::runtime_error(args.errorMessage.c_str());
+        if (args.stop) THROW_FORMAT(("inst.net.transfer_interput"_lang).c_str());
+
+        journal.Remove();
+    }
+}
@@ -24,10 +24,22 @@ SOFTWARE.
 
 #include <switch.h>
 #include <cstring>
+#include <algorithm>
+#include <deque>
+#include <exception>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include "util/error.hpp"
 
+#include "data/buffer_segment_pool.hpp"
+#include "install/install_journal.hpp"
+#include "install/install_telemetry.hpp"
+#include "nx/nca_writer.h"
 #include "nx/ncm.hpp"
+#include "util/config.hpp"
+#include "util/installed_content.hpp"
+#include "util/title_icon_cache.hpp"
 #include "util/title_util.hpp"
 
 
@@ -35,15 +47,36 @@ SOFTWARE.
 // TODO: Check tik/cert is present
 namespace tin::install
 {
+    // Upper bound on NCAs streamed at once, and the buffer segments each stream should at least get
+    static const u32 MAX_CONCURRENT_NCAS = 3;
+    static const u32 MIN_SEGMENTS_PER_NCA = 4;
+
     Install::Install(NcmStorageId destStorageId, bool ignoreReqFirmVersion) :
         m_destStorageId(destStorageId), m_ignoreReqFirmVersion(ignoreReqFirmVersion), m_contentMeta()
     {
         appletSetMediaPlaybackState(true);
+        InstallTelemetry::Get().Reset();
+        InstallJournal::Prune();
     }
 
     Install::~Install()
     {
         appletSetMediaPlaybackState(false);
+
+        // Whatever got registered, or rolled back, is what the shop should see next
+        for (size_t i = 0; i < m_contentMeta.size(); i++)
+        {
+            u64 baseTitleId = tin::util::GetBaseTitleId(this->GetTitleId(i), this->GetContentMetaType(i));
+            tin::util::InstalledContentIndex::Get().RefreshTitle(baseTitleId);
+            tin::util::TitleIconCache::Get().Invalidate(baseTitleId);
+        }
+
+        // Written however the install ended, a failed one is the most interesting
+        try
+        {
+            InstallTelemetry::Get().Dump(inst::config::appDir + "/install_stats.json");
+        }
+        catch (...) {}
     }
 
     // TODO: Implement RAII on NcmContentMetaDatabase
@@ -98,7 +131,7 @@ namespace tin::install
             if (!contentStorage.Has(cnmtContentRecord.content_id))
             {
                 LOG_DEBUG("Installing CNMT NCA...\n");
-                this->InstallNCA(cnmtContentRecord.content_id);
+                this->InstallNCA(cnmtContentRecord.content_id, ProgressSink());
             }
             else
             {
@@ -129,14 +162,120 @@ namespace tin::install
             LOG_DEBUG("WARNING: Ticket installation failed! This may not be an issue, depending on your use case.\nProceed with caution!\n");
         }
 
+        LOG_DEBUG("Installing NCAs...\n");
+
+        // Held for the whole install, so the NCAs below decompress on one set of pinned workers
+        std::shared_ptr<NczWorkerPool> decompressPool = NczWorkerPool::shared();
+
+        std::vector<NcmContentInfo> records;
+
         for (nx::ncm::ContentMeta contentMeta: m_contentMeta) {
-            LOG_DEBUG("Installing NCAs...\n");
             for (auto& record : contentMeta.GetContentInfos())
+                records.push_back(record);
+        }
+
+        u32 numStreams = std::min(this->GetMaxConcurrentNCAs(), MAX_CONCURRENT_NCAS);
+        numStreams = std::min(numStreams, std::max(tin::data::BufferSegmentPool::Get().GetMaxSegments() / MIN_SEGMENTS_PER_NCA, (u32)1));
+        numStreams = std::min(numStreams, (u32)records.size());
+
+        if (numStreams <= 1)
+        {
+            for (auto& record : records)
             {
                 LOG_DEBUG("Installing from %s\n", tin::util::GetNcaIdString(record.content_id).c_str());
-                this->InstallNCA(record.content_id);
+                this->InstallNCA(record.content_id, ProgressSink());
             }
+            return;
         }
+
+        // Largest first. The first stream, which also owns the progress display, works down from the
+        // front while the others take the small NCAs off the back, so those overlap with the big one.
+        std::stable_sort(records.begin(), records.end(), [](const NcmContentInfo& a, const NcmContentInfo& b) {
+            u64 sizeA = 0, sizeB = 0;
+            ncmContentInfoSizeToU64(&a, &sizeA);
+            ncmContentInfoSizeToU64(&b, &sizeB);
+            return sizeA > sizeB;
+        });
+
+        std::deque<NcmContentInfo> pending(records.begin(), records.end());
+        std::mutex pendingMutex;
+        std::exception_ptr error;
+
+        auto installFunc = [&](bool primary)
+        {
+            ProgressSink progress(primary);
+
+            while (true)
+            {
+                NcmContentId ncaId;
+
+                {
+                    std::lock_guard<std::mutex> lock(pendingMutex);
+
+                    if (error || pending.empty())
+                        break;
+
+                    if (primary)
+                    {
+                        ncaId = pending.front().content_id;
+                        pending.pop_front();
+                    }
+                    else
+                    {
+                        ncaId = pending.back().content_id;
+                        pending.pop_back();
+                    }
+                }
+
+                try
+                {
+                    LOG_DEBUG("Installing from %s\n", tin::util::GetNcaIdString(ncaId).c_str());
+                    this->InstallNCA(ncaId, progress);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(pendingMutex);
+
+                    if (!error)
+                        error = std::current_exception();
+                    break;
+                }
+            }
+        };
+
+        // The UI isn't thread safe, so any prompt about a failed signature has to happen here, before
+        // the other streams start
+        for (auto& record : records)
+            this->ValidateNCA(record.content_id);
+        m_ncasValidated = true;
+
+        LOG_DEBUG("Installing %lu NCAs over %u streams\n", records.size(), numStreams);
+        tin::data::BufferSegmentPool::Get().SetStreamCount(numStreams);
+
+        std::vector<std::thread> threads;
+
+        for (u32 i = 1; i < numStreams; i++)
+            threads.emplace_back(installFunc, false);
+
+        installFunc(true);
+
+        for (auto& thread : threads)
+            thread.join();
+
+        tin::data::BufferSegmentPool::Get().SetStreamCount(1);
+
+        // Streams already running finish their NCA, but no new ones are started after a failure
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    void Install::ValidateNCA(const NcmContentId& ncaId)
+    {
+    }
+
+    u32 Install::GetMaxConcurrentNCAs()
+    {
+        return 1;
     }
 
     u64 Install::GetTitleId(int i)
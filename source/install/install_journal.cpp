@@ -0,0 +1,232 @@
+#include "install/install_journal.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include "util/config.hpp"
+#include "util/error.hpp"
+#include "util/json.hpp"
+#include "util/title_util.hpp"
+
+namespace tin::install
+{
+    static const int JOURNAL_VERSION = 1;
+
+    static std::string GetJournalDir()
+    {
+        return inst::config::appDir + "/journal";
+    }
+
+    static std::string GetJournalPath(const NcmContentId& ncaId)
+    {
+        return GetJournalDir() + "/" + tin::util::GetNcaIdString(ncaId) + ".json";
+    }
+
+    // The hash state is kept as hex, it's only ever read back by the same build
+    static std::string HashStateToString(const Sha256Context& state)
+    {
+        static const char digits[] = "0123456789abcdef";
+        const u8* bytes = (const u8*)&state;
+        std::string out;
+
+        for (size_t i = 0; i < sizeof(state); i++)
+        {
+            out += digits[bytes[i] >> 4];
+            out += digits[bytes[i] & 0xF];
+        }
+
+        return out;
+    }
+
+    static bool HashStateFromString(const std::string& text, Sha256Context& state)
+    {
+        if (text.size() != sizeof(state) * 2)
+            return false;
+
+        u8* bytes = (u8*)&state;
+
+        for (size_t i = 0; i < sizeof(state); i++)
+            bytes[i] = (u8)std::stoul(text.substr(i * 2, 2), nullptr, 16);
+
+        return true;
+    }
+
+    InstallJournal::InstallJournal(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, const NcmContentId& ncaId, u64 ncaSize) :
+        m_contentStorage(contentStorage), m_ncaId(ncaId), m_ncaSize(ncaSize), m_path(GetJournalPath(ncaId))
+    {
+
+    }
+
+    bool InstallJournal::Load(NcaResumePoint& point)
+    {
+        if (!std::filesystem::exists(m_path))
+            return false;
+
+        bool valid = false;
+
+        try
+        {
+            std::ifstream file(m_path);
+            nlohmann::json j;
+            file >> j;
+
+            NcaResumePoint loaded;
+            loaded.inputOffset = j["inputOffset"].get<u64>();
+            loaded.outputOffset = j["outputOffset"].get<u64>();
+            loaded.prefixSize = j["prefixSize"].get<u64>();
+            loaded.block = j["block"].get<u32>();
+
+            if (j.contains("hashState"))
+                loaded.hashed = HashStateFromString(j["hashState"].get<std::string>(), loaded.hashState);
+
+            valid = j["version"].get<int>() == JOURNAL_VERSION &&
+                j["storageId"].get<u32>() == (u32)m_contentStorage->GetStorageId() &&
+                j["ncaSize"].get<u64>() == m_ncaSize &&
+                loaded.prefixSize >= NCA_HEADER_SIZE &&
+                loaded.prefixSize <= loaded.inputOffset &&
+                loaded.inputOffset < m_ncaSize &&
+                m_contentStorage->HasPlaceholder(*(NcmPlaceHolderId*)&m_ncaId);
+
+            if (valid)
+            {
+                point = loaded;
+                m_point = loaded;
+                m_savedOffset = loaded.outputOffset;
+            }
+        }
+        catch (std::exception& e)
+        {
+            LOG_DEBUG("Failed to read install journal: %s\n", e.what());
+        }
+
+        if (!valid)
+        {
+            this->Remove();
+            return false;
+        }
+
+        LOG_DEBUG("Resuming %s at 0x%lx\n", tin::util::GetNcaIdString(m_ncaId).c_str(), point.inputOffset);
+        return true;
+    }
+
+    void InstallJournal::Update(const NcaResumePoint& point)
+    {
+        if (point.inputOffset == m_point.inputOffset && point.outputOffset == m_point.outputOffset)
+            return;
+
+        m_point = point;
+        m_dirty = true;
+
+        if (m_point.outputOffset - m_savedOffset >= JOURNAL_UPDATE_INTERVAL)
+            this->Save();
+    }
+
+    void InstallJournal::Flush()
+    {
+        if (m_dirty)
+            this->Save();
+    }
+
+    void InstallJournal::Save()
+    {
+        nlohmann::json j = {
+            {"version", JOURNAL_VERSION},
+            {"storageId", (u32)m_contentStorage->GetStorageId()},
+            {"ncaSize", m_ncaSize},
+            {"inputOffset", m_point.inputOffset},
+            {"outputOffset", m_point.outputOffset},
+            {"prefixSize", m_point.prefixSize},
+            {"block", m_point.block}
+        };
+
+        if (m_point.hashed)
+            j["hashState"] = HashStateToString(m_point.hashState);
+
+        try
+        {
+            std::filesystem::create_directories(GetJournalDir());
+
+            // Written aside and renamed, so a power cut never leaves a half written journal
+            std::string tmpPath = m_path + ".tmp";
+            {
+                std::ofstream file(tmpPath, std::ios::trunc);
+                file << j << std::endl;
+                if (!file)
+                    return;
+            }
+
+            std::remove(m_path.c_str());
+            std::rename(tmpPath.c_str(), m_path.c_str());
+
+            m_savedOffset = m_point.outputOffset;
+            m_dirty = false;
+        }
+        catch (std::exception& e)
+        {
+            LOG_DEBUG("Failed to write install journal: %s\n", e.what());
+        }
+    }
+
+    void InstallJournal::Remove()
+    {
+        m_dirty = false;
+        InstallJournal::Remove(m_ncaId);
+    }
+
+    void InstallJournal::Remove(const NcmContentId& ncaId)
+    {
+        std::string path = GetJournalPath(ncaId);
+
+        if (std::filesystem::exists(path))
+            std::remove(path.c_str());
+    }
+
+    void InstallJournal::Prune()
+    {
+        std::error_code ec;
+        std::vector<std::filesystem::path> paths;
+
+        for (auto& entry : std::filesystem::directory_iterator(GetJournalDir(), ec))
+        {
+            if (entry.path().extension() == ".json" && entry.path().stem().string().size() == 32)
+                paths.push_back(entry.path());
+        }
+
+        auto now = std::filesystem::file_time_type::clock::now();
+
+        for (auto& path : paths)
+        {
+            NcmContentId ncaId = tin::util::GetNcaIdFromString(path.stem().string());
+            bool keep = false;
+
+            try
+            {
+                std::ifstream file(path);
+                nlohmann::json j;
+                file >> j;
+
+                nx::ncm::ContentStorage contentStorage((NcmStorageId)j["storageId"].get<u32>());
+                bool hasPlaceholder = contentStorage.HasPlaceholder(*(NcmPlaceHolderId*)&ncaId);
+                bool stale = now - std::filesystem::last_write_time(path) > std::chrono::hours(24 * JOURNAL_MAX_AGE_DAYS);
+
+                // An install that was never picked up again shouldn't hold on to its space
+                if (hasPlaceholder && stale)
+                {
+                    LOG_DEBUG("Removing stale placeholder %s\n", tin::util::GetNcaIdString(ncaId).c_str());
+                    contentStorage.DeletePlaceholder(*(NcmPlaceHolderId*)&ncaId);
+                }
+
+                keep = hasPlaceholder && !stale;
+            }
+            catch (std::exception& e)
+            {
+                LOG_DEBUG("Failed to check install journal: %s\n", e.what());
+            }
+
+            if (!keep)
+                std::filesystem::remove(path, ec);
+        }
+    }
+}
@@ -26,6 +26,8 @@ SOFTWARE.
 #include <thread>
 
 #include "install/nca.hpp"
+#include "install/install_journal.hpp"
+#include "install/install_telemetry.hpp"
 #include "nx/fs.hpp"
 #include "nx/ncm.hpp"
 #include "util/config.hpp"
@@ -64,7 +66,7 @@ namespace tin::install::nsp
             LOG_DEBUG("CNMT Name: %s\n", cnmtNcaName.c_str());
 
             // We install the cnmt nca early to read from it later
-            this->InstallNCA(cnmtContentId);
+            this->InstallNCA(cnmtContentId, ProgressSink());
             std::string cnmtNCAFullPath = contentStorage.GetPath(cnmtContentId);
 
             NcmContentInfo cnmtContentInfo;
@@ -78,7 +80,37 @@ namespace tin::install::nsp
         return CNMTList;
     }
 
-    void NSPInstall::InstallNCA(const NcmContentId& ncaId)
+    void NSPInstall::ValidateNCA(const NcmContentId& ncaId)
+    {
+        if (!inst::config::validateNCAs || m_declinedValidation)
+            return;
+
+        const PFS0FileEntry* fileEntry = m_NSP->GetFileEntryByNcaId(ncaId);
+        tin::install::NcaHeader* header = new NcaHeader;
+        m_NSP->BufferData(header, m_NSP->GetDataOffset() + fileEntry->dataOffset, sizeof(tin::install::NcaHeader));
+
+        Crypto::AesXtr crypto(Crypto::Keys().headerKey, false);
+        crypto.decrypt(header, header, sizeof(tin::install::NcaHeader), 0, 0x200);
+
+        if (header->magic != MAGIC_NCA3)
+            THROW_FORMAT("Invalid NCA magic");
+
+        if (!Crypto::rsa2048PssVerify(&header->magic, 0x200, header->fixed_key_sig, Crypto::NCAHeaderSignature))
+        {
+            std::string audioPath = "romfs:/audio/bark.wav";
+            if (!inst::config::soundEnabled) audioPath = "";
+            if (std::filesystem::exists(inst::config::appDir + "/bark.wav")) audioPath = inst::config::appDir + "/bark.wav";
+            std::thread audioThread(inst::util::playAudio,audioPath);
+            int rc = inst::ui::mainApp->CreateShowDialog("inst.nca_verify.title"_lang, "inst.nca_verify.desc"_lang, {"common.cancel"_lang, "inst.nca_verify.opt1"_lang}, false);
+            audioThread.join();
+            if (rc != 1)
+                THROW_FORMAT(("inst.nca_verify.error"_lang + tin::util::GetNcaIdString(ncaId)).c_str());
+            m_declinedValidation = true;
+        }
+        delete header;
+    }
+
+    void NSPInstall::InstallNCA(const NcmContentId& ncaId, const ProgressSink& progress)
     {
         const PFS0FileEntry* fileEntry = m_NSP->GetFileEntryByNcaId(ncaId);
         std::string ncaFileName = m_NSP->GetFileEntryName(fileEntry);
@@ -90,43 +122,29 @@ namespace tin::install::nsp
 
         std::shared_ptr<nx::ncm::ContentStorage> contentStorage(new nx::ncm::ContentStorage(m_destStorageId));
 
-        // Attempt to delete any leftover placeholders
-        try {
-            contentStorage->DeletePlaceholder(*(NcmPlaceHolderId*)&ncaId);
-        }
-        catch (...) {}
-
-        LOG_DEBUG("Size: 0x%lx\n", ncaSize);
-
-        if (inst::config::validateNCAs && !m_declinedValidation)
+        // Attempt to delete any leftover placeholders, unless the source can carry on from them
+        if (!m_NSP->CanResume())
         {
-            tin::install::NcaHeader* header = new NcaHeader;
-            m_NSP->BufferData(header, m_NSP->GetDataOffset() + fileEntry->dataOffset, sizeof(tin::install::NcaHeader));
+            try {
+                contentStorage->DeletePlaceholder(*(NcmPlaceHolderId*)&ncaId);
+            }
+            catch (...) {}
 
-            Crypto::AesXtr crypto(Crypto::Keys().headerKey, false);
-            crypto.decrypt(header, header, sizeof(tin::install::NcaHeader), 0, 0x200);
+            tin::install::InstallJournal::Remove(ncaId);
+        }
 
-            if (header->magic != MAGIC_NCA3)
-                THROW_FORMAT("Invalid NCA magic");
+        LOG_DEBUG("Size: 0x%lx\n", ncaSize);
 
-            if (!Crypto::rsa2048PssVerify(&header->magic, 0x200, header->fixed_key_sig, Crypto::NCAHeaderSignature))
-            {
-                std::string audioPath = "romfs:/audio/bark.wav";
-                if (!inst::config::soundEnabled) audioPath = "";
-                if (std::filesystem::exists(inst::config::appDir + "/bark.wav")) audioPath = inst::config::appDir + "/bark.wav";
-                std::thread audioThread(inst::util::playAudio,audioPath);
-                int rc = inst::ui::mainApp->CreateShowDialog("inst.nca_verify.title"_lang, "inst.nca_verify.desc"_lang, {"common.cancel"_lang, "inst.nca_verify.opt1"_lang}, false);
-                audioThread.join();
-                if (rc != 1)
-                    THROW_FORMAT(("inst.nca_verify.error"_lang + tin::util::GetNcaIdString(ncaId)).c_str());
-                m_declinedValidation = true;
-            }
-            delete header;
-        }
+        // Begin checks every header up front when it installs NCAs concurrently
+        if (!m_ncasValidated)
+            this->ValidateNCA(ncaId);
 
-        m_NSP->StreamToPlaceholder(contentStorage, ncaId);
+        // NCAs the user chose to install anyway won't match their content id either
+        bool verifyHash = inst::config::validateNCAs && !m_declinedValidation;
+        m_NSP->StreamToPlaceholder(contentStorage, ncaId, verifyHash, progress);
 
         LOG_DEBUG("Registering placeholder...\n");
+        u64 registerStart = armGetSystemTick();
 
         try
         {
@@ -142,6 +160,13 @@ namespace tin::install::nsp
             contentStorage->DeletePlaceholder(*(NcmPlaceHolderId*)&ncaId);
         }
         catch (...) {}
+
+        tin::install::InstallTelemetry::Get().EndNca(ncaId, armGetSystemTick() - registerStart);
+    }
+
+    u32 NSPInstall::GetMaxConcurrentNCAs()
+    {
+        return m_NSP->GetMaxConcurrentStreams();
     }
 
     void NSPInstall::InstallTicketCert()
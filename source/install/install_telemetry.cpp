@@ -0,0 +1,225 @@
+#include "install/install_telemetry.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include "util/error.hpp"
+#include "util/json.hpp"
+#include "util/lang.hpp"
+#include "util/title_util.hpp"
+
+namespace tin::install
+{
+    static u64 TicksToMs(u64 ticks)
+    {
+        return armTicksToNs(ticks) / 1000000;
+    }
+
+    // MB/s while the stage was busy, 0 if it never was
+    static double GetRate(const InstallStageStats& stage)
+    {
+        u64 ns = armTicksToNs(stage.ticks);
+
+        if (!ns)
+            return 0.0;
+
+        return (double)stage.bytes / 1000000.0 / ((double)ns / 1000000000.0);
+    }
+
+    static std::string FormatRate(double rate)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%.1f MB/s", rate);
+        return text;
+    }
+
+    static void AddStage(InstallStageStats& total, const InstallStageStats& stage)
+    {
+        total.ticks += stage.ticks;
+        total.bytes += stage.bytes;
+    }
+
+    static InstallStageStats ToStageStats(const NcaWriterStageStats& stats)
+    {
+        InstallStageStats stage;
+        stage.ticks = stats.busyTicks;
+        stage.bytes = stats.bytes;
+        return stage;
+    }
+
+    static nlohmann::json StageToJson(const InstallStageStats& stage)
+    {
+        return {
+            {"ms", TicksToMs(stage.ticks)},
+            {"bytes", stage.bytes},
+            {"mbps", GetRate(stage)}
+        };
+    }
+
+    static nlohmann::json NcaToJson(const NcaInstallStats& nca)
+    {
+        u64 endTick = nca.endTick ? nca.endTick : armGetSystemTick();
+
+        return {
+            {"ncaId", tin::util::GetNcaIdString(nca.ncaId)},
+            {"size", nca.size},
+            {"wallMs", nca.startTick ? TicksToMs(endTick - nca.startTick) : 0},
+            {"completed", nca.endTick != 0},
+            {"receive", StageToJson(nca.receive)},
+            {"bufferWait", StageToJson(nca.bufferWait)},
+            {"backpressure", StageToJson(nca.backpressure)},
+            {"decompress", StageToJson(nca.decompress)},
+            {"encrypt", StageToJson(nca.encrypt)},
+            {"write", StageToJson(nca.write)},
+            {"register", StageToJson(nca.registration)}
+        };
+    }
+
+    InstallTelemetry& InstallTelemetry::Get()
+    {
+        static InstallTelemetry telemetry;
+        return telemetry;
+    }
+
+    NcaInstallStats& InstallTelemetry::GetNca(const NcmContentId& ncaId)
+    {
+        for (auto& nca : m_ncas)
+        {
+            if (!memcmp(&nca.ncaId, &ncaId, sizeof(NcmContentId)))
+                return nca;
+        }
+
+        NcaInstallStats nca;
+        nca.ncaId = ncaId;
+        m_ncas.push_back(nca);
+        return m_ncas.back();
+    }
+
+    void InstallTelemetry::Reset()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_ncas.clear();
+        m_startTick = armGetSystemTick();
+    }
+
+    void InstallTelemetry::BeginNca(const NcmContentId& ncaId, u64 size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        NcaInstallStats& nca = this->GetNca(ncaId);
+        nca = NcaInstallStats();
+        nca.ncaId = ncaId;
+        nca.size = size;
+        nca.startTick = armGetSystemTick();
+    }
+
+    void InstallTelemetry::SetReceiveStats(const NcmContentId& ncaId, const InstallStageStats& receive, const InstallStageStats& bufferWait, const InstallStageStats& backpressure)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        NcaInstallStats& nca = this->GetNca(ncaId);
+        nca.receive = receive;
+        nca.bufferWait = bufferWait;
+        nca.backpressure = backpressure;
+    }
+
+    void InstallTelemetry::SetWriterStats(const NcmContentId& ncaId, const NcaWriterStats& stats)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        NcaInstallStats& nca = this->GetNca(ncaId);
+        nca.decompress = ToStageStats(stats.decompress);
+        nca.encrypt = ToStageStats(stats.encrypt);
+        nca.write = ToStageStats(stats.write);
+    }
+
+    void InstallTelemetry::EndNca(const NcmContentId& ncaId, u64 registerTicks)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        NcaInstallStats& nca = this->GetNca(ncaId);
+        nca.registration.ticks = registerTicks;
+        nca.registration.bytes = nca.size;
+        nca.endTick = armGetSystemTick();
+    }
+
+    std::string InstallTelemetry::GetOverlayText()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        NcaInstallStats total;
+        u64 receiveSpan = 0;
+
+        for (auto& nca : m_ncas)
+        {
+            AddStage(total.receive, nca.receive);
+            AddStage(total.bufferWait, nca.bufferWait);
+            AddStage(total.decompress, nca.decompress);
+            AddStage(total.encrypt, nca.encrypt);
+            AddStage(total.write, nca.write);
+            receiveSpan += nca.receive.ticks + nca.backpressure.ticks;
+        }
+
+        if (!total.write.bytes)
+            return "";
+
+        u64 wallNs = armTicksToNs(armGetSystemTick() - m_startTick);
+        double overall = wallNs ? (double)total.write.bytes / 1000000.0 / ((double)wallNs / 1000000000.0) : 0.0;
+        // Share of the time the source was busy that the installing side spent waiting on it
+        int starved = receiveSpan ? (int)(std::min(total.bufferWait.ticks, receiveSpan) * 100 / receiveSpan) : 0;
+
+        char starvedText[16];
+        snprintf(starvedText, sizeof(starvedText), "%d%%", starved);
+
+        return "inst.info_page.stats.receive"_lang + " " + FormatRate(GetRate(total.receive)) +
+            " | " + "inst.info_page.stats.zstd"_lang + " " + FormatRate(GetRate(total.decompress)) +
+            " | " + "inst.info_page.stats.aes"_lang + " " + FormatRate(GetRate(total.encrypt)) +
+            " | " + "inst.info_page.stats.write"_lang + " " + FormatRate(GetRate(total.write)) +
+            " | " + "inst.info_page.stats.starved"_lang + " " + starvedText +
+            " | " + "inst.info_page.stats.overall"_lang + " " + FormatRate(overall);
+    }
+
+    void InstallTelemetry::Dump(const std::string& path)
+    {
+        nlohmann::json j;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            NcaInstallStats total;
+            u64 bytes = 0;
+            j["ncas"] = nlohmann::json::array();
+
+            for (auto& nca : m_ncas)
+            {
+                j["ncas"].push_back(NcaToJson(nca));
+                AddStage(total.receive, nca.receive);
+                AddStage(total.bufferWait, nca.bufferWait);
+                AddStage(total.backpressure, nca.backpressure);
+                AddStage(total.decompress, nca.decompress);
+                AddStage(total.encrypt, nca.encrypt);
+                AddStage(total.write, nca.write);
+                AddStage(total.registration, nca.registration);
+                bytes += nca.size;
+            }
+
+            j["wallMs"] = TicksToMs(armGetSystemTick() - m_startTick);
+            j["bytes"] = bytes;
+            j["totals"] = {
+                {"receive", StageToJson(total.receive)},
+                {"bufferWait", StageToJson(total.bufferWait)},
+                {"backpressure", StageToJson(total.backpressure)},
+                {"decompress", StageToJson(total.decompress)},
+                {"encrypt", StageToJson(total.encrypt)},
+                {"write", StageToJson(total.write)},
+                {"register", StageToJson(total.registration)}
+            };
+        }
+
+        try
+        {
+            std::ofstream file(path, std::ios::trunc);
+            file << std::setw(4) << j << std::endl;
+        }
+        catch (std::exception& e)
+        {
+            LOG_DEBUG("Failed to write install stats: %s\n", e.what());
+        }
+    }
+}
@@ -23,6 +23,8 @@ SOFTWARE.
 #include <thread>
 
 #include "install/install_xci.hpp"
+#include "install/install_journal.hpp"
+#include "install/install_telemetry.hpp"
 #include "util/file_util.hpp"
 #include "util/title_util.hpp"
 #include "util/debug.h"
@@ -60,7 +62,7 @@ namespace tin::install::xci
             LOG_DEBUG("CNMT Name: %s\n", cnmtNcaName.c_str());
 
             // We install the cnmt nca early to read from it later
-            this->InstallNCA(cnmtContentId);
+            this->InstallNCA(cnmtContentId, ProgressSink());
             std::string cnmtNCAFullPath = contentStorage.GetPath(cnmtContentId);
 
             NcmContentInfo cnmtContentInfo;
@@ -74,7 +76,37 @@ namespace tin::install::xci
         return CNMTList;
     }
 
-    void XCIInstallTask::InstallNCA(const NcmContentId& ncaId)
+    void XCIInstallTask::ValidateNCA(const NcmContentId& ncaId)
+    {
+        if (!inst::config::validateNCAs || m_declinedValidation)
+            return;
+
+        const HFS0FileEntry* fileEntry = m_xci->GetFileEntryByNcaId(ncaId);
+        tin::install::NcaHeader* header = new NcaHeader;
+        m_xci->BufferData(header, m_xci->GetDataOffset() + fileEntry->dataOffset, sizeof(tin::install::NcaHeader));
+
+        Crypto::AesXtr crypto(Crypto::Keys().headerKey, false);
+        crypto.decrypt(header, header, sizeof(tin::install::NcaHeader), 0, 0x200);
+
+        if (header->magic != MAGIC_NCA3)
+            THROW_FORMAT("Invalid NCA magic");
+
+        if (!Crypto::rsa2048PssVerify(&header->magic, 0x200, header->fixed_key_sig, Crypto::NCAHeaderSignature))
+        {
+            std::string audioPath = "romfs:/audio/bark.wav";
+            if (!inst::config::soundEnabled) audioPath = "";
+            if (std::filesystem::exists(inst::config::appDir + "/bark.wav")) audioPath = inst::config::appDir + "/bark.wav";
+            std::thread audioThread(inst::util::playAudio,audioPath);
+            int rc = inst::ui::mainApp->CreateShowDialog("inst.nca_verify.title"_lang, "inst.nca_verify.desc"_lang, {"common.cancel"_lang, "inst.nca_verify.opt1"_lang}, false);
+            audioThread.join();
+            if (rc != 1)
+                THROW_FORMAT(("inst.nca_verify.error"_lang + tin::util::GetNcaIdString(ncaId)).c_str());
+            m_declinedValidation = true;
+        }
+        delete header;
+    }
+
+    void XCIInstallTask::InstallNCA(const NcmContentId& ncaId, const ProgressSink& progress)
     {
         const HFS0FileEntry* fileEntry = m_xci->GetFileEntryByNcaId(ncaId);
         std::string ncaFileName = m_xci->GetFileEntryName(fileEntry);
@@ -86,45 +118,31 @@ namespace tin::install::xci
 
         std::shared_ptr<nx::ncm::ContentStorage> contentStorage(new nx::ncm::ContentStorage(m_destStorageId));
 
-        // Attempt to delete any leftover placeholders
-        try {
-            contentStorage->DeletePlaceholder(*(NcmPlaceHolderId*)&ncaId);
-        }
-        catch (...) {}
-
-        LOG_DEBUG("Size: 0x%lx\n", ncaSize);
-
-        if (inst::config::validateNCAs && !m_declinedValidation)
+        // Attempt to delete any leftover placeholders, unless the source can carry on from them
+        if (!m_xci->CanResume())
         {
-            tin::install::NcaHeader* header = new NcaHeader;
-            m_xci->BufferData(header, m_xci->GetDataOffset() + fileEntry->dataOffset, sizeof(tin::install::NcaHeader));
+            try {
+                contentStorage->DeletePlaceholder(*(NcmPlaceHolderId*)&ncaId);
+            }
+            catch (...) {}
 
-            Crypto::AesXtr crypto(Crypto::Keys().headerKey, false);
-            crypto.decrypt(header, header, sizeof(tin::install::NcaHeader), 0, 0x200);
+            tin::install::InstallJournal::Remove(ncaId);
+        }
 
-            if (header->magic != MAGIC_NCA3)
-                THROW_FORMAT("Invalid NCA magic");
+        LOG_DEBUG("Size: 0x%lx\n", ncaSize);
 
-            if (!Crypto::rsa2048PssVerify(&header->magic, 0x200, header->fixed_key_sig, Crypto::NCAHeaderSignature))
-            {
-                std::string audioPath = "romfs:/audio/bark.wav";
-                if (!inst::config::soundEnabled) audioPath = "";
-                if (std::filesystem::exists(inst::config::appDir + "/bark.wav")) audioPath = inst::config::appDir + "/bark.wav";
-                std::thread audioThread(inst::util::playAudio,audioPath);
-                int rc = inst::ui::mainApp->CreateShowDialog("inst.nca_verify.title"_lang, "inst.nca_verify.desc"_lang, {"common.cancel"_lang, "inst.nca_verify.opt1"_lang}, false);
-                audioThread.join();
-                if (rc != 1)
-                    THROW_FORMAT(("inst.nca_verify.error"_lang + tin::util::GetNcaIdString(ncaId)).c_str());
-                m_declinedValidation = true;
-            }
-            delete header;
-        }
+        // Begin checks every header up front when it installs NCAs concurrently
+        if (!m_ncasValidated)
+            this->ValidateNCA(ncaId);
 
-        m_xci->StreamToPlaceholder(contentStorage, ncaId);
+        // NCAs the user chose to install anyway won't match their content id either
+        bool verifyHash = inst::config::validateNCAs && !m_declinedValidation;
+        m_xci->StreamToPlaceholder(contentStorage, ncaId, verifyHash, progress);
 
         // Clean up the line for whatever comes next
         LOG_DEBUG("                                                           \r");
         LOG_DEBUG("Registering placeholder...\n");
+        u64 registerStart = armGetSystemTick();
 
         try
         {
@@ -140,6 +158,13 @@ namespace tin::install::xci
             contentStorage->DeletePlaceholder(*(NcmPlaceHolderId*)&ncaId);
         }
         catch (...) {}
+
+        tin::install::InstallTelemetry::Get().EndNca(ncaId, armGetSystemTick() - registerStart);
+    }
+
+    u32 XCIInstallTask::GetMaxConcurrentNCAs()
+    {
+        return m_xci->GetMaxConcurrentStreams();
     }
 
     void XCIInstallTask::InstallTicketCert()
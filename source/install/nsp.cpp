@@ -32,6 +32,16 @@ namespace tin::install::nsp
 {
     NSP::NSP() {}
 
+    u32 NSP::GetMaxConcurrentStreams()
+    {
+        return 1;
+    }
+
+    bool NSP::CanResume()
+    {
+        return false;
+    }
+
     // TODO: Do verification: PFS0 magic, sizes not zero
     void NSP::RetrieveHeader()
     {
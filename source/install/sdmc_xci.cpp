@@ -1,6 +1,7 @@
 #include "install/sdmc_xci.hpp"
 #include "error.hpp"
 #include "debug.h"
+#include "install/install_telemetry.hpp"
 #include "nx/nca_writer.h"
 #include "ui/instPage.hpp"
 #include "util/lang.hpp"
@@ -19,7 +20,7 @@ namespace tin::install::xci
         fclose(m_xciFile);
     }
 
-    void SDMCXCI::StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId)
+    void SDMCXCI::StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId ncaId, bool verifyHash, const tin::install::ProgressSink& progress)
     {
         const HFS0FileEntry* fileEntry = this->GetFileEntryByNcaId(ncaId);
         std::string ncaFileName = this->GetFileEntryName(fileEntry);
@@ -27,9 +28,11 @@ namespace tin::install::xci
         LOG_DEBUG("Retrieving %s\n", ncaFileName.c_str());
         size_t ncaSize = fileEntry->fileSize;
 
-        NcaWriter writer(ncaId, contentStorage);
+        NcaWriter writer(ncaId, contentStorage, verifyHash);
+        tin::install::InstallTelemetry::Get().BeginNca(ncaId, ncaSize);
+        tin::install::InstallStageStats receive;
 
-        float progress;
+        float fraction;
 
         u64 fileStart = GetDataOffset() + fileEntry->dataOffset;
         u64 fileOff = 0;
@@ -38,25 +41,30 @@ namespace tin::install::xci
 
         try
         {
-            inst::ui::instPage::setInstInfoText("inst.info_page.top_info0"_lang + ncaFileName + "...");
-            inst::ui::instPage::setInstBarPerc(0);
+            progress.SetText("inst.info_page.top_info0"_lang + ncaFileName + "...");
+            progress.SetPercent(0);
             while (fileOff < ncaSize)
             {
-                progress = (float) fileOff / (float) ncaSize;
+                fraction = (float) fileOff / (float) ncaSize;
 
                 if (fileOff % (0x400000 * 3) == 0) {
-                    LOG_DEBUG("> Progress: %lu/%lu MB (%d%s)\r", (fileOff / 1000000), (ncaSize / 1000000), (int)(progress * 100.0), "%");
-                    inst::ui::instPage::setInstBarPerc((double)(progress * 100.0));
+                    LOG_DEBUG("> Progress: %lu/%lu MB (%d%s)\r", (fileOff / 1000000), (ncaSize / 1000000), (int)(fraction * 100.0), "%");
+                    tin::install::InstallTelemetry::Get().SetReceiveStats(ncaId, receive, {}, {});
+                    tin::install::InstallTelemetry::Get().SetWriterStats(ncaId, writer.stats());
+                    progress.SetPercent((double)(fraction * 100.0));
                 }
 
                 if (fileOff + readSize >= ncaSize) readSize = ncaSize - fileOff;
 
+                u64 readStart = armGetSystemTick();
                 this->BufferData(readBuffer.get(), fileOff + fileStart, readSize);
+                receive.ticks += armGetSystemTick() - readStart;
+                receive.bytes += readSize;
                 writer.write(readBuffer.get(), readSize);
 
                 fileOff += readSize;
             }
-            inst::ui::instPage::setInstBarPerc(100);
+            progress.SetPercent(100);
         }
         catch (std::exception& e)
         {
@@ -64,11 +72,20 @@ namespace tin::install::xci
         }
 
         writer.close();
+        tin::install::InstallTelemetry::Get().SetReceiveStats(ncaId, receive, {}, {});
+        tin::install::InstallTelemetry::Get().SetWriterStats(ncaId, writer.stats());
     }
 
     void SDMCXCI::BufferData(void* buf, off_t offset, size_t size)
     {
+        std::lock_guard<std::mutex> lock(m_fileMutex);
         fseeko(m_xciFile, offset, SEEK_SET);
         fread(buf, 1, size, m_xciFile);
     }
+
+    // Reads are serialized on the file, but decompression and placeholder writes can still overlap
+    u32 SDMCXCI::GetMaxConcurrentStreams()
+    {
+        return 2;
+    }
 }
\ No newline at end of file
@@ -61,7 +61,6 @@ namespace tin::install::nsp
         USBFuncArgs* args = reinterpret_cast<USBFuncArgs*>(in);
         tin::util::USBCmdHeader header = tin::util::USBCmdManager::SendFileRangeCmd(args->nspName, args->pfs0Offset, args->ncaSize);
 
-        u8* buf = (u8*)memalign(0x1000, 0x800000);
         u64 sizeRemaining = header.dataSize;
         size_t tmpSizeRead = 0;
 
@@ -69,27 +68,26 @@ namespace tin::install::nsp
         {
             while (sizeRemaining && !stopThreadsUsbNsp)
             {
-                tmpSizeRead = awoo_usbCommsRead(buf, std::min(sizeRemaining, (u64)0x800000), 5000000000);
+                // Receive directly into the buffer segment rather than bouncing through a staging buffer
+                size_t availableSize = 0;
+                u8* dest = args->bufferedPlaceholderWriter->AcquireWrite(&availableSize);
+                if (dest == NULL)
+                    break;
+
+                tmpSizeRead = awoo_usbCommsRead(dest, std::min(sizeRemaining, (u64)availableSize), 5000000000);
                 if (tmpSizeRead == 0) THROW_FORMAT(("inst.usb.error"_lang).c_str());
                 sizeRemaining -= tmpSizeRead;
 
-                while (true)
-                {
-                    if (args->bufferedPlaceholderWriter->CanAppendData(tmpSizeRead))
-                        break;
-                }
-
-                args->bufferedPlaceholderWriter->AppendData(buf, tmpSizeRead);
+                args->bufferedPlaceholderWriter->CommitWrite(tmpSizeRead);
             }
         }
         catch (std::exception& e)
         {
             stopThreadsUsbNsp = true;
             errorMessageUsbNsp = e.what();
+            args->bufferedPlaceholderWriter->Cancel();
         }
 
-        free(buf);
-
         return 0;
     }
 
@@ -97,16 +95,25 @@ namespace tin::install::nsp
     {
         USBFuncArgs* args = reinterpret_cast<USBFuncArgs*>(in);
 
-        while (!args->bufferedPlaceholderWriter->IsPlaceholderComplete() && !stopThreadsUsbNsp)
+        try
+        {
+            while (!args->bufferedPlaceholderWriter->IsPlaceholderComplete() && !stopThreadsUsbNsp)
+            {
+                if (!args->bufferedPlaceholderWriter->WriteSegmentToPlaceholder())
+                    break;
+            }
+        }
+        catch (std::exception& e)
         {
-            if (args->bufferedPlaceholderWriter->CanWriteSegmentToPlaceholder())
-                args->bufferedPlaceholderWriter->WriteSegmentToPlaceholder();
+            stopThreadsUsbNsp = true;
+            errorMessageUsbNsp = e.what();
+            args->bufferedPlaceholderWriter->Cancel();
         }
 
         return 0;
     }
 
-    void USBNSP::StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId placeholderId)
+    void USBNSP::StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId placeholderId, bool verifyHash, const tin::install::ProgressSink& progress)
     {
         const PFS0FileEntry* fileEntry = this->GetFileEntryByNcaId(placeholderId);
         std::string ncaFileName = this->GetFileEntryName(fileEntry);
@@ -114,7 +121,7 @@ namespace tin::install::nsp
         LOG_DEBUG("Retrieving %s\n", ncaFileName.c_str());
         size_t ncaSize = fileEntry->fileSize;
 
-        tin::data::BufferedPlaceholderWriter bufferedPlaceholderWriter(contentStorage, placeholderId, ncaSize);
+        tin::data::BufferedPlaceholderWriter bufferedPlaceholderWriter(contentStorage, placeholderId, verifyHash, ncaSize);
         USBFuncArgs args;
         args.nspName = m_nspName;
         args.bufferedPlaceholderWriter = &bufferedPlaceholderWriter;
@@ -132,8 +139,8 @@ namespace tin::install::nsp
         size_t startSizeBuffered = 0;
         double speed = 0.0;
 
-        inst::ui::instPage::setInstBarPerc(0);
-        while (!bufferedPlaceholderWriter.IsBufferDataComplete() && !stopThreadsUsbNsp)
+        progress.SetPercent(0);
+        while (!bufferedPlaceholderWriter.WaitBufferDataComplete(100000000) && !stopThreadsUsbNsp)
         {
             u64 newTime = armGetSystemTick();
 
@@ -153,28 +160,31 @@ namespace tin::install::nsp
                     LOG_DEBUG("> Download Progress: %lu/%lu MB (%i%s) (%.2f MB/s)\r", downloadSizeMB, totalSizeMB, downloadProgress, "%", speed);
                 #endif
 
-                inst::ui::instPage::setInstInfoText("inst.info_page.downloading"_lang + inst::util::formatUrlString(ncaFileName) + "inst.info_page.at"_lang + std::to_string(speed).substr(0, std::to_string(speed).size()-4) + "MB/s");
-                inst::ui::instPage::setInstBarPerc((double)downloadProgress);
+                progress.SetText("inst.info_page.downloading"_lang + inst::util::formatUrlString(ncaFileName) + "inst.info_page.at"_lang + std::to_string(speed).substr(0, std::to_string(speed).size()-4) + "MB/s");
+                progress.SetPercent((double)downloadProgress);
             }
         }
-        inst::ui::instPage::setInstBarPerc(100);
+        progress.SetPercent(100);
 
         #ifdef NXLINK_DEBUG
             u64 totalSizeMB = bufferedPlaceholderWriter.GetTotalDataSize() / 1000000;
         #endif
 
-        inst::ui::instPage::setInstInfoText("inst.info_page.top_info0"_lang + ncaFileName + "...");
-        inst::ui::instPage::setInstBarPerc(0);
-        while (!bufferedPlaceholderWriter.IsPlaceholderComplete() && !stopThreadsUsbNsp)
+        progress.SetText("inst.info_page.top_info0"_lang + ncaFileName + "...");
+        progress.SetPercent(0);
+        while (!bufferedPlaceholderWriter.WaitPlaceholderComplete(100000000) && !stopThreadsUsbNsp)
         {
             int installProgress = (int)(((double)bufferedPlaceholderWriter.GetSizeWrittenToPlaceholder() / (double)bufferedPlaceholderWriter.GetTotalDataSize()) * 100.0);
             #ifdef NXLINK_DEBUG
                 u64 installSizeMB = bufferedPlaceholderWriter.GetSizeWrittenToPlaceholder() / 1000000;
                 LOG_DEBUG("> Install Progress: %lu/%lu MB (%i%s)\r", installSizeMB, totalSizeMB, installProgress, "%");
             #endif
-            inst::ui::instPage::setInstBarPerc((double)installProgress);
+            progress.SetPercent((double)installProgress);
         }
-        inst::ui::instPage::setInstBarPerc(100);
+        progress.SetPercent(100);
+
+        // Make sure neither thread is left blocked on the other before joining
+        if (stopThreadsUsbNsp) bufferedPlaceholderWriter.Cancel();
 
         thrd_join(usbThread, NULL);
         thrd_join(writeThread, NULL);
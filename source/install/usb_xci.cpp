@@ -60,7 +60,6 @@ namespace tin::install::xci
         USBFuncArgs* args = reinterpret_cast<USBFuncArgs*>(in);
         tin::util::USBCmdHeader header = tin::util::USBCmdManager::SendFileRangeCmd(args->xciName, args->hfs0Offset, args->ncaSize);
 
-        u8* buf = (u8*)memalign(0x1000, 0x800000);
         u64 sizeRemaining = header.dataSize;
         size_t tmpSizeRead = 0;
 
@@ -68,27 +67,26 @@ namespace tin::install::xci
         {
             while (sizeRemaining && !stopThreadsUsbXci)
             {
-                tmpSizeRead = awoo_usbCommsRead(buf, std::min(sizeRemaining, (u64)0x800000), 5000000000);
+                // Receive directly into the buffer segment rather than bouncing through a staging buffer
+                size_t availableSize = 0;
+                u8* dest = args->bufferedPlaceholderWriter->AcquireWrite(&availableSize);
+                if (dest == NULL)
+                    break;
+
+                tmpSizeRead = awoo_usbCommsRead(dest, std::min(sizeRemaining, (u64)availableSize), 5000000000);
                 if (tmpSizeRead == 0) THROW_FORMAT(("inst.usb.error"_lang).c_str());
                 sizeRemaining -= tmpSizeRead;
 
-                while (true)
-                {
-                    if (args->bufferedPlaceholderWriter->CanAppendData(tmpSizeRead))
-                        break;
-                }
-
-                args->bufferedPlaceholderWriter->AppendData(buf, tmpSizeRead);
+                args->bufferedPlaceholderWriter->CommitWrite(tmpSizeRead);
             }
         }
         catch (std::exception& e)
         {
             stopThreadsUsbXci = true;
             errorMessageUsbXci = e.what();
+            args->bufferedPlaceholderWriter->Cancel();
         }
 
-        free(buf);
-
         return 0;
     }
 
@@ -96,16 +94,25 @@ namespace tin::install::xci
     {
         USBFuncArgs* args = reinterpret_cast<USBFuncArgs*>(in);
 
-        while (!args->bufferedPlaceholderWriter->IsPlaceholderComplete() && !stopThreadsUsbXci)
+        try
+        {
+            while (!args->bufferedPlaceholderWriter->IsPlaceholderComplete() && !stopThreadsUsbXci)
+            {
+                if (!args->bufferedPlaceholderWriter->WriteSegmentToPlaceholder())
+                    break;
+            }
+        }
+        catch (std::exception& e)
         {
-            if (args->bufferedPlaceholderWriter->CanWriteSegmentToPlaceholder())
-                args->bufferedPlaceholderWriter->WriteSegmentToPlaceholder();
+            stopThreadsUsbXci = true;
+            errorMessageUsbXci = e.what();
+            args->bufferedPlaceholderWriter->Cancel();
         }
 
         return 0;
     }
 
-    void USBXCI::StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId placeholderId)
+    void USBXCI::StreamToPlaceholder(std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcmContentId placeholderId, bool verifyHash, const tin::install::ProgressSink& progress)
     {
         const HFS0FileEntry* fileEntry = this->GetFileEntryByNcaId(placeholderId);
         std::string ncaFileName = this->GetFileEntryName(fileEntry);
@@ -113,7 +120,7 @@ namespace tin::install::xci
         LOG_DEBUG("Retrieving %s\n", ncaFileName.c_str());
         size_t ncaSize = fileEntry->fileSize;
 
-        tin::data::BufferedPlaceholderWriter bufferedPlaceholderWriter(contentStorage, placeholderId, ncaSize);
+        tin::data::BufferedPlaceholderWriter bufferedPlaceholderWriter(contentStorage, placeholderId, verifyHash, ncaSize);
         USBFuncArgs args;
         args.xciName = m_xciName;
         args.bufferedPlaceholderWriter = &bufferedPlaceholderWriter;
@@ -131,8 +138,8 @@ namespace tin::install::xci
         size_t startSizeBuffered = 0;
         double speed = 0.0;
 
-        inst::ui::instPage::setInstBarPerc(0);
-        while (!bufferedPlaceholderWriter.IsBufferDataComplete() && !stopThreadsUsbXci)
+        progress.SetPercent(0);
+        while (!bufferedPlaceholderWriter.WaitBufferDataComplete(100000000) && !stopThreadsUsbXci)
         {
             u64 newTime = armGetSystemTick();
 
@@ -152,28 +159,31 @@ namespace tin::install::xci
                     LOG_DEBUG("> Download Progress: %lu/%lu MB (%i%s) (%.2f MB/s)\r", downloadSizeMB, totalSizeMB, downloadProgress, "%", speed);
                 #endif
 
-                inst::ui::instPage::setInstInfoText("inst.info_page.downloading"_lang + inst::util::formatUrlString(ncaFileName) + "inst.info_page.at"_lang + std::to_string(speed).substr(0, std::to_string(speed).size()-4) + "MB/s");
-                inst::ui::instPage::setInstBarPerc((double)downloadProgress);
+                progress.SetText("inst.info_page.downloading"_lang + inst::util::formatUrlString(ncaFileName) + "inst.info_page.at"_lang + std::to_string(speed).substr(0, std::to_string(speed).size()-4) + "MB/s");
+                progress.SetPercent((double)downloadProgress);
             }
         }
-        inst::ui::instPage::setInstBarPerc(100);
+        progress.SetPercent(100);
 
         #ifdef NXLINK_DEBUG
             u64 totalSizeMB = bufferedPlaceholderWriter.GetTotalDataSize() / 1000000;
         #endif
 
-        inst::ui::instPage::setInstInfoText("inst.info_page.top_info0"_lang + ncaFileName + "...");
-        inst::ui::instPage::setInstBarPerc(0);
-        while (!bufferedPlaceholderWriter.IsPlaceholderComplete() && !stopThreadsUsbXci)
+        progress.SetText("inst.info_page.top_info0"_lang + ncaFileName + "...");
+        progress.SetPercent(0);
+        while (!bufferedPlaceholderWriter.WaitPlaceholderComplete(100000000) && !stopThreadsUsbXci)
         {
             int installProgress = (int)(((double)bufferedPlaceholderWriter.GetSizeWrittenToPlaceholder() / (double)bufferedPlaceholderWriter.GetTotalDataSize()) * 100.0);
             #ifdef NXLINK_DEBUG
                 u64 installSizeMB = bufferedPlaceholderWriter.GetSizeWrittenToPlaceholder() / 1000000;
                 LOG_DEBUG("> Install Progress: %lu/%lu MB (%i%s)\r", installSizeMB, totalSizeMB, installProgress, "%");
             #endif
-            inst::ui::instPage::setInstBarPerc((double)installProgress);
+            progress.SetPercent((double)installProgress);
         }
-        inst::ui::instPage::setInstBarPerc(100);
+        progress.SetPercent(100);
+
+        // Make sure neither thread is left blocked on the other before joining
+        if (stopThreadsUsbXci) bufferedPlaceholderWriter.Cancel();
 
         thrd_join(usbThread, NULL);
         thrd_join(writeThread, NULL);
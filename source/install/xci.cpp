@@ -31,6 +31,16 @@ namespace tin::install::xci
     {
     }
 
+    u32 XCI::GetMaxConcurrentStreams()
+    {
+        return 1;
+    }
+
+    bool XCI::CanResume()
+    {
+        return false;
+    }
+
     void XCI::RetrieveHeader()
     {
         LOG_DEBUG("Retrieving HFS0 header...\n");
@@ -19,6 +19,7 @@
 #include "install/install_nsp.hpp"
 #include "install/install_xci.hpp"
 #include "install/install.hpp"
+#include "install/install_telemetry.hpp"
 #include "install/nca.hpp"
 #include "install/pfs0.hpp"
 #include "install/hfs0.hpp"
@@ -49,6 +50,13 @@ std::atomic<std::uint64_t> g_stream_title_id{0};
 std::mutex g_stream_mutex;
 std::string g_stream_name;
 
+// The time the host took to send an NCA is the gap between two writes of it. Nothing is buffered
+// in between, so bufferWait and backpressure stay empty.
+void ReportEntryStats(const NcmContentId& nca_id, const tin::install::InstallStageStats& receive, const NcaWriter& writer) {
+    tin::install::InstallTelemetry::Get().SetReceiveStats(nca_id, receive, {}, {});
+    tin::install::InstallTelemetry::Get().SetWriterStats(nca_id, writer.stats());
+}
+
 class StreamInstaller {
 public:
     StreamInstaller() = default;
@@ -77,6 +85,8 @@ private:
         bool is_cnmt = false;
         std::shared_ptr<nx::ncm::ContentStorage> storage;
         std::unique_ptr<NcaWriter> nca_writer;
+        tin::install::InstallStageStats receive;
+        std::uint64_t last_tick = 0;
         std::vector<std::uint8_t> ticket_buf;
         std::vector<std::uint8_t> cert_buf;
     };
@@ -132,7 +142,7 @@ private:
 
     std::vector<std::tuple<nx::ncm::ContentMeta, NcmContentInfo>> ReadCNMT() override { return {}; }
     void InstallTicketCert() override {}
-    void InstallNCA(const NcmContentId& /*ncaId*/) override {}
+    void InstallNCA(const NcmContentId& /*ncaId*/, const tin::install::ProgressSink& /*progress*/) override {}
 };
 
 bool IsXciName(const std::string& name) {
@@ -211,7 +221,9 @@ bool MtpNspStream::EnsureEntryStarted(EntryState& entry)
     try {
         entry.storage->DeletePlaceholder(*(NcmPlaceHolderId*)&entry.nca_id);
     } catch (...) {}
-    entry.nca_writer = std::make_unique<NcaWriter>(entry.nca_id, entry.storage);
+    entry.nca_writer = std::make_unique<NcaWriter>(entry.nca_id, entry.storage, inst::config::validateNCAs);
+    tin::install::InstallTelemetry::Get().BeginNca(entry.nca_id, entry.size);
+    entry.last_tick = armGetSystemTick();
     entry.started = true;
     return true;
 }
@@ -261,14 +273,26 @@ bool MtpNspStream::WriteEntryData(EntryState& entry, const std::uint8_t* data, s
 
     if (!entry.is_nca || !entry.nca_writer) return false;
     if (rel_offset != entry.written) return false;
+    entry.receive.ticks += armGetSystemTick() - entry.last_tick;
+    entry.receive.bytes += size;
     entry.nca_writer->write(data, size);
+    entry.last_tick = armGetSystemTick();
+    ReportEntryStats(entry.nca_id, entry.receive, *entry.nca_writer);
     entry.written += size;
     if (entry.written >= entry.size) {
-        entry.nca_writer->close();
+        try {
+            entry.nca_writer->close();
+        } catch (...) {
+            // The placeholder has already been dropped, don't register it
+            return false;
+        }
+        ReportEntryStats(entry.nca_id, entry.receive, *entry.nca_writer);
+        const std::uint64_t register_start = armGetSystemTick();
         try {
             entry.storage->Register(*(NcmPlaceHolderId*)&entry.nca_id, entry.nca_id);
             entry.storage->DeletePlaceholder(*(NcmPlaceHolderId*)&entry.nca_id);
         } catch (...) {}
+        tin::install::InstallTelemetry::Get().EndNca(entry.nca_id, armGetSystemTick() - register_start);
         entry.complete = true;
         if (entry.is_cnmt) {
             CommitCnmt(entry);
@@ -598,6 +622,8 @@ private:
         bool is_cnmt = false;
         std::shared_ptr<nx::ncm::ContentStorage> storage;
         std::unique_ptr<NcaWriter> nca_writer;
+        tin::install::InstallStageStats receive;
+        std::uint64_t last_tick = 0;
         std::vector<std::uint8_t> ticket_buf;
         std::vector<std::uint8_t> cert_buf;
     };
@@ -613,7 +639,9 @@ private:
         try {
             entry.storage->DeletePlaceholder(*(NcmPlaceHolderId*)&entry.nca_id);
         } catch (...) {}
-        entry.nca_writer = std::make_unique<NcaWriter>(entry.nca_id, entry.storage);
+        entry.nca_writer = std::make_unique<NcaWriter>(entry.nca_id, entry.storage, inst::config::validateNCAs);
+        tin::install::InstallTelemetry::Get().BeginNca(entry.nca_id, entry.size);
+        entry.last_tick = armGetSystemTick();
         entry.started = true;
         return true;
     }
@@ -660,14 +688,26 @@ private:
         }
 
         if (!entry.is_nca || !entry.nca_writer) return false;
+        entry.receive.ticks += armGetSystemTick() - entry.last_tick;
+        entry.receive.bytes += size;
         entry.nca_writer->write(data, size);
+        entry.last_tick = armGetSystemTick();
+        ReportEntryStats(entry.nca_id, entry.receive, *entry.nca_writer);
         entry.written += size;
         if (entry.written >= entry.size) {
-            entry.nca_writer->close();
+            try {
+                entry.nca_writer->close();
+            } catch (...) {
+                // The placeholder has already been dropped, don't register it
+                return false;
+            }
+            ReportEntryStats(entry.nca_id, entry.receive, *entry.nca_writer);
+            const std::uint64_t register_start = armGetSystemTick();
             try {
                 entry.storage->Register(*(NcmPlaceHolderId*)&entry.nca_id, entry.nca_id);
                 entry.storage->DeletePlaceholder(*(NcmPlaceHolderId*)&entry.nca_id);
             } catch (...) {}
+            tin::install::InstallTelemetry::Get().EndNca(entry.nca_id, armGetSystemTick() - register_start);
             entry.complete = true;
             if (entry.is_cnmt) {
                 CommitCnmt(entry);
@@ -106,6 +106,7 @@ namespace netInstStuff{
             m_clientSocket = 0;
         }
 
+        tin::network::ClearConnectionPool();
         curl_global_cleanup();
     }
 
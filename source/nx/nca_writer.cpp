@@ -22,8 +22,14 @@ SOFTWARE.
 
 #include "nx/nca_writer.h"
 #include "util/error.hpp"
+#include "util/title_util.hpp"
 #include <zstd.h>
+#include <malloc.h>
 #include <string.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include "util/crypto.hpp"
 #include "util/config.hpp"
 #include "util/title_util.hpp"
@@ -36,7 +42,132 @@ void append(std::vector<u8>& buffer, const u8* ptr, u64 sz)
      memcpy(buffer.data() + offset, ptr, sz);
 }
 
-NcaBodyWriter::NcaBodyWriter(const NcmContentId& ncaId, u64 offset, std::shared_ptr<nx::ncm::ContentStorage>& contentStorage) : m_contentStorage(contentStorage), m_ncaId(ncaId), m_offset(offset)
+void NcaWriterStageCounter::addBusy(u64 startTick, u64 bytes)
+{
+     m_busyTicks += armGetSystemTick() - startTick;
+     m_bytes += bytes;
+}
+
+void NcaWriterStageCounter::addIdle(u64 startTick)
+{
+     m_idleTicks += armGetSystemTick() - startTick;
+}
+
+NcaWriterStageStats NcaWriterStageCounter::snapshot() const
+{
+     NcaWriterStageStats stats;
+     stats.busyTicks = m_busyTicks;
+     stats.idleTicks = m_idleTicks;
+     stats.bytes = m_bytes;
+     return stats;
+}
+
+NcaHasher::NcaHasher()
+{
+     sha256ContextCreate(&m_ctx);
+     m_thread = std::thread([this]() { run(); });
+}
+
+NcaHasher::~NcaHasher()
+{
+     {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_exit = true;
+     }
+
+     m_cv.notify_all();
+     m_thread.join();
+}
+
+void NcaHasher::run()
+{
+     std::unique_lock<std::mutex> lock(m_mutex);
+
+     while (true)
+     {
+          m_cv.wait(lock, [&]() { return m_exit || m_pending; });
+
+          if (!m_pending)
+               break;
+
+          const u8* ptr = m_ptr;
+          u64 sz = m_pendingSize;
+
+          lock.unlock();
+          sha256ContextUpdate(&m_ctx, ptr, sz);
+          lock.lock();
+
+          m_size += sz;
+          m_pending = false;
+          m_cv.notify_all();
+     }
+}
+
+void NcaHasher::update(const void* ptr, u64 sz)
+{
+     {
+          std::unique_lock<std::mutex> lock(m_mutex);
+          m_cv.wait(lock, [&]() { return !m_pending; });
+
+          m_ptr = (const u8*)ptr;
+          m_pendingSize = sz;
+          m_pending = true;
+     }
+
+     m_cv.notify_all();
+}
+
+void NcaHasher::wait()
+{
+     std::unique_lock<std::mutex> lock(m_mutex);
+     m_cv.wait(lock, [&]() { return !m_pending; });
+}
+
+void NcaHasher::getHash(u8* out)
+{
+     wait();
+     sha256ContextGetHash(&m_ctx, out);
+}
+
+u64 NcaHasher::size() const
+{
+     return m_size;
+}
+
+void NcaHasher::saveState(Sha256Context& out)
+{
+     wait();
+     out = m_ctx;
+}
+
+void NcaHasher::restoreState(const Sha256Context& state, u64 size)
+{
+     wait();
+     m_ctx = state;
+     m_size = size;
+}
+
+// Hashes a buffer for as long as the scope is alive, which is meant to cover its write
+class NcaHashScope
+{
+public:
+     NcaHashScope(NcaHasher* hasher, const void* ptr, u64 sz) : m_hasher(hasher)
+     {
+          if (m_hasher)
+               m_hasher->update(ptr, sz);
+     }
+
+     ~NcaHashScope()
+     {
+          if (m_hasher)
+               m_hasher->wait();
+     }
+
+protected:
+     NcaHasher* m_hasher;
+};
+
+NcaBodyWriter::NcaBodyWriter(const NcmContentId& ncaId, u64 offset, std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcaHasher* hasher) : m_contentStorage(contentStorage), m_ncaId(ncaId), m_bodyOffset(offset), m_offset(offset), m_hasher(hasher)
 {
 }
 
@@ -48,7 +179,10 @@ u64 NcaBodyWriter::write(const  u8* ptr, u64 sz)
 {
      if(isOpen())
      {
+          NcaHashScope hash(m_hasher, ptr, sz);
+          u64 start = armGetSystemTick();
           m_contentStorage->WritePlaceholder(*(NcmPlaceHolderId*)&m_ncaId, m_offset, (void*)ptr, sz);
+          m_writeStats.addBusy(start, sz);
           m_offset += sz;
           return sz;
      }
@@ -56,11 +190,45 @@ u64 NcaBodyWriter::write(const  u8* ptr, u64 sz)
      return 0;
 }
 
+bool NcaBodyWriter::close()
+{
+     return true;
+}
+
+void NcaBodyWriter::resume(const NcaResumePoint& point)
+{
+     m_offset = point.outputOffset;
+}
+
+// Writes are synchronous and the body is stored as is, so everything written so far is a checkpoint
+bool NcaBodyWriter::checkpoint(NcaResumePoint& point)
+{
+     point.inputOffset = m_offset;
+     point.outputOffset = m_offset;
+     point.prefixSize = m_bodyOffset;
+     point.block = 0;
+     point.hashed = m_hasher != NULL;
+
+     if (m_hasher)
+          m_hasher->saveState(point.hashState);
+
+     return true;
+}
+
 bool NcaBodyWriter::isOpen() const
 {
      return m_contentStorage != NULL;
 }
 
+NcaWriterStats NcaBodyWriter::stats() const
+{
+     NcaWriterStats stats;
+     stats.decompress = m_decompressStats.snapshot();
+     stats.encrypt = m_encryptStats.snapshot();
+     stats.write = m_writeStats.snapshot();
+     return stats;
+}
+
 
 class NczHeader
 {
@@ -141,20 +309,366 @@ protected:
      Section m_sections[1];
 } NX_PACKED;
 
+// Fixed capacity FIFO used to hand work between pipeline stages. close() lets the consumer
+// drain what is left, abort() throws it away. Both wake up anyone blocked on the queue.
+template<class T>
+class NczBoundedQueue
+{
+public:
+     NczBoundedQueue(size_t capacity) : m_capacity(capacity)
+     {
+     }
+
+     bool push(T item)
+     {
+          {
+               std::unique_lock<std::mutex> lock(m_mutex);
+               m_canPush.wait(lock, [&]() { return m_closed || m_items.size() < m_capacity; });
+
+               if (m_closed)
+                    return false;
+
+               m_items.push_back(std::move(item));
+          }
+
+          m_canPop.notify_one();
+          return true;
+     }
+
+     bool pop(T& item)
+     {
+          {
+               std::unique_lock<std::mutex> lock(m_mutex);
+               m_canPop.wait(lock, [&]() { return m_closed || !m_items.empty(); });
+
+               if (m_items.empty())
+                    return false;
+
+               item = std::move(m_items.front());
+               m_items.pop_front();
+          }
+
+          m_canPush.notify_one();
+          return true;
+     }
+
+     void close()
+     {
+          {
+               std::lock_guard<std::mutex> lock(m_mutex);
+               m_closed = true;
+          }
+
+          m_canPush.notify_all();
+          m_canPop.notify_all();
+     }
+
+     void abort()
+     {
+          {
+               std::lock_guard<std::mutex> lock(m_mutex);
+               m_closed = true;
+               m_items.clear();
+          }
+
+          m_canPush.notify_all();
+          m_canPop.notify_all();
+     }
+
+protected:
+     std::mutex m_mutex;
+     std::condition_variable m_canPush;
+     std::condition_variable m_canPop;
+     std::deque<T> m_items;
+     size_t m_capacity;
+     bool m_closed = false;
+};
+
+// Optional header following the section table in block compressed NCZs. Each block is an
+// independent zstd frame (or stored as is if compression didn't help), so they can be
+// decompressed in parallel.
+class NczBlockHeader
+{
+public:
+     static const u64 MAGIC = 0x4B434F4C425A434E;
+
+     const bool isValid() const
+     {
+          return m_magic == MAGIC && m_version == 2 && m_type == 1 && m_blockSizeExponent >= 14 && m_blockSizeExponent <= 32;
+     }
+
+     const u64 blockSize() const
+     {
+          return 1ULL << m_blockSizeExponent;
+     }
+
+     const u64 decompressedBlockSize(u32 i) const
+     {
+          if (i + 1 < m_numberOfBlocks)
+               return blockSize();
+
+          u64 remainder = m_decompressedSize % blockSize();
+          return remainder ? remainder : blockSize();
+     }
+
+     u64 m_magic;
+     u8 m_version;
+     u8 m_type;
+     u8 m_unused;
+     u8 m_blockSizeExponent;
+     u32 m_numberOfBlocks;
+     u64 m_decompressedSize;
+     // Followed by u32 compressedBlockSizeList[m_numberOfBlocks]
+} NX_PACKED;
+
+// Application threads can run on cores 0 to 2, core 3 belongs to the system
+static const u32 APPLICATION_CORES = 3;
+
+// Threads start on the process' default core whoever creates them, so threads meant to run in
+// parallel have to be moved to cores of their own
+static void PinThreadToCore(u32 core)
+{
+     core %= APPLICATION_CORES;
+     Result rc = svcSetThreadCoreMask(CUR_THREAD_HANDLE, core, 1U << core);
+
+     if (R_FAILED(rc))
+     {
+          LOG_DEBUG("Failed to move thread to core %u: 0x%x\n", core, rc);
+     }
+}
+
+NczWorkerPool::NczWorkerPool(u32 numWorkers)
+{
+     for (u32 i = 0; i < numWorkers; i++)
+     {
+          m_workers.emplace_back([this, i]() { workerFunc(i); });
+     }
+}
+
+NczWorkerPool::~NczWorkerPool()
+{
+     {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_stop = true;
+     }
+
+     m_taskAvailable.notify_all();
+
+     for (auto& worker : m_workers)
+     {
+          if (worker.joinable())
+               worker.join();
+     }
+}
+
+std::shared_ptr<NczWorkerPool> NczWorkerPool::shared()
+{
+     static std::mutex mutex;
+     static std::weak_ptr<NczWorkerPool> current;
+
+     std::lock_guard<std::mutex> lock(mutex);
+     std::shared_ptr<NczWorkerPool> pool = current.lock();
+
+     if (!pool)
+     {
+          pool = std::make_shared<NczWorkerPool>(workerCount());
+          current = pool;
+     }
+
+     return pool;
+}
+
+u32 NczWorkerPool::workerCount()
+{
+     u32 count = std::thread::hardware_concurrency();
+     return count ? std::min(count, APPLICATION_CORES) : APPLICATION_CORES;
+}
+
+void NczWorkerPool::run(std::function<void (ZSTD_DCtx* dctx)> task)
+{
+     {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_tasks.push_back(std::move(task));
+     }
+
+     m_taskAvailable.notify_one();
+}
+
+void NczWorkerPool::workerFunc(u32 core)
+{
+     PinThreadToCore(core);
+     ZSTD_DCtx* dctx = ZSTD_createDCtx();
+
+     while (true)
+     {
+          std::function<void (ZSTD_DCtx* dctx)> task;
+          {
+               std::unique_lock<std::mutex> lock(m_mutex);
+               m_taskAvailable.wait(lock, [&]() { return m_stop || !m_tasks.empty(); });
+
+               if (m_stop)
+                    break;
+
+               task = std::move(m_tasks.front());
+               m_tasks.pop_front();
+          }
+
+          task(dctx);
+     }
+
+     ZSTD_freeDCtx(dctx);
+}
+
+NczBlockDecompressor::NczBlockDecompressor(std::shared_ptr<NczWorkerPool> pool, u32 maxJobs, NcaWriterStageCounter& stats) : m_pool(pool), m_stats(stats), m_maxJobs(maxJobs)
+{
+}
+
+NczBlockDecompressor::NczBlockDecompressor(u32 numWorkers, u32 maxJobs, NcaWriterStageCounter& stats) : m_pool(std::make_shared<NczWorkerPool>(numWorkers)), m_stats(stats), m_maxJobs(maxJobs)
+{
+}
+
+NczBlockDecompressor::~NczBlockDecompressor()
+{
+     stop();
+}
+
+bool NczBlockDecompressor::full()
+{
+     std::lock_guard<std::mutex> lock(m_mutex);
+     return m_jobs.size() >= m_maxJobs;
+}
+
+bool NczBlockDecompressor::empty()
+{
+     std::lock_guard<std::mutex> lock(m_mutex);
+     return m_jobs.empty();
+}
+
+void NczBlockDecompressor::submit(std::unique_ptr<Job> job)
+{
+     Job* pending = job.get();
+     {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_jobs.push_back(std::move(job));
+          m_inFlight++;
+     }
+
+     m_pool->run([this, pending](ZSTD_DCtx* dctx) { runJob(dctx, *pending); });
+}
+
+std::unique_ptr<NczBlockDecompressor::Job> NczBlockDecompressor::popFront()
+{
+     std::unique_lock<std::mutex> lock(m_mutex);
+     m_jobDone.wait(lock, [&]() { return m_jobs.front()->done; });
+
+     std::unique_ptr<Job> job = std::move(m_jobs.front());
+     m_jobs.pop_front();
+     return job;
+}
+
+void NczBlockDecompressor::stop()
+{
+     std::unique_lock<std::mutex> lock(m_mutex);
+     m_stop = true;
+
+     // The pool is shared, so the jobs it still holds have to run out before this goes away
+     m_jobDone.wait(lock, [&]() { return m_inFlight == 0; });
+}
+
+void NczBlockDecompressor::decompress(ZSTD_DCtx* dctx, Job& job)
+{
+     // Blocks that didn't compress well are stored as is
+     if (job.input.size() >= job.output.size())
+     {
+          memcpy(job.output.data(), job.input.data(), job.output.size());
+          return;
+     }
+
+     size_t ret = ZSTD_decompressDCtx(dctx, job.output.data(), job.output.size(), job.input.data(), job.input.size());
+     job.failed = ZSTD_isError(ret) || ret != job.output.size();
+
+     if (ZSTD_isError(ret))
+     {
+          LOG_DEBUG("%s\n", ZSTD_getErrorName(ret));
+     }
+}
+
+void NczBlockDecompressor::runJob(ZSTD_DCtx* dctx, Job& job)
+{
+     bool stopped;
+     {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          stopped = m_stop;
+     }
+
+     if (stopped)
+     {
+          job.failed = true;
+     }
+     else
+     {
+          u64 start = armGetSystemTick();
+          decompress(dctx, job);
+          m_stats.addBusy(start, job.output.size());
+     }
+
+     // Notified under the lock, once it's released stop() may return and this be gone
+     std::lock_guard<std::mutex> lock(m_mutex);
+     job.done = true;
+     m_inFlight--;
+     m_jobDone.notify_all();
+}
+
 class NczBodyWriter : public NcaBodyWriter
 {
 public:
-     NczBodyWriter(const NcmContentId& ncaId, u64 offset, std::shared_ptr<nx::ncm::ContentStorage>& contentStorage) : NcaBodyWriter(ncaId, offset, contentStorage)
+     // Data is decompressed straight into fixed, page aligned slabs of this size, which are
+     // then encrypted and written to the placeholder in place by their own threads.
+     // The slab count bounds memory use, the queues between stages never hold more than that.
+     static const u64 CHUNK_SIZE = 0x400000;
+     static const u64 CHUNK_COUNT = 4;
+     static const u64 QUEUE_DEPTH = 2;
+
+     struct Chunk
      {
-          buffIn = malloc(buffInSize);
-          buffOut = malloc(buffOutSize);
+          u8* data = NULL;
+          u64 size = 0;
+          u64 offset = 0;
+     };
 
+     NczBodyWriter(const NcmContentId& ncaId, u64 offset, std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, NcaHasher* hasher) : NcaBodyWriter(ncaId, offset, contentStorage, hasher)
+     {
           dctx = ZSTD_createDCtx();
+          m_committedOffset = offset;
+
+          for (u64 i = 0; i < CHUNK_COUNT; i++)
+          {
+               m_chunks[i].data = (u8*)memalign(0x1000, CHUNK_SIZE);
+
+               if (!m_chunks[i].data)
+               {
+                    for (auto& chunk : m_chunks)
+                         free(chunk.data);
+
+                    ZSTD_freeDCtx(dctx);
+                    THROW_FORMAT("Failed to allocate NCZ buffers");
+               }
+
+               m_freeChunks.push(&m_chunks[i]);
+          }
+
+          // Each NCA starts a core further along, so NCAs streamed at once spread their stages over
+          // the cores, and an NCA's encryption and writes never share one
+          static std::atomic<u32> nextCore = 0;
+          u32 core = nextCore++;
+
+          m_encryptThread = std::thread([this, core]() { PinThreadToCore(core); encryptFunc(); });
+          m_writeThread = std::thread([this, core]() { PinThreadToCore(core + 1); writeFunc(); });
      }
 
      virtual ~NczBodyWriter()
      {
-          close();
+          finish();
 
           for (auto& i : sections)
           {
@@ -170,21 +684,73 @@ public:
                ZSTD_freeDCtx(dctx);
                dctx = NULL;
           }
+
+          for (auto& chunk : m_chunks)
+          {
+               free(chunk.data);
+               chunk.data = NULL;
+          }
      }
 
-     bool close()
+     bool close() override
      {
-          if (this->m_buffer.size())
+          finish();
+
+          if (!m_error.empty())
           {
-               processChunk(m_buffer.data(), m_buffer.size());
+               THROW_FORMAT("Failed to write NCZ: %s", m_error.c_str());
           }
 
-          encrypt(m_deflateBuffer.data(), m_deflateBuffer.size(), m_offset);
-          flush();
-
           return true;
      }
 
+     // Drains the pipeline and stops its threads. This also runs from the destructor, so failures
+     // are kept in m_error for close() to throw rather than thrown from here.
+     void finish()
+     {
+          if (m_closed)
+          {
+               return;
+          }
+
+          m_closed = true;
+
+          try
+          {
+               if (m_blockDecompressor)
+               {
+                    while (!m_blockDecompressor->empty())
+                    {
+                         writeBlock(m_blockDecompressor->popFront());
+                    }
+               }
+               else if (this->m_buffer.size())
+               {
+                    processChunk(m_buffer.data(), m_buffer.size());
+                    m_buffer.resize(0);
+               }
+
+               flush();
+          }
+          catch (std::exception& e)
+          {
+               fail(e.what());
+          }
+
+          m_blockDecompressor = NULL;
+
+          m_encryptQueue.close();
+          m_encryptThread.join();
+          m_writeQueue.close();
+          m_writeThread.join();
+
+          if (!m_error.empty())
+          {
+               LOG_DEBUG("Failed to write NCZ: %s\n", m_error.c_str());
+          }
+     }
+
+     // Hands the current chunk over to the encryption stage
      bool flush()
      {
           if(!isOpen())
@@ -192,15 +758,144 @@ public:
                return false;
           }
 
-          if (m_deflateBuffer.size())
+          if (m_currentChunk && m_currentChunk->size)
           {
-               m_contentStorage->WritePlaceholder(*(NcmPlaceHolderId*)&m_ncaId, m_offset, m_deflateBuffer.data(), m_deflateBuffer.size());
-               m_offset += m_deflateBuffer.size();
-               m_deflateBuffer.resize(0);
+               m_currentChunk->offset = m_offset;
+               m_offset += m_currentChunk->size;
+
+               u64 start = armGetSystemTick();
+               bool pushed = m_encryptQueue.push(m_currentChunk);
+               m_decompressStats.addIdle(start);
+               m_currentChunk = NULL;
+
+               if (!pushed)
+                    THROW_FORMAT("%s", m_error.c_str());
           }
           return true;
      }
 
+     // Blocks until the write stage hands a slab back
+     Chunk* acquireChunk()
+     {
+          Chunk* chunk = NULL;
+
+          u64 start = armGetSystemTick();
+          bool popped = m_freeChunks.pop(chunk);
+          m_decompressStats.addIdle(start);
+
+          if (!popped)
+               THROW_FORMAT("%s", m_error.c_str());
+
+          chunk->size = 0;
+          return chunk;
+     }
+
+     void fail(const std::string& error)
+     {
+          {
+               std::lock_guard<std::mutex> lock(m_errorMutex);
+
+               if (m_error.empty())
+                    m_error = error;
+          }
+
+          m_encryptQueue.abort();
+          m_writeQueue.abort();
+          m_freeChunks.abort();
+     }
+
+     void encryptFunc()
+     {
+          while (true)
+          {
+               Chunk* chunk = NULL;
+
+               u64 start = armGetSystemTick();
+               if (!m_encryptQueue.pop(chunk))
+                    break;
+               m_encryptStats.addIdle(start);
+
+               start = armGetSystemTick();
+               encrypt(chunk->data, chunk->size, chunk->offset);
+               m_encryptStats.addBusy(start, chunk->size);
+
+               start = armGetSystemTick();
+               if (!m_writeQueue.push(chunk))
+                    break;
+               m_encryptStats.addIdle(start);
+          }
+     }
+
+     void writeFunc()
+     {
+          while (true)
+          {
+               Chunk* chunk = NULL;
+
+               u64 start = armGetSystemTick();
+               if (!m_writeQueue.pop(chunk))
+                    break;
+               m_writeStats.addIdle(start);
+
+               try
+               {
+                    // Slabs arrive in offset order, so the re-encrypted data hashes as the original NCA
+                    u64 hashed = hashToMarks(chunk);
+                    NcaHashScope hash(m_hasher, chunk->data + hashed, chunk->size - hashed);
+                    start = armGetSystemTick();
+                    m_contentStorage->WritePlaceholder(*(NcmPlaceHolderId*)&m_ncaId, chunk->offset, chunk->data, chunk->size);
+                    m_writeStats.addBusy(start, chunk->size);
+                    m_committedOffset = chunk->offset + chunk->size;
+               }
+               catch (std::exception& e)
+               {
+                    fail(e.what());
+                    break;
+               }
+
+               m_freeChunks.push(chunk);
+          }
+     }
+
+     // Hashes the slab up to each block end that falls inside it and keeps the hash state there, so
+     // a checkpoint at that block can be resumed with verification. Returns how much was hashed.
+     u64 hashToMarks(Chunk* chunk)
+     {
+          if (!m_hasher)
+               return 0;
+
+          u64 hashed = 0;
+
+          while (true)
+          {
+               u64 mark;
+
+               {
+                    std::lock_guard<std::mutex> lock(m_hashMutex);
+
+                    if (m_hashMarks.empty() || m_hashMarks.front() > chunk->offset + chunk->size)
+                         break;
+
+                    mark = m_hashMarks.front();
+                    m_hashMarks.pop_front();
+               }
+
+               if (mark < chunk->offset + hashed)
+                    continue;
+
+               m_hasher->update(chunk->data + hashed, mark - chunk->offset - hashed);
+               hashed = mark - chunk->offset;
+
+               Sha256Context state;
+               m_hasher->saveState(state);
+
+               std::lock_guard<std::mutex> lock(m_hashMutex);
+               m_hashStates.emplace_back(mark, state);
+          }
+
+          return hashed;
+     }
+
      NczHeader::SectionContext& section(u64 offset)
      {
           for (u64 i = 0; i < sections.size(); i++)
@@ -236,49 +931,220 @@ public:
           return true;
      }
 
-     u64 processChunk(const u8* ptr, u64 sz)
+     // Feeds the caller's buffer straight into zstd, decompressing into the tail of the current slab.
+     // Throws if the stream is corrupt, nothing after the error could be placed correctly.
+     void processChunk(const u8* ptr, u64 sz)
      {
-          while(sz > 0)
+          ZSTD_inBuffer input = { ptr, sz, 0 };
+          bool outputFull = false;
+
+          // A full output buffer may mean zstd still holds decompressed data, so keep going until it doesn't
+          while(input.pos < input.size || outputFull)
           {
-               const size_t readChunkSz = std::min(sz, buffInSize);
-               ZSTD_inBuffer input = { ptr, readChunkSz, 0 };
+               if (!m_currentChunk)
+               {
+                    m_currentChunk = acquireChunk();
+               }
+
+               ZSTD_outBuffer output = { m_currentChunk->data + m_currentChunk->size, CHUNK_SIZE - m_currentChunk->size, 0 };
+               u64 start = armGetSystemTick();
+               size_t const ret = ZSTD_decompressStream(dctx, &output, &input);
+               m_decompressStats.addBusy(start, output.pos);
 
-               while(input.pos < input.size)
+               if (ZSTD_isError(ret))
                {
-                    ZSTD_outBuffer output = { buffOut, buffOutSize, 0 };
-                    size_t const ret = ZSTD_decompressStream(dctx, &output, &input);
+                    std::string error = std::string("Failed to decompress NCZ: ") + ZSTD_getErrorName(ret);
+                    fail(error);
+                    THROW_FORMAT("%s", error.c_str());
+               }
 
-                    if (ZSTD_isError(ret))
-                    {
-                         LOG_DEBUG("%s\n", ZSTD_getErrorName(ret));
-                         return 0;
-                    }
+               m_currentChunk->size += output.pos;
+               outputFull = output.pos == output.size;
 
-                    size_t len = output.pos;
-                    u8* p = (u8*)buffOut;                         
+               if(m_currentChunk->size >= CHUNK_SIZE)
+               {
+                    flush();
+               }
+          }
+     }
 
-                    while(len)
-                    {
-                         const size_t writeChunkSz = std::min(0x1000000 - m_deflateBuffer.size(), len);
+     void writeDecompressed(const u8* p, u64 len)
+     {
+          while(len)
+          {
+               if (!m_currentChunk)
+               {
+                    m_currentChunk = acquireChunk();
+               }
 
-                         append(m_deflateBuffer, p, writeChunkSz);
+               const size_t writeChunkSz = std::min(CHUNK_SIZE - m_currentChunk->size, len);
 
-                         if(m_deflateBuffer.size() >= 0x1000000)
-                         {
-                              encrypt(m_deflateBuffer.data(), m_deflateBuffer.size(), m_offset);
-                              flush();
-                         }
+               memcpy(m_currentChunk->data + m_currentChunk->size, p, writeChunkSz);
+               m_currentChunk->size += writeChunkSz;
 
-                         p += writeChunkSz;
-                         len -= writeChunkSz;
+               if(m_currentChunk->size >= CHUNK_SIZE)
+               {
+                    flush();
+               }
+
+               p += writeChunkSz;
+               len -= writeChunkSz;
+          }
+     }
+
+     // Throws if the block couldn't be decompressed, every block after it would land at the wrong offset
+     void writeBlock(std::unique_ptr<NczBlockDecompressor::Job> job)
+     {
+          if (job->failed)
+          {
+               std::string error = "Failed to decompress NCZ block " + std::to_string(job->index);
+               fail(error);
+               THROW_FORMAT("%s", error.c_str());
+          }
+
+          // Blocks are independent, so the end of each one is a point decompression can restart from
+          NcaResumePoint point;
+          point.inputOffset = m_bodyOffset + job->inputEnd;
+          point.outputOffset = m_offset + (m_currentChunk ? m_currentChunk->size : 0) + job->output.size();
+
+          // Marked before the data is queued, the write thread may reach the block end straight away
+          if (m_hasher)
+          {
+               std::lock_guard<std::mutex> lock(m_hashMutex);
+               m_hashMarks.push_back(point.outputOffset);
+          }
+
+          writeDecompressed(job->output.data(), job->output.size());
+
+          point.prefixSize = m_bodyOffset + m_blockDataOffset;
+          point.block = job->index + 1;
+          m_pendingCheckpoints.push_back(point);
+     }
+
+     void resume(const NcaResumePoint& point) override
+     {
+          if (!m_blockHeaderRead || point.block > m_blockSizes.size())
+               THROW_FORMAT("Only block compressed NCZs can be resumed");
+
+          m_currentBlock = point.block;
+          m_blockInputOffset = point.inputOffset - m_bodyOffset;
+          m_offset = point.outputOffset;
+          m_committedOffset = point.outputOffset;
+     }
+
+     bool checkpoint(NcaResumePoint& point) override
+     {
+          while (!m_pendingCheckpoints.empty() && m_pendingCheckpoints.front().outputOffset <= m_committedOffset)
+          {
+               m_checkpoint = m_pendingCheckpoints.front();
+               m_hasCheckpoint = true;
+               m_pendingCheckpoints.pop_front();
+
+               if (m_hasher)
+               {
+                    std::lock_guard<std::mutex> lock(m_hashMutex);
+
+                    while (!m_hashStates.empty() && m_hashStates.front().first < m_checkpoint.outputOffset)
+                         m_hashStates.pop_front();
+
+                    if (!m_hashStates.empty() && m_hashStates.front().first == m_checkpoint.outputOffset)
+                    {
+                         m_checkpoint.hashed = true;
+                         m_checkpoint.hashState = m_hashStates.front().second;
+                         m_hashStates.pop_front();
                     }
                }
+          }
+
+          if (m_hasCheckpoint)
+               point = m_checkpoint;
+
+          return m_hasCheckpoint;
+     }
+
+     // Returns the number of bytes consumed
+     u64 readBlockHeader(const u8* ptr, u64 sz)
+     {
+          const u64 fixedSize = sizeof(NczBlockHeader);
+          u64 consumed = 0;
+
+          if (m_buffer.size() < fixedSize)
+          {
+               u64 chunk = std::min(fixedSize - m_buffer.size(), sz);
+               append(m_buffer, ptr, chunk);
+               consumed += chunk;
+
+               if (m_buffer.size() < fixedSize)
+                    return consumed;
+
+               auto header = (NczBlockHeader*)m_buffer.data();
+
+               if (!header->isValid())
+                    THROW_FORMAT("Unsupported NCZ block header");
+          }
+
+          auto header = (NczBlockHeader*)m_buffer.data();
+          u64 totalSize = fixedSize + header->m_numberOfBlocks * sizeof(u32);
+          u64 chunk = std::min(totalSize - m_buffer.size(), sz - consumed);
+          append(m_buffer, ptr + consumed, chunk);
+          consumed += chunk;
 
-               sz -= readChunkSz;
-               ptr += readChunkSz;
+          if (m_buffer.size() == totalSize)
+          {
+               // The append may have moved the buffer
+               m_blockHeader = *(NczBlockHeader*)m_buffer.data();
+               m_blockSizes.resize(m_blockHeader.m_numberOfBlocks);
+               memcpy(m_blockSizes.data(), m_buffer.data() + fixedSize, m_blockSizes.size() * sizeof(u32));
+               m_buffer.resize(0);
+
+               m_blockDataOffset = m_sectionHeaderSize + totalSize;
+               m_blockInputOffset = m_blockDataOffset;
+
+               // Enough jobs queued to keep every worker busy, whichever NCA they come from
+               m_blockDecompressor = std::make_unique<NczBlockDecompressor>(NczWorkerPool::shared(), NczWorkerPool::workerCount() * 2, m_decompressStats);
+               m_blockHeaderRead = true;
           }
 
-          return 1;
+          return consumed;
+     }
+
+     void writeBlocks(const u8* ptr, u64 sz)
+     {
+          while (sz && m_currentBlock < m_blockSizes.size())
+          {
+               if (!m_currentJob)
+               {
+                    m_currentJob = std::make_unique<NczBlockDecompressor::Job>();
+                    m_currentJob->index = m_currentBlock;
+                    m_currentJob->input.resize(m_blockSizes[m_currentBlock]);
+                    m_currentJob->output.resize(m_blockHeader.decompressedBlockSize(m_currentBlock));
+                    m_currentJobFilled = 0;
+               }
+
+               // Copied once, straight into the buffer the worker decompresses from
+               u64 chunk = std::min(m_currentJob->input.size() - m_currentJobFilled, sz);
+               memcpy(m_currentJob->input.data() + m_currentJobFilled, ptr, chunk);
+               m_currentJobFilled += chunk;
+               ptr += chunk;
+               sz -= chunk;
+               m_blockInputOffset += chunk;
+
+               if (m_currentJobFilled == m_currentJob->input.size())
+               {
+                    // Keep the number of blocks in flight bounded, writing out finished ones in order
+                    while (m_blockDecompressor->full())
+                    {
+                         u64 start = armGetSystemTick();
+                         std::unique_ptr<NczBlockDecompressor::Job> job = m_blockDecompressor->popFront();
+                         m_decompressStats.addIdle(start);
+                         writeBlock(std::move(job));
+                    }
+
+                    m_currentJob->inputEnd = m_blockInputOffset;
+                    m_blockDecompressor->submit(std::move(m_currentJob));
+                    m_currentBlock++;
+               }
+          }
      }
 
      u64 write(const  u8* ptr, u64 sz) override
@@ -318,85 +1184,269 @@ public:
                     }
 
                     m_sectionsInitialized = true;
+                    m_sectionHeaderSize = m_buffer.size();
                     m_buffer.resize(0);
                }
           }
 
-          while (sz)
+          // Peek past the section table to see whether this is a block compressed NCZ.
+          // For a solid NCZ the peeked bytes are simply left in m_buffer to be decompressed.
+          if (sz && m_sectionsInitialized && !m_blockModeChecked)
           {
-               if (m_buffer.size() + sz >= 0x1000000)
-               {
-                    u64 chunk = 0x1000000 - m_buffer.size();
-                    append(m_buffer, ptr, chunk);
+               u64 chunk = std::min(sizeof(u64) - m_buffer.size(), sz);
+               append(m_buffer, ptr, chunk);
+               ptr += chunk;
+               sz -= chunk;
 
-                    processChunk(m_buffer.data(), m_buffer.size());
-                    m_buffer.resize(0);
+               if (m_buffer.size() == sizeof(u64))
+               {
+                    m_blockMode = *(u64*)m_buffer.data() == NczBlockHeader::MAGIC;
+                    m_blockModeChecked = true;
+               }
+          }
 
-                    sz -= chunk;
-                    ptr += chunk;
+          if (m_blockMode)
+          {
+               if (sz && !m_blockHeaderRead)
+               {
+                    u64 consumed = readBlockHeader(ptr, sz);
+                    ptr += consumed;
+                    sz -= consumed;
                }
-               else
+
+               if (sz && m_blockHeaderRead)
                {
-                    append(m_buffer, ptr, sz);
-                    sz = 0;
+                    writeBlocks(ptr, sz);
                }
 
+               return 0;
           }
 
-          return sz;
-     }
+          if (sz && m_blockModeChecked)
+          {
+               // The peeked magic bytes were the start of the zstd stream
+               if (m_buffer.size())
+               {
+                    processChunk(m_buffer.data(), m_buffer.size());
+                    m_buffer.resize(0);
+               }
 
-     size_t const buffInSize = ZSTD_DStreamInSize();
-     size_t const buffOutSize = ZSTD_DStreamOutSize();
+               processChunk(ptr, sz);
+          }
 
-     void* buffIn = NULL;
-     void* buffOut = NULL;
+          return 0;
+     }
 
      ZSTD_DCtx* dctx = NULL;
 
      std::vector<u8> m_buffer;
-     std::vector<u8> m_deflateBuffer;
+
+     Chunk m_chunks[CHUNK_COUNT];
+     Chunk* m_currentChunk = NULL;
+
+     NczBoundedQueue<Chunk*> m_freeChunks{CHUNK_COUNT};
+     NczBoundedQueue<Chunk*> m_encryptQueue{QUEUE_DEPTH};
+     NczBoundedQueue<Chunk*> m_writeQueue{QUEUE_DEPTH};
+     std::mutex m_errorMutex;
+     std::string m_error;
+     std::thread m_encryptThread;
+     std::thread m_writeThread;
+     bool m_closed = false;
 
      bool m_sectionsInitialized = false;
+     bool m_blockModeChecked = false;
+     bool m_blockMode = false;
+     bool m_blockHeaderRead = false;
+
+     NczBlockHeader m_blockHeader;
+     std::vector<u32> m_blockSizes;
+     u32 m_currentBlock = 0;
+     std::unique_ptr<NczBlockDecompressor::Job> m_currentJob;
+     u64 m_currentJobFilled = 0;
+
+     // Offsets relative to the start of the NCZ body
+     u64 m_sectionHeaderSize = 0;
+     u64 m_blockDataOffset = 0;
+     u64 m_blockInputOffset = 0;
+
+     std::atomic<u64> m_committedOffset = 0;
+     std::deque<NcaResumePoint> m_pendingCheckpoints;
+     NcaResumePoint m_checkpoint;
+     bool m_hasCheckpoint = false;
+     std::unique_ptr<NczBlockDecompressor> m_blockDecompressor;
+
+     // Block ends still to be hashed up to, and the hash states taken there
+     std::mutex m_hashMutex;
+     std::deque<u64> m_hashMarks;
+     std::deque<std::pair<u64, Sha256Context>> m_hashStates;
 
      std::vector<NczHeader::SectionContext*> sections;
 };
 
-NcaWriter::NcaWriter(const NcmContentId& ncaId, std::shared_ptr<nx::ncm::ContentStorage>& contentStorage) : m_ncaId(ncaId), m_contentStorage(contentStorage), m_writer(NULL)
+NcaWriter::NcaWriter(const NcmContentId& ncaId, std::shared_ptr<nx::ncm::ContentStorage>& contentStorage, bool verifyHash) : m_ncaId(ncaId), m_contentStorage(contentStorage), m_writer(NULL)
 {
+     if (verifyHash)
+     {
+          m_hasher = std::make_unique<NcaHasher>();
+     }
 }
 
 NcaWriter::~NcaWriter()
 {
-     close();
+     try
+     {
+          close();
+     }
+     catch (std::exception& e)
+     {
+          LOG_DEBUG("%s\n", e.what());
+     }
 }
 
 bool NcaWriter::close()
 {
+     u64 ncaSize = headerNcaSize();
+
      if (m_writer)
      {
+          // A body that failed to write must not be registered, even when the hash isn't checked
+          std::string error;
+
+          try
+          {
+               m_writer->close();
+          }
+          catch (std::exception& e)
+          {
+               error = e.what();
+          }
+
+          m_stats = m_writer->stats();
           m_writer = NULL;
+
+          LOG_DEBUG("NCA write stages (busy/idle ms): decompress %lu/%lu, encrypt %lu/%lu, write %lu/%lu\n",
+               armTicksToNs(m_stats.decompress.busyTicks) / 1000000, armTicksToNs(m_stats.decompress.idleTicks) / 1000000,
+               armTicksToNs(m_stats.encrypt.busyTicks) / 1000000, armTicksToNs(m_stats.encrypt.idleTicks) / 1000000,
+               armTicksToNs(m_stats.write.busyTicks) / 1000000, armTicksToNs(m_stats.write.idleTicks) / 1000000);
+
+          if (!error.empty())
+          {
+               m_hasher = NULL;
+               m_contentStorage = NULL;
+               THROW_FORMAT("%s", error.c_str());
+          }
      }
      else if(m_buffer.size())
      {
-          if(isOpen())
+          if(isOpen() && !m_resuming)
           {
                flushHeader();
           }
 
           m_buffer.resize(0);
      }
+
+     bool verified = true;
+
+     // An NCA that stopped part way keeps its placeholder so it can be resumed, there's no hash to check yet
+     if (m_hasher && isOpen() && m_hasher->size() && m_hasher->size() < ncaSize)
+     {
+          LOG_DEBUG("NCA %s closed at 0x%lx of 0x%lx, not verified\n", tin::util::GetNcaIdString(m_ncaId).c_str(), m_hasher->size(), ncaSize);
+     }
+     else if (m_hasher && isOpen() && m_hasher->size())
+     {
+          u8 hash[SHA256_HASH_SIZE];
+          m_hasher->getHash(hash);
+
+          // The content id is the first half of the NCA's hash
+          if (memcmp(hash, m_ncaId.c, sizeof(m_ncaId.c)))
+          {
+               verified = false;
+
+               try
+               {
+                    m_contentStorage->DeletePlaceholder(*(NcmPlaceHolderId*)&m_ncaId);
+               }
+               catch (...) {}
+          }
+     }
+
+     m_hasher = NULL;
      m_contentStorage = NULL;
+
+     if (!verified)
+     {
+          m_verificationFailed = true;
+          THROW_FORMAT("Hash mismatch for NCA %s", tin::util::GetNcaIdString(m_ncaId).c_str());
+     }
+
      return true;
 }
 
+bool NcaWriter::verificationFailed() const
+{
+     return m_verificationFailed;
+}
+
 bool NcaWriter::isOpen() const
 {
      return (bool)m_contentStorage;
 }
 
+void NcaWriter::resume(const NcaResumePoint& point)
+{
+     if (m_buffer.size() || m_writer)
+          THROW_FORMAT("Can't resume an NCA that has already been written to");
+
+     m_resumePoint = point;
+     m_resuming = true;
+
+     if (m_hasher && point.hashed)
+     {
+          m_hasher->restoreState(point.hashState, point.outputOffset);
+     }
+     else if (m_hasher)
+     {
+          LOG_DEBUG("Resuming NCA %s without its hash state, it won't be verified\n", tin::util::GetNcaIdString(m_ncaId).c_str());
+          m_hasher = NULL;
+     }
+}
+
+bool NcaWriter::checkpoint(NcaResumePoint& point)
+{
+     if (!m_writer || (m_resuming && !m_resumed))
+          return false;
+
+     return m_writer->checkpoint(point);
+}
+
 u64 NcaWriter::write(const  u8* ptr, u64 sz)
 {
+     // When resuming, the headers are parsed again but the placeholder is only written to after them
+     if (m_resuming && !m_resumed && m_inputOffset + sz > m_resumePoint.prefixSize)
+     {
+          u64 prefix = m_resumePoint.prefixSize - m_inputOffset;
+          writeData(ptr, prefix);
+          ptr += prefix;
+          sz -= prefix;
+
+          if (!m_writer)
+          {
+               m_writer = std::shared_ptr<NcaBodyWriter>(new NcaBodyWriter(m_ncaId, m_buffer.size(), m_contentStorage, m_hasher.get()));
+          }
+
+          m_writer->resume(m_resumePoint);
+          m_inputOffset = m_resumePoint.inputOffset;
+          m_resumed = true;
+     }
+
+     return writeData(ptr, sz);
+}
+
+u64 NcaWriter::writeData(const  u8* ptr, u64 sz)
+{
+     m_inputOffset += sz;
+
      if (m_buffer.size() < NCA_HEADER_SIZE)
      {
           if (m_buffer.size() + sz > NCA_HEADER_SIZE)
@@ -414,7 +1464,7 @@ u64 NcaWriter::write(const  u8* ptr, u64 sz)
                sz = 0;
           }
 
-          if (m_buffer.size() == NCA_HEADER_SIZE)
+          if (m_buffer.size() == NCA_HEADER_SIZE && !m_resuming)
           {
                flushHeader();
           }
@@ -428,11 +1478,11 @@ u64 NcaWriter::write(const  u8* ptr, u64 sz)
                {
                     if (*(u64*)ptr == NczHeader::MAGIC)
                     {
-                         m_writer = std::shared_ptr<NcaBodyWriter>(new NczBodyWriter(m_ncaId, m_buffer.size(), m_contentStorage));
+                         m_writer = std::shared_ptr<NcaBodyWriter>(new NczBodyWriter(m_ncaId, m_buffer.size(), m_contentStorage, m_hasher.get()));
                     }
                     else
                     {
-                         m_writer = std::shared_ptr<NcaBodyWriter>(new NcaBodyWriter(m_ncaId, m_buffer.size(), m_contentStorage));
+                         m_writer = std::shared_ptr<NcaBodyWriter>(new NcaBodyWriter(m_ncaId, m_buffer.size(), m_contentStorage, m_hasher.get()));
                     }
                }
                else
@@ -454,8 +1504,33 @@ u64 NcaWriter::write(const  u8* ptr, u64 sz)
      return sz;
 }
 
+u64 NcaWriter::headerNcaSize() const
+{
+     if (m_buffer.size() < NCA_HEADER_SIZE)
+          return 0;
+
+     tin::install::NcaHeader header;
+     memcpy(&header, m_buffer.data(), sizeof(header));
+     Crypto::AesXtr decryptor(Crypto::Keys().headerKey, false);
+     decryptor.decrypt(&header, &header, sizeof(header), 0, 0x200);
+
+     return header.magic == MAGIC_NCA3 ? header.nca_size : 0;
+}
+
+NcaWriterStats NcaWriter::stats() const
+{
+     return m_writer ? m_writer->stats() : m_stats;
+}
+
 void NcaWriter::flushHeader()
 {
+     // Hash the header as received, before the distribution type is patched
+     if (m_hasher)
+     {
+          m_hasher->update(m_buffer.data(), m_buffer.size());
+          m_hasher->wait();
+     }
+
      tin::install::NcaHeader header;
      memcpy(&header, m_buffer.data(), sizeof(header));
      Crypto::AesXtr decryptor(Crypto::Keys().headerKey, false);
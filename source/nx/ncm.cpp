@@ -25,7 +25,7 @@ SOFTWARE.
 
 namespace nx::ncm
 {
-    ContentStorage::ContentStorage(NcmStorageId storageId) 
+    ContentStorage::ContentStorage(NcmStorageId storageId) : m_storageId(storageId)
     {
         ASSERT_OK(ncmOpenContentStorage(&m_contentStorage, storageId), "Failed to open NCM ContentStorage");
     }
@@ -45,6 +45,13 @@ namespace nx::ncm
         ASSERT_OK(ncmContentStorageDeletePlaceHolder(&m_contentStorage, &placeholderId), "Failed to delete placeholder");
     }
 
+    bool ContentStorage::HasPlaceholder(const NcmPlaceHolderId &placeholderId)
+    {
+        bool hasPlaceholder = false;
+        ASSERT_OK(ncmContentStorageHasPlaceHolder(&m_contentStorage, &hasPlaceholder, &placeholderId), "Failed to check if placeholder is present");
+        return hasPlaceholder;
+    }
+
     void ContentStorage::WritePlaceholder(const NcmPlaceHolderId &placeholderId, u64 offset, void *buffer, size_t bufSize)
     {
         ASSERT_OK(ncmContentStorageWritePlaceHolder(&m_contentStorage, &placeholderId, offset, buffer, bufSize), "Failed to write to placeholder");
@@ -73,4 +80,9 @@ namespace nx::ncm
         ASSERT_OK(ncmContentStorageGetPath(&m_contentStorage, pathBuf, FS_MAX_PATH, &registeredId), "Failed to get installed NCA path");
         return std::string(pathBuf);
     }
+
+    NcmStorageId ContentStorage::GetStorageId() const
+    {
+        return m_storageId;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,468 @@
+#include "shopCatalog.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include "shopInstall.hpp"
+#include <switch.h>
+
+namespace {
+    // Bump whenever a record layout changes, older files are then ignored
+    constexpr std::uint32_t kCatalogMagic = 0x43534643; // "CFSC"
+    constexpr std::uint32_t kCatalogVersion = 1;
+
+    struct FileStringRef {
+        std::uint32_t offset;
+        std::uint32_t length;
+    };
+
+    struct FileHeader {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t itemCount;
+        std::uint32_t prefixCount;
+        std::uint32_t sectionCount;
+        std::uint32_t sectionItemCount;
+        std::uint32_t stringsSize;
+        std::uint32_t itemRecordSize;
+    };
+
+    struct ItemRecord {
+        std::uint64_t titleId;
+        std::uint64_t size;
+        std::uint32_t appVersion;
+        std::int32_t appType;
+        FileStringRef name;
+        FileStringRef urlLeaf;
+        FileStringRef iconLeaf;
+        FileStringRef appId;
+        std::uint32_t urlPrefix;
+        std::uint32_t iconPrefix;
+        std::uint32_t flags;
+        std::uint32_t reserved;
+    };
+
+    struct SectionRecord {
+        FileStringRef id;
+        FileStringRef title;
+        std::uint32_t firstItem;
+        std::uint32_t itemCount;
+    };
+
+    template<typename T>
+    void AppendRaw(std::string& out, const T* data, std::size_t count)
+    {
+        out.append(reinterpret_cast<const char*>(data), sizeof(T) * count);
+    }
+}
+
+namespace shopInstStuff {
+    ShopCatalog::StringRef ShopCatalog::Store(std::string_view text)
+    {
+        StringRef ref;
+        ref.offset = static_cast<std::uint32_t>(m_arena.size());
+        ref.length = static_cast<std::uint32_t>(text.size());
+        m_arena.append(text.data(), text.size());
+        return ref;
+    }
+
+    std::string_view ShopCatalog::Load(const StringRef& ref) const
+    {
+        return std::string_view(m_arena.data() + ref.offset, ref.length);
+    }
+
+    // Prefix 0 is the empty string, so urls that can't be split still round trip
+    std::uint32_t ShopCatalog::InternPrefix(const std::string& prefix)
+    {
+        if (m_prefixes.empty()) {
+            m_prefixes.push_back("");
+            m_prefixLookup[""] = 0;
+        }
+
+        auto it = m_prefixLookup.find(prefix);
+        if (it == m_prefixLookup.end()) {
+            it = m_prefixLookup.emplace(prefix, static_cast<std::uint32_t>(m_prefixes.size())).first;
+            m_prefixes.push_back(prefix);
+        }
+        return it->second;
+    }
+
+    void ShopCatalog::StoreUrl(const std::string& url, std::uint32_t& prefix, StringRef& leaf)
+    {
+        auto queryPos = url.find('?');
+        auto slashPos = url.find_last_of('/', queryPos == std::string::npos ? std::string::npos : queryPos);
+        std::size_t split = slashPos == std::string::npos ? 0 : slashPos + 1;
+
+        prefix = this->InternPrefix(url.substr(0, split));
+        leaf = this->Store(std::string_view(url).substr(split));
+    }
+
+    void ShopCatalog::IndexUrls()
+    {
+        for (; m_urlLookupEnd < m_names.size(); m_urlLookupEnd++) {
+            if (this->HasUrl(m_urlLookupEnd))
+                m_urlLookup.emplace(std::hash<std::string>{}(this->GetUrl(m_urlLookupEnd)), m_urlLookupEnd);
+        }
+    }
+
+    std::string ShopCatalog::LoadUrl(std::uint32_t prefix, const StringRef& leaf) const
+    {
+        std::string url;
+        if (prefix < m_prefixes.size())
+            url = m_prefixes[prefix];
+        url.append(this->Load(leaf));
+        return url;
+    }
+
+    ShopCatalog::Index ShopCatalog::Add(const ShopItem& item)
+    {
+        this->IndexUrls();
+        std::size_t urlHash = std::hash<std::string>{}(item.url);
+        if (!item.url.empty()) {
+            auto range = m_urlLookup.equal_range(urlHash);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (this->GetUrl(it->second) == item.url)
+                    return it->second;
+            }
+        }
+
+        Index index = static_cast<Index>(m_names.size());
+
+        std::uint8_t flags = 0;
+        if (item.hasTitleId) flags |= kHasTitleId;
+        if (item.hasAppVersion) flags |= kHasAppVersion;
+        if (item.hasIconUrl) flags |= kHasIconUrl;
+        if (item.hasAppId) flags |= kHasAppId;
+
+        std::uint32_t urlPrefix = 0, iconPrefix = 0;
+        StringRef urlLeaf, iconLeaf;
+        this->StoreUrl(item.url, urlPrefix, urlLeaf);
+        this->StoreUrl(item.iconUrl, iconPrefix, iconLeaf);
+
+        m_names.push_back(this->Store(item.name));
+        m_urlPrefixes.push_back(urlPrefix);
+        m_urlLeaves.push_back(urlLeaf);
+        m_iconPrefixes.push_back(iconPrefix);
+        m_iconLeaves.push_back(iconLeaf);
+        m_appIds.push_back(this->Store(item.appId));
+        m_sizes.push_back(item.size);
+        m_titleIds.push_back(item.titleId);
+        m_appVersions.push_back(item.appVersion);
+        m_appTypes.push_back(item.appType);
+        m_flags.push_back(flags);
+
+        if (!item.url.empty())
+            m_urlLookup.emplace(urlHash, index);
+        m_urlLookupEnd = index + 1;
+        return index;
+    }
+
+    void ShopCatalog::Clear()
+    {
+        *this = ShopCatalog();
+    }
+
+    std::size_t ShopCatalog::Size() const
+    {
+        return m_names.size();
+    }
+
+    std::string_view ShopCatalog::GetName(Index index) const
+    {
+        return this->Load(m_names[index]);
+    }
+
+    std::string ShopCatalog::GetDisplayName(Index index) const
+    {
+        std::string name(this->GetName(index));
+        if (!m_typeLabels)
+            return name;
+
+        std::string suffix;
+        if (m_appTypes[index] == NcmContentMetaType_Patch)
+            suffix = " (Update)";
+        else if (m_appTypes[index] == NcmContentMetaType_AddOnContent)
+            suffix = " (DLC)";
+        if (!suffix.empty() && (name.size() < suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0))
+            name += suffix;
+        return name;
+    }
+
+    std::string ShopCatalog::GetUrl(Index index) const
+    {
+        return this->LoadUrl(m_urlPrefixes[index], m_urlLeaves[index]);
+    }
+
+    std::string ShopCatalog::GetIconUrl(Index index) const
+    {
+        return this->LoadUrl(m_iconPrefixes[index], m_iconLeaves[index]);
+    }
+
+    std::string_view ShopCatalog::GetAppId(Index index) const
+    {
+        return this->Load(m_appIds[index]);
+    }
+
+    std::uint64_t ShopCatalog::GetSize(Index index) const
+    {
+        return m_sizes[index];
+    }
+
+    std::uint64_t ShopCatalog::GetTitleId(Index index) const
+    {
+        return m_titleIds[index];
+    }
+
+    std::uint32_t ShopCatalog::GetAppVersion(Index index) const
+    {
+        return m_appVersions[index];
+    }
+
+    std::int32_t ShopCatalog::GetAppType(Index index) const
+    {
+        return m_appTypes[index];
+    }
+
+    bool ShopCatalog::HasUrl(Index index) const
+    {
+        return m_urlPrefixes[index] != 0 || m_urlLeaves[index].length != 0;
+    }
+
+    bool ShopCatalog::HasIconUrl(Index index) const
+    {
+        return m_flags[index] & kHasIconUrl;
+    }
+
+    bool ShopCatalog::HasAppId(Index index) const
+    {
+        return m_flags[index] & kHasAppId;
+    }
+
+    bool ShopCatalog::HasTitleId(Index index) const
+    {
+        return m_flags[index] & kHasTitleId;
+    }
+
+    bool ShopCatalog::HasAppVersion(Index index) const
+    {
+        return m_flags[index] & kHasAppVersion;
+    }
+
+    ShopItem ShopCatalog::GetItem(Index index) const
+    {
+        ShopItem item;
+        item.name = this->GetDisplayName(index);
+        item.url = this->GetUrl(index);
+        item.iconUrl = this->GetIconUrl(index);
+        item.appId = std::string(this->GetAppId(index));
+        item.size = m_sizes[index];
+        item.titleId = m_titleIds[index];
+        item.appVersion = m_appVersions[index];
+        item.appType = m_appTypes[index];
+        item.hasTitleId = this->HasTitleId(index);
+        item.hasAppVersion = this->HasAppVersion(index);
+        item.hasIconUrl = this->HasIconUrl(index);
+        item.hasAppId = this->HasAppId(index);
+        return item;
+    }
+
+    void ShopCatalog::SetTypeLabels(bool enabled)
+    {
+        m_typeLabels = enabled;
+    }
+}
+
+namespace shopInstStuff {
+    bool ShopCatalog::Save(const std::string& path, const std::vector<ShopSection>& sections) const
+    {
+        // Prefixes and section labels go after the arena, so item string offsets stay as they are
+        std::string strings = m_arena;
+        auto appendString = [&](const std::string& text) {
+            FileStringRef ref{static_cast<std::uint32_t>(strings.size()), static_cast<std::uint32_t>(text.size())};
+            strings.append(text);
+            return ref;
+        };
+
+        std::vector<FileStringRef> prefixes;
+        prefixes.reserve(m_prefixes.size());
+        for (const auto& prefix : m_prefixes)
+            prefixes.push_back(appendString(prefix));
+
+        std::vector<SectionRecord> sectionRecords;
+        std::vector<std::uint32_t> sectionItems;
+        sectionRecords.reserve(sections.size());
+        for (const auto& section : sections) {
+            SectionRecord record;
+            record.id = appendString(section.id);
+            record.title = appendString(section.title);
+            record.firstItem = static_cast<std::uint32_t>(sectionItems.size());
+            record.itemCount = static_cast<std::uint32_t>(section.items.size());
+            sectionItems.insert(sectionItems.end(), section.items.begin(), section.items.end());
+            sectionRecords.push_back(record);
+        }
+
+        std::vector<ItemRecord> items(m_names.size());
+        for (std::size_t i = 0; i < items.size(); i++) {
+            auto& record = items[i];
+            std::memset(&record, 0, sizeof(record));
+            record.titleId = m_titleIds[i];
+            record.size = m_sizes[i];
+            record.appVersion = m_appVersions[i];
+            record.appType = m_appTypes[i];
+            record.name = {m_names[i].offset, m_names[i].length};
+            record.urlLeaf = {m_urlLeaves[i].offset, m_urlLeaves[i].length};
+            record.iconLeaf = {m_iconLeaves[i].offset, m_iconLeaves[i].length};
+            record.appId = {m_appIds[i].offset, m_appIds[i].length};
+            record.urlPrefix = m_urlPrefixes[i];
+            record.iconPrefix = m_iconPrefixes[i];
+            record.flags = m_flags[i];
+        }
+
+        FileHeader header;
+        header.magic = kCatalogMagic;
+        header.version = kCatalogVersion;
+        header.itemCount = static_cast<std::uint32_t>(items.size());
+        header.prefixCount = static_cast<std::uint32_t>(prefixes.size());
+        header.sectionCount = static_cast<std::uint32_t>(sectionRecords.size());
+        header.sectionItemCount = static_cast<std::uint32_t>(sectionItems.size());
+        header.stringsSize = static_cast<std::uint32_t>(strings.size());
+        header.itemRecordSize = sizeof(ItemRecord);
+
+        std::string data;
+        AppendRaw(data, &header, 1);
+        AppendRaw(data, items.data(), items.size());
+        AppendRaw(data, prefixes.data(), prefixes.size());
+        AppendRaw(data, sectionRecords.data(), sectionRecords.size());
+        AppendRaw(data, sectionItems.data(), sectionItems.size());
+        data.append(strings);
+
+        std::string tmpPath = path + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+            out.write(data.data(), data.size());
+            if (!out)
+                return false;
+        }
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        std::filesystem::rename(tmpPath, path, ec);
+        return !ec;
+    }
+
+    bool ShopCatalog::Load(const std::string& path, std::vector<ShopSection>& sections)
+    {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)
+            return false;
+        std::streamsize fileSize = in.tellg();
+        if (fileSize < (std::streamsize)sizeof(FileHeader))
+            return false;
+        std::string data(static_cast<std::size_t>(fileSize), '\0');
+        in.seekg(0);
+        if (!in.read(data.data(), fileSize))
+            return false;
+
+        FileHeader header;
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (header.magic != kCatalogMagic || header.version != kCatalogVersion || header.itemRecordSize != sizeof(ItemRecord))
+            return false;
+
+        std::uint64_t itemsOffset = sizeof(FileHeader);
+        std::uint64_t prefixesOffset = itemsOffset + (std::uint64_t)header.itemCount * sizeof(ItemRecord);
+        std::uint64_t sectionsOffset = prefixesOffset + (std::uint64_t)header.prefixCount * sizeof(FileStringRef);
+        std::uint64_t sectionItemsOffset = sectionsOffset + (std::uint64_t)header.sectionCount * sizeof(SectionRecord);
+        std::uint64_t stringsOffset = sectionItemsOffset + (std::uint64_t)header.sectionItemCount * sizeof(std::uint32_t);
+        if (stringsOffset + header.stringsSize != (std::uint64_t)fileSize)
+            return false;
+
+        const auto* items = reinterpret_cast<const ItemRecord*>(data.data() + itemsOffset);
+        const auto* prefixes = reinterpret_cast<const FileStringRef*>(data.data() + prefixesOffset);
+        const auto* sectionRecords = reinterpret_cast<const SectionRecord*>(data.data() + sectionsOffset);
+        const auto* sectionItems = reinterpret_cast<const std::uint32_t*>(data.data() + sectionItemsOffset);
+        const char* strings = data.data() + stringsOffset;
+
+        // A damaged file must not leave indices pointing outside the catalog
+        auto validRef = [&](const FileStringRef& ref) {
+            return (std::uint64_t)ref.offset + ref.length <= header.stringsSize;
+        };
+        for (std::uint32_t i = 0; i < header.prefixCount; i++) {
+            if (!validRef(prefixes[i]))
+                return false;
+        }
+        for (std::uint32_t i = 0; i < header.itemCount; i++) {
+            const auto& item = items[i];
+            if (!validRef(item.name) || !validRef(item.urlLeaf) || !validRef(item.iconLeaf) || !validRef(item.appId))
+                return false;
+            if (item.urlPrefix >= header.prefixCount || item.iconPrefix >= header.prefixCount)
+                return false;
+        }
+        for (std::uint32_t i = 0; i < header.sectionCount; i++) {
+            const auto& section = sectionRecords[i];
+            if (!validRef(section.id) || !validRef(section.title))
+                return false;
+            if ((std::uint64_t)section.firstItem + section.itemCount > header.sectionItemCount)
+                return false;
+        }
+        for (std::uint32_t i = 0; i < header.sectionItemCount; i++) {
+            if (sectionItems[i] >= header.itemCount)
+                return false;
+        }
+
+        // Everything is appended behind what the catalog already holds
+        std::uint32_t arenaBase = static_cast<std::uint32_t>(m_arena.size());
+        Index itemBase = static_cast<Index>(m_names.size());
+        m_arena.append(strings, header.stringsSize);
+
+        std::vector<std::uint32_t> prefixMap(header.prefixCount);
+        for (std::uint32_t i = 0; i < header.prefixCount; i++)
+            prefixMap[i] = this->InternPrefix(std::string(strings + prefixes[i].offset, prefixes[i].length));
+
+        std::size_t total = m_names.size() + header.itemCount;
+        m_names.reserve(total);
+        m_urlPrefixes.reserve(total);
+        m_urlLeaves.reserve(total);
+        m_iconPrefixes.reserve(total);
+        m_iconLeaves.reserve(total);
+        m_appIds.reserve(total);
+        m_sizes.reserve(total);
+        m_titleIds.reserve(total);
+        m_appVersions.reserve(total);
+        m_appTypes.reserve(total);
+        m_flags.reserve(total);
+
+        auto rebase = [&](const FileStringRef& ref) {
+            return StringRef{ref.offset + arenaBase, ref.length};
+        };
+        for (std::uint32_t i = 0; i < header.itemCount; i++) {
+            const auto& item = items[i];
+            m_names.push_back(rebase(item.name));
+            m_urlPrefixes.push_back(prefixMap[item.urlPrefix]);
+            m_urlLeaves.push_back(rebase(item.urlLeaf));
+            m_iconPrefixes.push_back(prefixMap[item.iconPrefix]);
+            m_iconLeaves.push_back(rebase(item.iconLeaf));
+            m_appIds.push_back(rebase(item.appId));
+            m_sizes.push_back(item.size);
+            m_titleIds.push_back(item.titleId);
+            m_appVersions.push_back(item.appVersion);
+            m_appTypes.push_back(item.appType);
+            m_flags.push_back(static_cast<std::uint8_t>(item.flags));
+        }
+
+        sections.clear();
+        sections.reserve(header.sectionCount);
+        for (std::uint32_t i = 0; i < header.sectionCount; i++) {
+            const auto& record = sectionRecords[i];
+            ShopSection section;
+            section.id.assign(strings + record.id.offset, record.id.length);
+            section.title.assign(strings + record.title.offset, record.title.length);
+            section.items.reserve(record.itemCount);
+            for (std::uint32_t j = 0; j < record.itemCount; j++)
+                section.items.push_back(sectionItems[record.firstItem + j] + itemBase);
+            sections.push_back(std::move(section));
+        }
+        return true;
+    }
+}
@@ -0,0 +1,428 @@
+#include "shopIcons.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <curl/curl.h>
+#include <filesystem>
+#include <fstream>
+#include "util/config.hpp"
+#include "util/error.hpp"
+#include "util/json.hpp"
+#include "util/network_util.hpp"
+
+namespace {
+    constexpr int kIconWorkers = 2;
+    constexpr std::size_t kMaxQueuedJobs = 64;
+    constexpr long kIconTimeoutMs = 8000;
+    constexpr int kIconRetryBaseSeconds = 30;
+    constexpr int kIconRetryMaxSeconds = 600;
+    // Index writes are batched, the index is only a hint and is rebuilt from the folder if lost
+    constexpr int kIndexSaveInterval = 16;
+
+    std::size_t WriteToString(char* ptr, std::size_t size, std::size_t nmemb, void* userdata)
+    {
+        auto* out = static_cast<std::string*>(userdata);
+        out->append(ptr, size * nmemb);
+        return size * nmemb;
+    }
+
+    int AbortIfStopping(void* userdata, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+    {
+        return static_cast<const std::atomic<bool>*>(userdata)->load() ? 1 : 0;
+    }
+
+    bool IsLikelyImage(const std::string& data)
+    {
+        const auto* buf = reinterpret_cast<const unsigned char*>(data.data());
+        if (data.size() >= 3 && buf[0] == 0xFF && buf[1] == 0xD8 && buf[2] == 0xFF)
+            return true;
+        if (data.size() >= 8 && std::memcmp(buf, "\x89PNG\r\n\x1a\n", 8) == 0)
+            return true;
+        if (data.size() >= 12 && std::memcmp(buf, "RIFF", 4) == 0 && std::memcmp(buf + 8, "WEBP", 4) == 0)
+            return true;
+        return false;
+    }
+}
+
+namespace shopInstStuff {
+    ShopIconService& ShopIconService::Get()
+    {
+        static ShopIconService service;
+        return service;
+    }
+
+    ShopIconService::~ShopIconService()
+    {
+        this->Stop();
+    }
+
+    void ShopIconService::Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+            m_jobs.clear();
+        }
+        m_jobCv.notify_all();
+        m_doneCv.notify_all();
+
+        // Nothing is queued once stopped, so the workers are never started again
+        std::vector<std::thread> workers = std::move(m_workers);
+        m_workers.clear();
+        for (auto& worker : workers)
+            worker.join();
+        if (!workers.empty())
+            curl_global_cleanup();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_unsavedChanges > 0)
+            this->SaveIndex();
+    }
+
+    std::string ShopIconService::GetCacheName(const std::string& iconUrl, bool hasTitleId, std::uint64_t titleId)
+    {
+        std::string ext = ".jpg";
+        auto queryPos = iconUrl.find('?');
+        std::string cleanPath = queryPos == std::string::npos ? iconUrl : iconUrl.substr(0, queryPos);
+        auto dotPos = cleanPath.find_last_of('.');
+        if (dotPos != std::string::npos) {
+            std::string suffix = cleanPath.substr(dotPos);
+            if (suffix.size() <= 5 && suffix.find('/') == std::string::npos)
+                ext = suffix;
+        }
+
+        if (hasTitleId)
+            return std::to_string(titleId) + ext;
+        return std::to_string(std::hash<std::string>{}(iconUrl)) + ext;
+    }
+
+    std::string ShopIconService::GetCacheDir() const
+    {
+        return inst::config::appDir + "/shop_icons";
+    }
+
+    // Folders from before the index existed are adopted as they are, oldest first to go is arbitrary
+    void ShopIconService::LoadIndex()
+    {
+        if (m_indexLoaded)
+            return;
+        m_indexLoaded = true;
+
+        std::error_code ec;
+        std::filesystem::create_directories(this->GetCacheDir(), ec);
+
+        std::ifstream in(this->GetCacheDir() + "/index.json", std::ios::binary);
+        bool loaded = false;
+        if (in) {
+            try {
+                nlohmann::json index = nlohmann::json::parse(in);
+                for (const auto& entry : index.at("entries")) {
+                    CacheEntry cacheEntry;
+                    cacheEntry.size = entry.at(1).get<std::uint64_t>();
+                    cacheEntry.lastUsed = entry.at(2).get<std::uint64_t>();
+                    m_entries[entry.at(0).get<std::string>()] = cacheEntry;
+                }
+                loaded = true;
+            }
+            catch (...) {
+                m_entries.clear();
+            }
+        }
+
+        if (!loaded) {
+            for (const auto& file : std::filesystem::directory_iterator(this->GetCacheDir(), ec)) {
+                if (!file.is_regular_file(ec) || file.path().filename() == "index.json")
+                    continue;
+                auto ext = file.path().extension();
+                if (ext == ".part" || ext == ".tmp") {
+                    std::filesystem::remove(file.path(), ec);
+                    continue;
+                }
+                CacheEntry cacheEntry;
+                cacheEntry.size = file.file_size(ec);
+                m_entries[file.path().filename().string()] = cacheEntry;
+            }
+            m_unsavedChanges++;
+        }
+
+        m_totalSize = 0;
+        for (const auto& entry : m_entries) {
+            m_totalSize += entry.second.size;
+            m_useCounter = std::max(m_useCounter, entry.second.lastUsed);
+        }
+        LOG_DEBUG("Icon cache: %zu icons, %llu bytes\n", m_entries.size(), (unsigned long long)m_totalSize);
+    }
+
+    void ShopIconService::SaveIndex()
+    {
+        nlohmann::json entries = nlohmann::json::array();
+        for (const auto& entry : m_entries)
+            entries.push_back({entry.first, entry.second.size, entry.second.lastUsed});
+        nlohmann::json index = {{"entries", entries}};
+
+        std::string path = this->GetCacheDir() + "/index.json";
+        std::string tmpPath = path + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return;
+            out << index.dump();
+            if (!out)
+                return;
+        }
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        std::filesystem::rename(tmpPath, path, ec);
+        m_unsavedChanges = 0;
+    }
+
+    void ShopIconService::Touch(const std::string& cacheName)
+    {
+        auto it = m_entries.find(cacheName);
+        if (it == m_entries.end())
+            return;
+        it->second.lastUsed = ++m_useCounter;
+        m_unsavedChanges++;
+    }
+
+    void ShopIconService::AddEntry(const std::string& cacheName, std::uint64_t size)
+    {
+        auto& entry = m_entries[cacheName];
+        m_totalSize -= entry.size;
+        entry.size = size;
+        entry.lastUsed = ++m_useCounter;
+        m_totalSize += size;
+
+        const std::uint64_t cap = (std::uint64_t)std::max(inst::config::shopIconCacheMB, 1) * 1024 * 1024;
+        while (m_totalSize > cap && m_entries.size() > 1) {
+            auto oldest = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& a, const auto& b) {
+                return a.second.lastUsed < b.second.lastUsed;
+            });
+            std::error_code ec;
+            std::filesystem::remove(this->GetCacheDir() + "/" + oldest->first, ec);
+            m_totalSize -= oldest->second.size;
+            m_entries.erase(oldest);
+        }
+
+        if (++m_unsavedChanges >= kIndexSaveInterval)
+            this->SaveIndex();
+    }
+
+    std::string ShopIconService::Lookup(const std::string& cacheName)
+    {
+        this->LoadIndex();
+        auto it = m_entries.find(cacheName);
+        if (it == m_entries.end())
+            return "";
+
+        std::string path = this->GetCacheDir() + "/" + cacheName;
+        std::error_code ec;
+        if (!std::filesystem::exists(path, ec)) {
+            m_totalSize -= it->second.size;
+            m_entries.erase(it);
+            m_unsavedChanges++;
+            return "";
+        }
+        return path;
+    }
+
+    void ShopIconService::Enqueue(const Job& job)
+    {
+        if (m_workers.empty()) {
+            curl_global_init(CURL_GLOBAL_ALL);
+            for (int i = 0; i < kIconWorkers; i++)
+                m_workers.emplace_back(&ShopIconService::WorkerMain, this);
+        }
+
+        if (m_inFlight.count(job.cacheName))
+            return;
+
+        auto queued = std::find_if(m_jobs.begin(), m_jobs.end(), [&](const Job& entry) {
+            return entry.cacheName == job.cacheName;
+        });
+        if (queued != m_jobs.end()) {
+            if (job.priority == Priority::Prefetch)
+                return;
+            m_jobs.erase(queued);
+        }
+
+        if (job.priority == Priority::Visible)
+            m_jobs.push_front(job);
+        else
+            m_jobs.push_back(job);
+
+        // Over the limit the oldest prefetches go, what's on screen is always fetched
+        while (m_jobs.size() > kMaxQueuedJobs) {
+            auto oldest = std::find_if(m_jobs.begin(), m_jobs.end(), [](const Job& entry) {
+                return entry.priority == Priority::Prefetch;
+            });
+            if (oldest == m_jobs.end())
+                break;
+            m_jobs.erase(oldest);
+        }
+        m_jobCv.notify_one();
+    }
+
+    std::string ShopIconService::Request(const std::string& iconUrl, const std::string& cacheName, Priority priority)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string path = this->Lookup(cacheName);
+        if (!path.empty()) {
+            this->Touch(cacheName);
+            return path;
+        }
+
+        if (!m_stop && !this->IsFailed(iconUrl))
+            this->Enqueue({iconUrl, cacheName, priority});
+        return "";
+    }
+
+    std::string ShopIconService::Wait(const std::string& iconUrl, const std::string& cacheName, int timeoutMs)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::string path = this->Lookup(cacheName);
+        if (!path.empty()) {
+            this->Touch(cacheName);
+            return path;
+        }
+        if (m_stop)
+            return "";
+
+        // Asked for explicitly, so an earlier failure gets another go
+        m_failed.erase(iconUrl);
+        this->Enqueue({iconUrl, cacheName, Priority::Visible});
+        m_doneCv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]() {
+            return m_stop || this->IsFailed(iconUrl) || !this->Lookup(cacheName).empty();
+        });
+        return this->Lookup(cacheName);
+    }
+
+    void ShopIconService::CancelPrefetch()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.erase(std::remove_if(m_jobs.begin(), m_jobs.end(), [](const Job& job) {
+            return job.priority == Priority::Prefetch;
+        }), m_jobs.end());
+    }
+
+    void ShopIconService::ClearFailures()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_failed.clear();
+    }
+
+    bool ShopIconService::IsFailed(const std::string& iconUrl)
+    {
+        auto found = m_failed.find(iconUrl);
+        if (found == m_failed.end())
+            return false;
+        return std::chrono::steady_clock::now() < found->second.retryAt;
+    }
+
+    std::uint64_t ShopIconService::GetGeneration()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_generation;
+    }
+
+    void ShopIconService::WorkerMain()
+    {
+        // One handle per worker for its whole life, so connections to the shop are reused
+        CURL* curl = curl_easy_init();
+
+        while (curl) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_jobCv.wait(lock, [&]() { return m_stop || !m_jobs.empty(); });
+                if (m_stop)
+                    break;
+                job = m_jobs.front();
+                m_jobs.pop_front();
+                if (!this->Lookup(job.cacheName).empty() || m_inFlight.count(job.cacheName))
+                    continue;
+                m_inFlight.insert(job.cacheName);
+            }
+
+            bool ok = this->Download(curl, job);
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_inFlight.erase(job.cacheName);
+                if (ok) {
+                    m_generation++;
+                    m_failed.erase(job.url);
+                } else {
+                    auto& failure = m_failed[job.url];
+                    int delay = std::min(kIconRetryBaseSeconds << std::min(failure.count, 5), kIconRetryMaxSeconds);
+                    failure.count++;
+                    failure.retryAt = std::chrono::steady_clock::now() + std::chrono::seconds(delay);
+                }
+            }
+            m_doneCv.notify_all();
+        }
+
+        if (curl)
+            curl_easy_cleanup(curl);
+    }
+
+    bool ShopIconService::Download(void* handle, const Job& job)
+    {
+        CURL* curl = static_cast<CURL*>(handle);
+        std::string data;
+        curl_easy_reset(curl);
+        curl_easy_setopt(curl, CURLOPT_URL, job.url.c_str());
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, "Awoo-Installer");
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, kIconTimeoutMs);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, kIconTimeoutMs);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteToString);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &data);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, AbortIfStopping);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &m_stop);
+
+        std::string authValue;
+        if (tin::network::GetBasicAuth(job.url, authValue)) {
+            curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+            curl_easy_setopt(curl, CURLOPT_USERPWD, authValue.c_str());
+        }
+
+        CURLcode rc = curl_easy_perform(curl);
+        long responseCode = 0;
+        char* contentType = nullptr;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+        curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &contentType);
+
+        bool ok = rc == CURLE_OK && responseCode >= 200 && responseCode < 300 && !data.empty();
+        if (ok)
+            ok = (contentType && std::strncmp(contentType, "image/", 6) == 0) || IsLikelyImage(data);
+        if (!ok) {
+            LOG_DEBUG("Icon download failed: %s (%ld) %s\n", job.url.c_str(), responseCode, curl_easy_strerror(rc));
+            return false;
+        }
+
+        // Written aside and renamed, so a half written icon is never picked up
+        std::string path = this->GetCacheDir() + "/" + job.cacheName;
+        std::string tmpPath = path + ".part";
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+            out.write(data.data(), data.size());
+            if (!out)
+                return false;
+        }
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        std::filesystem::rename(tmpPath, path, ec);
+        if (ec)
+            return false;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        this->AddEntry(job.cacheName, data.size());
+        return true;
+    }
+}
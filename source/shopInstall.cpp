@@ -1,13 +1,21 @@
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <chrono>
+#include <condition_variable>
 #include <cstdlib>
+#include <deque>
 #include <curl/curl.h>
 #include <filesystem>
 #include <fstream>
+#include <map>
+#include <numeric>
+#include <mutex>
 #include <sstream>
 #include <thread>
+#include <unordered_set>
 #include "shopInstall.hpp"
+#include "shopIcons.hpp"
 #include "install/http_nsp.hpp"
 #include "install/http_xci.hpp"
 #include "install/install.hpp"
@@ -16,7 +24,6 @@
 #include "ui/MainApplication.hpp"
 #include "ui/instPage.hpp"
 #include "util/config.hpp"
-#include "util/curl.hpp"
 #include "util/error.hpp"
 #include "util/json.hpp"
 #include "util/lang.hpp"
@@ -28,13 +35,6 @@ namespace inst::ui {
 }
 
 namespace {
-    size_t WriteToString(char* ptr, size_t size, size_t numItems, void* userdata)
-    {
-        auto out = reinterpret_cast<std::string*>(userdata);
-        out->append(ptr, size * numItems);
-        return size * numItems;
-    }
-
     std::string NormalizeShopUrl(std::string url)
     {
         url.erase(0, url.find_first_not_of(" \t\r\n"));
@@ -50,15 +50,12 @@ namespace {
 
     std::string DecodeUrlSegment(const std::string& value)
     {
-        CURL* curl = curl_easy_init();
-        if (!curl)
-            return value;
+        // curl doesn't need a handle for this, creating one per item was most of the parse time
         int outLength = 0;
-        char* decoded = curl_easy_unescape(curl, value.c_str(), value.size(), &outLength);
+        char* decoded = curl_easy_unescape(nullptr, value.c_str(), value.size(), &outLength);
         std::string result = decoded ? std::string(decoded, outLength) : value;
         if (decoded)
             curl_free(decoded);
-        curl_easy_cleanup(curl);
         return result;
     }
 
@@ -106,33 +103,6 @@ namespace {
         return baseUrl + "/" + urlPath;
     }
 
-    std::string GetShopIconCachePath(const shopInstStuff::ShopItem& item)
-    {
-        if (!item.hasIconUrl)
-            return "";
-        std::string cacheDir = inst::config::appDir + "/shop_icons";
-        if (!std::filesystem::exists(cacheDir))
-            std::filesystem::create_directory(cacheDir);
-
-        std::string urlPath = item.iconUrl;
-        std::string ext = ".jpg";
-        auto queryPos = urlPath.find('?');
-        std::string cleanPath = queryPos == std::string::npos ? urlPath : urlPath.substr(0, queryPos);
-        auto dotPos = cleanPath.find_last_of('.');
-        if (dotPos != std::string::npos) {
-            std::string suffix = cleanPath.substr(dotPos);
-            if (suffix.size() <= 5 && suffix.find('/') == std::string::npos && suffix.find('?') == std::string::npos)
-                ext = suffix;
-        }
-
-        std::string fileName;
-        if (item.hasTitleId)
-            fileName = std::to_string(item.titleId);
-        else
-            fileName = std::to_string(std::hash<std::string>{}(item.iconUrl));
-        return cacheDir + "/" + fileName + ext;
-    }
-
     void UpdateInstallIcon(const shopInstStuff::ShopItem& item)
     {
         if (!item.hasIconUrl) {
@@ -140,19 +110,9 @@ namespace {
             return;
         }
 
-        std::string filePath = GetShopIconCachePath(item);
-        if (filePath.empty()) {
-            inst::ui::instPage::clearInstallIcon();
-            return;
-        }
-
-        if (!std::filesystem::exists(filePath)) {
-            bool ok = inst::curl::downloadImageWithAuth(item.iconUrl, filePath.c_str(), inst::config::shopUser, inst::config::shopPass, 8000);
-            if (!ok && std::filesystem::exists(filePath))
-                std::filesystem::remove(filePath);
-        }
-
-        if (std::filesystem::exists(filePath))
+        auto cacheName = shopInstStuff::ShopIconService::GetCacheName(item.iconUrl, item.hasTitleId, item.titleId);
+        std::string filePath = shopInstStuff::ShopIconService::Get().Wait(item.iconUrl, cacheName, 8000);
+        if (!filePath.empty())
             inst::ui::instPage::setInstallIcon(filePath);
         else
             inst::ui::instPage::clearInstallIcon();
@@ -160,46 +120,116 @@ namespace {
 
     constexpr int kShopCacheTtlSeconds = 300;
 
+    // Validators the server sent with the cached body, echoed back on the next request so an
+    // unchanged shop answers 304 instead of resending the whole listing.
+    struct ShopCacheValidators {
+        std::string etag;
+        std::string lastModified;
+    };
+
+    // Guards the cache files, the background revalidation writes them too
+    std::mutex g_shopCacheMutex;
+
     std::string GetShopCachePath(const std::string& baseUrl)
+    {
+        std::size_t hash = std::hash<std::string>{}(baseUrl);
+        return inst::config::appDir + "/shop_cache_" + std::to_string(hash) + ".bin";
+    }
+
+    std::string GetShopCacheLegacyPath(const std::string& baseUrl)
     {
         std::size_t hash = std::hash<std::string>{}(baseUrl);
         return inst::config::appDir + "/shop_cache_" + std::to_string(hash) + ".json";
     }
 
-    bool LoadShopCache(const std::string& baseUrl, std::string& body, bool& fresh)
+    std::string GetShopCacheMetaPath(const std::string& baseUrl)
+    {
+        std::size_t hash = std::hash<std::string>{}(baseUrl);
+        return inst::config::appDir + "/shop_cache_" + std::to_string(hash) + ".meta.json";
+    }
+
+    std::int64_t GetUnixTime()
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    void WriteShopCacheMeta(const std::string& baseUrl, const ShopCacheValidators& validators)
     {
+        nlohmann::json meta = {
+            {"etag", validators.etag},
+            {"last_modified", validators.lastModified},
+            {"checked_at", GetUnixTime()},
+        };
+        std::string path = GetShopCacheMetaPath(baseUrl);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (out)
+            out << meta.dump();
+    }
+
+    // Reads the validators and the age of the cached catalog, the catalog itself is only loaded
+    // once it is known to be usable
+    bool LoadShopCacheMeta(const std::string& baseUrl, ShopCacheValidators& validators, bool& fresh)
+    {
+        std::lock_guard<std::mutex> lock(g_shopCacheMutex);
         fresh = false;
+        validators = ShopCacheValidators();
         std::string path = GetShopCachePath(baseUrl);
         if (!std::filesystem::exists(path))
             return false;
 
-        std::ifstream in(path, std::ios::binary);
-        if (!in)
-            return false;
-        std::ostringstream ss;
-        ss << in.rdbuf();
-        body = ss.str();
-        if (body.empty())
-            return false;
-
-        auto ftime = std::filesystem::last_write_time(path);
-        auto now = std::chrono::system_clock::now();
-        auto ftime_sys = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-            ftime - std::filesystem::file_time_type::clock::now() + now);
-        auto age = std::chrono::duration_cast<std::chrono::seconds>(now - ftime_sys).count();
+        // The last successful check counts as the cache age, a 304 renews it without rewriting the catalog
+        std::int64_t age = -1;
+        std::ifstream metaIn(GetShopCacheMetaPath(baseUrl), std::ios::binary);
+        if (metaIn) {
+            try {
+                nlohmann::json meta = nlohmann::json::parse(metaIn);
+                validators.etag = meta.value("etag", "");
+                validators.lastModified = meta.value("last_modified", "");
+                age = GetUnixTime() - meta.value("checked_at", (std::int64_t)0);
+            }
+            catch (...) {
+                validators = ShopCacheValidators();
+            }
+        }
+        if (age < 0) {
+            auto ftime = std::filesystem::last_write_time(path);
+            auto now = std::chrono::system_clock::now();
+            auto ftime_sys = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+                ftime - std::filesystem::file_time_type::clock::now() + now);
+            age = std::chrono::duration_cast<std::chrono::seconds>(now - ftime_sys).count();
+        }
         fresh = age >= 0 && age <= kShopCacheTtlSeconds;
         return true;
     }
 
-    void SaveShopCache(const std::string& baseUrl, const std::string& body)
+    std::vector<shopInstStuff::ShopSection> LoadShopCache(const std::string& baseUrl, shopInstStuff::ShopCatalog& catalog)
     {
-        if (body.empty())
+        std::lock_guard<std::mutex> lock(g_shopCacheMutex);
+        std::vector<shopInstStuff::ShopSection> sections;
+        if (!catalog.Load(GetShopCachePath(baseUrl), sections))
+            sections.clear();
+        return sections;
+    }
+
+    void SaveShopCache(const std::string& baseUrl, const shopInstStuff::ShopCatalog& catalog, const std::vector<shopInstStuff::ShopSection>& sections, const ShopCacheValidators& validators)
+    {
+        if (sections.empty())
             return;
-        std::string path = GetShopCachePath(baseUrl);
-        std::ofstream out(path, std::ios::binary | std::ios::trunc);
-        if (!out)
+        std::lock_guard<std::mutex> lock(g_shopCacheMutex);
+        if (!catalog.Save(GetShopCachePath(baseUrl), sections))
             return;
-        out << body;
+        WriteShopCacheMeta(baseUrl, validators);
+
+        // Left behind by versions that cached the raw json body
+        std::error_code ec;
+        std::filesystem::remove(GetShopCacheLegacyPath(baseUrl), ec);
+    }
+
+    // The server confirmed the cached body is current
+    void RenewShopCache(const std::string& baseUrl, const ShopCacheValidators& validators)
+    {
+        std::lock_guard<std::mutex> lock(g_shopCacheMutex);
+        WriteShopCacheMeta(baseUrl, validators);
     }
 
     bool TryParseTitleId(const nlohmann::json& entry, std::uint64_t& out);
@@ -300,112 +330,384 @@ namespace {
         return false;
     }
 
-    std::vector<shopInstStuff::ShopSection> ParseShopSectionsBody(const std::string& body, const std::string& baseUrl, std::string& error)
+    // Turns one entry of a shop listing into an item. Sections carry names and title metadata,
+    // the plain file list only has urls.
+    bool BuildShopItem(const nlohmann::json& entry, const std::string& baseUrl, bool withMetadata, shopInstStuff::ShopItem& out)
     {
-        std::vector<shopInstStuff::ShopSection> sections;
-        try {
-            nlohmann::json shop = nlohmann::json::parse(body);
-            if (!shop.contains("sections") || !shop["sections"].is_array()) {
-                error = "Shop response missing sections.";
-                return sections;
+        if (!entry.contains("url") || !entry["url"].is_string())
+            return false;
+        std::string url = entry["url"].get<std::string>();
+        std::uint64_t size = 0;
+        if (entry.contains("size") && entry["size"].is_number()) {
+            size = entry["size"].get<std::uint64_t>();
+        }
+
+        std::string fragment;
+        std::string urlPath = url;
+        auto hashPos = urlPath.find('#');
+        if (hashPos != std::string::npos) {
+            fragment = urlPath.substr(hashPos + 1);
+            urlPath = urlPath.substr(0, hashPos);
+        }
+
+        std::string fullUrl = BuildFullUrl(baseUrl, urlPath);
+
+        std::string name;
+        if (withMetadata && entry.contains("name") && entry["name"].is_string()) {
+            name = entry["name"].get<std::string>();
+        } else if (!fragment.empty()) {
+            name = DecodeUrlSegment(fragment);
+        } else {
+            name = inst::util::formatUrlString(fullUrl);
+        }
+
+        if (fullUrl.empty() || name.empty())
+            return false;
+
+        shopInstStuff::ShopItem item{name, fullUrl, "", "", size};
+        if (withMetadata) {
+            std::uint64_t titleId = 0;
+            std::uint32_t appVersion = 0;
+            std::int32_t appType = -1;
+            if (TryParseTitleId(entry, titleId)) {
+                item.titleId = titleId;
+                item.hasTitleId = true;
+            }
+            if (TryParseAppVersion(entry, appVersion)) {
+                item.appVersion = appVersion;
+                item.hasAppVersion = true;
+            }
+            if (TryParseAppType(entry, appType))
+                item.appType = appType;
+            if (entry.contains("app_id") && entry["app_id"].is_string()) {
+                item.appId = entry["app_id"].get<std::string>();
+                item.hasAppId = !item.appId.empty();
+            }
+            if (entry.contains("icon_url") && entry["icon_url"].is_string()) {
+                std::string iconUrl = entry["icon_url"].get<std::string>();
+                if (!iconUrl.empty()) {
+                    item.iconUrl = BuildFullUrl(baseUrl, iconUrl);
+                    item.hasIconUrl = true;
+                }
+            } else if (entry.contains("iconUrl") && entry["iconUrl"].is_string()) {
+                std::string iconUrl = entry["iconUrl"].get<std::string>();
+                if (!iconUrl.empty()) {
+                    item.iconUrl = BuildFullUrl(baseUrl, iconUrl);
+                    item.hasIconUrl = true;
+                }
             }
+        }
 
-            for (const auto& section : shop["sections"]) {
-                if (!section.contains("items") || !section["items"].is_array())
-                    continue;
-                shopInstStuff::ShopSection parsed;
-                parsed.id = section.value("id", "all");
-                parsed.title = section.value("title", "All");
-                for (const auto& entry : section["items"]) {
-                    if (!entry.contains("url"))
-                        continue;
-                    std::string url = entry["url"].get<std::string>();
-                    std::uint64_t size = 0;
-                    if (entry.contains("size") && entry["size"].is_number()) {
-                        size = entry["size"].get<std::uint64_t>();
-                    }
+        out = std::move(item);
+        return true;
+    }
 
-                    std::string fragment;
-                    std::string urlPath = url;
-                    auto hashPos = urlPath.find('#');
-                    if (hashPos != std::string::npos) {
-                        fragment = urlPath.substr(hashPos + 1);
-                        urlPath = urlPath.substr(0, hashPos);
-                    }
+    // SAX handler for shop responses. Items are built as soon as their object closes and go straight
+    // into the catalog, only the entry being parsed is ever held as a json value.
+    class ShopJsonParser : public nlohmann::json_sax<nlohmann::json>
+    {
+        public:
+            enum class Mode { Sections, Files, Motd };
+
+            std::vector<shopInstStuff::ShopSection> sections;
+            std::vector<shopInstStuff::ShopCatalog::Index> items;
+            std::string error;
+            std::string success;
+            bool hasSections = false;
+            bool hasFiles = false;
+
+            ShopJsonParser(Mode mode, const std::string& baseUrl, shopInstStuff::ShopCatalog* catalog) : m_mode(mode), m_baseUrl(baseUrl), m_catalog(catalog) {}
+
+            bool null() override { return this->Value(nullptr); }
+            bool boolean(bool val) override { return this->Value(val); }
+            bool number_integer(number_integer_t val) override { return this->Value(val); }
+            bool number_unsigned(number_unsigned_t val) override { return this->Value(val); }
+            bool number_float(number_float_t val, const string_t&) override { return this->Value(val); }
+            bool string(string_t& val) override { return this->Value(std::move(val)); }
+            bool binary(binary_t&) override { return true; }
+
+            bool key(string_t& val) override
+            {
+                m_key = val;
+                return true;
+            }
 
-                    std::string fullUrl = BuildFullUrl(baseUrl, urlPath);
+            bool start_object(std::size_t) override
+            {
+                Level level = Level::Other;
+                if (m_stack.empty())
+                    level = Level::Root;
+                else if (m_stack.back().level == Level::Files)
+                    level = Level::Item;
+                else if (m_stack.back().level == Level::Sections)
+                    level = Level::Section;
+                else if (m_stack.back().level == Level::SectionItems)
+                    level = Level::Item;
+
+                if (level == Level::Item)
+                    m_entry = nlohmann::json::object();
+                else if (level == Level::Section)
+                    m_section = shopInstStuff::ShopSection{"all", "All", {}};
+
+                m_stack.push_back({level});
+                return true;
+            }
 
-                    std::string name;
-                    if (entry.contains("name")) {
-                        name = entry["name"].get<std::string>();
-                    } else if (!fragment.empty()) {
-                        name = DecodeUrlSegment(fragment);
-                    } else {
-                        name = inst::util::formatUrlString(fullUrl);
+            bool end_object() override
+            {
+                Level level = m_stack.back().level;
+                m_stack.pop_back();
+
+                if (level == Level::Item) {
+                    shopInstStuff::ShopItem item;
+                    if (m_catalog && BuildShopItem(m_entry, m_baseUrl, m_mode == Mode::Sections, item)) {
+                        auto index = m_catalog->Add(item);
+                        if (m_mode == Mode::Sections)
+                            m_section.items.push_back(index);
+                        else
+                            items.push_back(index);
                     }
+                    m_entry = nullptr;
+                } else if (level == Level::Section && !m_section.items.empty()) {
+                    sections.push_back(std::move(m_section));
+                }
+                return true;
+            }
 
-                    if (!fullUrl.empty() && !name.empty()) {
-                        shopInstStuff::ShopItem item{name, fullUrl, "", "", size};
-                        std::uint64_t titleId = 0;
-                        std::uint32_t appVersion = 0;
-                        std::int32_t appType = -1;
-                        if (TryParseTitleId(entry, titleId)) {
-                            item.titleId = titleId;
-                            item.hasTitleId = true;
-                        }
-                        if (TryParseAppVersion(entry, appVersion)) {
-                            item.appVersion = appVersion;
-                            item.hasAppVersion = true;
-                        }
-                        if (TryParseAppType(entry, appType))
-                            item.appType = appType;
-                        if (entry.contains("app_id") && entry["app_id"].is_string()) {
-                            item.appId = entry["app_id"].get<std::string>();
-                            item.hasAppId = !item.appId.empty();
-                        }
-                        if (entry.contains("icon_url") && entry["icon_url"].is_string()) {
-                            std::string iconUrl = entry["icon_url"].get<std::string>();
-                            if (!iconUrl.empty()) {
-                                item.iconUrl = BuildFullUrl(baseUrl, iconUrl);
-                                item.hasIconUrl = true;
-                            }
-                        } else if (entry.contains("iconUrl") && entry["iconUrl"].is_string()) {
-                            std::string iconUrl = entry["iconUrl"].get<std::string>();
-                            if (!iconUrl.empty()) {
-                                item.iconUrl = BuildFullUrl(baseUrl, iconUrl);
-                                item.hasIconUrl = true;
-                            }
-                        }
-                        parsed.items.push_back(item);
-                    }
+            bool start_array(std::size_t) override
+            {
+                Level level = Level::Other;
+                Level parent = m_stack.empty() ? Level::Other : m_stack.back().level;
+                if (parent == Level::Root && m_key == "sections" && m_mode == Mode::Sections) {
+                    level = Level::Sections;
+                    hasSections = true;
+                } else if (parent == Level::Root && m_key == "files" && m_mode == Mode::Files) {
+                    level = Level::Files;
+                    hasFiles = true;
+                } else if (parent == Level::Section && m_key == "items") {
+                    level = Level::SectionItems;
+                }
+
+                m_stack.push_back({level});
+                return true;
+            }
+
+            bool end_array() override
+            {
+                m_stack.pop_back();
+                return true;
+            }
+
+            bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override
+            {
+                return false;
+            }
+
+        private:
+            enum class Level { Root, Files, Sections, Section, SectionItems, Item, Other };
+
+            struct Frame
+            {
+                Level level;
+            };
+
+            Mode m_mode;
+            std::string m_baseUrl;
+            shopInstStuff::ShopCatalog* m_catalog;
+            std::vector<Frame> m_stack;
+            std::string m_key;
+            nlohmann::json m_entry;
+            shopInstStuff::ShopSection m_section;
+
+            bool Value(nlohmann::json value)
+            {
+                if (m_stack.empty())
+                    return true;
+
+                Level level = m_stack.back().level;
+                if (level == Level::Item) {
+                    m_entry[m_key] = std::move(value);
+                } else if (level == Level::Section && value.is_string()) {
+                    if (m_key == "id")
+                        m_section.id = value.get<std::string>();
+                    else if (m_key == "title")
+                        m_section.title = value.get<std::string>();
+                } else if (level == Level::Root && value.is_string()) {
+                    if (m_key == "error")
+                        error = value.get<std::string>();
+                    else if (m_key == "success")
+                        success = value.get<std::string>();
+                }
+                return true;
+            }
+    };
+
+    // Hands the response to the parser thread while curl is still receiving it. Data consumed by
+    // the parser is dropped, and once the parser gives up everything else is discarded too.
+    class ShopStreamBuf : public std::streambuf
+    {
+        public:
+            void Push(const char* data, std::size_t size)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_abandoned)
+                        return;
+                    m_pending.append(data, size);
+                }
+                m_cv.notify_one();
+            }
+
+            void Finish()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_finished = true;
                 }
+                m_cv.notify_one();
+            }
+
+            void Abandon()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_abandoned = true;
+                m_pending = std::string();
+            }
 
-                if (!parsed.items.empty())
-                    sections.push_back(parsed);
+        protected:
+            int_type underflow() override
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [&]() { return !m_pending.empty() || m_finished; });
+                if (m_pending.empty())
+                    return traits_type::eof();
+
+                m_current.swap(m_pending);
+                m_pending.clear();
+                setg(m_current.data(), m_current.data(), m_current.data() + m_current.size());
+                return traits_type::to_int_type(*gptr());
             }
+
+        private:
+            std::mutex m_mutex;
+            std::condition_variable m_cv;
+            std::string m_pending;
+            std::string m_current;
+            bool m_finished = false;
+            bool m_abandoned = false;
+    };
+
+    // A streamed body is parsed as it arrives, only its start is kept to tell a login page or an
+    // encrypted listing apart from JSON
+    constexpr std::size_t kShopSniffBytes = 4096;
+
+    struct ShopResponseSink
+    {
+        std::string* body;
+        ShopStreamBuf* stream;
+    };
+
+    size_t WriteToShopSink(char* ptr, size_t size, size_t numItems, void* userdata)
+    {
+        auto sink = reinterpret_cast<ShopResponseSink*>(userdata);
+        std::size_t total = size * numItems;
+        if (!sink->stream) {
+            sink->body->append(ptr, total);
+            return total;
+        }
+        if (sink->body->size() < kShopSniffBytes)
+            sink->body->append(ptr, std::min(total, kShopSniffBytes - sink->body->size()));
+        sink->stream->Push(ptr, total);
+        return total;
+    }
+
+    template <typename Input>
+    bool RunShopParser(ShopJsonParser& parser, Input&& in)
+    {
+        try {
+            return nlohmann::json::sax_parse(std::forward<Input>(in), &parser);
         }
         catch (...) {
+            return false;
+        }
+    }
+
+    std::vector<shopInstStuff::ShopSection> FinishShopSections(ShopJsonParser& parser, bool parsed, std::string& error)
+    {
+        if (!parsed) {
             error = "Invalid shop response.";
             return {};
         }
+        if (!parser.hasSections) {
+            error = "Shop response missing sections.";
+            return {};
+        }
+        return std::move(parser.sections);
+    }
 
-        return sections;
+    std::vector<shopInstStuff::ShopSection> ParseShopSectionsBody(const std::string& body, const std::string& baseUrl, shopInstStuff::ShopCatalog& catalog, std::string& error)
+    {
+        ShopJsonParser parser(ShopJsonParser::Mode::Sections, baseUrl, &catalog);
+        bool parsed = RunShopParser(parser, body);
+        return FinishShopSections(parser, parsed, error);
     }
 }
 
 namespace shopInstStuff {
     struct FetchResult {
+        // Only the first kShopSniffBytes when a parser was passed in
         std::string body;
         long responseCode = 0;
         std::string effectiveUrl;
         std::string contentType;
         std::string error;
+        ShopCacheValidators validators;
+        // Seconds until the response started to arrive (curl's start transfer time), connecting included
+        double startTransferTime = 0.0;
+        // Only meaningful when a parser was passed in
+        bool parsed = false;
     };
 
-    FetchResult FetchShopResponse(const std::string& url, const std::string& user, const std::string& pass)
+    std::size_t ReadShopHeader(char* buffer, std::size_t size, std::size_t nitems, void* userdata)
+    {
+        auto* validators = static_cast<ShopCacheValidators*>(userdata);
+        std::size_t total = size * nitems;
+        std::string line(buffer, total);
+        // A new status line means a redirect was followed, only the final response counts
+        if (line.rfind("HTTP/", 0) == 0) {
+            *validators = ShopCacheValidators();
+            return total;
+        }
+
+        auto colon = line.find(':');
+        if (colon == std::string::npos)
+            return total;
+        std::string name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        std::string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r\n") + 1);
+
+        if (name == "etag")
+            validators->etag = value;
+        else if (name == "last-modified")
+            validators->lastModified = value;
+        return total;
+    }
+
+    int AbortShopTransfer(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+    {
+        // Non-zero makes curl give up with CURLE_ABORTED_BY_CALLBACK
+        return static_cast<const std::atomic<bool>*>(clientp)->load() ? 1 : 0;
+    }
+
+    // When given a parser, the body is parsed on a second thread as it arrives. When given the
+    // validators of a cached copy, the request is conditional and may come back as a bodiless 304.
+    // Setting cancel aborts the transfer. Credentials are the ones registered for the url's shop.
+    FetchResult FetchShopResponse(const std::string& url, ShopJsonParser* parser = nullptr, const ShopCacheValidators* cached = nullptr, const std::atomic<bool>* cancel = nullptr)
     {
         FetchResult result;
-        CURL* curl = curl_easy_init();
+        CURL* curl = tin::network::AcquireCurl();
         if (!curl) {
             result.error = "Failed to initialize curl.";
             return result;
@@ -415,39 +717,67 @@ namespace shopInstStuff {
         curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
         curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
         curl_easy_setopt(curl, CURLOPT_USERAGENT, "tinfoil");
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteToString);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &result.body);
+        ShopStreamBuf stream;
+        ShopResponseSink sink{&result.body, parser ? &stream : nullptr};
+        std::thread parserThread;
+        if (parser) {
+            parserThread = std::thread([&]() {
+                std::istream in(&stream);
+                result.parsed = RunShopParser(*parser, in);
+                stream.Abandon();
+            });
+        }
+
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteToShopSink);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sink);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, ReadShopHeader);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &result.validators);
         curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 15000L);
         curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, 5000L);
+        if (cancel) {
+            curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, AbortShopTransfer);
+            curl_easy_setopt(curl, CURLOPT_XFERINFODATA, cancel);
+            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        }
 
         struct curl_slist* headerList = nullptr;
-        const auto headers = BuildTinfoilHeaders();
+        auto headers = BuildTinfoilHeaders();
+        if (cached) {
+            if (!cached->etag.empty())
+                headers.push_back("If-None-Match: " + cached->etag);
+            if (!cached->lastModified.empty())
+                headers.push_back("If-Modified-Since: " + cached->lastModified);
+        }
         for (const auto& header : headers)
             headerList = curl_slist_append(headerList, header.c_str());
         if (headerList)
             curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerList);
 
         std::string authValue;
-        if (!user.empty() || !pass.empty()) {
-            authValue = user + ":" + pass;
+        if (tin::network::GetBasicAuth(url, authValue)) {
             curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
             curl_easy_setopt(curl, CURLOPT_USERPWD, authValue.c_str());
         }
 
         CURLcode rc = curl_easy_perform(curl);
+        if (parser) {
+            stream.Finish();
+            parserThread.join();
+        }
         long responseCode = 0;
         char* effectiveUrl = nullptr;
         char* contentType = nullptr;
         curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
         curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effectiveUrl);
         curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &contentType);
-        if (headerList)
-            curl_slist_free_all(headerList);
-        curl_easy_cleanup(curl);
-
+        curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &result.startTransferTime);
         result.responseCode = responseCode;
         result.effectiveUrl = effectiveUrl ? effectiveUrl : "";
         result.contentType = contentType ? contentType : "";
+        // The strings above belong to the handle, copied before it goes back to the pool
+        if (headerList)
+            curl_slist_free_all(headerList);
+        tin::network::ReleaseCurl(curl);
 
         if (rc != CURLE_OK) {
             result.error = curl_easy_strerror(rc);
@@ -456,6 +786,28 @@ namespace shopInstStuff {
         return result;
     }
 
+    // Start transfer times of the shops reached this session, used to order them when merging
+    std::mutex g_shopLatencyMutex;
+    std::unordered_map<std::string, double> g_shopLatency;
+
+    void RecordShopLatency(const std::string& baseUrl, const FetchResult& fetch)
+    {
+        if (!fetch.error.empty() || fetch.responseCode == 0 || fetch.startTransferTime <= 0.0)
+            return;
+        std::lock_guard<std::mutex> lock(g_shopLatencyMutex);
+        g_shopLatency[baseUrl] = fetch.startTransferTime;
+    }
+
+    bool GetShopLatency(const std::string& baseUrl, double& latency)
+    {
+        std::lock_guard<std::mutex> lock(g_shopLatencyMutex);
+        auto found = g_shopLatency.find(baseUrl);
+        if (found == g_shopLatency.end())
+            return false;
+        latency = found->second;
+        return true;
+    }
+
     bool ValidateShopResponse(const FetchResult& fetch, std::string& error)
     {
         if (!fetch.error.empty()) {
@@ -477,9 +829,9 @@ namespace shopInstStuff {
         return true;
     }
 
-    std::vector<ShopItem> FetchShop(const std::string& shopUrl, const std::string& user, const std::string& pass, std::string& error)
+    std::vector<ShopCatalog::Index> FetchShop(const std::string& shopUrl, const std::string& user, const std::string& pass, ShopCatalog& catalog, std::string& error)
     {
-        std::vector<ShopItem> items;
+        std::vector<ShopCatalog::Index> items;
         error.clear();
 
         std::string baseUrl = NormalizeShopUrl(shopUrl);
@@ -488,70 +840,132 @@ namespace shopInstStuff {
             return items;
         }
 
-        FetchResult fetch = FetchShopResponse(baseUrl, user, pass);
+        tin::network::SetBasicAuth(baseUrl, user, pass);
+        ShopJsonParser parser(ShopJsonParser::Mode::Files, baseUrl, &catalog);
+        FetchResult fetch = FetchShopResponse(baseUrl, &parser);
         if (!ValidateShopResponse(fetch, error))
             return items;
 
-        try {
-            nlohmann::json shop = nlohmann::json::parse(fetch.body);
-            if (shop.contains("error")) {
-                error = shop["error"].get<std::string>();
-                return items;
-            }
-            if (!shop.contains("files") || !shop["files"].is_array()) {
-                error = "Shop response missing file list.";
-                return items;
-            }
-
-            for (const auto& entry : shop["files"]) {
-                if (!entry.contains("url"))
-                    continue;
-                std::string url = entry["url"].get<std::string>();
-                std::uint64_t size = 0;
-                if (entry.contains("size") && entry["size"].is_number()) {
-                    size = entry["size"].get<std::uint64_t>();
-                }
+        if (!fetch.parsed) {
+            error = "Invalid shop response.";
+            return items;
+        }
+        if (!parser.error.empty()) {
+            error = parser.error;
+            return items;
+        }
+        if (!parser.hasFiles) {
+            error = "Shop response missing file list.";
+            return items;
+        }
+        items = std::move(parser.items);
 
-                std::string fragment;
-                std::string urlPath = url;
-                auto hashPos = urlPath.find('#');
-                if (hashPos != std::string::npos) {
-                    fragment = urlPath.substr(hashPos + 1);
-                    urlPath = urlPath.substr(0, hashPos);
+        std::sort(items.begin(), items.end(), [&](ShopCatalog::Index a, ShopCatalog::Index b) {
+            return inst::util::ignoreCaseCompare(std::string(catalog.GetName(a)), std::string(catalog.GetName(b)));
+        });
+        return items;
+    }
+
+    // Runs conditional requests for caches that were served stale, so the next visit finds them
+    // current. Shops are revalidated one after another on a single thread, which the app stops
+    // before it shuts its services down.
+    class ShopCacheRevalidator {
+        public:
+            ~ShopCacheRevalidator()
+            {
+                Stop();
+            }
+
+            void Start(const std::string& baseUrl, const std::string& user, const std::string& pass, const ShopCacheValidators& cached)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_stopped)
+                    return;
+                for (const auto& job : m_jobs) {
+                    if (job.baseUrl == baseUrl)
+                        return;
                 }
+                m_jobs.push_back({baseUrl, user, pass, cached});
+                if (m_running)
+                    return;
+                if (m_thread.joinable())
+                    m_thread.join();
+
+                m_running = true;
+                m_thread = std::thread(&ShopCacheRevalidator::Run, this);
+            }
 
-                std::string fullUrl;
-                if (urlPath.rfind("http://", 0) == 0 || urlPath.rfind("https://", 0) == 0)
-                    fullUrl = urlPath;
-                else if (!urlPath.empty() && urlPath[0] == '/')
-                    fullUrl = baseUrl + urlPath;
-                else
-                    fullUrl = baseUrl + "/" + urlPath;
-
-                std::string name;
-                if (!fragment.empty())
-                    name = DecodeUrlSegment(fragment);
-                else {
-                    name = inst::util::formatUrlString(fullUrl);
+            // Aborts the request in flight, drops the queued ones and joins the thread. Nothing is
+            // revalidated after this.
+            void Stop()
+            {
+                std::thread thread;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_stopped = true;
+                    m_jobs.clear();
+                    thread = std::move(m_thread);
                 }
+                if (thread.joinable())
+                    thread.join();
+            }
+
+        private:
+            struct Job {
+                std::string baseUrl;
+                std::string user;
+                std::string pass;
+                ShopCacheValidators cached;
+            };
+
+            std::mutex m_mutex;
+            std::deque<Job> m_jobs;
+            std::thread m_thread;
+            bool m_running = false;
+            std::atomic<bool> m_stopped = false;
+
+            void Run()
+            {
+                while (true) {
+                    Job job;
+                    {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        if (m_jobs.empty()) {
+                            m_running = false;
+                            return;
+                        }
+                        job = m_jobs.front();
+                        m_jobs.pop_front();
+                    }
 
-                if (!fullUrl.empty() && !name.empty()) {
-                    items.push_back({name, fullUrl, "", "", size});
+                    // An install in the meantime clears the registered credentials
+                    tin::network::SetBasicAuth(job.baseUrl, job.user, job.pass);
+                    FetchResult fetch = FetchShopResponse(job.baseUrl + "/api/shop/sections", nullptr, &job.cached, &m_stopped);
+                    if (m_stopped)
+                        return;
+                    RecordShopLatency(job.baseUrl, fetch);
+                    std::string error;
+                    if (fetch.error.empty() && fetch.responseCode == 304) {
+                        RenewShopCache(job.baseUrl, job.cached);
+                    } else if (fetch.responseCode == 200 && ValidateShopResponse(fetch, error)) {
+                        // Parsed into a catalog of its own, only a usable listing replaces the cache
+                        ShopCatalog catalog;
+                        auto sections = ParseShopSectionsBody(fetch.body, job.baseUrl, catalog, error);
+                        SaveShopCache(job.baseUrl, catalog, sections, fetch.validators);
+                    }
+                    LOG_DEBUG("Shop cache revalidated in the background: %ld\n", fetch.responseCode);
                 }
             }
-        }
-        catch (...) {
-            error = "Invalid shop response.";
-            return {};
-        }
+    };
 
-        std::sort(items.begin(), items.end(), [](const ShopItem& a, const ShopItem& b) {
-            return inst::util::ignoreCaseCompare(a.name, b.name);
-        });
-        return items;
+    ShopCacheRevalidator g_shopCacheRevalidator;
+
+    void StopCacheRevalidation()
+    {
+        g_shopCacheRevalidator.Stop();
     }
 
-    std::vector<ShopSection> FetchShopSections(const std::string& shopUrl, const std::string& user, const std::string& pass, std::string& error, bool allowCache)
+    std::vector<ShopSection> FetchShopSections(const std::string& shopUrl, const std::string& user, const std::string& pass, ShopCatalog& catalog, std::string& error, bool allowCache)
     {
         std::vector<ShopSection> sections;
         error.clear();
@@ -562,48 +976,174 @@ namespace shopInstStuff {
             return sections;
         }
 
-        if (allowCache) {
-            std::string cachedBody;
-            bool fresh = false;
-            if (LoadShopCache(baseUrl, cachedBody, fresh) && fresh) {
-                std::string cacheError;
-                sections = ParseShopSectionsBody(cachedBody, baseUrl, cacheError);
-                if (!sections.empty()) {
-                    error.clear();
-                    return sections;
-                }
+        tin::network::SetBasicAuth(baseUrl, user, pass);
+
+        // Even a forced refresh sends the cached validators, a 304 still means the copy is current
+        ShopCacheValidators cached;
+        bool fresh = false;
+        bool hasCache = LoadShopCacheMeta(baseUrl, cached, fresh);
+
+        if (allowCache && hasCache && (fresh || inst::config::shopBackgroundRefresh)) {
+            sections = LoadShopCache(baseUrl, catalog);
+            if (!sections.empty()) {
+                if (!fresh)
+                    g_shopCacheRevalidator.Start(baseUrl, user, pass, cached);
+                return sections;
             }
         }
 
         std::string sectionsUrl = baseUrl + "/api/shop/sections";
-        FetchResult fetch = FetchShopResponse(sectionsUrl, user, pass);
+        ShopJsonParser parser(ShopJsonParser::Mode::Sections, baseUrl, &catalog);
+        FetchResult fetch = FetchShopResponse(sectionsUrl, &parser, hasCache ? &cached : nullptr);
+        RecordShopLatency(baseUrl, fetch);
         if (fetch.responseCode == 404) {
-            std::vector<ShopItem> items = FetchShop(shopUrl, user, pass, error);
+            std::vector<ShopCatalog::Index> items = FetchShop(shopUrl, user, pass, catalog, error);
             if (!items.empty()) {
                 sections.push_back({"all", "All", items});
             }
             return sections;
         }
 
+        if (fetch.error.empty() && fetch.responseCode == 304 && hasCache) {
+            sections = LoadShopCache(baseUrl, catalog);
+            if (!sections.empty()) {
+                RenewShopCache(baseUrl, cached);
+                return sections;
+            }
+        }
+
         if (!ValidateShopResponse(fetch, error)) {
-            if (allowCache) {
-                std::string cachedBody;
-                bool fresh = false;
-                if (LoadShopCache(baseUrl, cachedBody, fresh)) {
-                    std::string cacheError;
-                    sections = ParseShopSectionsBody(cachedBody, baseUrl, cacheError);
-                    if (!sections.empty()) {
-                        error.clear();
-                        return sections;
-                    }
+            if (allowCache && hasCache) {
+                sections = LoadShopCache(baseUrl, catalog);
+                if (!sections.empty()) {
+                    error.clear();
+                    return sections;
                 }
             }
             return sections;
         }
 
-        sections = ParseShopSectionsBody(fetch.body, baseUrl, error);
-        if (!sections.empty())
-            SaveShopCache(baseUrl, fetch.body);
+        sections = FinishShopSections(parser, fetch.parsed, error);
+        SaveShopCache(baseUrl, catalog, sections, fetch.validators);
+        return sections;
+    }
+
+    std::vector<inst::config::ShopProfile> GetShopProfiles()
+    {
+        std::vector<inst::config::ShopProfile> shops;
+        std::unordered_set<std::string> seen;
+        auto addShop = [&](const inst::config::ShopProfile& shop) {
+            std::string baseUrl = NormalizeShopUrl(shop.url);
+            if (!baseUrl.empty() && seen.insert(baseUrl).second)
+                shops.push_back(shop);
+        };
+
+        addShop({inst::config::shopUrl, inst::config::shopUser, inst::config::shopPass});
+        for (const auto& shop : inst::config::shopProfiles)
+            addShop(shop);
+        return shops;
+    }
+
+    void RegisterShopAuth(const std::vector<inst::config::ShopProfile>& shops)
+    {
+        tin::network::ClearBasicAuth();
+        for (const auto& shop : shops)
+            tin::network::SetBasicAuth(NormalizeShopUrl(shop.url), shop.user, shop.pass);
+    }
+
+    std::vector<ShopSection> FetchShopSections(const std::vector<inst::config::ShopProfile>& shops, ShopCatalog& catalog, std::string& error, bool allowCache)
+    {
+        error.clear();
+        RegisterShopAuth(shops);
+        if (shops.empty()) {
+            error = "Shop URL is empty.";
+            return {};
+        }
+        if (shops.size() == 1)
+            return FetchShopSections(shops[0].url, shops[0].user, shops[0].pass, catalog, error, allowCache);
+
+        struct ShopFetch {
+            ShopCatalog catalog;
+            std::vector<ShopSection> sections;
+            std::string error;
+        };
+
+        // Every shop is fetched into a catalog of its own at the same time, so the slowest one sets
+        // the wait rather than the sum of them
+        std::vector<ShopFetch> fetches(shops.size());
+        std::vector<std::thread> threads;
+        threads.reserve(shops.size());
+        for (std::size_t i = 0; i < shops.size(); i++) {
+            threads.emplace_back([&shops, &fetches, i, allowCache]() {
+                fetches[i].sections = FetchShopSections(shops[i].url, shops[i].user, shops[i].pass, fetches[i].catalog, fetches[i].error, allowCache);
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        // Merged quickest to respond first, so an item offered by several shops is installed from the
+        // one whose response started soonest rather than the one with the smallest listing. A shop served from
+        // its cache and not reached yet this session keeps its place after the others.
+        std::vector<std::size_t> order(shops.size());
+        std::vector<double> latency(shops.size(), 0.0);
+        std::vector<bool> measured(shops.size(), false);
+        for (std::size_t i = 0; i < shops.size(); i++)
+            measured[i] = GetShopLatency(NormalizeShopUrl(shops[i].url), latency[i]);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) -> bool {
+            if (measured[a] != measured[b])
+                return measured[a];
+            return measured[a] && latency[a] < latency[b];
+        });
+
+        std::vector<ShopSection> sections;
+        std::vector<std::unordered_set<ShopCatalog::Index>> sectionItems;
+        std::unordered_map<std::string, std::size_t> sectionLookup;
+        std::map<std::pair<std::uint64_t, std::uint32_t>, ShopCatalog::Index> titleLookup;
+        for (std::size_t shop : order) {
+            auto& fetch = fetches[shop];
+            if (!fetch.error.empty() || fetch.sections.empty()) {
+                LOG_DEBUG("Shop %s failed: %s\n", shops[shop].url.c_str(), fetch.error.c_str());
+                continue;
+            }
+
+            constexpr ShopCatalog::Index kUnmapped = ~ShopCatalog::Index(0);
+            std::vector<ShopCatalog::Index> merged(fetch.catalog.Size(), kUnmapped);
+            for (const auto& section : fetch.sections) {
+                auto found = sectionLookup.find(section.id);
+                if (found == sectionLookup.end()) {
+                    found = sectionLookup.emplace(section.id, sections.size()).first;
+                    sections.push_back({section.id, section.title, {}});
+                    sectionItems.emplace_back();
+                }
+
+                auto& target = sections[found->second];
+                for (auto item : section.items) {
+                    if (merged[item] == kUnmapped) {
+                        if (fetch.catalog.HasTitleId(item) && fetch.catalog.HasAppVersion(item)) {
+                            auto key = std::make_pair(fetch.catalog.GetTitleId(item), fetch.catalog.GetAppVersion(item));
+                            auto known = titleLookup.find(key);
+                            if (known == titleLookup.end())
+                                known = titleLookup.emplace(key, catalog.Add(fetch.catalog.GetItem(item))).first;
+                            merged[item] = known->second;
+                        } else {
+                            merged[item] = catalog.Add(fetch.catalog.GetItem(item));
+                        }
+                    }
+                    if (sectionItems[found->second].insert(merged[item]).second)
+                        target.items.push_back(merged[item]);
+                }
+            }
+        }
+
+        if (sections.empty()) {
+            for (const auto& fetch : fetches) {
+                if (!fetch.error.empty()) {
+                    error = fetch.error;
+                    break;
+                }
+            }
+        }
         return sections;
     }
 
@@ -613,24 +1153,19 @@ namespace shopInstStuff {
         if (baseUrl.empty())
             return "";
 
-        FetchResult fetch = FetchShopResponse(baseUrl, user, pass);
+        tin::network::SetBasicAuth(baseUrl, user, pass);
+        ShopJsonParser parser(ShopJsonParser::Mode::Motd, baseUrl, nullptr);
+        FetchResult fetch = FetchShopResponse(baseUrl, &parser);
         if (fetch.responseCode == 401 || fetch.responseCode == 403)
             return "";
         if (!fetch.error.empty())
             return "";
         if (fetch.body.rfind("TINFOIL", 0) == 0)
             return "";
-
-        try {
-            nlohmann::json shop = nlohmann::json::parse(fetch.body);
-            if (shop.contains("success") && shop["success"].is_string())
-                return shop["success"].get<std::string>();
-        }
-        catch (...) {
+        if (!fetch.parsed)
             return "";
-        }
 
-        return "";
+        return parser.success;
     }
 
     void installTitleShop(const std::vector<ShopItem>& items, int storage, const std::string& sourceLabel)
@@ -652,10 +1187,7 @@ namespace shopInstStuff {
             previousClockValues.push_back(inst::util::setClockSpeed(2, 1600000000)[0]);
         }
 
-        if (!inst::config::shopUser.empty() || !inst::config::shopPass.empty())
-            tin::network::SetBasicAuth(inst::config::shopUser, inst::config::shopPass);
-        else
-            tin::network::ClearBasicAuth();
+        RegisterShopAuth(GetShopProfiles());
 
         std::string currentName;
         try {
@@ -0,0 +1,118 @@
+#include "shopSearch.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <string_view>
+#include <utility>
+
+namespace {
+    std::string FoldText(const std::string& text)
+    {
+        std::string folded(text);
+        for (auto& c : folded)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return folded;
+    }
+
+    std::uint32_t TrigramKey(const char* text)
+    {
+        return (static_cast<std::uint32_t>(static_cast<unsigned char>(text[0])) << 16) |
+            (static_cast<std::uint32_t>(static_cast<unsigned char>(text[1])) << 8) |
+            static_cast<std::uint32_t>(static_cast<unsigned char>(text[2]));
+    }
+}
+
+namespace shopInstStuff {
+    void ShopSearchIndex::Build(const ShopCatalog& catalog, const std::vector<ShopCatalog::Index>& items)
+    {
+        this->Clear();
+        m_items = items;
+        m_offsets.reserve(items.size() + 1);
+        for (auto item : items) {
+            m_offsets.push_back(static_cast<std::uint32_t>(m_folded.size()));
+            m_folded += FoldText(catalog.GetDisplayName(item));
+        }
+        m_offsets.push_back(static_cast<std::uint32_t>(m_folded.size()));
+
+        // Every (trigram, entry) pair once, sorted by trigram and then entry
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> pairs;
+        pairs.reserve(m_folded.size());
+        for (std::uint32_t entry = 0; entry < items.size(); entry++) {
+            for (std::uint32_t pos = m_offsets[entry]; pos + 3 <= m_offsets[entry + 1]; pos++)
+                pairs.emplace_back(TrigramKey(m_folded.data() + pos), entry);
+        }
+        std::sort(pairs.begin(), pairs.end());
+        pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+        m_postings.reserve(pairs.size());
+        for (const auto& pair : pairs) {
+            if (m_trigrams.empty() || m_trigrams.back() != pair.first) {
+                m_trigrams.push_back(pair.first);
+                m_postingStarts.push_back(static_cast<std::uint32_t>(m_postings.size()));
+            }
+            m_postings.push_back(pair.second);
+        }
+        m_postingStarts.push_back(static_cast<std::uint32_t>(m_postings.size()));
+    }
+
+    void ShopSearchIndex::Clear()
+    {
+        *this = ShopSearchIndex();
+    }
+
+    const std::vector<ShopCatalog::Index>& ShopSearchIndex::Search(const std::string& query)
+    {
+        std::string folded = FoldText(query);
+        if (folded.empty()) {
+            m_hasLast = false;
+            return m_items;
+        }
+
+        std::string_view names(m_folded);
+        std::vector<std::uint32_t> matches;
+        auto check = [&](std::uint32_t entry) {
+            auto name = names.substr(m_offsets[entry], m_offsets[entry + 1] - m_offsets[entry]);
+            if (name.find(folded) != std::string_view::npos)
+                matches.push_back(entry);
+        };
+
+        if (m_hasLast && folded.find(m_lastQuery) != std::string::npos) {
+            // Anything matching the longer query matched the previous one too
+            for (auto entry : m_lastMatches)
+                check(entry);
+        } else if (folded.size() >= 3) {
+            // The rarest trigram of the query bounds the candidates, a missing one means no match
+            std::uint32_t bestStart = 0, bestEnd = 0;
+            bool first = true;
+            for (std::size_t pos = 0; pos + 3 <= folded.size(); pos++) {
+                std::uint32_t key = TrigramKey(folded.data() + pos);
+                auto it = std::lower_bound(m_trigrams.begin(), m_trigrams.end(), key);
+                if (it == m_trigrams.end() || *it != key) {
+                    bestStart = bestEnd = 0;
+                    break;
+                }
+                std::size_t slot = it - m_trigrams.begin();
+                if (first || m_postingStarts[slot + 1] - m_postingStarts[slot] < bestEnd - bestStart) {
+                    bestStart = m_postingStarts[slot];
+                    bestEnd = m_postingStarts[slot + 1];
+                    first = false;
+                }
+            }
+            for (std::uint32_t i = bestStart; i < bestEnd; i++)
+                check(m_postings[i]);
+        } else {
+            for (std::uint32_t entry = 0; entry < m_items.size(); entry++)
+                check(entry);
+        }
+
+        m_results.clear();
+        m_results.reserve(matches.size());
+        for (auto entry : matches)
+            m_results.push_back(m_items[entry]);
+
+        m_hasLast = true;
+        m_lastQuery = std::move(folded);
+        m_lastMatches = std::move(matches);
+        return m_results;
+    }
+}
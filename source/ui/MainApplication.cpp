@@ -74,6 +74,8 @@ namespace inst::ui {
                 this->instpage->awooImage->SetVisible(!inst::config::gayMode);
                 this->instpage->hintText->SetVisible(true);
                 this->instpage->progressText->SetVisible(true);
+                this->instpage->statsText->SetText("");
+                this->instpage->statsText->SetVisible(false);
                 icon_set = false;
             }
 
@@ -86,6 +88,8 @@ namespace inst::ui {
                     this->instpage->installBar->SetVisible(true);
                     this->instpage->installBar->SetProgress(percent);
                     this->instpage->installInfoText->SetText("inst.info_page.downloading"_lang + last_name);
+                    // MTP installs don't go through setInstBarPerc, refresh the stats overlay here
+                    instPage::updateStatsText();
 
                     const auto now = std::chrono::steady_clock::now();
                     const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_time).count();
@@ -2,6 +2,7 @@
 #include "ui/MainApplication.hpp"
 #include "ui/instPage.hpp"
 #include "util/config.hpp"
+#include "install/install_telemetry.hpp"
 #include "mtp_server.hpp"
 
 #define COLOR(hex) pu::ui::Color::FromHex(hex)
@@ -49,6 +50,9 @@ namespace inst::ui {
         this->progressText = TextBlock::New(0, 340, "", 30);
         this->progressText->SetColor(COLOR("#FFFFFFFF"));
         this->progressText->SetVisible(false);
+        this->statsText = TextBlock::New(15, 538, "", 18);
+        this->statsText->SetColor(COLOR("#FFFFFFFF"));
+        this->statsText->SetVisible(false);
         if (std::filesystem::exists(inst::config::appDir + "/awoo_inst.png")) this->awooImage = Image::New(410, 190, inst::config::appDir + "/awoo_inst.png");
         else this->awooImage = Image::New(510, 166, "romfs:/images/awoos/7d8a05cddfef6da4901b20d2698d5a71.png");
         this->installIconImage = Image::New(kInstallIconX, kInstallIconY, "romfs:/images/awoos/7d8a05cddfef6da4901b20d2698d5a71.png");
@@ -64,6 +68,7 @@ namespace inst::ui {
         this->Add(this->installInfoText);
         this->Add(this->installBar);
         this->Add(this->progressText);
+        this->Add(this->statsText);
         this->Add(this->hintText);
         this->Add(this->awooImage);
         this->Add(this->installIconImage);
@@ -83,9 +88,22 @@ namespace inst::ui {
     void instPage::setInstBarPerc(double ourPercent){
         mainApp->instpage->installBar->SetVisible(true);
         mainApp->instpage->installBar->SetProgress(ourPercent);
+        // Every source reports progress, so this doubles as the refresh for the stats overlay
+        updateStatsText();
         mainApp->CallForRender();
     }
 
+    void instPage::updateStatsText(){
+        if (!inst::config::installStats) return;
+        static u64 lastStatsTick = 0;
+        u64 now = armGetSystemTick();
+        if (now - lastStatsTick >= armGetSystemTickFreq() / 2) {
+            lastStatsTick = now;
+            mainApp->instpage->statsText->SetText(tin::install::InstallTelemetry::Get().GetOverlayText());
+            mainApp->instpage->statsText->SetVisible(true);
+        }
+    }
+
     void instPage::setInstallIcon(const std::string& imagePath){
         if (imagePath.empty()) {
             clearInstallIcon();
@@ -119,6 +137,8 @@ namespace inst::ui {
         mainApp->instpage->installBar->SetVisible(false);
         mainApp->instpage->hintText->SetVisible(false);
         mainApp->instpage->progressText->SetVisible(false);
+        mainApp->instpage->statsText->SetText("");
+        mainApp->instpage->statsText->SetVisible(false);
         mainApp->instpage->installIconImage->SetVisible(false);
         mainApp->instpage->awooImage->SetVisible(!inst::config::gayMode);
         mainApp->LoadLayout(mainApp->instpage);
@@ -6,7 +6,7 @@
 #include "util/config.hpp"
 #include "util/lang.hpp"
 #include "sigInstall.hpp"
-#include "data/buffered_placeholder_writer.hpp"
+#include "data/buffer_segment_pool.hpp"
 #include "mtp_server.hpp"
 
 #define COLOR(hex) pu::ui::Color::FromHex(hex)
@@ -19,14 +19,15 @@ namespace inst::ui {
     void mainMenuThread() {
         bool menuLoaded = mainApp->IsShown();
         if (!appletFinished && appletGetAppletType() == AppletType_LibraryApplet) {
-            tin::data::NUM_BUFFER_SEGMENTS = 2;
+            // Applets have a much smaller heap, the pool will stop short of this if it runs out
+            tin::data::BufferSegmentPool::Get().SetBudget(0x2000000);
             if (menuLoaded) {
                 inst::ui::appletFinished = true;
                 mainApp->CreateShowDialog("main.applet.title"_lang, "main.applet.desc"_lang, {"common.ok"_lang}, true);
             } 
         } else if (!appletFinished) {
             inst::ui::appletFinished = true;
-            tin::data::NUM_BUFFER_SEGMENTS = 128;
+            tin::data::BufferSegmentPool::Get().SetBudget(0x40000000);
         }
         if (!updateFinished && (!inst::config::autoUpdate || inst::util::getIPAddress() == "1.0.0.127")) updateFinished = true;
         if (!updateFinished && menuLoaded && inst::config::updateInfo.size()) {
@@ -142,6 +142,10 @@ namespace inst::ui {
         deletePromptOption->SetColor(COLOR("#FFFFFFFF"));
         deletePromptOption->SetIcon(this->getMenuOptionIcon(inst::config::deletePrompt));
         this->menu->AddItem(deletePromptOption);
+        auto installStatsOption = pu::ui::elm::MenuItem::New("options.menu_items.install_stats"_lang);
+        installStatsOption->SetColor(COLOR("#FFFFFFFF"));
+        installStatsOption->SetIcon(this->getMenuOptionIcon(inst::config::installStats));
+        this->menu->AddItem(installStatsOption);
         auto autoUpdateOption = pu::ui::elm::MenuItem::New("options.menu_items.auto_update"_lang);
         autoUpdateOption->SetColor(COLOR("#FFFFFFFF"));
         autoUpdateOption->SetIcon(this->getMenuOptionIcon(inst::config::autoUpdate));
@@ -173,6 +177,9 @@ namespace inst::ui {
         auto shopPassOption = pu::ui::elm::MenuItem::New("options.menu_items.shop_pass"_lang + shopPassDisplay);
         shopPassOption->SetColor(COLOR("#FFFFFFFF"));
         this->menu->AddItem(shopPassOption);
+        auto shopProfilesOption = pu::ui::elm::MenuItem::New("options.menu_items.shop_profiles"_lang + std::to_string(inst::config::shopProfiles.size()));
+        shopProfilesOption->SetColor(COLOR("#FFFFFFFF"));
+        this->menu->AddItem(shopProfilesOption);
         auto shopHideInstalledOption = pu::ui::elm::MenuItem::New("options.menu_items.shop_hide_installed"_lang);
         shopHideInstalledOption->SetColor(COLOR("#FFFFFFFF"));
         shopHideInstalledOption->SetIcon(this->getMenuOptionIcon(inst::config::shopHideInstalled));
@@ -192,6 +199,37 @@ namespace inst::ui {
         this->menu->AddItem(creditsOption);
     }
 
+    void optionsPage::editShopProfiles() {
+        std::vector<std::string> profileList;
+        for (const auto& profile : inst::config::shopProfiles)
+            profileList.push_back(inst::util::shortenString(profile.url, 32, false));
+        profileList.push_back("options.shop.add_profile"_lang);
+        int rc = mainApp->CreateShowDialog("options.shop.profiles_title"_lang, "options.shop.profiles_desc"_lang, profileList, false);
+        if (rc < 0) return;
+
+        if (rc == (int)inst::config::shopProfiles.size()) {
+            inst::config::ShopProfile profile;
+            profile.url = inst::util::softwareKeyboard("options.shop.url_hint"_lang, "", 200);
+            if (profile.url.empty()) return;
+            profile.user = inst::util::softwareKeyboard("options.shop.user_hint"_lang, "", 100);
+            profile.pass = inst::util::softwareKeyboard("options.shop.pass_hint"_lang, "", 100);
+            inst::config::shopProfiles.push_back(profile);
+        } else {
+            auto& profile = inst::config::shopProfiles[rc];
+            int action = mainApp->CreateShowDialog(inst::util::shortenString(profile.url, 42, false), "options.shop.profile_desc"_lang, {"options.shop.edit_profile"_lang, "options.shop.remove_profile"_lang, "common.cancel"_lang}, false);
+            if (action == 0) {
+                std::string keyboardResult = inst::util::softwareKeyboard("options.shop.url_hint"_lang, profile.url.c_str(), 200);
+                if (keyboardResult.size() > 0) profile.url = keyboardResult;
+                profile.user = inst::util::softwareKeyboard("options.shop.user_hint"_lang, profile.user.c_str(), 100);
+                profile.pass = inst::util::softwareKeyboard("options.shop.pass_hint"_lang, profile.pass.c_str(), 100);
+            } else if (action == 1) {
+                inst::config::shopProfiles.erase(inst::config::shopProfiles.begin() + rc);
+            } else return;
+        }
+        inst::config::setConfig();
+        this->setMenuText();
+    }
+
     void optionsPage::onInput(u64 Down, u64 Up, u64 Held, pu::ui::Touch Pos) {
         if (Down & HidNpadButton_B) {
             mainApp->LoadLayout(mainApp->mainPage);
@@ -225,11 +263,16 @@ namespace inst::ui {
                     this->setMenuText();
                     break;
                 case 4:
-                    inst::config::autoUpdate = !inst::config::autoUpdate;
+                    inst::config::installStats = !inst::config::installStats;
                     inst::config::setConfig();
                     this->setMenuText();
                     break;
                 case 5:
+                    inst::config::autoUpdate = !inst::config::autoUpdate;
+                    inst::config::setConfig();
+                    this->setMenuText();
+                    break;
+                case 6:
                     if (inst::config::gayMode) {
                         inst::config::gayMode = false;
                         mainApp->mainPage->awooImage->SetVisible(true);
@@ -271,12 +314,12 @@ namespace inst::ui {
                     inst::config::setConfig();
                     this->setMenuText();
                     break;
-                case 6:
+                case 7:
                     inst::config::soundEnabled = !inst::config::soundEnabled;
                     inst::config::setConfig();
                     this->setMenuText();
                     break;
-                case 7:
+                case 8:
                     inst::config::oledMode = !inst::config::oledMode;
                     inst::config::setConfig();
                     {
@@ -298,7 +341,7 @@ namespace inst::ui {
                         mainApp->LoadLayout(mainApp->optionspage);
                     }
                     break;
-                case 8:
+                case 9:
                     keyboardResult = inst::util::softwareKeyboard("options.sig_hint"_lang, inst::config::sigPatchesUrl.c_str(), 500);
                     if (keyboardResult.size() > 0) {
                         inst::config::sigPatchesUrl = keyboardResult;
@@ -306,7 +349,7 @@ namespace inst::ui {
                         this->setMenuText();
                     }
                     break;
-                case 9:
+                case 10:
                     keyboardResult = inst::util::softwareKeyboard("options.shop.url_hint"_lang, inst::config::shopUrl.c_str(), 200);
                     if (keyboardResult.size() > 0) {
                         inst::config::shopUrl = keyboardResult;
@@ -314,29 +357,32 @@ namespace inst::ui {
                         this->setMenuText();
                     }
                     break;
-                case 10:
+                case 11:
                     keyboardResult = inst::util::softwareKeyboard("options.shop.user_hint"_lang, inst::config::shopUser.c_str(), 100);
                     inst::config::shopUser = keyboardResult;
                     inst::config::setConfig();
                     this->setMenuText();
                     break;
-                case 11:
+                case 12:
                     keyboardResult = inst::util::softwareKeyboard("options.shop.pass_hint"_lang, inst::config::shopPass.c_str(), 100);
                     inst::config::shopPass = keyboardResult;
                     inst::config::setConfig();
                     this->setMenuText();
                     break;
-                case 12:
+                case 13:
+                    this->editShopProfiles();
+                    break;
+                case 14:
                     inst::config::shopHideInstalled = !inst::config::shopHideInstalled;
                     inst::config::setConfig();
                     this->setMenuText();
                     break;
-                case 13:
+                case 15:
                     inst::config::shopHideInstalledSection = !inst::config::shopHideInstalledSection;
                     inst::config::setConfig();
                     this->setMenuText();
                     break;
-                case 14:
+                case 16:
                     languageList = languageStrings;
                     languageList.push_back("options.language.system_language"_lang);
                     rc = inst::ui::mainApp->CreateShowDialog("options.language.title"_lang, "options.language.desc"_lang, languageList, false);
@@ -382,7 +428,7 @@ namespace inst::ui {
                     mainApp->FadeOut();
                     mainApp->Close();
                     break;
-                case 15:
+                case 17:
                     if (inst::util::getIPAddress() == "1.0.0.127") {
                         inst::ui::mainApp->CreateShowDialog("main.net.title"_lang, "main.net.desc"_lang, {"common.ok"_lang}, true);
                         break;
@@ -394,7 +440,7 @@ namespace inst::ui {
                     }
                     this->askToUpdate(downloadUrl);
                     break;
-                case 16:
+                case 18:
                     inst::ui::mainApp->CreateShowDialog("options.credits.title"_lang, "options.credits.desc"_lang, {"common.close"_lang}, true);
                     break;
                 default:
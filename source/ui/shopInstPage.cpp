@@ -7,9 +7,12 @@
 #include <switch.h>
 #include "ui/MainApplication.hpp"
 #include "ui/shopInstPage.hpp"
+#include "shopIcons.hpp"
 #include "util/config.hpp"
-#include "util/curl.hpp"
+#include "util/error.hpp"
+#include "util/installed_content.hpp"
 #include "util/lang.hpp"
+#include "util/title_icon_cache.hpp"
 #include "util/title_util.hpp"
 #include "util/util.hpp"
 
@@ -25,6 +28,10 @@ namespace {
     constexpr int kGridStartX = (1280 - kGridWidth) / 2;
     constexpr int kGridStartY = 170;
     constexpr int kGridItemsPerPage = kGridCols * kGridRows;
+    // Tiles keep their decoded icon, so flipping back and forth between nearby pages doesn't decode again
+    constexpr int kGridCachedPages = 3;
+    // Two screens of the list below the selection get their icons fetched ahead
+    constexpr int kIconPrefetchCount = 12;
 
     std::string NormalizeHex(std::string hex)
     {
@@ -49,21 +56,21 @@ namespace {
         return true;
     }
 
-    bool DeriveBaseTitleId(const shopInstStuff::ShopItem& item, std::uint64_t& out)
+    bool DeriveBaseTitleId(const shopInstStuff::ShopCatalog& catalog, shopInstStuff::ShopCatalog::Index item, std::uint64_t& out)
     {
-        if (item.hasTitleId) {
-            out = item.titleId;
+        if (catalog.HasTitleId(item)) {
+            out = catalog.GetTitleId(item);
             return true;
         }
-        if (!item.hasAppId)
+        if (!catalog.HasAppId(item))
             return false;
-        std::string appId = NormalizeHex(item.appId);
+        std::string appId = NormalizeHex(std::string(catalog.GetAppId(item)));
         if (appId.size() < 16)
             return false;
         std::string baseId;
-        if (item.appType == NcmContentMetaType_Patch) {
+        if (catalog.GetAppType(item) == NcmContentMetaType_Patch) {
             baseId = appId.substr(0, appId.size() - 3) + "000";
-        } else if (item.appType == NcmContentMetaType_AddOnContent) {
+        } else if (catalog.GetAppType(item) == NcmContentMetaType_AddOnContent) {
             std::string basePart = appId.substr(0, appId.size() - 3);
             if (basePart.empty())
                 return false;
@@ -81,48 +88,19 @@ namespace {
         return TryParseHexU64(baseId, out);
     }
 
-    bool IsBaseItem(const shopInstStuff::ShopItem& item)
+    bool IsBaseItem(const shopInstStuff::ShopCatalog& catalog, shopInstStuff::ShopCatalog::Index item)
     {
-        if (item.appType == NcmContentMetaType_Application)
+        if (catalog.GetAppType(item) == NcmContentMetaType_Application)
             return true;
-        if (item.hasAppId) {
-            std::string appId = NormalizeHex(item.appId);
+        if (catalog.HasAppId(item)) {
+            std::string appId = NormalizeHex(std::string(catalog.GetAppId(item)));
             return appId.size() >= 3 && appId.rfind("000") == appId.size() - 3;
         }
-        if (item.hasTitleId) {
-            return (item.titleId & 0xFFF) == 0;
+        if (catalog.HasTitleId(item)) {
+            return (catalog.GetTitleId(item) & 0xFFF) == 0;
         }
         return false;
     }
-
-    bool IsBaseTitleCurrentlyInstalled(u64 baseTitleId)
-    {
-        s32 metaCount = 0;
-        if (R_FAILED(nsCountApplicationContentMeta(baseTitleId, &metaCount)) || metaCount <= 0)
-            return false;
-        return tin::util::IsTitleInstalled(baseTitleId);
-    }
-
-    bool TryGetInstalledUpdateVersionNcm(u64 baseTitleId, u32& outVersion)
-    {
-        outVersion = 0;
-        const u64 patchTitleId = baseTitleId ^ 0x800;
-        const NcmStorageId storages[] = {NcmStorageId_BuiltInUser, NcmStorageId_SdCard};
-        for (auto storage : storages) {
-            NcmContentMetaDatabase db;
-            if (R_FAILED(ncmOpenContentMetaDatabase(&db, storage)))
-                continue;
-            NcmContentMetaKey key = {};
-            if (R_SUCCEEDED(ncmContentMetaDatabaseGetLatestContentMetaKey(&db, &key, patchTitleId))) {
-                if (key.type == NcmContentMetaType_Patch && key.id == patchTitleId) {
-                    if (key.version > outVersion)
-                        outVersion = key.version;
-                }
-            }
-            ncmContentMetaDatabaseClose(&db);
-        }
-        return outVersion > 0;
-    }
 }
 
 namespace inst::ui {
@@ -170,8 +148,9 @@ namespace inst::ui {
         auto highlightColor = inst::config::oledMode ? COLOR("#FFFFFF66") : COLOR("#FFFFFF33");
         this->gridHighlight = Rectangle::New(0, 0, kGridTileWidth + 8, kGridTileHeight + 8, highlightColor);
         this->gridHighlight->SetVisible(false);
-        this->gridImages.reserve(kGridItemsPerPage);
-        for (int i = 0; i < kGridItemsPerPage; i++) {
+        this->gridImages.reserve(kGridItemsPerPage * kGridCachedPages);
+        this->gridSlots.resize(kGridItemsPerPage * kGridCachedPages);
+        for (int i = 0; i < kGridItemsPerPage * kGridCachedPages; i++) {
             auto img = Image::New(0, 0, "romfs:/images/awoos/7d8a05cddfef6da4901b20d2698d5a71.png");
             img->SetWidth(kGridTileWidth);
             img->SetHeight(kGridTileHeight);
@@ -220,8 +199,8 @@ namespace inst::ui {
         return this->shopSections[this->selectedSectionIndex].id == "installed";
     }
 
-    const std::vector<shopInstStuff::ShopItem>& shopInstPage::getCurrentItems() const {
-        static const std::vector<shopInstStuff::ShopItem> empty;
+    const std::vector<shopInstStuff::ShopCatalog::Index>& shopInstPage::getCurrentItems() const {
+        static const std::vector<shopInstStuff::ShopCatalog::Index> empty;
         if (this->shopSections.empty())
             return empty;
         if (this->selectedSectionIndex < 0 || this->selectedSectionIndex >= (int)this->shopSections.size())
@@ -252,61 +231,52 @@ namespace inst::ui {
     }
 
     void shopInstPage::buildInstalledSection() {
-        std::vector<shopInstStuff::ShopItem> installedItems;
-        Result rc = nsInitialize();
-        if (R_FAILED(rc))
-            return;
-        rc = ncmInitialize();
-        if (R_FAILED(rc)) {
-            nsExit();
+        std::vector<shopInstStuff::ShopCatalog::Index> installedItems;
+        if (R_FAILED(nsInitialize()))
             return;
-        }
 
-        const s32 chunk = 64;
-        s32 offset = 0;
-        while (true) {
-            NsApplicationRecord records[chunk];
-            s32 outCount = 0;
-            rc = nsListApplicationRecord(records, chunk, offset, &outCount);
-            if (R_FAILED(rc) || outCount <= 0)
-                break;
+        auto& installed = tin::util::InstalledContentIndex::Get();
+        for (const u64 baseId : installed.GetInstalledBases()) {
+            tin::util::InstalledTitle title;
+            if (!installed.GetTitle(baseId, title))
+                continue;
 
-            for (s32 i = 0; i < outCount; i++) {
-                const u64 baseId = records[i].application_id;
-                if (!IsBaseTitleCurrentlyInstalled(baseId))
-                    continue;
-                shopInstStuff::ShopItem baseItem;
-                baseItem.name = tin::util::GetTitleName(baseId, NcmContentMetaType_Application);
-                baseItem.url = "";
-                baseItem.size = 0;
-                baseItem.titleId = baseId;
-                baseItem.hasTitleId = true;
-                baseItem.appType = NcmContentMetaType_Application;
-                installedItems.push_back(baseItem);
-
-                s32 metaCount = 0;
-                if (R_SUCCEEDED(nsCountApplicationContentMeta(baseId, &metaCount)) && metaCount > 0) {
-                    std::vector<NsApplicationContentMetaStatus> list(metaCount);
-                    s32 metaOut = 0;
-                    if (R_SUCCEEDED(nsListApplicationContentMetaStatus(baseId, 0, list.data(), metaCount, &metaOut)) && metaOut > 0) {
-                        for (s32 j = 0; j < metaOut; j++) {
-                            if (list[j].meta_type != NcmContentMetaType_Patch && list[j].meta_type != NcmContentMetaType_AddOnContent)
-                                continue;
-                            shopInstStuff::ShopItem item;
-                            item.titleId = list[j].application_id;
-                            item.hasTitleId = true;
-                            item.appVersion = list[j].version;
-                            item.hasAppVersion = true;
-                            item.appType = list[j].meta_type;
-                            item.name = tin::util::GetTitleName(item.titleId, static_cast<NcmContentMetaType>(item.appType));
-                            item.url = "";
-                            item.size = 0;
-                            installedItems.push_back(item);
-                        }
-                    }
-                }
+            // One control data read per title, updates and DLC share the base name
+            const std::string baseName = tin::util::GetBaseTitleName(baseId);
+            shopInstStuff::ShopItem baseItem;
+            baseItem.name = baseName;
+            baseItem.url = "";
+            baseItem.size = 0;
+            baseItem.titleId = baseId;
+            baseItem.hasTitleId = true;
+            baseItem.appType = NcmContentMetaType_Application;
+            installedItems.push_back(this->catalog.Add(baseItem));
+
+            if (title.hasPatch) {
+                shopInstStuff::ShopItem item;
+                item.titleId = baseId ^ 0x800;
+                item.hasTitleId = true;
+                item.appVersion = title.patchVersion;
+                item.hasAppVersion = true;
+                item.appType = NcmContentMetaType_Patch;
+                item.name = baseName + " (Update)";
+                item.url = "";
+                item.size = 0;
+                installedItems.push_back(this->catalog.Add(item));
+            }
+
+            for (const auto& addOn : title.addOns) {
+                shopInstStuff::ShopItem item;
+                item.titleId = addOn.titleId;
+                item.hasTitleId = true;
+                item.appVersion = addOn.version;
+                item.hasAppVersion = true;
+                item.appType = NcmContentMetaType_AddOnContent;
+                item.name = baseName + " (DLC)";
+                item.url = "";
+                item.size = 0;
+                installedItems.push_back(this->catalog.Add(item));
             }
-            offset += outCount;
         }
 
         nsExit();
@@ -314,8 +284,8 @@ namespace inst::ui {
         if (installedItems.empty())
             return;
 
-        std::sort(installedItems.begin(), installedItems.end(), [](const auto& a, const auto& b) {
-            return inst::util::ignoreCaseCompare(a.name, b.name);
+        std::sort(installedItems.begin(), installedItems.end(), [&](auto a, auto b) {
+            return inst::util::ignoreCaseCompare(std::string(this->catalog.GetName(a)), std::string(this->catalog.GetName(b)));
         });
 
         shopInstStuff::ShopSection installedSection;
@@ -339,55 +309,22 @@ namespace inst::ui {
         if (this->shopSections.empty())
             return;
 
-        Result rc = nsInitialize();
-        if (R_FAILED(rc))
-            return;
-
-        std::unordered_map<std::uint64_t, std::uint32_t> installedUpdateVersion;
-        std::unordered_map<std::uint64_t, bool> baseInstalled;
-
-        const s32 chunk = 64;
-        s32 offset = 0;
-        while (true) {
-            NsApplicationRecord records[chunk];
-            s32 outCount = 0;
-            if (R_FAILED(nsListApplicationRecord(records, chunk, offset, &outCount)) || outCount <= 0)
-                break;
-            for (s32 i = 0; i < outCount; i++) {
-                const auto titleId = records[i].application_id;
-                baseInstalled[titleId] = IsBaseTitleCurrentlyInstalled(titleId);
-            }
-            offset += outCount;
-        }
-
-        auto isBaseInstalled = [&](const shopInstStuff::ShopItem& item, std::uint32_t& outVersion) {
+        auto& installed = tin::util::InstalledContentIndex::Get();
+        const auto& catalog = this->catalog;
+        auto isBaseInstalled = [&](shopInstStuff::ShopCatalog::Index item, std::uint32_t& outVersion) {
             std::uint64_t baseTitleId = 0;
-            if (!DeriveBaseTitleId(item, baseTitleId))
+            if (!DeriveBaseTitleId(catalog, item, baseTitleId))
                 return false;
-            auto baseIt = baseInstalled.find(baseTitleId);
-            if (baseIt != baseInstalled.end()) {
-                if (baseIt->second) {
-                    auto verIt = installedUpdateVersion.find(baseTitleId);
-                    if (verIt != installedUpdateVersion.end()) {
-                        outVersion = verIt->second;
-                    } else {
-                        tin::util::GetInstalledUpdateVersion(baseTitleId, outVersion);
-                        if (outVersion == 0)
-                            TryGetInstalledUpdateVersionNcm(baseTitleId, outVersion);
-                        installedUpdateVersion[baseTitleId] = outVersion;
-                    }
-                }
-                return baseIt->second;
-            }
-            bool installed = IsBaseTitleCurrentlyInstalled(baseTitleId);
-            if (installed) {
-                tin::util::GetInstalledUpdateVersion(baseTitleId, outVersion);
-                if (outVersion == 0)
-                    TryGetInstalledUpdateVersionNcm(baseTitleId, outVersion);
-            }
-            baseInstalled[baseTitleId] = installed;
-            installedUpdateVersion[baseTitleId] = outVersion;
-            return installed;
+            if (!installed.IsBaseInstalled(baseTitleId))
+                return false;
+            installed.GetPatchVersion(baseTitleId, outVersion);
+            return true;
+        };
+        auto isContentInstalled = [&](shopInstStuff::ShopCatalog::Index item) {
+            if (!catalog.HasTitleId(item))
+                return false;
+            const auto titleId = catalog.GetTitleId(item);
+            return installed.IsAddOnInstalled(titleId) || installed.IsBaseInstalled(titleId);
         };
 
         for (auto& section : this->shopSections) {
@@ -396,19 +333,19 @@ namespace inst::ui {
             if (section.id != "updates" && section.id != "dlc")
                 continue;
 
-            std::vector<shopInstStuff::ShopItem> filtered;
+            std::vector<shopInstStuff::ShopCatalog::Index> filtered;
             filtered.reserve(section.items.size());
-            for (const auto& item : section.items) {
+            for (auto item : section.items) {
                 std::uint32_t installedVersion = 0;
                 if (!isBaseInstalled(item, installedVersion))
                     continue;
-                if (section.id == "updates" || item.appType == NcmContentMetaType_Patch) {
-                    if (!item.hasAppVersion)
+                if (section.id == "updates" || catalog.GetAppType(item) == NcmContentMetaType_Patch) {
+                    if (!catalog.HasAppVersion(item))
                         continue;
-                    if (item.appVersion > installedVersion)
+                    if (catalog.GetAppVersion(item) > installedVersion)
                         filtered.push_back(item);
                 } else {
-                    if (item.hasTitleId && tin::util::IsTitleInstalled(item.titleId))
+                    if (isContentInstalled(item))
                         continue;
                     filtered.push_back(item);
                 }
@@ -424,15 +361,15 @@ namespace inst::ui {
             if (section.id == "updates" || section.id == "dlc")
                 continue;
 
-            std::vector<shopInstStuff::ShopItem> filtered;
+            std::vector<shopInstStuff::ShopCatalog::Index> filtered;
             filtered.reserve(section.items.size());
-            for (const auto& item : section.items) {
-                if (item.appType != NcmContentMetaType_AddOnContent) {
+            for (auto item : section.items) {
+                if (catalog.GetAppType(item) != NcmContentMetaType_AddOnContent) {
                     filtered.push_back(item);
                     continue;
                 }
                 std::uint32_t installedVersion = 0;
-                if (item.hasTitleId && tin::util::IsTitleInstalled(item.titleId))
+                if (isContentInstalled(item))
                     continue;
                 if (isBaseInstalled(item, installedVersion))
                     filtered.push_back(item);
@@ -447,11 +384,11 @@ namespace inst::ui {
                 if (section.id == "all" || section.id == "installed" || section.id == "updates")
                     continue;
 
-                std::vector<shopInstStuff::ShopItem> filtered;
+                std::vector<shopInstStuff::ShopCatalog::Index> filtered;
                 filtered.reserve(section.items.size());
-                for (const auto& item : section.items) {
+                for (auto item : section.items) {
                     std::uint32_t installedVersion = 0;
-                    if (!IsBaseItem(item) || !item.hasTitleId || !isBaseInstalled(item, installedVersion)) {
+                    if (!IsBaseItem(catalog, item) || !catalog.HasTitleId(item) || !isBaseInstalled(item, installedVersion)) {
                         filtered.push_back(item);
                     }
                 }
@@ -459,34 +396,7 @@ namespace inst::ui {
             }
         }
 
-        auto hasSuffix = [](const std::string& text, const std::string& suffix) {
-            if (text.size() < suffix.size())
-                return false;
-            return text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
-        };
-
-        auto appendTypeLabels = [&](shopInstStuff::ShopSection& section) {
-            static const std::string kUpdateSuffix = " (Update)";
-            static const std::string kDlcSuffix = " (DLC)";
-            for (auto& item : section.items) {
-                if (item.appType == NcmContentMetaType_Patch) {
-                    if (!hasSuffix(item.name, kUpdateSuffix))
-                        item.name += kUpdateSuffix;
-                } else if (item.appType == NcmContentMetaType_AddOnContent) {
-                    if (!hasSuffix(item.name, kDlcSuffix))
-                        item.name += kDlcSuffix;
-                }
-            }
-        };
-
-        for (auto& section : this->shopSections) {
-            if (section.items.empty())
-                continue;
-            appendTypeLabels(section);
-        }
-
-        ncmExit();
-        nsExit();
+        this->catalog.SetTypeLabels(true);
     }
 
     void shopInstPage::updatePreview() {
@@ -504,20 +414,25 @@ namespace inst::ui {
         int selectedIndex = this->menu->GetSelectedIndex();
         if (selectedIndex < 0 || selectedIndex >= (int)this->visibleItems.size())
             return;
-        const auto& item = this->visibleItems[selectedIndex];
+        const auto itemIndex = this->visibleItems[selectedIndex];
 
         std::string key;
-        if (item.url.empty()) {
-            key = "installed:" + std::to_string(item.titleId);
-        } else if (item.hasIconUrl) {
-            key = item.iconUrl;
+        if (!this->catalog.HasUrl(itemIndex)) {
+            key = "installed:" + std::to_string(this->catalog.GetTitleId(itemIndex));
+        } else if (this->catalog.HasIconUrl(itemIndex)) {
+            key = this->catalog.GetIconUrl(itemIndex);
         } else {
-            key = item.url;
+            key = this->catalog.GetUrl(itemIndex);
         }
 
-        if (key == this->previewKey)
+        auto& icons = shopInstStuff::ShopIconService::Get();
+        u64 iconGeneration = icons.GetGeneration() + tin::util::TitleIconCache::Get().GetGeneration();
+        bool iconLanded = this->previewIconPending && iconGeneration != this->previewIconGeneration;
+        if (key == this->previewKey && !iconLanded)
             return;
         this->previewKey = key;
+        this->previewIconPending = false;
+        const auto item = this->catalog.GetItem(itemIndex);
 
         auto applyPreviewLayout = [&]() {
             this->previewImage->SetX(900);
@@ -527,63 +442,35 @@ namespace inst::ui {
         };
 
         if (item.url.empty()) {
-            Result rc = nsInitialize();
-            if (R_SUCCEEDED(rc)) {
-                u64 baseId = tin::util::GetBaseTitleId(item.titleId, static_cast<NcmContentMetaType>(item.appType));
-                NsApplicationControlData appControlData;
-                u64 sizeRead = 0;
-                if (R_SUCCEEDED(nsGetApplicationControlData(NsApplicationControlSource_Storage, baseId, &appControlData, sizeof(NsApplicationControlData), &sizeRead))) {
-                    u64 iconSize = 0;
-                    if (sizeRead > sizeof(appControlData.nacp))
-                        iconSize = sizeRead - sizeof(appControlData.nacp);
-                    if (iconSize > 0) {
-                        this->previewImage->SetJpegImage(appControlData.icon, iconSize);
-                        applyPreviewLayout();
-                        this->previewImage->SetVisible(true);
-                        nsExit();
-                        return;
-                    }
-                }
-                nsExit();
-            }
-            this->previewImage->SetImage("romfs:/images/awoos/7d8a05cddfef6da4901b20d2698d5a71.png");
+            auto& titleIcons = tin::util::TitleIconCache::Get();
+            this->previewIconGeneration = icons.GetGeneration() + titleIcons.GetGeneration();
+            tin::util::TitleIconCache::Icon icon;
+            this->previewIconPending = !titleIcons.Find(tin::util::GetBaseTitleId(item.titleId, static_cast<NcmContentMetaType>(item.appType)), icon);
+            if (icon && !icon->empty())
+                this->previewImage->SetJpegImage(icon->data(), icon->size());
+            else
+                this->previewImage->SetImage("romfs:/images/awoos/7d8a05cddfef6da4901b20d2698d5a71.png");
             applyPreviewLayout();
             this->previewImage->SetVisible(true);
             return;
         }
 
         if (item.hasIconUrl) {
-            std::string cacheDir = inst::config::appDir + "/shop_icons";
-            if (!std::filesystem::exists(cacheDir))
-                std::filesystem::create_directory(cacheDir);
-
-            std::string urlPath = item.iconUrl;
-            std::string ext = ".jpg";
-            auto queryPos = urlPath.find('?');
-            std::string cleanPath = queryPos == std::string::npos ? urlPath : urlPath.substr(0, queryPos);
-            auto dotPos = cleanPath.find_last_of('.');
-            if (dotPos != std::string::npos) {
-                std::string suffix = cleanPath.substr(dotPos);
-                if (suffix.size() <= 5 && suffix.find('/') == std::string::npos && suffix.find('?') == std::string::npos)
-                    ext = suffix;
-            }
-
-            std::string fileName;
-            if (item.hasTitleId)
-                fileName = std::to_string(item.titleId);
-            else
-                fileName = std::to_string(std::hash<std::string>{}(item.iconUrl));
-            std::string filePath = cacheDir + "/" + fileName + ext;
-
-            if (!std::filesystem::exists(filePath)) {
-                bool ok = inst::curl::downloadImageWithAuth(item.iconUrl, filePath.c_str(), inst::config::shopUser, inst::config::shopPass, 8000);
-                if (!ok) {
-                    if (std::filesystem::exists(filePath))
-                        std::filesystem::remove(filePath);
-                }
+            // Read before asking, so an icon landing in between still triggers a retry
+            this->previewIconGeneration = icons.GetGeneration() + tin::util::TitleIconCache::Get().GetGeneration();
+            std::string filePath = icons.Request(item.iconUrl, shopInstStuff::ShopIconService::GetCacheName(item.iconUrl, item.hasTitleId, item.titleId), shopInstStuff::ShopIconService::Priority::Visible);
+            this->previewIconPending = filePath.empty();
+
+            int prefetchEnd = std::min(selectedIndex + 1 + kIconPrefetchCount, (int)this->visibleItems.size());
+            for (int i = selectedIndex + 1; i < prefetchEnd; i++) {
+                const auto next = this->visibleItems[i];
+                if (!this->catalog.HasIconUrl(next))
+                    continue;
+                std::string iconUrl = this->catalog.GetIconUrl(next);
+                icons.Request(iconUrl, shopInstStuff::ShopIconService::GetCacheName(iconUrl, this->catalog.HasTitleId(next), this->catalog.GetTitleId(next)), shopInstStuff::ShopIconService::Priority::Prefetch);
             }
 
-            if (std::filesystem::exists(filePath)) {
+            if (!filePath.empty()) {
                 this->previewImage->SetImage(filePath);
                 applyPreviewLayout();
                 this->previewImage->SetVisible(true);
@@ -619,24 +506,19 @@ namespace inst::ui {
         int selectedIndex = this->isInstalledSection() ? this->gridSelectedIndex : this->menu->GetSelectedIndex();
         if (selectedIndex < 0 || selectedIndex >= (int)this->visibleItems.size())
             return;
-        const auto& item = this->visibleItems[selectedIndex];
+        const auto itemIndex = this->visibleItems[selectedIndex];
+        const auto item = this->catalog.GetItem(itemIndex);
 
         std::uint64_t baseTitleId = 0;
-        bool hasBase = DeriveBaseTitleId(item, baseTitleId);
+        bool hasBase = DeriveBaseTitleId(this->catalog, itemIndex, baseTitleId);
         bool installed = false;
         std::uint32_t installedVersion = 0;
 
         if (hasBase) {
-            if (R_SUCCEEDED(nsInitialize()) && R_SUCCEEDED(ncmInitialize())) {
-                installed = tin::util::IsTitleInstalled(baseTitleId);
-                if (installed) {
-                    tin::util::GetInstalledUpdateVersion(baseTitleId, installedVersion);
-                    if (installedVersion == 0)
-                        TryGetInstalledUpdateVersionNcm(baseTitleId, installedVersion);
-                }
-                ncmExit();
-                nsExit();
-            }
+            auto& index = tin::util::InstalledContentIndex::Get();
+            installed = index.IsBaseInstalled(baseTitleId);
+            if (installed)
+                index.GetPatchVersion(baseTitleId, installedVersion);
         }
 
         char baseBuf[32] = {0};
@@ -660,22 +542,16 @@ namespace inst::ui {
     }
 
     void shopInstPage::drawMenuItems(bool clearItems) {
-        if (clearItems) this->selectedItems.clear();
-        this->menu->ClearItems();
-        this->visibleItems.clear();
-        const auto& items = this->getCurrentItems();
-        if (this->isAllSection() && !this->searchQuery.empty()) {
-            for (const auto& item : items) {
-                std::string name = item.name;
-                std::string query = this->searchQuery;
-                std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-                std::transform(query.begin(), query.end(), query.begin(), ::tolower);
-                if (name.find(query) != std::string::npos)
-                    this->visibleItems.push_back(item);
-            }
-        } else {
-            this->visibleItems = items;
+        if (clearItems) {
+            this->selectedItems.clear();
+            this->selectedLookup.clear();
         }
+        this->menu->ClearItems();
+        shopInstStuff::ShopIconService::Get().CancelPrefetch();
+        if (this->isAllSection() && !this->searchQuery.empty())
+            this->visibleItems = this->searchIndex.Search(this->searchQuery);
+        else
+            this->visibleItems = this->getCurrentItems();
 
         if (this->isInstalledSection()) {
             this->menu->SetVisible(false);
@@ -691,17 +567,13 @@ namespace inst::ui {
         this->gridHighlight->SetVisible(false);
         this->menu->SetVisible(true);
 
-        for (const auto& item : this->visibleItems) {
-            std::string itm = inst::util::shortenString(item.name, 56, true);
+        for (auto item : this->visibleItems) {
+            std::string itm = inst::util::shortenString(this->catalog.GetDisplayName(item), 56, true);
             auto entry = pu::ui::elm::MenuItem::New(itm);
             entry->SetColor(COLOR("#FFFFFFFF"));
             entry->SetIcon("romfs:/images/icons/checkbox-blank-outline.png");
-            for (const auto& selected : this->selectedItems) {
-                if (selected.url == item.url) {
-                    entry->SetIcon("romfs:/images/icons/check-box-outline.png");
-                    break;
-                }
-            }
+            if (this->selectedLookup.count(item))
+                entry->SetIcon("romfs:/images/icons/check-box-outline.png");
             this->menu->AddItem(entry);
         }
 
@@ -712,6 +584,17 @@ namespace inst::ui {
         }
     }
 
+    void shopInstPage::resetGridSlots() {
+        for (auto& img : this->gridImages)
+            img->SetVisible(false);
+        for (auto& state : this->gridSlots)
+            state = GridSlot{};
+        this->gridSlotByItem.clear();
+        this->gridSlotCounter = 0;
+        this->gridIconsPending = false;
+        this->gridPage = -1;
+    }
+
     void shopInstPage::updateInstalledGrid() {
         if (!this->isInstalledSection()) {
             for (auto& img : this->gridImages)
@@ -740,51 +623,94 @@ namespace inst::ui {
         int pageStart = page * kGridItemsPerPage;
         int maxIndex = (int)this->visibleItems.size();
 
-        if (page != this->gridPage) {
-            bool nsReady = R_SUCCEEDED(nsInitialize());
-            for (int i = 0; i < kGridItemsPerPage; i++) {
-                int itemIndex = pageStart + i;
-                int row = i / kGridCols;
-                int col = i % kGridCols;
-                int x = kGridStartX + (col * (kGridTileWidth + kGridGap));
-                int y = kGridStartY + (row * (kGridTileHeight + kGridGap));
-                this->gridImages[i]->SetX(x);
-                this->gridImages[i]->SetY(y);
-
-                if (itemIndex >= maxIndex) {
-                    this->gridImages[i]->SetVisible(false);
-                    continue;
+        auto& titleIcons = tin::util::TitleIconCache::Get();
+        u64 iconGeneration = titleIcons.GetGeneration();
+        bool iconLanded = this->gridIconsPending && iconGeneration != this->gridIconGeneration;
+        if (page != this->gridPage || iconLanded) {
+            // Read before asking, so an icon landing in between still triggers another pass
+            this->gridIconGeneration = iconGeneration;
+            this->gridIconsPending = false;
+            int pageEnd = std::min(pageStart + kGridItemsPerPage, maxIndex);
+            std::vector<int> pageSlots(pageEnd - pageStart, -1);
+            std::vector<bool> slotOnPage(this->gridSlots.size(), false);
+            for (int i = pageStart; i < pageEnd; i++) {
+                auto found = this->gridSlotByItem.find(this->visibleItems[i]);
+                if (found != this->gridSlotByItem.end()) {
+                    pageSlots[i - pageStart] = found->second;
+                    slotOnPage[found->second] = true;
                 }
+            }
 
-                const auto& item = this->visibleItems[itemIndex];
-                bool applied = false;
-                if (nsReady && item.hasTitleId) {
-                    u64 baseId = tin::util::GetBaseTitleId(item.titleId, static_cast<NcmContentMetaType>(item.appType));
-                    NsApplicationControlData appControlData;
-                    u64 sizeRead = 0;
-                    if (R_SUCCEEDED(nsGetApplicationControlData(NsApplicationControlSource_Storage, baseId, &appControlData, sizeof(NsApplicationControlData), &sizeRead))) {
-                        u64 iconSize = 0;
-                        if (sizeRead > sizeof(appControlData.nacp))
-                            iconSize = sizeRead - sizeof(appControlData.nacp);
-                        if (iconSize > 0) {
-                            this->gridImages[i]->SetJpegImage(appControlData.icon, iconSize);
-                            this->gridImages[i]->SetWidth(kGridTileWidth);
-                            this->gridImages[i]->SetHeight(kGridTileHeight);
-                            applied = true;
-                        }
+            // Icons are decoded here on the UI thread, see TitleIconCache, so the cost is logged
+            int iconsDecoded = 0;
+            u64 decodeTicks = 0;
+            for (int i = pageStart; i < pageEnd; i++) {
+                const auto item = this->visibleItems[i];
+                int& slot = pageSlots[i - pageStart];
+                if (slot < 0) {
+                    // Take the tile shown longest ago that isn't needed on this page
+                    for (int s = 0; s < (int)this->gridSlots.size(); s++) {
+                        if (slotOnPage[s])
+                            continue;
+                        if (slot < 0 || this->gridSlots[s].lastUsed < this->gridSlots[slot].lastUsed)
+                            slot = s;
                     }
+                    auto& reused = this->gridSlots[slot];
+                    if (reused.assigned)
+                        this->gridSlotByItem.erase(reused.item);
+                    reused = GridSlot{item, 0, true, false, false};
+                    this->gridSlotByItem[item] = slot;
+                    slotOnPage[slot] = true;
                 }
 
-                if (!applied) {
-                    this->gridImages[i]->SetImage("romfs:/images/awoos/7d8a05cddfef6da4901b20d2698d5a71.png");
-                    this->gridImages[i]->SetWidth(kGridTileWidth);
-                    this->gridImages[i]->SetHeight(kGridTileHeight);
+                auto& state = this->gridSlots[slot];
+                auto& img = this->gridImages[slot];
+                state.lastUsed = ++this->gridSlotCounter;
+                if (!state.iconResolved) {
+                    tin::util::TitleIconCache::Icon icon;
+                    if (!this->catalog.HasTitleId(item))
+                        state.iconResolved = true;
+                    else if (titleIcons.Find(tin::util::GetBaseTitleId(this->catalog.GetTitleId(item), static_cast<NcmContentMetaType>(this->catalog.GetAppType(item))), icon))
+                        state.iconResolved = true;
+                    else
+                        this->gridIconsPending = true;
+
+                    if (icon && !icon->empty()) {
+                        u64 decodeStart = armGetSystemTick();
+                        img->SetJpegImage(icon->data(), icon->size());
+                        decodeTicks += armGetSystemTick() - decodeStart;
+                        iconsDecoded++;
+                        img->SetWidth(kGridTileWidth);
+                        img->SetHeight(kGridTileHeight);
+                    } else if (!state.placeholderSet) {
+                        img->SetImage("romfs:/images/awoos/7d8a05cddfef6da4901b20d2698d5a71.png");
+                        img->SetWidth(kGridTileWidth);
+                        img->SetHeight(kGridTileHeight);
+                        state.placeholderSet = true;
+                    }
                 }
 
-                this->gridImages[i]->SetVisible(true);
+                int row = (i - pageStart) / kGridCols;
+                int col = (i - pageStart) % kGridCols;
+                img->SetX(kGridStartX + (col * (kGridTileWidth + kGridGap)));
+                img->SetY(kGridStartY + (row * (kGridTileHeight + kGridGap)));
+            }
+
+            for (int s = 0; s < (int)this->gridSlots.size(); s++)
+                this->gridImages[s]->SetVisible(slotOnPage[s]);
+            if (iconsDecoded)
+                LOG_DEBUG("Decoded %d title icons in %lu us\n", iconsDecoded, armTicksToNs(decodeTicks) / 1000);
+
+            // Have the pages either side of this one read while it's being looked at
+            std::vector<u64> neighbours;
+            int prefetchStart = std::max(0, pageStart - kGridItemsPerPage);
+            int prefetchEnd = std::min(maxIndex, pageEnd + kGridItemsPerPage);
+            for (int i = prefetchStart; i < prefetchEnd; i++) {
+                const auto item = this->visibleItems[i];
+                if ((i < pageStart || i >= pageEnd) && this->catalog.HasTitleId(item))
+                    neighbours.push_back(tin::util::GetBaseTitleId(this->catalog.GetTitleId(item), static_cast<NcmContentMetaType>(this->catalog.GetAppType(item))));
             }
-            if (nsReady)
-                nsExit();
+            titleIcons.Prefetch(neighbours);
             this->gridPage = page;
         }
 
@@ -804,7 +730,7 @@ namespace inst::ui {
         }
 
         if (this->gridSelectedIndex >= 0 && this->gridSelectedIndex < (int)this->visibleItems.size()) {
-            std::string title = inst::util::shortenString(this->visibleItems[this->gridSelectedIndex].name, 70, true);
+            std::string title = inst::util::shortenString(this->catalog.GetDisplayName(this->visibleItems[this->gridSelectedIndex]), 70, true);
             this->gridTitleText->SetText(title);
             this->gridTitleText->SetVisible(true);
         } else {
@@ -812,21 +738,21 @@ namespace inst::ui {
         }
     }
 
-    void shopInstPage::selectTitle(int selectedIndex) {
+    void shopInstPage::selectTitle(int selectedIndex, bool redraw) {
         if (selectedIndex < 0 || selectedIndex >= (int)this->visibleItems.size())
             return;
-        const auto& item = this->visibleItems[selectedIndex];
-        if (item.url.empty())
+        const auto item = this->visibleItems[selectedIndex];
+        if (!this->catalog.HasUrl(item))
             return;
-        auto selected = std::find_if(this->selectedItems.begin(), this->selectedItems.end(), [&](const auto& entry) {
-            return entry.url == item.url;
-        });
-        if (selected != this->selectedItems.end())
-            this->selectedItems.erase(selected);
-        else
+        if (this->selectedLookup.erase(item))
+            this->selectedItems.erase(std::find(this->selectedItems.begin(), this->selectedItems.end(), item));
+        else {
             this->selectedItems.push_back(item);
+            this->selectedLookup.insert(item);
+        }
         this->updateRememberedSelection();
-        this->drawMenuItems(false);
+        if (redraw)
+            this->drawMenuItems(false);
     }
 
     void shopInstPage::updateRememberedSelection() {
@@ -842,19 +768,28 @@ namespace inst::ui {
         mainApp->LoadLayout(mainApp->shopinstPage);
         mainApp->CallForRender();
 
-        std::string shopUrl = inst::config::shopUrl;
-        if (shopUrl.empty()) {
-            shopUrl = inst::util::softwareKeyboard("options.shop.url_hint"_lang, "http://", 200);
+        auto shops = shopInstStuff::GetShopProfiles();
+        if (shops.empty()) {
+            std::string shopUrl = inst::util::softwareKeyboard("options.shop.url_hint"_lang, "http://", 200);
             if (shopUrl.empty()) {
                 mainApp->LoadLayout(mainApp->mainPage);
                 return;
             }
             inst::config::shopUrl = shopUrl;
             inst::config::setConfig();
+            shops = shopInstStuff::GetShopProfiles();
         }
 
         std::string error;
-        this->shopSections = shopInstStuff::FetchShopSections(shopUrl, inst::config::shopUser, inst::config::shopPass, error, !forceRefresh);
+        this->selectedItems.clear();
+        this->selectedLookup.clear();
+        this->visibleItems.clear();
+        this->availableUpdates.clear();
+        this->searchIndex.Clear();
+        this->catalog.Clear();
+        this->resetGridSlots();
+        shopInstStuff::ShopIconService::Get().ClearFailures();
+        this->shopSections = shopInstStuff::FetchShopSections(shops, this->catalog, error, !forceRefresh);
         if (!error.empty()) {
             mainApp->CreateShowDialog("inst.shop.failed"_lang, error, {"common.ok"_lang}, true);
             mainApp->LoadLayout(mainApp->mainPage);
@@ -866,14 +801,22 @@ namespace inst::ui {
             return;
         }
 
-        std::string motd = shopInstStuff::FetchShopMotd(shopUrl, inst::config::shopUser, inst::config::shopPass);
+        std::string motd = shopInstStuff::FetchShopMotd(shops.front().url, shops.front().user, shops.front().pass);
         if (!motd.empty())
             mainApp->CreateShowDialog("inst.shop.motd_title"_lang, motd, {"common.ok"_lang}, true);
 
+        // Things may have changed outside the app since the last visit
+        tin::util::InstalledContentIndex::Get().Refresh();
         if (!inst::config::shopHideInstalledSection)
             this->buildInstalledSection();
         this->cacheAvailableUpdates();
         this->filterOwnedSections();
+        for (const auto& section : this->shopSections) {
+            if (section.id == "all") {
+                this->searchIndex.Build(this->catalog, section.items);
+                break;
+            }
+        }
 
         this->selectedSectionIndex = 0;
         for (size_t i = 0; i < this->shopSections.size(); i++) {
@@ -887,6 +830,7 @@ namespace inst::ui {
         this->updateSectionText();
         this->updateButtonsText();
         this->selectedItems.clear();
+        this->selectedLookup.clear();
         this->drawMenuItems(false);
         this->menu->SetSelectedIndex(0);
         this->infoImage->SetVisible(false);
@@ -896,32 +840,31 @@ namespace inst::ui {
 
     void shopInstPage::startInstall() {
         if (!this->selectedItems.empty()) {
-            std::vector<shopInstStuff::ShopItem> updatesToAdd;
-            std::unordered_map<std::uint64_t, shopInstStuff::ShopItem> latestUpdates;
-            for (const auto& update : this->availableUpdates) {
-                if (update.appType != NcmContentMetaType_Patch || !update.hasAppVersion)
+            std::vector<shopInstStuff::ShopCatalog::Index> updatesToAdd;
+            std::unordered_map<std::uint64_t, shopInstStuff::ShopCatalog::Index> latestUpdates;
+            for (auto update : this->availableUpdates) {
+                if (this->catalog.GetAppType(update) != NcmContentMetaType_Patch || !this->catalog.HasAppVersion(update))
                     continue;
                 std::uint64_t baseTitleId = 0;
-                if (!DeriveBaseTitleId(update, baseTitleId))
+                if (!DeriveBaseTitleId(this->catalog, update, baseTitleId))
                     continue;
                 auto it = latestUpdates.find(baseTitleId);
-                if (it == latestUpdates.end() || update.appVersion > it->second.appVersion)
+                if (it == latestUpdates.end() || this->catalog.GetAppVersion(update) > this->catalog.GetAppVersion(it->second))
                     latestUpdates[baseTitleId] = update;
             }
 
-            for (const auto& item : this->selectedItems) {
-                if (!IsBaseItem(item))
+            for (auto item : this->selectedItems) {
+                if (!IsBaseItem(this->catalog, item))
                     continue;
                 std::uint64_t baseTitleId = 0;
-                if (!DeriveBaseTitleId(item, baseTitleId))
+                if (!DeriveBaseTitleId(this->catalog, item, baseTitleId))
                     continue;
                 auto updateIt = latestUpdates.find(baseTitleId);
                 if (updateIt == latestUpdates.end())
                     continue;
-                bool alreadySelected = std::any_of(this->selectedItems.begin(), this->selectedItems.end(), [&](const auto& entry) {
-                    return entry.url == updateIt->second.url;
-                });
-                if (!alreadySelected && !updateIt->second.url.empty())
+                bool alreadySelected = this->selectedLookup.count(updateIt->second)
+                    || std::find(updatesToAdd.begin(), updatesToAdd.end(), updateIt->second) != updatesToAdd.end();
+                if (!alreadySelected && this->catalog.HasUrl(updateIt->second))
                     updatesToAdd.push_back(updateIt->second);
             }
 
@@ -930,15 +873,17 @@ namespace inst::ui {
                     "inst.shop.update_prompt_desc"_lang + std::to_string(updatesToAdd.size()),
                     {"common.yes"_lang, "common.no"_lang}, false);
                 if (res == 0) {
-                    for (const auto& update : updatesToAdd)
+                    for (const auto& update : updatesToAdd) {
                         this->selectedItems.push_back(update);
+                        this->selectedLookup.insert(update);
+                    }
                 }
             }
         }
 
         int dialogResult = -1;
         if (this->selectedItems.size() == 1) {
-            std::string name = inst::util::shortenString(this->selectedItems[0].name, 32, true);
+            std::string name = inst::util::shortenString(this->catalog.GetDisplayName(this->selectedItems[0]), 32, true);
             dialogResult = mainApp->CreateShowDialog("inst.target.desc0"_lang + name + "inst.target.desc1"_lang, "common.cancel_desc"_lang, {"inst.target.opt0"_lang, "inst.target.opt1"_lang}, false);
         } else {
             dialogResult = mainApp->CreateShowDialog("inst.target.desc00"_lang + std::to_string(this->selectedItems.size()) + "inst.target.desc01"_lang, "common.cancel_desc"_lang, {"inst.target.opt0"_lang, "inst.target.opt1"_lang}, false);
@@ -947,7 +892,11 @@ namespace inst::ui {
             return;
 
         this->updateRememberedSelection();
-        shopInstStuff::installTitleShop(this->selectedItems, dialogResult, "inst.shop.source_string"_lang);
+        std::vector<shopInstStuff::ShopItem> items;
+        items.reserve(this->selectedItems.size());
+        for (auto item : this->selectedItems)
+            items.push_back(this->catalog.GetItem(item));
+        shopInstStuff::installTitleShop(items, dialogResult, "inst.shop.source_string"_lang);
     }
 
     void shopInstPage::onInput(u64 Down, u64 Up, u64 Held, pu::ui::Touch Pos) {
@@ -1028,7 +977,7 @@ namespace inst::ui {
                 } else {
                     for (long unsigned int i = 0; i < this->menu->GetItems().size(); i++) {
                         if (this->menu->GetItems()[i]->GetIcon() == "romfs:/images/icons/check-box-outline.png") continue;
-                        this->selectTitle(i);
+                        this->selectTitle(i, false);
                     }
                     this->drawMenuItems(false);
                 }
@@ -1055,7 +1004,7 @@ namespace inst::ui {
             return;
         if (this->gridSelectedIndex < 0 || this->gridSelectedIndex >= (int)this->visibleItems.size())
             return;
-        const auto& item = this->visibleItems[this->gridSelectedIndex];
+        const auto item = this->catalog.GetItem(this->visibleItems[this->gridSelectedIndex]);
 
         const char* typeLabel = "Base";
         if (item.appType == NcmContentMetaType_Patch)
@@ -10,8 +10,11 @@ namespace inst::config {
     std::string shopUrl;
     std::string shopUser;
     std::string shopPass;
+    std::vector<ShopProfile> shopProfiles;
     std::vector<std::string> updateInfo;
     int languageSetting;
+    int httpRetries;
+    int httpStallSeconds;
     bool autoUpdate;
     bool deletePrompt;
     bool gayMode;
@@ -21,10 +24,16 @@ namespace inst::config {
     bool overClock;
     bool usbAck;
     bool validateNCAs;
+    bool installStats;
     bool shopHideInstalled;
     bool shopHideInstalledSection;
+    bool shopBackgroundRefresh;
+    int shopIconCacheMB;
 
     void setConfig() {
+        nlohmann::json profiles = nlohmann::json::array();
+        for (const auto& profile : shopProfiles)
+            profiles.push_back({{"url", profile.url}, {"user", profile.user}, {"pass", profile.pass}});
         nlohmann::json j = {
             {"autoUpdate", autoUpdate},
             {"deletePrompt", deletePrompt},
@@ -34,16 +43,22 @@ namespace inst::config {
             {"oledMode", oledMode},
             {"ignoreReqVers", ignoreReqVers},
             {"languageSetting", languageSetting},
+            {"httpRetries", httpRetries},
+            {"httpStallSeconds", httpStallSeconds},
             {"overClock", overClock},
             {"sigPatchesUrl", sigPatchesUrl},
             {"usbAck", usbAck},
             {"validateNCAs", validateNCAs},
+            {"installStats", installStats},
             {"lastNetUrl", lastNetUrl},
             {"shopUrl", shopUrl},
             {"shopUser", shopUser},
             {"shopPass", shopPass},
+            {"shopProfiles", profiles},
             {"shopHideInstalled", shopHideInstalled},
             {"shopHideInstalledSection", shopHideInstalledSection},
+            {"shopBackgroundRefresh", shopBackgroundRefresh},
+            {"shopIconCacheMB", shopIconCacheMB},
             {"shopRememberSelection", false},
             {"shopSelection", nlohmann::json::array()}
         };
@@ -55,6 +70,8 @@ namespace inst::config {
         gAuthKey = {0x41,0x49,0x7a,0x61,0x53,0x79,0x42,0x4d,0x71,0x76,0x34,0x64,0x58,0x6e,0x54,0x4a,0x4f,0x47,0x51,0x74,0x5a,0x5a,0x53,0x33,0x43,0x42,0x6a,0x76,0x66,0x37,0x34,0x38,0x51,0x76,0x78,0x53,0x7a,0x46,0x30};
         sigPatchesUrl = "https://sigmapatches.coomer.party/sigpatches.zip";
         languageSetting = 99;
+        httpRetries = 5;
+        httpStallSeconds = 30;
         autoUpdate = true;
         deletePrompt = true;
         gayMode = true;
@@ -64,12 +81,16 @@ namespace inst::config {
         overClock = false;
         usbAck = false;
         validateNCAs = true;
+        installStats = false;
         lastNetUrl = "https://";
         shopUrl.clear();
         shopUser.clear();
         shopPass.clear();
+        shopProfiles.clear();
         shopHideInstalled = false;
         shopHideInstalledSection = false;
+        shopBackgroundRefresh = false;
+        shopIconCacheMB = 64;
 
         try {
             std::ifstream file(inst::config::configPath);
@@ -83,16 +104,30 @@ namespace inst::config {
             if (j.contains("oledMode")) oledMode = j["oledMode"].get<bool>();
             if (j.contains("ignoreReqVers")) ignoreReqVers = j["ignoreReqVers"].get<bool>();
             if (j.contains("languageSetting")) languageSetting = j["languageSetting"].get<int>();
+            if (j.contains("httpRetries")) httpRetries = j["httpRetries"].get<int>();
+            if (j.contains("httpStallSeconds")) httpStallSeconds = j["httpStallSeconds"].get<int>();
             if (j.contains("overClock")) overClock = j["overClock"].get<bool>();
             if (j.contains("sigPatchesUrl")) sigPatchesUrl = j["sigPatchesUrl"].get<std::string>();
             if (j.contains("usbAck")) usbAck = j["usbAck"].get<bool>();
             if (j.contains("validateNCAs")) validateNCAs = j["validateNCAs"].get<bool>();
+            if (j.contains("installStats")) installStats = j["installStats"].get<bool>();
             if (j.contains("lastNetUrl")) lastNetUrl = j["lastNetUrl"].get<std::string>();
             if (j.contains("shopUrl")) shopUrl = j["shopUrl"].get<std::string>();
             if (j.contains("shopUser")) shopUser = j["shopUser"].get<std::string>();
             if (j.contains("shopPass")) shopPass = j["shopPass"].get<std::string>();
+            if (j.contains("shopProfiles")) {
+                for (const auto& profile : j["shopProfiles"]) {
+                    ShopProfile shop;
+                    shop.url = profile.value("url", "");
+                    shop.user = profile.value("user", "");
+                    shop.pass = profile.value("pass", "");
+                    shopProfiles.push_back(shop);
+                }
+            }
             if (j.contains("shopHideInstalled")) shopHideInstalled = j["shopHideInstalled"].get<bool>();
             if (j.contains("shopHideInstalledSection")) shopHideInstalledSection = j["shopHideInstalledSection"].get<bool>();
+            if (j.contains("shopBackgroundRefresh")) shopBackgroundRefresh = j["shopBackgroundRefresh"].get<bool>();
+            if (j.contains("shopIconCacheMB")) shopIconCacheMB = j["shopIconCacheMB"].get<int>();
         }
         catch (...) {
             // If loading values from the config fails, we just load the defaults and overwrite the old config
@@ -0,0 +1,189 @@
+#include "util/installed_content.hpp"
+
+#include <algorithm>
+#include "util/error.hpp"
+#include "util/title_util.hpp"
+
+namespace tin::util
+{
+    // Application ids are 0x2000 aligned, the update and every DLC of a title fall in that block
+    static const u64 TITLE_ID_BLOCK_SIZE = 0x2000;
+
+    static void ListContentMetaKeys(u64 idMin, u64 idMax, std::vector<NcmContentMetaKey>& out)
+    {
+        const NcmStorageId storages[] = {NcmStorageId_BuiltInUser, NcmStorageId_SdCard};
+
+        for (auto storage : storages)
+        {
+            NcmContentMetaDatabase db;
+
+            if (R_FAILED(ncmOpenContentMetaDatabase(&db, storage)))
+                continue;
+
+            // Asked once with a guess, then once more with room for the total if it didn't fit
+            std::vector<NcmContentMetaKey> keys(256);
+            s32 total = 0;
+            s32 written = 0;
+            Result rc = ncmContentMetaDatabaseList(&db, &total, &written, keys.data(), (s32)keys.size(), NcmContentMetaType_Unknown, 0, idMin, idMax, NcmContentInstallType_Full);
+
+            if (R_SUCCEEDED(rc) && total > written)
+            {
+                keys.resize(total);
+                rc = ncmContentMetaDatabaseList(&db, &total, &written, keys.data(), (s32)keys.size(), NcmContentMetaType_Unknown, 0, idMin, idMax, NcmContentInstallType_Full);
+            }
+
+            if (R_SUCCEEDED(rc))
+                out.insert(out.end(), keys.begin(), keys.begin() + written);
+            else
+                LOG_DEBUG("Failed to list content meta on storage %u: 0x%08x\n", storage, rc);
+
+            ncmContentMetaDatabaseClose(&db);
+        }
+    }
+
+    InstalledContentIndex& InstalledContentIndex::Get()
+    {
+        static InstalledContentIndex index;
+        return index;
+    }
+
+    void InstalledContentIndex::AddKey(const NcmContentMetaKey& key)
+    {
+        const auto type = static_cast<NcmContentMetaType>(key.type);
+
+        if (type != NcmContentMetaType_Application && type != NcmContentMetaType_Patch && type != NcmContentMetaType_AddOnContent)
+            return;
+
+        InstalledTitle& title = m_titles[GetBaseTitleId(key.id, type)];
+
+        if (type == NcmContentMetaType_Application)
+        {
+            title.hasBase = true;
+            title.baseVersion = std::max(title.baseVersion, key.version);
+        }
+        else if (type == NcmContentMetaType_Patch)
+        {
+            title.hasPatch = true;
+            title.patchVersion = std::max(title.patchVersion, key.version);
+        }
+        else
+        {
+            auto addOn = std::find_if(title.addOns.begin(), title.addOns.end(), [&](const InstalledAddOn& entry) {
+                return entry.titleId == key.id;
+            });
+
+            if (addOn == title.addOns.end())
+                title.addOns.push_back({key.id, key.version});
+            else
+                addOn->version = std::max(addOn->version, key.version);
+        }
+    }
+
+    void InstalledContentIndex::Load()
+    {
+        if (m_loaded)
+            return;
+
+        if (R_FAILED(ncmInitialize()))
+            return;
+
+        std::vector<NcmContentMetaKey> keys;
+        ListContentMetaKeys(0, UINT64_MAX, keys);
+        ncmExit();
+
+        m_titles.clear();
+        for (auto& key : keys)
+            this->AddKey(key);
+
+        m_loaded = true;
+        LOG_DEBUG("Indexed %zu content meta keys for %zu titles\n", keys.size(), m_titles.size());
+    }
+
+    void InstalledContentIndex::Refresh()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_loaded = false;
+        this->Load();
+    }
+
+    void InstalledContentIndex::RefreshTitle(u64 baseTitleId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Nothing to patch up yet, the first query lists everything anyway
+        if (!m_loaded)
+            return;
+
+        if (R_FAILED(ncmInitialize()))
+        {
+            m_loaded = false;
+            return;
+        }
+
+        std::vector<NcmContentMetaKey> keys;
+        ListContentMetaKeys(baseTitleId, baseTitleId + TITLE_ID_BLOCK_SIZE - 1, keys);
+        ncmExit();
+
+        m_titles.erase(baseTitleId);
+        for (auto& key : keys)
+            this->AddKey(key);
+    }
+
+    bool InstalledContentIndex::IsBaseInstalled(u64 baseTitleId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        this->Load();
+        auto it = m_titles.find(baseTitleId);
+        return it != m_titles.end() && it->second.hasBase;
+    }
+
+    bool InstalledContentIndex::GetPatchVersion(u64 baseTitleId, u32& outVersion)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        this->Load();
+        outVersion = 0;
+        auto it = m_titles.find(baseTitleId);
+        if (it == m_titles.end() || !it->second.hasPatch)
+            return false;
+        outVersion = it->second.patchVersion;
+        return true;
+    }
+
+    bool InstalledContentIndex::IsAddOnInstalled(u64 addOnTitleId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        this->Load();
+        auto it = m_titles.find(GetBaseTitleId(addOnTitleId, NcmContentMetaType_AddOnContent));
+        if (it == m_titles.end())
+            return false;
+        const auto& addOns = it->second.addOns;
+        return std::any_of(addOns.begin(), addOns.end(), [&](const InstalledAddOn& entry) {
+            return entry.titleId == addOnTitleId;
+        });
+    }
+
+    bool InstalledContentIndex::GetTitle(u64 baseTitleId, InstalledTitle& out)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        this->Load();
+        auto it = m_titles.find(baseTitleId);
+        if (it == m_titles.end())
+            return false;
+        out = it->second;
+        return true;
+    }
+
+    std::vector<u64> InstalledContentIndex::GetInstalledBases()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        this->Load();
+        std::vector<u64> bases;
+        bases.reserve(m_titles.size());
+        for (const auto& entry : m_titles)
+        {
+            if (entry.second.hasBase)
+                bases.push_back(entry.first);
+        }
+        return bases;
+    }
+}
@@ -25,8 +25,13 @@ SOFTWARE.
 #include <switch.h>
 #include <curl/curl.h>
 #include <algorithm>
+#include <cctype>
 #include <cstring>
+#include <deque>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
+#include "util/config.hpp"
 #include "util/error.hpp"
 #include "ui/MainApplication.hpp"
 
@@ -36,20 +41,130 @@ namespace inst::ui {
 
 namespace tin::network
 {
-    static std::string g_basic_auth_user;
-    static std::string g_basic_auth_pass;
-    static bool g_basic_auth_set = false;
+    // Basic auth credentials by origin, so every shop gets its own login and other servers get none
+    static std::mutex g_basicAuthMutex;
+    static std::unordered_map<std::string, std::string> g_basicAuth;
 
-    static void ApplyBasicAuth(CURL* curl, std::string& authValue)
+    static std::string GetUrlOrigin(const std::string& url)
     {
-        if (!g_basic_auth_set)
+        size_t schemeEnd = url.find("://");
+        size_t hostStart = (schemeEnd == std::string::npos) ? 0 : schemeEnd + 3;
+        std::string origin = url.substr(0, url.find_first_of("/?#", hostStart));
+        std::transform(origin.begin(), origin.end(), origin.begin(), [](unsigned char c) { return std::tolower(c); });
+        return origin;
+    }
+
+    static void ApplyBasicAuth(CURL* curl, const std::string& url, std::string& authValue)
+    {
+        if (!GetBasicAuth(url, authValue))
             return;
 
-        authValue = g_basic_auth_user + ":" + g_basic_auth_pass;
         curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
         curl_easy_setopt(curl, CURLOPT_USERPWD, authValue.c_str());
     }
 
+    // Connection pool
+    // Easy handles are kept around between requests rather than cleaned up, and all of them share
+    // the DNS cache, TLS sessions and open connections. Requests to the same server, including the
+    // parallel ones, then reuse a kept alive connection instead of paying for a new TCP and TLS handshake.
+
+    static const size_t MAX_IDLE_CURL_HANDLES = 8;
+    static const long CONNECT_TIMEOUT_SECONDS = 10;
+
+    static std::mutex g_poolMutex;
+    static std::vector<CURL*> g_idleCurlHandles;
+    static CURLSH* g_curlShare = NULL;
+    static std::mutex g_shareMutexes[CURL_LOCK_DATA_LAST];
+
+    static void LockShare(CURL* curl, curl_lock_data data, curl_lock_access access, void* userPtr)
+    {
+        g_shareMutexes[data].lock();
+    }
+
+    static void UnlockShare(CURL* curl, curl_lock_data data, void* userPtr)
+    {
+        g_shareMutexes[data].unlock();
+    }
+
+    CURL* AcquireCurl()
+    {
+        CURL* curl = NULL;
+
+        {
+            std::lock_guard<std::mutex> lock(g_poolMutex);
+
+            if (!g_curlShare)
+            {
+                g_curlShare = curl_share_init();
+
+                if (g_curlShare)
+                {
+                    curl_share_setopt(g_curlShare, CURLSHOPT_LOCKFUNC, &LockShare);
+                    curl_share_setopt(g_curlShare, CURLSHOPT_UNLOCKFUNC, &UnlockShare);
+                    curl_share_setopt(g_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+                    curl_share_setopt(g_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+                    curl_share_setopt(g_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+                }
+            }
+
+            if (!g_idleCurlHandles.empty())
+            {
+                curl = g_idleCurlHandles.back();
+                g_idleCurlHandles.pop_back();
+            }
+        }
+
+        if (!curl)
+            curl = curl_easy_init();
+
+        if (curl)
+        {
+            if (g_curlShare)
+                curl_easy_setopt(curl, CURLOPT_SHARE, g_curlShare);
+
+            curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+            // A connection that stops sending fails as a timeout, which the range downloads retry
+            curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, CONNECT_TIMEOUT_SECONDS);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)std::max(inst::config::httpStallSeconds, 1));
+        }
+
+        return curl;
+    }
+
+    void ReleaseCurl(CURL* curl)
+    {
+        // Resetting drops the options but keeps the handle's connections and caches
+        curl_easy_reset(curl);
+
+        {
+            std::lock_guard<std::mutex> lock(g_poolMutex);
+
+            if (g_idleCurlHandles.size() < MAX_IDLE_CURL_HANDLES)
+            {
+                g_idleCurlHandles.push_back(curl);
+                return;
+            }
+        }
+
+        curl_easy_cleanup(curl);
+    }
+
+    void ClearConnectionPool()
+    {
+        std::lock_guard<std::mutex> lock(g_poolMutex);
+
+        for (CURL* curl : g_idleCurlHandles)
+            curl_easy_cleanup(curl);
+
+        g_idleCurlHandles.clear();
+
+        // Fails while a handle still uses it, it is then left for the next clear
+        if (g_curlShare && curl_share_cleanup(g_curlShare) == CURLSHE_OK)
+            g_curlShare = NULL;
+    }
+
+    // End connection pool
     // HTTPHeader
 
     HTTPHeader::HTTPHeader(std::string url) :
@@ -91,7 +206,7 @@ namespace tin::network
         // We don't want any existing values to get mixed up with this request
         m_values.clear();
 
-        CURL* curl = curl_easy_init();
+        CURL* curl = AcquireCurl();
         CURLcode rc = (CURLcode)0;
 
         if (!curl)
@@ -106,17 +221,18 @@ namespace tin::network
         curl_easy_setopt(curl, CURLOPT_HEADERDATA, this);
         curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &tin::network::HTTPHeader::ParseHTMLHeader);
         std::string authValue;
-        ApplyBasicAuth(curl, authValue);
+        ApplyBasicAuth(curl, m_url, authValue);
 
         rc = curl_easy_perform(curl);
         if (rc != CURLE_OK)
         {
+            ReleaseCurl(curl);
             THROW_FORMAT("Failed to retrieve HTTP Header: %s\n", curl_easy_strerror(rc));
         }
 
         u64 httpCode = 0;
         curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
-        curl_easy_cleanup(curl);
+        ReleaseCurl(curl);
 
         if (httpCode != 200 && httpCode != 204)
         {
@@ -149,7 +265,7 @@ namespace tin::network
         }
         else
         {
-            CURL* curl = curl_easy_init();
+            CURL* curl = AcquireCurl();
             CURLcode rc = (CURLcode)0;
 
             if (!curl)
@@ -163,17 +279,18 @@ namespace tin::network
             curl_easy_setopt(curl, CURLOPT_USERAGENT, "tinfoil");
             curl_easy_setopt(curl, CURLOPT_RANGE, "0-0");
             std::string authValue;
-            ApplyBasicAuth(curl, authValue);
+            ApplyBasicAuth(curl, m_url, authValue);
 
             rc = curl_easy_perform(curl);
             if (rc != CURLE_OK)
             {
+                ReleaseCurl(curl);
                 THROW_FORMAT("Failed to retrieve HTTP Header: %s\n", curl_easy_strerror(rc));
             }
 
             u64 httpCode = 0;
             curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
-            curl_easy_cleanup(curl);
+            ReleaseCurl(curl);
 
             m_rangesSupported = httpCode == 206;
         }
@@ -213,6 +330,59 @@ namespace tin::network
         this->StreamDataRange(offset, size, streamFunc);
     }
 
+    static const u64 RETRY_BASE_DELAY_MS = 500;
+    static const u64 RETRY_MAX_DELAY_MS = 8000;
+
+    // Errors a fresh request stands a chance of getting past. Anything else, including the stream
+    // function refusing data, is final.
+    static bool IsRecoverableError(CURLcode rc, u64 httpCode)
+    {
+        switch (rc)
+        {
+            case CURLE_OK:
+                return httpCode == 408 || httpCode == 429 || httpCode >= 500;
+            case CURLE_COULDNT_RESOLVE_HOST:
+            case CURLE_COULDNT_CONNECT:
+            case CURLE_PARTIAL_FILE:
+            case CURLE_OPERATION_TIMEDOUT:
+            case CURLE_GOT_NOTHING:
+            case CURLE_SEND_ERROR:
+            case CURLE_RECV_ERROR:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Doubles with every attempt that made no progress
+    static u64 GetRetryDelayMs(u32 attempt)
+    {
+        return std::min(RETRY_BASE_DELAY_MS << std::min(attempt, 5u), RETRY_MAX_DELAY_MS);
+    }
+
+    enum class RangeBody
+    {
+        Data,
+        Discard,
+        Refuse
+    };
+
+    // Only the body of a 206 is the requested range. An error page is read and dropped so its status
+    // can decide on a retry, anything else (a 200 with the whole file) is refused before it's read.
+    static RangeBody CheckRangeBody(CURL* curl)
+    {
+        u64 httpCode = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
+
+        if (httpCode == 206)
+            return RangeBody::Data;
+
+        if (httpCode >= 400)
+            return RangeBody::Discard;
+
+        return RangeBody::Refuse;
+    }
+
     int HTTPDownload::StreamDataRange(size_t offset, size_t size, std::function<size_t (u8* bytes, size_t size)> streamFunc)
     {
         if (!m_rangesSupported)
@@ -220,53 +390,497 @@ namespace tin::network
             THROW_FORMAT("Attempted range request when ranges aren't supported!\n");
         }
 
-        auto writeDataFunc = streamFunc;
+        // Count what the consumer has accepted, so a retry can carry on right after it
+        size_t delivered = 0;
+        CURL* curl = NULL;
 
-        CURL* curl = curl_easy_init();
-        CURLcode rc = (CURLcode)0;
+        std::function<size_t (u8* bytes, size_t size)> writeDataFunc = [&](u8* bytes, size_t numBytes) -> size_t
+        {
+            switch (CheckRangeBody(curl))
+            {
+                case RangeBody::Discard:
+                    return numBytes;
+                case RangeBody::Refuse:
+                    return 0;
+                default:
+                    break;
+            }
 
-        if (!curl)
+            size_t accepted = streamFunc(bytes, numBytes);
+            delivered += accepted;
+            return accepted;
+        };
+
+        u32 attempt = 0;
+
+        while (true)
         {
-            THROW_FORMAT("Failed to initialize curl\n");
+            curl = AcquireCurl();
+            CURLcode rc = (CURLcode)0;
+
+            if (!curl)
+            {
+                THROW_FORMAT("Failed to initialize curl\n");
+            }
+
+            size_t attemptStart = delivered;
+
+            std::stringstream ss;
+            ss << (offset + delivered) << "-" << (offset + size - 1);
+            auto range = ss.str();
+
+            curl_easy_setopt(curl, CURLOPT_URL, m_url.c_str());
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, false);
+            curl_easy_setopt(curl, CURLOPT_USERAGENT, "tinfoil");
+            curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
+            // libcurl owns its receive buffer, so make it as large as allowed to cut down on callbacks
+            curl_easy_setopt(curl, CURLOPT_BUFFERSIZE, 0x80000L);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &writeDataFunc);
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &tin::network::HTTPDownload::ParseHTMLData);
+            std::string authValue;
+            ApplyBasicAuth(curl, m_url, authValue);
+
+            rc = curl_easy_perform(curl);
+
+            u64 httpCode = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
+            ReleaseCurl(curl);
+
+            if ((httpCode == 206 && rc == CURLE_OK) || delivered == size) return 0;
+
+            // A server that ignores the range on a retry would send the file from the start
+            if (!IsRecoverableError(rc, httpCode) || (httpCode && httpCode != 206 && httpCode < 400))
+                return 1;
+
+            if (delivered > attemptStart)
+                attempt = 0;
+
+            if (attempt >= (u32)std::max(inst::config::httpRetries, 0))
+                return 1;
+
+            u64 delayMs = GetRetryDelayMs(attempt++);
+            LOG_DEBUG("Range request at 0x%lx failed: %s, HTTP %lu. Retrying in %lu ms\n", offset + delivered, curl_easy_strerror(rc), httpCode, delayMs);
+            svcSleepThread(delayMs * 1000000);
         }
+    }
+
+    // Segmented downloads are cut into pieces of this size. Pieces past the one currently being streamed
+    // are held in memory, at most the number of connections plus SEGMENTED_READ_AHEAD of them.
+    static const size_t SEGMENTED_PIECE_SIZE = 0x400000;
+    static const size_t SEGMENTED_MIN_SIZE = 4 * SEGMENTED_PIECE_SIZE;
+    static const u32 SEGMENTED_MIN_CONNECTIONS = 2;
+    static const u32 SEGMENTED_MAX_CONNECTIONS = 4;
+    static const u32 SEGMENTED_READ_AHEAD = 2;
+    static const u64 SEGMENTED_ADAPT_INTERVAL_MS = 2000;
+
+    struct SegmentedDownload;
 
+    struct SegmentedPiece
+    {
+        SegmentedDownload* download = NULL;
+        CURL* curl = NULL;
+        size_t offset = 0;
+        size_t size = 0;
+        size_t received = 0;
+        bool done = false;
+        // Set while a failed piece waits to be requested again from where it got to
+        u64 retryTick = 0;
+        u32 attempt = 0;
+        size_t attemptStart = 0;
+        // Only the head piece passes data straight through, the others buffer it until they become the head
+        bool direct = false;
+        std::vector<u8> buffer;
+    };
+
+    struct SegmentedDownload
+    {
+        std::function<size_t (u8* bytes, size_t size)> streamFunc;
+        std::deque<std::unique_ptr<SegmentedPiece>> pieces;
+        size_t bytesReceived = 0;
+        bool aborted = false;
+    };
+
+    static size_t SegmentedWriteFunc(char* bytes, size_t size, size_t numItems, void* userData)
+    {
+        SegmentedPiece* piece = reinterpret_cast<SegmentedPiece*>(userData);
+        size_t numBytes = size * numItems;
+
+        switch (CheckRangeBody(piece->curl))
+        {
+            case RangeBody::Discard:
+                return numBytes;
+            case RangeBody::Refuse:
+                LOG_DEBUG("Segment at 0x%lx got a response other than 206\n", piece->offset);
+                return 0;
+            default:
+                break;
+        }
+
+        if (piece->received + numBytes > piece->size)
+        {
+            LOG_DEBUG("Segment at 0x%lx received more data than requested\n", piece->offset);
+            return 0;
+        }
+
+        if (piece->direct)
+        {
+            if (piece->download->streamFunc((u8*)bytes, numBytes) != numBytes)
+            {
+                piece->download->aborted = true;
+                return 0;
+            }
+        }
+        else
+        {
+            piece->buffer.insert(piece->buffer.end(), (u8*)bytes, (u8*)bytes + numBytes);
+        }
+
+        piece->received += numBytes;
+        piece->download->bytesReceived += numBytes;
+        return numBytes;
+    }
+
+    // (Re)issues the request for whatever part of the piece hasn't been received yet
+    static void StartSegmentedPiece(CURLM* multi, SegmentedPiece* piece)
+    {
         std::stringstream ss;
-        ss << offset << "-" << (offset + size - 1);
-        auto range = ss.str();
+        ss << (piece->offset + piece->received) << "-" << (piece->offset + piece->size - 1);
 
-        curl_easy_setopt(curl, CURLOPT_URL, m_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, false);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, "tinfoil");
-        curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &writeDataFunc);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &tin::network::HTTPDownload::ParseHTMLData);
-        std::string authValue;
-        ApplyBasicAuth(curl, authValue);
+        piece->attemptStart = piece->received;
+        curl_easy_setopt(piece->curl, CURLOPT_RANGE, ss.str().c_str());
+        curl_multi_add_handle(multi, piece->curl);
+    }
 
-        rc = curl_easy_perform(curl);
+    int HTTPDownload::StreamDataRangeSegmented(size_t offset, size_t size, std::function<size_t (u8* bytes, size_t size)> streamFunc)
+    {
+        if (!m_rangesSupported)
+        {
+            THROW_FORMAT("Attempted range request when ranges aren't supported!\n");
+        }
 
-        u64 httpCode = 0;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
-        curl_easy_cleanup(curl);
+        // Not worth the extra connections
+        if (size < SEGMENTED_MIN_SIZE)
+            return this->StreamDataRange(offset, size, streamFunc);
+
+        CURLM* multi = curl_multi_init();
+
+        if (!multi)
+        {
+            THROW_FORMAT("Failed to initialize curl\n");
+        }
+
+        SegmentedDownload download;
+        download.streamFunc = streamFunc;
+
+        const size_t end = offset + size;
+        size_t nextOffset = offset;
+        u32 numConnections = SEGMENTED_MIN_CONNECTIONS;
+        u32 numActive = 0;
+        int result = 0;
+
+        u64 freq = armGetSystemTickFreq();
+        u64 windowStart = armGetSystemTick();
+        size_t windowBytes = 0;
+        double lastRate = 0.0;
+
+        while (true)
+        {
+            // Keep every connection busy, as long as the read ahead allows it
+            while (numActive < numConnections && nextOffset < end && download.pieces.size() < numConnections + SEGMENTED_READ_AHEAD)
+            {
+                auto piece = std::make_unique<SegmentedPiece>();
+                piece->download = &download;
+                piece->offset = nextOffset;
+                piece->size = std::min(SEGMENTED_PIECE_SIZE, end - nextOffset);
+                piece->direct = download.pieces.empty();
+                piece->curl = AcquireCurl();
+
+                if (!piece->curl)
+                {
+                    result = 1;
+                    break;
+                }
+
+                if (!piece->direct)
+                    piece->buffer.reserve(piece->size);
+
+                curl_easy_setopt(piece->curl, CURLOPT_URL, m_url.c_str());
+                curl_easy_setopt(piece->curl, CURLOPT_SSL_VERIFYPEER, false);
+                curl_easy_setopt(piece->curl, CURLOPT_USERAGENT, "tinfoil");
+                curl_easy_setopt(piece->curl, CURLOPT_BUFFERSIZE, 0x80000L);
+                curl_easy_setopt(piece->curl, CURLOPT_WRITEDATA, piece.get());
+                curl_easy_setopt(piece->curl, CURLOPT_WRITEFUNCTION, &SegmentedWriteFunc);
+                curl_easy_setopt(piece->curl, CURLOPT_PRIVATE, piece.get());
+                std::string authValue;
+                ApplyBasicAuth(piece->curl, m_url, authValue);
+
+                StartSegmentedPiece(multi, piece.get());
+                nextOffset += piece->size;
+                numActive++;
+                download.pieces.push_back(std::move(piece));
+            }
+
+            if (result || (nextOffset == end && download.pieces.empty()))
+                break;
+
+            // Request failed pieces again once they've waited out their backoff
+            u64 now = armGetSystemTick();
+
+            for (auto& piece : download.pieces)
+            {
+                if (piece->retryTick && now >= piece->retryTick)
+                {
+                    piece->retryTick = 0;
+                    StartSegmentedPiece(multi, piece.get());
+                }
+            }
 
-        if (httpCode != 206 || rc != CURLE_OK) return 1;
-        return 0;
+            int running = 0;
+            curl_multi_perform(multi, &running);
+
+            CURLMsg* msg = NULL;
+            int msgsLeft = 0;
+
+            while ((msg = curl_multi_info_read(multi, &msgsLeft)))
+            {
+                if (msg->msg != CURLMSG_DONE)
+                    continue;
+
+                SegmentedPiece* piece = NULL;
+                u64 httpCode = 0;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &piece);
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &httpCode);
+
+                curl_multi_remove_handle(multi, piece->curl);
+
+                // A connection dropping after the last byte still delivered the whole piece
+                if (httpCode != 206 || piece->received != piece->size)
+                {
+                    bool recoverable = IsRecoverableError(msg->data.result, httpCode) || (msg->data.result == CURLE_OK && httpCode == 206);
+
+                    if (piece->received > piece->attemptStart)
+                        piece->attempt = 0;
+
+                    if (recoverable && !download.aborted && piece->attempt < (u32)std::max(inst::config::httpRetries, 0))
+                    {
+                        u64 delayMs = GetRetryDelayMs(piece->attempt++);
+                        LOG_DEBUG("Segment at 0x%lx failed: %s, HTTP %lu. Retrying in %lu ms\n", piece->offset + piece->received, curl_easy_strerror(msg->data.result), httpCode, delayMs);
+                        piece->retryTick = armGetSystemTick() + freq * delayMs / 1000;
+                        continue;
+                    }
+
+                    LOG_DEBUG("Segment at 0x%lx failed: %s, HTTP %lu\n", piece->offset, curl_easy_strerror(msg->data.result), httpCode);
+                    result = 1;
+                }
+
+                ReleaseCurl(piece->curl);
+                piece->curl = NULL;
+                piece->done = true;
+                numActive--;
+            }
+
+            if (result || download.aborted)
+            {
+                result = 1;
+                break;
+            }
+
+            // Retire finished pieces from the head, the next one flushes what it has buffered and goes direct
+            while (!download.pieces.empty() && download.pieces.front()->done)
+            {
+                download.pieces.pop_front();
+
+                if (download.pieces.empty())
+                    break;
+
+                SegmentedPiece* head = download.pieces.front().get();
+
+                if (head->buffer.size() && streamFunc(head->buffer.data(), head->buffer.size()) != head->buffer.size())
+                {
+                    result = 1;
+                    break;
+                }
+
+                head->direct = true;
+                head->buffer = std::vector<u8>();
+            }
+
+            if (result)
+                break;
+
+            // Add a connection for as long as that keeps paying off, drop one when throughput falls
+            now = armGetSystemTick();
+
+            if (now - windowStart >= freq * SEGMENTED_ADAPT_INTERVAL_MS / 1000)
+            {
+                double rate = (double)(download.bytesReceived - windowBytes) / ((double)(now - windowStart) / (double)freq);
+
+                if (rate > lastRate * 1.1 && numConnections < SEGMENTED_MAX_CONNECTIONS)
+                    numConnections++;
+                else if (rate < lastRate * 0.9 && numConnections > SEGMENTED_MIN_CONNECTIONS)
+                    numConnections--;
+
+                LOG_DEBUG("Segmented download at %.2f MB/s over %u connections\n", rate / 1000000.0, numConnections);
+                lastRate = rate;
+                windowStart = now;
+                windowBytes = download.bytesReceived;
+            }
+
+            curl_multi_wait(multi, NULL, 0, 100, NULL);
+        }
+
+        for (auto& piece : download.pieces)
+        {
+            if (piece->curl)
+            {
+                curl_multi_remove_handle(multi, piece->curl);
+                ReleaseCurl(piece->curl);
+            }
+        }
+
+        curl_multi_cleanup(multi);
+        return result;
     }
 
     // End HTTPDownload
+    // HTTPRangeCache
+
+    static const size_t RANGE_CACHE_PREFETCH_SIZE = 0x40000;
+    static const size_t RANGE_CACHE_MIN_FETCH_SIZE = 0x10000;
+    // Anything bigger isn't header data and goes straight to the server
+    static const size_t RANGE_CACHE_MAX_READ_SIZE = 0x100000;
+    static const size_t RANGE_CACHE_MAX_SIZE = 0x800000;
+
+    HTTPRangeCache::HTTPRangeCache(HTTPDownload& download) :
+        m_download(download)
+    {
+    }
+
+    bool HTTPRangeCache::ReadCached(void* buffer, size_t offset, size_t size)
+    {
+        auto it = m_ranges.upper_bound(offset);
+
+        if (it == m_ranges.begin())
+            return false;
+
+        --it;
+
+        if (offset + size > it->first + it->second.size())
+            return false;
+
+        memcpy(buffer, it->second.data() + (offset - it->first), size);
+        return true;
+    }
+
+    void HTTPRangeCache::Insert(size_t offset, std::vector<u8>& data)
+    {
+        if (m_cachedSize + data.size() > RANGE_CACHE_MAX_SIZE)
+        {
+            m_ranges.clear();
+            m_cachedSize = 0;
+        }
+
+        size_t start = offset;
+        size_t end = offset + data.size();
+
+        // Find every range that overlaps or touches the new one
+        auto first = m_ranges.upper_bound(start);
+
+        if (first != m_ranges.begin() && std::prev(first)->first + std::prev(first)->second.size() >= start)
+            --first;
+
+        auto last = first;
+
+        while (last != m_ranges.end() && last->first <= end)
+        {
+            start = std::min(start, last->first);
+            end = std::max(end, last->first + last->second.size());
+            ++last;
+        }
+
+        std::vector<u8> merged(end - start);
+
+        for (auto it = first; it != last; ++it)
+        {
+            memcpy(merged.data() + (it->first - start), it->second.data(), it->second.size());
+            m_cachedSize -= it->second.size();
+        }
+
+        memcpy(merged.data() + (offset - start), data.data(), data.size());
+        m_ranges.erase(first, last);
 
-    void SetBasicAuth(const std::string& user, const std::string& pass)
+        m_cachedSize += merged.size();
+        m_ranges[start] = std::move(merged);
+    }
+
+    void HTTPRangeCache::BufferDataRange(void* buffer, size_t offset, size_t size)
     {
-        g_basic_auth_user = user;
-        g_basic_auth_pass = pass;
-        g_basic_auth_set = true;
+        if (size > RANGE_CACHE_MAX_READ_SIZE)
+        {
+            m_download.BufferDataRange(buffer, offset, size, nullptr);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (this->ReadCached(buffer, offset, size))
+            return;
+
+        size_t fetchSize = std::max(size, m_prefetched ? RANGE_CACHE_MIN_FETCH_SIZE : RANGE_CACHE_PREFETCH_SIZE);
+        m_prefetched = true;
+
+        // The window may run past the end of the file, the server then just sends less
+        std::vector<u8> data;
+        data.reserve(fetchSize);
+
+        auto streamFunc = [&](u8* streamBuf, size_t streamBufSize) -> size_t
+        {
+            if (data.size() + streamBufSize > fetchSize)
+                return 0;
+
+            data.insert(data.end(), streamBuf, streamBuf + streamBufSize);
+            return streamBufSize;
+        };
+
+        // A failed request may have streamed part of the window, none of it is cached
+        if (m_download.StreamDataRange(offset, fetchSize, streamFunc) != 0 || data.size() < size)
+        {
+            THROW_FORMAT("Failed to read 0x%lx bytes at 0x%lx\n", size, offset);
+        }
+
+        memcpy(buffer, data.data(), size);
+        this->Insert(offset, data);
+    }
+
+    // End HTTPRangeCache
+
+    void SetBasicAuth(const std::string& url, const std::string& user, const std::string& pass)
+    {
+        std::lock_guard<std::mutex> lock(g_basicAuthMutex);
+        if (user.empty() && pass.empty())
+            g_basicAuth.erase(GetUrlOrigin(url));
+        else
+            g_basicAuth[GetUrlOrigin(url)] = user + ":" + pass;
+    }
+
+    bool GetBasicAuth(const std::string& url, std::string& authValue)
+    {
+        std::lock_guard<std::mutex> lock(g_basicAuthMutex);
+        if (g_basicAuth.empty())
+            return false;
+
+        auto found = g_basicAuth.find(GetUrlOrigin(url));
+        if (found == g_basicAuth.end())
+            return false;
+
+        authValue = found->second;
+        return true;
     }
 
     void ClearBasicAuth()
     {
-        g_basic_auth_user.clear();
-        g_basic_auth_pass.clear();
-        g_basic_auth_set = false;
+        std::lock_guard<std::mutex> lock(g_basicAuthMutex);
+        g_basicAuth.clear();
     }
 
     size_t WaitReceiveNetworkData(int sockfd, void* buf, size_t len)
@@ -0,0 +1,158 @@
+#include "util/title_icon_cache.hpp"
+
+#include <algorithm>
+#include "util/error.hpp"
+
+namespace tin::util
+{
+    // Plenty for several pages of the installed grid, icons are usually 20-100KB
+    static const u64 MAX_CACHED_ICON_BYTES = 16 * 1024 * 1024;
+    static const size_t MAX_QUEUED_ICONS = 128;
+
+    TitleIconCache& TitleIconCache::Get()
+    {
+        static TitleIconCache cache;
+        return cache;
+    }
+
+    TitleIconCache::~TitleIconCache()
+    {
+        m_stop = true;
+        m_cv.notify_all();
+        if (m_worker.joinable())
+            m_worker.join();
+    }
+
+    void TitleIconCache::Enqueue(u64 baseTitleId, bool front)
+    {
+        if (!m_worker.joinable())
+            m_worker = std::thread(&TitleIconCache::WorkerMain, this);
+
+        auto queued = std::find(m_queue.begin(), m_queue.end(), baseTitleId);
+        if (queued != m_queue.end())
+        {
+            if (!front)
+                return;
+            m_queue.erase(queued);
+        }
+
+        if (front)
+            m_queue.push_front(baseTitleId);
+        else
+            m_queue.push_back(baseTitleId);
+
+        while (m_queue.size() > MAX_QUEUED_ICONS)
+            m_queue.pop_back();
+        m_cv.notify_one();
+    }
+
+    bool TitleIconCache::Find(u64 baseTitleId, Icon& out)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(baseTitleId);
+        if (it != m_entries.end())
+        {
+            it->second.lastUsed = ++m_useCounter;
+            out = it->second.icon;
+            return true;
+        }
+
+        out = nullptr;
+        this->Enqueue(baseTitleId, true);
+        return false;
+    }
+
+    void TitleIconCache::Prefetch(const std::vector<u64>& baseTitleIds)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto baseTitleId : baseTitleIds)
+        {
+            if (!m_entries.count(baseTitleId))
+                this->Enqueue(baseTitleId, false);
+        }
+    }
+
+    void TitleIconCache::Invalidate(u64 baseTitleId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_reading == baseTitleId)
+            m_readingInvalidated = true;
+
+        auto it = m_entries.find(baseTitleId);
+        if (it == m_entries.end())
+            return;
+
+        m_totalSize -= it->second.icon ? it->second.icon->size() : 0;
+        m_entries.erase(it);
+        m_generation++;
+    }
+
+    u64 TitleIconCache::GetGeneration()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_generation;
+    }
+
+    void TitleIconCache::WorkerMain()
+    {
+        if (R_FAILED(nsInitialize()))
+        {
+            LOG_DEBUG("Title icon cache could not initialize ns\n");
+            return;
+        }
+
+        // Too big for the stack of a thread
+        auto controlData = std::make_unique<NsApplicationControlData>();
+
+        while (true)
+        {
+            u64 baseTitleId = 0;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [&]() { return m_stop || !m_queue.empty(); });
+                if (m_stop)
+                    break;
+                baseTitleId = m_queue.front();
+                m_queue.pop_front();
+                if (m_entries.count(baseTitleId))
+                    continue;
+                m_reading = baseTitleId;
+                m_readingInvalidated = false;
+            }
+
+            Icon icon;
+            u64 sizeRead = 0;
+            if (R_SUCCEEDED(nsGetApplicationControlData(NsApplicationControlSource_Storage, baseTitleId, controlData.get(), sizeof(NsApplicationControlData), &sizeRead)) && sizeRead > sizeof(controlData->nacp))
+            {
+                const u8* iconData = controlData->icon;
+                icon = std::make_shared<std::vector<u8>>(iconData, iconData + (sizeRead - sizeof(controlData->nacp)));
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_reading = 0;
+            if (m_readingInvalidated)
+            {
+                // Read again the next time it's asked for
+                m_generation++;
+                continue;
+            }
+
+            auto& entry = m_entries[baseTitleId];
+            entry.icon = icon;
+            entry.lastUsed = ++m_useCounter;
+            m_totalSize += icon ? icon->size() : 0;
+            m_generation++;
+
+            while (m_totalSize > MAX_CACHED_ICON_BYTES && m_entries.size() > 1)
+            {
+                auto oldest = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& a, const auto& b) {
+                    return a.second.lastUsed < b.second.lastUsed;
+                });
+                m_totalSize -= oldest->second.icon ? oldest->second.icon->size() : 0;
+                m_entries.erase(oldest);
+            }
+        }
+
+        nsExit();
+    }
+}
@@ -10,11 +10,15 @@
 #include "switch.h"
 #include "util/util.hpp"
 #include "nx/ipc/tin_ipc.h"
+#include "data/buffer_segment_pool.hpp"
+#include "util/network_util.hpp"
 #include "util/config.hpp"
 #include "util/curl.hpp"
 #include "ui/MainApplication.hpp"
 #include "util/usb_comms_awoo.h"
 #include "util/json.hpp"
+#include "shopIcons.hpp"
+#include "shopInstall.hpp"
 
 namespace inst::util {
     void initApp () {
@@ -32,6 +36,8 @@ namespace inst::util {
     }
 
     void deinitApp () {
+        shopInstStuff::StopCacheRevalidation();
+        shopInstStuff::ShopIconService::Get().Stop();
         socketExit();
         awoo_usbCommsExit();
     }
@@ -50,6 +56,9 @@ namespace inst::util {
         esExit();
         splCryptoExit();
         splExit();
+        // Don't hold on to the install buffers once a batch is done
+        tin::data::BufferSegmentPool::Get().Trim();
+        tin::network::ClearConnectionPool();
     }
 
     bool ignoreCaseCompare(const std::string &a, const std::string &b) {